@@ -0,0 +1,167 @@
+#include <benchmark/benchmark.h>
+#include "../include/proxy/CachedResponse.hpp"
+#include "../include/proxy/ShardedLruCache.hpp"
+#include "bench_util.hpp"
+#include <string>
+#include <vector>
+
+using proxy::CachedResponse;
+using proxy::ResponseSink;
+
+namespace
+{
+    // Copies what it is given into one reused buffer, standing in for the kernel's copy
+    // into a socket buffer without a syscall in the measurement
+    class CopySink : public ResponseSink
+    {
+    public:
+        void write(std::string_view data) override { out.append(data); }
+
+        std::string out;
+    };
+
+    // An origin 200 with `header_count` end-to-end headers (plus the hop-by-hop ones sealing drops)
+    CachedResponse make_entry(size_t body_bytes, int header_count)
+    {
+        CachedResponse entry;
+        entry.status_line = "HTTP/1.1 200 OK";
+        entry.headers.add("Content-Type", "video/mp4");
+        entry.headers.add("Content-Length", std::to_string(body_bytes));
+        entry.headers.add("Cache-Control", "public, max-age=3600");
+        entry.headers.add("ETag", "\"5f2b-1a2b3c4d\"");
+        entry.headers.add("Connection", "keep-alive");
+        entry.headers.add("Keep-Alive", "timeout=5");
+        for (int i = 4; i < header_count; ++i)
+            entry.headers.add("X-Origin-Field-" + std::to_string(i), "value-" + std::to_string(i));
+        entry.etag = "\"5f2b-1a2b3c4d\"";
+        entry.received_at = std::chrono::steady_clock::now();
+        entry.max_age = std::chrono::seconds(3600);
+        entry.expires_at = entry.received_at + entry.max_age;
+        return entry;
+    }
+
+    // Once per fill: pre-serialize the head block and take ownership of the body
+    void BM_SealCacheEntry(benchmark::State &state)
+    {
+        const size_t body_bytes = static_cast<size_t>(state.range(0));
+        CachedResponse entry = make_entry(body_bytes, static_cast<int>(state.range(1)));
+        for (auto _ : state)
+        {
+            CachedResponse sealed = entry;
+            proxy::seal_cache_entry(sealed, std::vector<char>(body_bytes, 'b'));
+            benchmark::DoNotOptimize(sealed);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // Once per hit: per-hit headers, then head block, per-hit headers and body into the sink
+    void BM_SendCachedResponse(benchmark::State &state)
+    {
+        const size_t body_bytes = static_cast<size_t>(state.range(0));
+        CachedResponse entry = make_entry(body_bytes, static_cast<int>(state.range(1)));
+        proxy::seal_cache_entry(entry, std::vector<char>(body_bytes, 'b'));
+        CopySink sink;
+        sink.out.reserve(entry.wire_head->size() + body_bytes + 256);
+        for (auto _ : state)
+        {
+            sink.out.clear();
+            proxy::send_cached_response(sink, entry, "HIT", true);
+            benchmark::DoNotOptimize(sink.out.data());
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(sink.out.size()));
+    }
+
+    // A hit on the proxy's cache: should cost the same for any body size (a reference count,
+    // not a copy of the entry)
+    void BM_ResponseCacheHit(benchmark::State &state)
+    {
+        const size_t body_bytes = static_cast<size_t>(state.range(0));
+        CachedResponse entry = make_entry(body_bytes, static_cast<int>(state.range(1)));
+        proxy::seal_cache_entry(entry, std::vector<char>(body_bytes, 'b'));
+        auto shared = std::make_shared<const CachedResponse>(std::move(entry));
+
+        const size_t keys = 64;
+        std::vector<std::string> names = bench::make_keys(keys);
+        Cache::ShardedLruCache<std::string, proxy::CachedResponsePtr> cache(keys);
+        for (const std::string &key : names)
+            cache.put(key, shared);
+        size_t i = 0;
+        for (auto _ : state)
+        {
+            auto hit = cache.get(names[i++ % keys]);
+            benchmark::DoNotOptimize(hit);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // Byte hit ratio of the response cache by policy, on Zipf traffic over objects from 1 KB
+    // to 128 KB, optionally with every eighth stretch of 1024 requests replaced by a crawler
+    // walking keys nobody asks for again. The timed loop is the read-through itself.
+    void BM_ResponseCachePolicy(benchmark::State &state)
+    {
+        const auto policy = static_cast<Cache::EvictionPolicy>(state.range(0));
+        const bool scans = state.range(1) != 0;
+        const size_t key_space = 40000, size_classes = 8;
+
+        std::vector<proxy::CachedResponsePtr> bodies;
+        for (size_t c = 0; c < size_classes; ++c)
+        {
+            CachedResponse entry = make_entry(size_t{1024} << c, 8);
+            proxy::seal_cache_entry(entry, std::vector<char>(size_t{1024} << c, 'b'));
+            bodies.push_back(std::make_shared<const CachedResponse>(std::move(entry)));
+        }
+        std::vector<uint32_t> trace = bench::make_key_trace(bench::KeyDistribution::Zipf, key_space);
+        if (scans)
+            for (size_t i = 0; i < trace.size(); ++i)
+                if ((i >> 10) % 8 == 7)
+                    trace[i] = static_cast<uint32_t>(key_space + i); // never repeated within a pass
+        std::vector<std::string> names = bench::make_keys(key_space + trace.size());
+        auto body_for = [&](uint32_t k) { return bodies[(k * 2654435761u >> 16) % size_classes]; };
+
+        Cache::ShardedLruCache<std::string, proxy::CachedResponsePtr> cache(
+            32 << 20, 0, [](const std::string &key, const proxy::CachedResponsePtr &entry)
+            { return key.size() + proxy::cached_response_bytes(*entry); },
+            0.125, policy);
+        for (uint32_t k : trace) // warm up on one pass of the trace
+            if (!cache.get(names[k]))
+                cache.put(names[k], body_for(k));
+
+        size_t i = 0, hits = 0, hit_bytes = 0, bytes = 0;
+        for (auto _ : state)
+        {
+            const uint32_t k = trace[i++ & (trace.size() - 1)];
+            auto hit = cache.get(names[k]);
+            const size_t size = body_for(k)->body->size();
+            bytes += size;
+            if (hit)
+            {
+                ++hits;
+                hit_bytes += size;
+            }
+            else
+            {
+                cache.put(names[k], body_for(k));
+            }
+            benchmark::DoNotOptimize(hit);
+        }
+        const double requests = static_cast<double>(state.iterations());
+        state.counters["hit_ratio"] = requests ? static_cast<double>(hits) / requests : 0.0;
+        state.counters["byte_hit_ratio"] = bytes ? static_cast<double>(hit_bytes) / static_cast<double>(bytes) : 0.0;
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // body_bytes x header_count
+    void response_args(benchmark::internal::Benchmark *b)
+    {
+        b->ArgNames({"body_bytes", "headers"});
+        for (int64_t size : {1 << 10, 64 << 10, 1 << 20})
+            for (int64_t headers : {4, 16, 48})
+                b->Args({size, headers});
+    }
+}
+
+BENCHMARK(BM_SealCacheEntry)->Apply(response_args);
+BENCHMARK(BM_SendCachedResponse)->Apply(response_args);
+BENCHMARK(BM_ResponseCacheHit)->Apply(response_args);
+// policy: 0 lru, 1 tinylfu, 2 clock, 3 s3fifo, 4 slru (Cache::EvictionPolicy)
+BENCHMARK(BM_ResponseCachePolicy)->ArgNames({"policy", "scans"})->ArgsProduct({{0, 1, 2, 3, 4}, {0, 1}});
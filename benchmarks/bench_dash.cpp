@@ -0,0 +1,82 @@
+#include <benchmark/benchmark.h>
+#include "../include/proxy/DashEngine.hpp"
+#include "../include/proxy/MpdParser.hpp"
+#include "bench_util.hpp"
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using proxy::DashEngine;
+using proxy::MpdParser;
+
+namespace
+{
+    // A single-period MPD like tests/video_test_data/manifest.mpd, with `count` representations
+    std::string make_mpd(int count)
+    {
+        std::string mpd = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                          "<MPD type=\"static\" mediaPresentationDuration=\"PT600S\" minBufferTime=\"PT1.5S\" "
+                          "profiles=\"urn:mpeg:dash:profile:isoff-on-demand:2011\">\n"
+                          "  <Period duration=\"PT600S\">\n"
+                          "    <AdaptationSet mimeType=\"video/mp4\" segmentAlignment=\"true\" startWithSAP=\"1\">\n";
+        for (int i = 0; i < count; ++i)
+        {
+            std::string id = "video_" + std::to_string(i);
+            mpd += "      <Representation id=\"" + id + "\" bandwidth=\"" + std::to_string(200000 + i * 150000) +
+                   "\" width=\"" + std::to_string(426 + i * 64) + "\" height=\"" + std::to_string(240 + i * 36) +
+                   "\" codecs=\"avc1.4d401f\">\n"
+                   "        <BaseURL>" + id + "/</BaseURL>\n"
+                   "        <SegmentTemplate media=\"chunk-$Number$.m4s\" initialization=\"init.mp4\" "
+                   "startNumber=\"1\" duration=\"4\" timescale=\"1\" />\n"
+                   "      </Representation>\n";
+        }
+        return mpd + "    </AdaptationSet>\n  </Period>\n</MPD>\n";
+    }
+
+    void BM_MpdParser(benchmark::State &state)
+    {
+        std::string mpd = make_mpd(static_cast<int>(state.range(0)));
+        try
+        {
+            MpdParser probe(mpd);
+        }
+        catch (const std::exception &e)
+        {
+            state.SkipWithError(e.what());
+            return;
+        }
+        for (auto _ : state)
+        {
+            MpdParser parser(mpd);
+            benchmark::DoNotOptimize(parser);
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(mpd.size()));
+    }
+
+    // Bandwidth estimates spread over (and a little beyond) the ladder
+    void BM_DashSelectRepresentation(benchmark::State &state)
+    {
+        const int count = static_cast<int>(state.range(0));
+        std::unique_ptr<DashEngine> engine;
+        try
+        {
+            engine = std::make_unique<DashEngine>(make_mpd(count));
+        }
+        catch (const std::exception &e)
+        {
+            state.SkipWithError(e.what());
+            return;
+        }
+        std::vector<uint32_t> trace = bench::make_key_trace(bench::KeyDistribution::Uniform, 200 + count * 160);
+        size_t i = 0;
+        for (auto _ : state)
+        {
+            int kbps = static_cast<int>(trace[i++ & (trace.size() - 1)]);
+            benchmark::DoNotOptimize(engine->selectRepresentation(kbps));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+}
+
+BENCHMARK(BM_MpdParser)->ArgName("representations")->Arg(2)->Arg(8)->Arg(32);
+BENCHMARK(BM_DashSelectRepresentation)->ArgName("representations")->Arg(2)->Arg(8)->Arg(32);
@@ -0,0 +1,90 @@
+#include <benchmark/benchmark.h>
+#include "../include/proxy/HttpParser.hpp"
+#include <string>
+
+using proxy::HttpParser;
+using proxy::HttpRequest;
+using proxy::RequestHeadParser;
+
+namespace
+{
+    // A browser-like GET with `extra` additional headers after the usual handful
+    std::string make_request_head(int extra)
+    {
+        std::string head = "GET http://origin.example:8000/video_480p/chunk-17.m4s HTTP/1.1\r\n"
+                           "Host: origin.example:8000\r\n"
+                           "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n"
+                           "Accept: */*\r\n"
+                           "Accept-Encoding: gzip, deflate, br\r\n"
+                           "Connection: keep-alive\r\n";
+        for (int i = 0; i < extra; ++i)
+            head += "X-Request-Field-" + std::to_string(i) + ": value-" + std::to_string(i * 7919) + "\r\n";
+        return head + "\r\n";
+    }
+
+    // The whole-string entry point (builds an HttpRequest)
+    void BM_HttpParserParse(benchmark::State &state)
+    {
+        std::string head = make_request_head(static_cast<int>(state.range(0)));
+        for (auto _ : state)
+        {
+            HttpRequest req = HttpParser::parse(head);
+            benchmark::DoNotOptimize(req);
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(head.size()));
+    }
+
+    // The request path's entry point: scan the head in place, then build the HttpRequest
+    void BM_RequestHeadParserFeed(benchmark::State &state)
+    {
+        std::string head = make_request_head(static_cast<int>(state.range(0)));
+        RequestHeadParser parser;
+        for (auto _ : state)
+        {
+            parser.reset();
+            if (parser.feed(head) != RequestHeadParser::Status::Complete)
+            {
+                state.SkipWithError("head did not parse");
+                break;
+            }
+            HttpRequest req = HttpParser::parse(parser);
+            benchmark::DoNotOptimize(req);
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(head.size()));
+    }
+
+    // The head arriving in `range(1)`-byte reads, resumed where the last feed stopped
+    void BM_RequestHeadParserFeedSplit(benchmark::State &state)
+    {
+        std::string head = make_request_head(static_cast<int>(state.range(0)));
+        const size_t step = static_cast<size_t>(state.range(1));
+        RequestHeadParser parser;
+        for (auto _ : state)
+        {
+            parser.reset();
+            RequestHeadParser::Status status = RequestHeadParser::Status::Incomplete;
+            for (size_t n = step; status == RequestHeadParser::Status::Incomplete; n += step)
+                status = parser.feed(std::string_view(head).substr(0, n));
+            benchmark::DoNotOptimize(status);
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(head.size()));
+    }
+
+    void BM_HttpParserSerialize(benchmark::State &state)
+    {
+        HttpRequest req = HttpParser::parse(make_request_head(static_cast<int>(state.range(0))));
+        int64_t bytes = 0;
+        for (auto _ : state)
+        {
+            std::string out = HttpParser::serialize(req);
+            bytes += static_cast<int64_t>(out.size());
+            benchmark::DoNotOptimize(out);
+        }
+        state.SetBytesProcessed(bytes);
+    }
+}
+
+BENCHMARK(BM_HttpParserParse)->ArgName("extra_headers")->Arg(0)->Arg(8)->Arg(32)->Arg(90);
+BENCHMARK(BM_RequestHeadParserFeed)->ArgName("extra_headers")->Arg(0)->Arg(8)->Arg(32)->Arg(90);
+BENCHMARK(BM_RequestHeadParserFeedSplit)->ArgNames({"extra_headers", "read_bytes"})->Args({8, 64})->Args({8, 1460});
+BENCHMARK(BM_HttpParserSerialize)->ArgName("extra_headers")->Arg(0)->Arg(8)->Arg(32)->Arg(90);
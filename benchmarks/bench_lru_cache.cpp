@@ -0,0 +1,240 @@
+#include <benchmark/benchmark.h>
+#include "../include/proxy/LruCache.hpp"
+#include "../include/proxy/FlatLruCache.hpp"
+#include "../include/proxy/ShardedLruCache.hpp"
+#include "bench_util.hpp"
+#include <mutex>
+#include <string>
+
+namespace
+{
+    constexpr size_t kCapacity = 10000;
+    constexpr size_t kKeySpace = 4 * kCapacity; // a working set larger than the cache, so there are misses
+
+    struct Workload
+    {
+        std::vector<std::string> keys = bench::make_keys(kKeySpace);
+        std::vector<uint32_t> trace;
+        std::string value;
+
+        explicit Workload(const benchmark::State &state)
+            : trace(bench::make_key_trace(static_cast<bench::KeyDistribution>(state.range(1)), kKeySpace)),
+              value(static_cast<size_t>(state.range(0)), 'v')
+        {
+        }
+
+        template <typename CacheType>
+        void fill(CacheType &cache) const
+        {
+            // Warm up with the trace itself so the cache holds what the distribution favours
+            for (uint32_t k : trace)
+                cache.put(keys[k], value);
+        }
+    };
+
+    void set_hit_ratio(benchmark::State &state, size_t hits, size_t lookups)
+    {
+        double ratio = lookups ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0;
+        state.counters["hit_ratio"] = benchmark::Counter(ratio, benchmark::Counter::kAvgThreads);
+    }
+
+    using ListLru = Cache::LruCache<std::string, std::string>;
+    using FlatLru = Cache::FlatLruCache<std::string, std::string>;
+
+    // Lookups only (a hit copies the value out)
+    template <typename CacheType>
+    void cache_get(benchmark::State &state)
+    {
+        Workload w(state);
+        CacheType cache(kCapacity);
+        w.fill(cache);
+        size_t i = 0, hits = 0, lookups = 0;
+        for (auto _ : state)
+        {
+            auto v = cache.get(w.keys[w.trace[i++ & (w.trace.size() - 1)]]);
+            hits += v.has_value();
+            ++lookups;
+            benchmark::DoNotOptimize(v);
+        }
+        set_hit_ratio(state, hits, lookups);
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // Inserts and updates, evicting once the cache is full
+    template <typename CacheType>
+    void cache_put(benchmark::State &state)
+    {
+        Workload w(state);
+        CacheType cache(kCapacity);
+        w.fill(cache);
+        size_t i = 0;
+        for (auto _ : state)
+            cache.put(w.keys[w.trace[i++ & (w.trace.size() - 1)]], w.value);
+        state.SetItemsProcessed(state.iterations());
+        state.SetBytesProcessed(state.iterations() * state.range(0));
+    }
+
+    // What the proxy does per request: look up, fill on a miss
+    template <typename CacheType>
+    void cache_read_through(benchmark::State &state)
+    {
+        Workload w(state);
+        CacheType cache(kCapacity);
+        w.fill(cache);
+        size_t i = 0, hits = 0, lookups = 0;
+        for (auto _ : state)
+        {
+            const std::string &key = w.keys[w.trace[i++ & (w.trace.size() - 1)]];
+            auto v = cache.get(key);
+            if (v)
+                ++hits;
+            else
+                cache.put(key, w.value);
+            ++lookups;
+            benchmark::DoNotOptimize(v);
+        }
+        set_hit_ratio(state, hits, lookups);
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // std::list + std::unordered_map, and the open-addressing table with an intrusive list
+    void BM_LruCacheGet(benchmark::State &state) { cache_get<ListLru>(state); }
+    void BM_FlatLruCacheGet(benchmark::State &state) { cache_get<FlatLru>(state); }
+    void BM_LruCachePut(benchmark::State &state) { cache_put<ListLru>(state); }
+    void BM_FlatLruCachePut(benchmark::State &state) { cache_put<FlatLru>(state); }
+    void BM_LruCacheReadThrough(benchmark::State &state) { cache_read_through<ListLru>(state); }
+    void BM_FlatLruCacheReadThrough(benchmark::State &state) { cache_read_through<FlatLru>(state); }
+
+    // Read-through from several threads sharing one cache behind a mutex. Thread 0 sets up
+    // before the timed loop; the framework starts and stops all threads together.
+    Workload *g_shared_workload = nullptr;
+    Cache::LruCache<std::string, std::string> *g_shared_cache = nullptr;
+    std::mutex g_shared_mutex;
+
+    void BM_LruCacheReadThroughLocked(benchmark::State &state)
+    {
+        if (state.thread_index() == 0)
+        {
+            g_shared_workload = new Workload(state);
+            g_shared_cache = new Cache::LruCache<std::string, std::string>(kCapacity);
+            g_shared_workload->fill(*g_shared_cache);
+        }
+        size_t i = static_cast<size_t>(state.thread_index()) * 7919, hits = 0, lookups = 0;
+        for (auto _ : state)
+        {
+            const Workload &w = *g_shared_workload;
+            const std::string &key = w.keys[w.trace[i++ & (w.trace.size() - 1)]];
+            std::lock_guard<std::mutex> lock(g_shared_mutex);
+            auto v = g_shared_cache->get(key);
+            if (v)
+                ++hits;
+            else
+                g_shared_cache->put(key, w.value);
+            ++lookups;
+            benchmark::DoNotOptimize(v);
+        }
+        set_hit_ratio(state, hits, lookups);
+        state.SetItemsProcessed(state.iterations());
+        if (state.thread_index() == 0)
+        {
+            delete g_shared_cache;
+            delete g_shared_workload;
+        }
+    }
+
+    // The same, with the lock striped across ShardedLruCache shards
+    Cache::ShardedLruCache<std::string, std::string> *g_sharded_cache = nullptr;
+
+    void BM_ShardedLruCacheReadThrough(benchmark::State &state)
+    {
+        if (state.thread_index() == 0)
+        {
+            g_shared_workload = new Workload(state);
+            g_sharded_cache = new Cache::ShardedLruCache<std::string, std::string>(kCapacity);
+            g_shared_workload->fill(*g_sharded_cache);
+        }
+        size_t i = static_cast<size_t>(state.thread_index()) * 7919, hits = 0, lookups = 0;
+        for (auto _ : state)
+        {
+            const Workload &w = *g_shared_workload;
+            const std::string &key = w.keys[w.trace[i++ & (w.trace.size() - 1)]];
+            auto v = g_sharded_cache->get(key);
+            if (v)
+                ++hits;
+            else
+                g_sharded_cache->put(key, w.value);
+            ++lookups;
+            benchmark::DoNotOptimize(v);
+        }
+        set_hit_ratio(state, hits, lookups);
+        state.SetItemsProcessed(state.iterations());
+        if (state.thread_index() == 0)
+        {
+            delete g_sharded_cache;
+            delete g_shared_workload;
+        }
+    }
+
+    // Read-through on Zipf keys by eviction policy, over four shards so that the threads share
+    // them: Clock and S3Fifo hits take the shard lock shared, the other policies exclusively
+    Cache::ShardedLruCache<std::string, std::string> *g_policy_cache = nullptr;
+
+    void BM_ShardedCachePolicyReadThrough(benchmark::State &state)
+    {
+        if (state.thread_index() == 0)
+        {
+            g_shared_workload = new Workload(state);
+            g_policy_cache = new Cache::ShardedLruCache<std::string, std::string>(
+                kCapacity, 4, nullptr, 1.0, static_cast<Cache::EvictionPolicy>(state.range(2)));
+            g_shared_workload->fill(*g_policy_cache);
+        }
+        size_t i = static_cast<size_t>(state.thread_index()) * 7919, hits = 0, lookups = 0;
+        for (auto _ : state)
+        {
+            const Workload &w = *g_shared_workload;
+            const std::string &key = w.keys[w.trace[i++ & (w.trace.size() - 1)]];
+            auto v = g_policy_cache->get(key);
+            if (v)
+                ++hits;
+            else
+                g_policy_cache->put(key, w.value);
+            ++lookups;
+            benchmark::DoNotOptimize(v);
+        }
+        set_hit_ratio(state, hits, lookups);
+        state.SetItemsProcessed(state.iterations());
+        if (state.thread_index() == 0)
+        {
+            delete g_policy_cache;
+            delete g_shared_workload;
+        }
+    }
+
+    void policy_args(benchmark::internal::Benchmark *b)
+    {
+        b->ArgNames({"value_bytes", "zipf", "policy"});
+        for (auto policy : {Cache::EvictionPolicy::Lru, Cache::EvictionPolicy::WTinyLfu, Cache::EvictionPolicy::Clock,
+                            Cache::EvictionPolicy::S3Fifo, Cache::EvictionPolicy::Slru})
+            b->Args({4096, 1, static_cast<int64_t>(policy)});
+        b->ThreadRange(1, 8)->UseRealTime();
+    }
+
+    // value_bytes x {uniform, zipf}
+    void cache_args(benchmark::internal::Benchmark *b)
+    {
+        b->ArgNames({"value_bytes", "zipf"});
+        for (int64_t size : {64, 4096, 65536})
+            for (int64_t zipf : {0, 1})
+                b->Args({size, zipf});
+    }
+}
+
+BENCHMARK(BM_LruCacheGet)->Apply(cache_args);
+BENCHMARK(BM_FlatLruCacheGet)->Apply(cache_args);
+BENCHMARK(BM_LruCachePut)->Apply(cache_args);
+BENCHMARK(BM_FlatLruCachePut)->Apply(cache_args);
+BENCHMARK(BM_LruCacheReadThrough)->Apply(cache_args);
+BENCHMARK(BM_FlatLruCacheReadThrough)->Apply(cache_args);
+BENCHMARK(BM_LruCacheReadThroughLocked)->ArgNames({"value_bytes", "zipf"})->Args({4096, 1})->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_ShardedLruCacheReadThrough)->ArgNames({"value_bytes", "zipf"})->Args({4096, 1})->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_ShardedCachePolicyReadThrough)->Apply(policy_args);
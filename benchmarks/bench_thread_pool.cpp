@@ -0,0 +1,54 @@
+#include <benchmark/benchmark.h>
+#include "../include/proxy/ThreadPool.hpp"
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    constexpr size_t kBatch = 256;
+
+    // Enqueue a batch of trivial tasks into a pool of `range(0)` workers and wait for all of
+    // them: the per-task cost of the queue, the wake-ups and the futures
+    void BM_ThreadPoolEnqueue(benchmark::State &state)
+    {
+        ThreadPool pool(static_cast<size_t>(state.range(0)));
+        std::vector<std::future<int>> results;
+        results.reserve(kBatch);
+        for (auto _ : state)
+        {
+            for (size_t i = 0; i < kBatch; ++i)
+                results.push_back(pool.enqueue([](int x) { return x + 1; }, static_cast<int>(i)));
+            for (auto &r : results)
+                benchmark::DoNotOptimize(r.get());
+            results.clear();
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(kBatch));
+    }
+
+    // Several producer threads sharing one pool, as when every client connection hands
+    // DNS lookups or MPD parsing to the helpers
+    std::unique_ptr<ThreadPool> g_shared_pool;
+
+    void BM_ThreadPoolEnqueueContended(benchmark::State &state)
+    {
+        if (state.thread_index() == 0)
+            g_shared_pool = std::make_unique<ThreadPool>(4);
+        std::vector<std::future<int>> results;
+        results.reserve(kBatch);
+        for (auto _ : state)
+        {
+            for (size_t i = 0; i < kBatch; ++i)
+                results.push_back(g_shared_pool->enqueue([](int x) { return x + 1; }, static_cast<int>(i)));
+            for (auto &r : results)
+                benchmark::DoNotOptimize(r.get());
+            results.clear();
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(kBatch));
+        if (state.thread_index() == 0)
+            g_shared_pool.reset();
+    }
+}
+
+BENCHMARK(BM_ThreadPoolEnqueue)->ArgName("workers")->RangeMultiplier(2)->Range(1, 16)->UseRealTime();
+BENCHMARK(BM_ThreadPoolEnqueueContended)->ThreadRange(1, 8)->UseRealTime();
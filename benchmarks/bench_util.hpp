@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bench
+{
+    // Key popularity for cache benchmarks (the "zipf" argument of a benchmark)
+    enum class KeyDistribution
+    {
+        Uniform = 0,
+        Zipf = 1 // s = 0.99, roughly what CDN request logs show
+    };
+
+    /**
+     * @brief A fixed trace of key indices in [0, key_space), drawn once with a fixed seed.
+     *
+     * Benchmarks walk the trace in their timed loop so no random number generation is
+     * measured, and every run (and every build being compared) sees the same sequence.
+     */
+    inline std::vector<uint32_t> make_key_trace(KeyDistribution distribution, size_t key_space, size_t length = 1 << 16)
+    {
+        std::mt19937_64 rng(42);
+        std::vector<uint32_t> trace(length);
+        if (distribution == KeyDistribution::Uniform)
+        {
+            std::uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(key_space - 1));
+            for (uint32_t &k : trace)
+                k = pick(rng);
+            return trace;
+        }
+
+        // Inverse CDF over the rank weights 1/(r+1)^s
+        std::vector<double> cdf(key_space);
+        double sum = 0;
+        for (size_t r = 0; r < key_space; ++r)
+            cdf[r] = sum += 1.0 / std::pow(static_cast<double>(r + 1), 0.99);
+        std::uniform_real_distribution<double> u(0, sum);
+        for (uint32_t &k : trace)
+            k = static_cast<uint32_t>(std::lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin());
+        // Spread popular ranks over the key space so they do not share a hash neighbourhood
+        std::vector<uint32_t> rank_to_key(key_space);
+        for (size_t i = 0; i < key_space; ++i)
+            rank_to_key[i] = static_cast<uint32_t>(i);
+        std::shuffle(rank_to_key.begin(), rank_to_key.end(), rng);
+        for (uint32_t &k : trace)
+            k = rank_to_key[k];
+        return trace;
+    }
+
+    // Cache keys shaped like the proxy's ("host:port/path")
+    inline std::vector<std::string> make_keys(size_t count)
+    {
+        std::vector<std::string> keys;
+        keys.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+            keys.push_back("origin.example:80/video_480p/chunk-" + std::to_string(i) + ".m4s");
+        return keys;
+    }
+
+} // namespace bench
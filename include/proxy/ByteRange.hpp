@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CachedResponse.hpp"
+#include "ResponseSink.hpp"
+
+namespace proxy
+{
+    // One satisfiable byte range of a body, both ends inclusive
+    struct ByteRange
+    {
+        uint64_t first = 0;
+        uint64_t last = 0;
+        uint64_t length() const { return last - first + 1; }
+    };
+
+    // More ranges than this (after coalescing) and the Range header is ignored: the whole body
+    // is cheaper to send than hundreds of tiny parts
+    constexpr size_t kMaxByteRanges = 16;
+
+    /**
+     * @brief The ranges a `Range` header selects from a body of `length` bytes (RFC 7233).
+     *
+     * Ranges are clipped to the body, and sorted with overlapping or adjacent ones merged.
+     * @return std::nullopt if the header must be ignored (not a bytes range, malformed, or more
+     *         than kMaxByteRanges ranges), so the whole body is sent; an empty vector if no range
+     *         overlaps the body (416).
+     */
+    std::optional<std::vector<ByteRange>> parse_byte_ranges(std::string_view header, uint64_t length);
+
+    // If-Range (RFC 7233 3.2): the validator is the entry's strong ETag, or exactly its Last-Modified date
+    bool if_range_matches(std::string_view if_range, const CachedResponse &entry);
+
+    /**
+     * @brief What a GET asks of an object beyond the whole of it: the client's validators and Range.
+     *
+     * They are taken off the request before the cache lookup, so a cache fill always fetches
+     * the plain full object (never a 206, or a 304 for the client's copy), and are answered
+     * from the cached entry by cached_reply().
+     */
+    struct ClientConditions
+    {
+        std::string if_none_match;
+        std::string if_modified_since;
+        std::string range;
+        std::string if_range;
+
+        bool empty() const { return if_none_match.empty() && if_modified_since.empty() && range.empty(); }
+    };
+
+    // Move the conditional and Range headers out of a request
+    ClientConditions take_client_conditions(HttpHeaders &headers);
+
+    // Put them back, for a request the origin answers itself (an object too large to cache)
+    void restore_client_conditions(HttpHeaders &headers, const ClientConditions &conditions);
+
+    // RFC 9110 13.1.2 / 13.1.3: If-None-Match (weak comparison, or "*") decides when present,
+    // otherwise If-Modified-Since against the entry's Last-Modified
+    bool not_modified(const ClientConditions &conditions, const CachedResponse &entry);
+
+    /**
+     * @brief The response to a Range request, cut from a cached full response.
+     *
+     * A single range becomes a 206 with Content-Range; several become a 206
+     * multipart/byteranges body; none overlapping the body becomes a 416. The body pieces are
+     * views of the entry's shared body or file (sent with sendfile), so nothing is copied or
+     * read until the reply is sent.
+     *
+     * @return std::nullopt if the whole response must be sent instead: `range` is empty or
+     *         ignored, If-Range does not match, or the entry cannot be sliced (not a 200, or a
+     *         chunked body kept as received).
+     */
+    std::optional<CachedReply> range_response(const CachedResponsePtr &full, std::string_view range, std::string_view if_range);
+
+    /**
+     * @brief The response to a GET with `conditions`, cut from a cached full response: a 304 if
+     *        the client's copy is current (see not_modified()), else range_response().
+     * @return std::nullopt if the whole response must be sent.
+     */
+    std::optional<CachedReply> cached_reply(const CachedResponsePtr &full, const ClientConditions &conditions);
+
+    // send_cached_response() with the client's conditions applied (the whole entry if cached_reply() declines)
+    void send_cached_reply(ResponseSink &client, const CachedResponsePtr &cached, const ClientConditions &conditions,
+                           const char *x_cache, bool keep_alive);
+
+} // namespace proxy
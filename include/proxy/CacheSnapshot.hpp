@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "CachedResponse.hpp"
+
+namespace proxy
+{
+    class CacheSnapshot;
+
+    /**
+     * @brief Write cached responses to a snapshot file for a warm restart.
+     *
+     * One header, then per entry a fixed-size record header (sizes, wall-clock receive and
+     * expiry times, checksum) followed by key, head block, ETag, Last-Modified and body. The
+     * file is written next to `path` and renamed over it, so a crash mid-write leaves the
+     * previous snapshot intact. Entries with a file body (disk tier) are skipped.
+     *
+     * `carry_over` is the snapshot loaded at startup: its records nobody has asked for yet (and
+     * whose key is not in `entries`) are copied over as they are, so a checkpoint soon after
+     * a restart does not forget the colder part of the cache.
+     *
+     * @return Entries written.
+     * @throw std::runtime_error if the file cannot be written.
+     */
+    size_t write_cache_snapshot(const std::string &path,
+                                const std::vector<std::pair<std::string, CachedResponsePtr>> &entries,
+                                const CacheSnapshot *carry_over = nullptr);
+
+    /**
+     * @brief A snapshot written by write_cache_snapshot(), memory-mapped and handed out lazily.
+     *
+     * Opening it only walks the record headers to index the keys (views into the mapping),
+     * so the proxy can serve right away; a record's checksum is checked, and its entry
+     * rebuilt, the first time its key is asked for. Times are carried over through the wall
+     * clock, so entries that expired while the proxy was down come back stale (and can
+     * still be revalidated with their validators).
+     *
+     * Thread-safe.
+     */
+    class CacheSnapshot
+    {
+    public:
+        /** @throw std::runtime_error if the file cannot be mapped or is not a snapshot. */
+        explicit CacheSnapshot(const std::string &path);
+        ~CacheSnapshot();
+
+        CacheSnapshot(const CacheSnapshot &) = delete;
+        CacheSnapshot &operator=(const CacheSnapshot &) = delete;
+
+        /** @brief The entry for `key` (removed from the snapshot), or nullptr if absent or corrupt. */
+        CachedResponsePtr take(std::string_view key);
+
+        /** @brief Entries not taken yet. */
+        size_t size() const;
+
+    private:
+        friend size_t write_cache_snapshot(const std::string &, const std::vector<std::pair<std::string, CachedResponsePtr>> &,
+                                           const CacheSnapshot *);
+
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+        int64_t wall_to_steady_ms_ = 0; // steady = wall + this, both in ms since their epochs
+        mutable std::mutex mutex_;
+        std::unordered_map<std::string_view, size_t> index_; // key -> record offset
+    };
+
+} // namespace proxy
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "HttpHeaders.hpp"
+#include "ResponseSink.hpp"
+
+namespace proxy
+{
+    /** @brief Owns an open file descriptor (closed on destruction). */
+    class FileHandle
+    {
+    public:
+        explicit FileHandle(int fd) : fd_(fd) {}
+        ~FileHandle();
+        FileHandle(const FileHandle &) = delete;
+        FileHandle &operator=(const FileHandle &) = delete;
+
+        int fd() const { return fd_; }
+
+    private:
+        int fd_;
+    };
+
+    // A body that stays in a file (the disk tier) and goes to the client with sendfile. The
+    // handle keeps the bytes readable while a hit is being sent, even if the file was unlinked.
+    struct FileBody
+    {
+        std::shared_ptr<const FileHandle> file;
+        uint64_t offset = 0;
+        size_t length = 0;
+    };
+
+    /**
+     * @brief A cached HTTP response: the 'Value' in the proxy's response cache.
+     *
+     * The head block and body are immutable once sealed and shared by every hit, so a copy
+     * out of the cache costs two reference-count bumps rather than a copy of the payload.
+     */
+    struct CachedResponse
+    {
+        std::string status_line;                           // e.g., "HTTP/1.1 200 OK"
+        HttpHeaders headers;                               // e.g., "Content-Type: text/html"
+        std::shared_ptr<const std::vector<char>> body;     // immutable once cached; shared by every hit
+        FileBody file_body;                                // instead of `body` for entries read from the disk tier
+        std::shared_ptr<const std::string> wire_head;      // status line + end-to-end headers, pre-serialized (see seal_cache_entry)
+        std::chrono::steady_clock::time_point received_at; // the exact time when the proxy received this response from the origin server
+        std::chrono::seconds max_age;                      // calculate from Cache-Control: max-age
+        std::chrono::steady_clock::time_point expires_at;  // This would be received_at + max_age or parsed from an Expires header.
+        std::string etag;                                  // for cache validation
+        std::string last_modified;
+        std::optional<std::chrono::seconds> stale_while_revalidate; // Cache-Control windows (RFC 5861); unset:
+        std::optional<std::chrono::seconds> stale_if_error;         // the proxy's defaults apply
+        std::chrono::milliseconds fetch_time{0};                    // how long the origin fetch took (XFetch)
+
+        CachedResponse() : max_age(0) {}
+        size_t body_size() const { return body ? body->size() : file_body.length; }
+        bool is_stale() const
+        {
+            return std::chrono::steady_clock::now() > expires_at;
+        }
+    };
+
+    // Read the stale-while-revalidate / stale-if-error windows from the entry's Cache-Control
+    // header. must-revalidate, proxy-revalidate and no-cache forbid serving the entry stale.
+    void read_stale_directives(CachedResponse &entry);
+
+    /**
+     * @brief How long past expiry an entry may still be served, for entries whose origin did
+     *        not say (see read_stale_directives()), and how eagerly fresh entries are refreshed.
+     *        Both windows are 0 unless an operator opens them: without the origin's consent,
+     *        nothing is served stale.
+     */
+    struct StalePolicy
+    {
+        // Serve a stale entry at once and revalidate it in the background
+        std::chrono::seconds while_revalidate{0};
+        // Serve a stale entry when revalidation fails (origin unreachable, or a 5xx)
+        std::chrono::seconds if_error{0};
+        // XFetch: 0 disables early refresh, larger values refresh earlier
+        double early_refresh_beta = 1.0;
+    };
+
+    enum class Freshness
+    {
+        Fresh,
+        RefreshEarly,         // fresh, but picked for an early background refresh (XFetch)
+        StaleWhileRevalidate, // stale, may be served while it is revalidated in the background
+        Expired               // must be revalidated before it is served
+    };
+
+    /**
+     * @brief Classify an entry at `now`.
+     *
+     * Early refresh follows XFetch (Vattani et al., "Optimal Probabilistic Cache Stampede
+     * Prevention"): a fresh entry is refreshed when now - fetch_time * beta * ln(random) passes
+     * its expiry, so the closer a key is to expiring, and the longer its fetch takes, the more
+     * likely a request is to refresh it early, and the hits on a hot key do not all find it
+     * expired at the same moment.
+     *
+     * @param random Uniform in (0, 1].
+     */
+    Freshness cache_freshness(const CachedResponse &entry, const StalePolicy &policy,
+                              std::chrono::steady_clock::time_point now, double random);
+
+    // True while a stale entry may stand in for an origin that failed to revalidate it
+    bool usable_if_error(const CachedResponse &entry, const StalePolicy &policy, std::chrono::steady_clock::time_point now);
+
+    // How the cache holds entries: hits share one immutable entry, and a response still being
+    // sent keeps its entry alive after eviction
+    using CachedResponsePtr = std::shared_ptr<const CachedResponse>;
+
+    // Attach the body and pre-serialize the head block, once, before the entry goes into the cache.
+    // The block is always self-delimiting (Content-Length added if the origin closed the connection
+    // to end the body) and leaves out hop-by-hop and Age headers, which are added per hit.
+    void seal_cache_entry(CachedResponse &entry, std::vector<char> body);
+
+    // Rebuild the parsed header list from a sealed head block (status line first), for entries
+    // read back from the disk tier or a snapshot
+    void parse_head_block(std::string_view head, HttpHeaders &headers);
+
+    // Memory a sealed entry holds: body, head block, the parsed copy of the headers (about the
+    // size of the head block again) and the validators
+    size_t cached_response_bytes(const CachedResponse &entry);
+
+    // The small per-hit part of a cached response: Age, X-Cache, Connection and the final CRLF
+    std::string cache_hit_headers(const CachedResponse &cached, const char *x_cache, bool keep_alive);
+
+    // Send a cached response with one writev: shared head block, per-hit headers, shared body
+    // (a file body follows the headers with ResponseSink::write_file)
+    void send_cached_response(ResponseSink &client, const CachedResponse &cached, const char *x_cache, bool keep_alive);
+
+    /**
+     * @brief A response sent from a cached entry without copying its body: the entry's own head
+     *        block and whole body, or a reply built per request (a 206, 416 or 304, see
+     *        ByteRange.hpp) whose body pieces point into the entry's shared body or file.
+     */
+    struct CachedReply
+    {
+        enum class From : uint8_t
+        {
+            Text, // `text`
+            Body, // the entry's memory body
+            File  // the entry's file body (sent with sendfile)
+        };
+        struct Piece
+        {
+            From from;
+            uint64_t offset; // into the source named by `from`
+            size_t length;
+        };
+
+        CachedResponsePtr source;                // keeps the body and file the pieces point into alive
+        std::shared_ptr<const std::string> head; // status line and end-to-end headers, as in wire_head
+        std::string text;                        // multipart delimiters and part headers
+        std::vector<Piece> body;
+
+        size_t body_size() const;
+        // A memory piece's bytes (Text or Body)
+        std::string_view bytes(const Piece &piece) const;
+    };
+
+    // The entry as it is: its head block and its whole body
+    CachedReply whole_reply(CachedResponsePtr entry);
+
+    // Send a reply: head block and per-hit headers, then the pieces, runs of memory pieces with
+    // one writev and file pieces with ResponseSink::write_file
+    void send_reply(ResponseSink &client, const CachedReply &reply, const char *x_cache, bool keep_alive);
+
+} // namespace proxy
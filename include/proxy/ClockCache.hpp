@@ -0,0 +1,85 @@
+#ifndef CLOCK_CACHE_HPP
+#define CLOCK_CACHE_HPP
+
+#include "LruCache.hpp"
+#include "SlotIndex.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace Cache
+{
+    /**
+     * @brief A CLOCK cache: LruCache's interface, where a hit only sets a reference bit.
+     *
+     * Entries sit in a slot array indexed by a SlotIndex. A hit stores 1 into the entry's
+     * atomic reference bit and changes nothing else, so get() calls may run concurrently with
+     * each other (but not with put() or clear()); ShardedLruCache serves them under a shared
+     * lock. To make room, a hand sweeps the slots in order: a referenced entry has its bit
+     * cleared and is passed over, the first unreferenced one is evicted. New entries start
+     * unreferenced, so a one-off key goes before anything that was hit since the hand last
+     * passed, which approximates LRU without writing on every hit.
+     */
+    template <typename Key, typename Value>
+    class ClockCache : public WeightBudget<Key, Value>
+    {
+    public:
+        using Weigher = typename WeightBudget<Key, Value>::Weigher;
+
+        /** @brief get() and contains() may run concurrently with each other. */
+        static constexpr bool kConcurrentGet = true;
+
+        /** @brief Same parameters, and exceptions, as LruCache. */
+        explicit ClockCache(size_t capacity, Weigher weigher = nullptr, double max_entry_fraction = 1.0);
+
+        /** @brief See LruCache::put; the hand evicts until the new entry fits. */
+        bool put(const Key &key, const Value &value);
+
+        /**
+         * @brief Looks up a key and sets its reference bit.
+         * @param weight If not null and the key is found, receives the entry's weight.
+         */
+        std::optional<Value> get(KeyView<Key> key, size_t *weight = nullptr);
+
+        bool contains(KeyView<Key> key) const;
+        size_t size() const;
+        size_t weight() const;
+
+        /** @brief Copies of all items in the order the hand will reach them (does not touch the bits). */
+        std::vector<std::pair<Key, Value>> entries() const;
+
+        void clear();
+
+    private:
+        static constexpr uint32_t kNone = SlotIndex::kNone;
+
+        struct Slot
+        {
+            Key key{};
+            Value value{};
+            size_t weight = 0;
+            uint32_t next_free = kNone;
+            bool used = false;
+            std::atomic<uint8_t> referenced{0};
+        };
+
+        uint32_t find(KeyView<Key> key, uint32_t hash) const;
+        void evict(uint32_t keep);
+        void erase(uint32_t slot);
+
+        size_t weight_ = 0;
+
+        // A deque, since slots hold atomics and must not move when it grows
+        std::deque<Slot> slots_;
+        SlotIndex index_;
+        uint32_t free_ = kNone;
+        uint32_t hand_ = 0;
+    };
+
+} // namespace Cache
+
+#endif
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "CachedResponse.hpp"
+
+namespace proxy
+{
+    /**
+     * @brief The response cache's second tier: sealed responses in append-only segment files.
+     *
+     * Each store appends one record (key, head block, validators, body) to the current segment
+     * of `segment_bytes`; when the store is over `max_bytes`, the oldest segment is unlinked
+     * whole, like a FIFO, so there is no per-object free-space management or compaction. A
+     * rewritten key leaves its old record behind as garbage until that segment goes.
+     *
+     * Only bodies stay on disk. The index keeps, per object, the key and the entry without its
+     * body (head block, parsed headers, validators, freshness) whose FileBody points into the
+     * record: about 1.3 KB of memory for a typical 250-byte head, against at least tens of KB of
+     * disk for the media objects it indexes. A hit is an index lookup that hands out that
+     * shared entry, so the event loop never waits on the disk until sendfile.
+     *
+     * Thread-safe. Segment files from an earlier run are removed at startup.
+     */
+    class DiskCache
+    {
+    public:
+        struct Stats
+        {
+            uint64_t hits = 0;
+            uint64_t misses = 0;             // including stale entries, which are dropped
+            uint64_t stores = 0;
+            uint64_t rejected = 0;           // over max_object_bytes(), the write failed, or a newer store won
+            uint64_t dropped_segments = 0;
+        };
+
+        /**
+         * @param dir Directory for the segment files, created if missing.
+         * @param max_bytes Disk budget over all segments.
+         * @param segment_bytes Size of one segment, and so of the largest record; 0 picks an
+         *        eighth of the budget, between 1 MB and 256 MB.
+         * @throw std::invalid_argument if the budget cannot hold two segments.
+         * @throw std::runtime_error if the directory or first segment cannot be created.
+         */
+        DiskCache(std::string dir, size_t max_bytes, size_t segment_bytes = 0);
+
+        DiskCache(const DiskCache &) = delete;
+        DiskCache &operator=(const DiskCache &) = delete;
+
+        /**
+         * @brief Append a sealed, in-memory entry. False if it is too big or could not be written,
+         *        or if a later store of the same key finished its write first (that one is kept).
+         */
+        bool store(const std::string &key, const CachedResponse &entry);
+
+        /** @brief A fresh entry for `key` with a file body, or nullptr (a stale one is dropped). */
+        CachedResponsePtr lookup(std::string_view key);
+
+        /** @brief Largest body (plus key and head) a record can hold. */
+        size_t max_object_bytes() const;
+
+        /** @brief Bytes of segment files on disk (live records and garbage). */
+        size_t bytes() const;
+        size_t size() const;
+        Stats stats() const;
+
+    private:
+        struct Location
+        {
+            uint32_t segment = 0;
+            uint64_t sequence = 0;   // order of the stores' reservations; the latest one is served
+            std::string key;         // the index is keyed by hash; a colliding key must miss
+            CachedResponsePtr entry; // body-less, with the FileBody of the record
+        };
+
+        struct Segment
+        {
+            uint32_t id = 0;
+            std::string path;
+            std::shared_ptr<const FileHandle> file;
+            uint64_t bytes = 0;          // reserved so far
+            std::vector<uint64_t> keys;  // key hashes written here, to clean the index on drop
+        };
+
+        static uint64_t hash_key(std::string_view key);
+        void open_segment();      // caller holds mutex_
+        void drop_oldest();       // caller holds mutex_
+
+        std::string dir_;
+        size_t max_bytes_;
+        size_t segment_bytes_;
+
+        mutable std::mutex mutex_;
+        std::deque<Segment> segments_; // oldest first; the back one takes new records
+        uint32_t next_segment_id_ = 0;
+        uint64_t next_sequence_ = 0;
+        size_t total_bytes_ = 0;
+        std::unordered_map<uint64_t, Location> index_;
+        Stats stats_;
+    };
+
+} // namespace proxy
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <atomic>
+
+namespace net
+{
+    /**
+     * @brief A minimal epoll-based reactor (Linux only).
+     *
+     * Every registered fd owns one handler that receives the ready event mask.
+     * Handlers always run on the thread that called run(); other threads hand
+     * results back with post(), which wakes the loop through an eventfd.
+     * One-shot timers (run_after) bound the epoll_wait timeout and also run on
+     * the loop thread.
+     */
+    class EventLoop
+    {
+    public:
+        // Event bits passed to add()/modify() and reported to handlers.
+        static constexpr uint32_t kReadable = 1u << 0;
+        static constexpr uint32_t kWritable = 1u << 1;
+        static constexpr uint32_t kError = 1u << 2; // error or hang-up
+
+        using Handler = std::function<void(uint32_t events)>;
+        using TimerId = uint64_t;
+
+        /**
+         * @throw std::runtime_error if epoll/eventfd cannot be created (or on non-Linux builds).
+         */
+        EventLoop();
+        ~EventLoop();
+
+        /**
+         * @brief Register an fd. The handler is invoked for each readiness notification.
+         */
+        void add(int fd, uint32_t events, Handler handler);
+
+        /**
+         * @brief Change the interest set of an already registered fd (0 pauses it).
+         */
+        void modify(int fd, uint32_t events);
+
+        /**
+         * @brief Unregister an fd. Does not close it.
+         */
+        void remove(int fd);
+
+        /**
+         * @brief Queue a task to run on the loop thread. Safe to call from any thread.
+         */
+        void post(std::function<void()> task);
+
+        /**
+         * @brief Run a task on the loop thread once `delay` has elapsed. Loop thread only.
+         * @return An id for cancel_timer(); never 0, so 0 can mean "no timer".
+         */
+        TimerId run_after(std::chrono::milliseconds delay, std::function<void()> task);
+
+        /**
+         * @brief Drop a pending timer. Unknown or already fired ids are ignored.
+         */
+        void cancel_timer(TimerId id);
+
+        /**
+         * @brief Dispatch events until stop() is called.
+         */
+        void run();
+
+        /**
+         * @brief Ask run() to return after the current iteration. Safe from any thread.
+         */
+        void stop();
+
+        EventLoop(const EventLoop &) = delete;
+        EventLoop &operator=(const EventLoop &) = delete;
+
+    private:
+        void drain_posted();
+        void run_due_timers();
+        int next_timeout_ms() const;
+
+        int epoll_fd_ = -1;
+        int wake_fd_ = -1;
+        std::unordered_map<int, std::shared_ptr<Handler>> handlers_;
+        std::mutex posted_mutex_;
+        std::vector<std::function<void()>> posted_;
+        std::atomic<bool> running_{false};
+
+        using TimerKey = std::pair<std::chrono::steady_clock::time_point, TimerId>;
+        std::map<TimerKey, std::function<void()>> timers_; // ordered by deadline
+        std::unordered_map<TimerId, std::chrono::steady_clock::time_point> timer_deadlines_;
+        TimerId next_timer_id_ = 1;
+    };
+}
@@ -0,0 +1,81 @@
+#ifndef FLAT_LRU_CACHE_HPP
+#define FLAT_LRU_CACHE_HPP
+
+#include "LruCache.hpp"
+#include "SlotIndex.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace Cache
+{
+    /**
+     * @brief LruCache with the same interface, without a node allocation per entry.
+     *
+     * Entries live in one contiguous slot array, threaded on an intrusive doubly linked
+     * recency list of 32-bit slot indices; freed slots are reused through a free list. The
+     * index is a SlotIndex of 8-byte buckets (a 32-bit hash and a slot index): a lookup probes
+     * adjacent buckets and only touches a slot, to compare its key, when the stored hash matches. Each entry keeps its key once; bookkeeping beyond key and value is
+     * its weight and two indices (16 bytes) plus 11 to 21 bytes of table, where LruCache pays
+     * for a list node and a map node (two allocations, the key twice, five pointers).
+     */
+    template <typename Key, typename Value>
+    class FlatLruCache : public WeightBudget<Key, Value>
+    {
+    public:
+        using Weigher = typename WeightBudget<Key, Value>::Weigher;
+
+        /** @brief get() reorders the recency list, so it needs exclusive access. */
+        static constexpr bool kConcurrentGet = false;
+
+        /** @brief See LruCache::LruCache. */
+        explicit FlatLruCache(size_t capacity, Weigher weigher = nullptr, double max_entry_fraction = 1.0);
+
+        /** @brief See LruCache::put. */
+        bool put(const Key &key, const Value &value);
+
+        /**
+         * @brief See LruCache::get.
+         * @param weight If not null and the key is found, receives the entry's weight.
+         */
+        std::optional<Value> get(KeyView<Key> key, size_t *weight = nullptr);
+
+        bool contains(KeyView<Key> key) const;
+        size_t size() const;
+        size_t weight() const;
+
+        /** @brief Copies of all items, most recently used first (does not update usage). */
+        std::vector<std::pair<Key, Value>> entries() const;
+
+        void clear();
+
+    private:
+        static constexpr uint32_t kNone = SlotIndex::kNone;
+
+        struct Slot
+        {
+            Key key{};
+            Value value{};
+            size_t weight = 0;
+            uint32_t prev = kNone; // towards the most recently used end
+            uint32_t next = kNone; // towards the least recently used end; the free list when unused
+        };
+
+        // Bucket holding `key`, or kNone
+        uint32_t find(KeyView<Key> key, uint32_t hash) const;
+        // Drop an entry: its bucket, its place in the list, and its key and value
+        void erase(uint32_t bucket);
+
+        size_t weight_ = 0;
+
+        std::vector<Slot> slots_;
+        SlotIndex index_;
+        uint32_t free_ = kNone; // first unused slot
+        SlotList recency_;      // head: most recently used
+    };
+
+} // namespace Cache
+
+#endif
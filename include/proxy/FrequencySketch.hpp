@@ -0,0 +1,56 @@
+#ifndef FREQUENCY_SKETCH_HPP
+#define FREQUENCY_SKETCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Cache
+{
+    /**
+     * @brief Approximate, aging access counts for TinyLFU admission.
+     *
+     * A count-min sketch of 4-bit counters (16 per 64-bit word, four rows) estimates how
+     * often a key hash was seen. A doorkeeper Bloom filter absorbs the first sighting of
+     * every key, so one-hit wonders never reach the counters. After 10 x width() recorded
+     * accesses all counters are halved and the doorkeeper is cleared, so popularity decays
+     * and a formerly hot key cannot hold its place forever.
+     */
+    class FrequencySketch
+    {
+    public:
+        /** @param expected_entries Sizes the counters (rounded up to a power of two, at least 64). */
+        explicit FrequencySketch(size_t expected_entries);
+
+        /** @brief Count one access to `hash`. */
+        void record(uint64_t hash);
+
+        /** @brief Estimated accesses to `hash` since it was last aged out, at most 16. */
+        unsigned frequency(uint64_t hash) const;
+
+        /** @brief Grow to at least `expected_entries` counters; counts start over if it does. */
+        void ensure_capacity(size_t expected_entries);
+
+        size_t width() const { return width_; }
+
+        void clear();
+
+    private:
+        static constexpr unsigned kRows = 4;
+        static constexpr unsigned kMaxCount = 15;
+
+        size_t counter_index(uint64_t hash, unsigned row) const;
+        unsigned counter(size_t index) const;
+        bool doorkeeper_contains(uint64_t hash) const;
+        void age();
+
+        size_t width_ = 0;             // counters per row (power of two)
+        std::vector<uint64_t> table_;  // kRows * width_ 4-bit counters
+        std::vector<uint64_t> doorkeeper_; // width_ * 8 bits
+        size_t additions_ = 0;
+        size_t sample_size_ = 0;
+    };
+
+} // namespace Cache
+
+#endif
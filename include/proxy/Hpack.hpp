@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace proxy
+{
+    struct HeaderField
+    {
+        std::string name; // lower case on the wire in HTTP/2
+        std::string value;
+    };
+    using HeaderList = std::vector<HeaderField>;
+
+    /** Malformed header block; on HTTP/2 this is a connection error (COMPRESSION_ERROR). */
+    struct HpackError : std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * @brief HPACK (RFC 7541) decoder for the header blocks of one connection.
+     *
+     * The dynamic table carries over from one header block to the next, so every block
+     * the peer sends must go through the same decoder in order, including blocks of
+     * streams that are refused.
+     */
+    class HpackDecoder
+    {
+    public:
+        /**
+         * @param max_table_size Our SETTINGS_HEADER_TABLE_SIZE: the most the peer may grow the table to.
+         * @param max_header_list_size Decoded size (RFC 7540 6.5.2 accounting) above which a block is rejected.
+         */
+        explicit HpackDecoder(size_t max_table_size = 4096, size_t max_header_list_size = 64 * 1024);
+
+        /**
+         * @brief Decode one complete header block (HEADERS + CONTINUATION payloads joined).
+         * @throw HpackError on malformed input or when the decoded list is too large.
+         */
+        HeaderList decode(const uint8_t *data, size_t len);
+
+        size_t table_size() const { return table_bytes_; }
+
+        /** Huffman-decode a string literal (RFC 7541 5.2, Appendix B). */
+        static std::string huffman_decode(const uint8_t *data, size_t len);
+
+    private:
+        const HeaderField &lookup(uint64_t index) const;
+        void insert(HeaderField field);
+        void evict_to(size_t limit);
+
+        std::deque<HeaderField> dynamic_; // newest first
+        size_t table_bytes_ = 0;          // sum of name + value + 32 per entry
+        size_t table_limit_;              // current size, set by the peer's size updates
+        size_t max_table_size_;           // upper bound for table_limit_
+        size_t max_header_list_size_;
+    };
+
+    /**
+     * @brief HPACK encoder for response headers.
+     *
+     * Stateless on purpose: it uses the static table (fully indexed fields such as
+     * ":status: 200", indexed names otherwise) and plain literals "without indexing", so it
+     * never has to track the peer's dynamic table.
+     */
+    class HpackEncoder
+    {
+    public:
+        static std::string encode(const HeaderList &headers);
+    };
+
+} // namespace proxy
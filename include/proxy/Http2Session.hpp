@@ -0,0 +1,118 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "Hpack.hpp"
+#include "HttpParser.hpp"
+#include "ResponseSink.hpp"
+
+namespace proxy
+{
+    /**
+     * @brief Server side of one cleartext HTTP/2 (h2c) client connection, blocking I/O.
+     *
+     * The calling thread reads frames: SETTINGS, PING, WINDOW_UPDATE and RST_STREAM are
+     * handled inline, and every request stream gets its own thread running the handler,
+     * so a slow origin on one stream never holds up the others. The handler writes an
+     * ordinary HTTP/1.1 response into a ResponseSink; the session turns its head into a
+     * HEADERS frame (HPACK) and its body, de-chunked, into DATA frames, respecting the
+     * peer's connection and stream flow-control windows. Frames of different streams
+     * interleave at frame granularity over the one connection.
+     *
+     * Request bodies are not forwarded (matching the HTTP/1.1 path); DATA from the client
+     * is consumed and its flow-control credit handed back. Server push is not used.
+     */
+    class Http2Session
+    {
+    public:
+        using Handler = std::function<void(HttpRequest &req, ResponseSink &response)>;
+
+        struct Options
+        {
+            uint32_t max_concurrent_streams = 32;
+            std::chrono::seconds idle_timeout{15};        // no open stream and nothing received
+            std::chrono::seconds write_stall_timeout{30}; // a stream waiting for flow-control credit
+        };
+
+        // The client connection preface (RFC 7540 3.5)
+        static constexpr std::string_view kPreface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+        Http2Session(int fd, Handler handler, Options options);
+        // Waits for the stream threads still running
+        ~Http2Session();
+
+        /**
+         * @brief Serve the connection until the client closes it, goes idle, or breaks the protocol.
+         * @param received Bytes already read from the client, starting with the preface.
+         * @param upgraded For "Upgrade: h2c" (after the 101 was sent): the HTTP/1.1 request,
+         *        which becomes stream 1. `upgrade_settings` is its HTTP2-Settings header.
+         */
+        void run(std::string received, const HttpRequest *upgraded = nullptr, const std::string &upgrade_settings = "");
+
+        Http2Session(const Http2Session &) = delete;
+        Http2Session &operator=(const Http2Session &) = delete;
+
+    private:
+        struct Stream;
+        class StreamSink;
+
+        // Fatal for the whole connection: answered with GOAWAY(code)
+        struct ConnectionError : std::runtime_error
+        {
+            uint32_t code;
+            ConnectionError(uint32_t c, const std::string &what) : std::runtime_error(what), code(c) {}
+        };
+
+        // Reader side
+        bool consume_preface();
+        void handle_frame(uint8_t type, uint8_t flags, uint32_t stream_id, const uint8_t *payload, size_t len);
+        void on_headers(uint8_t flags, uint32_t stream_id, const uint8_t *payload, size_t len);
+        void on_header_block(uint32_t stream_id, bool end_stream);
+        void on_window_update(uint32_t stream_id, const uint8_t *payload, size_t len);
+        void apply_settings(const uint8_t *payload, size_t len);
+        void open_stream(uint32_t stream_id, HttpRequest req);
+        void reap_finished_streams();
+        size_t open_streams();
+
+        // Stream side (handler threads)
+        void serve_stream(Stream &stream, HttpRequest req);
+        void send_headers(Stream &stream, const HeaderList &headers, bool end_stream);
+        void send_data(Stream &stream, std::string_view data, bool end_stream);
+        void reset_stream(uint32_t stream_id, uint32_t code);
+
+        // Frame output, serialized by write_mutex_
+        void write_frame(uint8_t type, uint8_t flags, uint32_t stream_id, std::string_view payload);
+        void write_raw(std::string_view bytes);
+        void shut_down(); // stop everything: wake blocked writers, join stream threads
+
+        int fd_;
+        Handler handler_;
+        Options options_;
+        std::string in_;      // received, not yet parsed
+        HpackDecoder decoder_;
+        std::string header_block_;         // HEADERS + CONTINUATION fragments being collected
+        uint32_t continuation_stream_ = 0; // stream whose header block is incomplete
+        bool header_block_end_stream_ = false;
+        uint32_t last_stream_id_ = 0;
+        bool peer_going_away_ = false;
+
+        std::mutex write_mutex_; // one frame (or HEADERS + CONTINUATIONs) at a time on the socket
+
+        std::mutex mutex_; // guards everything below
+        std::condition_variable window_cv_;
+        std::map<uint32_t, std::unique_ptr<Stream>> streams_;
+        int64_t connection_window_ = 65535;
+        int64_t peer_initial_window_ = 65535;
+        size_t peer_max_frame_size_ = 16384;
+        bool closed_ = false; // connection gone: writers give up
+    };
+
+} // namespace proxy
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace proxy
+{
+    /**
+     * @brief Header names the proxy knows: looked up in O(1) by a compile-time perfect hash.
+     *
+     * Keep kHeaderNames in the same order; Other (any name not listed) must stay first.
+     */
+    enum class HeaderId : uint8_t
+    {
+        Other,
+        Accept,
+        AcceptEncoding,
+        AcceptLanguage,
+        AcceptRanges,
+        Age,
+        Authorization,
+        CacheControl,
+        Connection,
+        ContentEncoding,
+        ContentLength,
+        ContentRange,
+        ContentType,
+        Cookie,
+        Date,
+        ETag,
+        Expires,
+        Host,
+        Http2Settings,
+        IfMatch,
+        IfModifiedSince,
+        IfNoneMatch,
+        IfRange,
+        IfUnmodifiedSince,
+        KeepAlive,
+        LastModified,
+        Location,
+        Pragma,
+        ProxyConnection,
+        Range,
+        Referer,
+        Server,
+        SetCookie,
+        TE,
+        Trailer,
+        TransferEncoding,
+        Upgrade,
+        UserAgent,
+        Vary,
+        Via,
+        kCount
+    };
+
+    // Canonical spelling, indexed by HeaderId
+    inline constexpr std::array<std::string_view, static_cast<size_t>(HeaderId::kCount)> kHeaderNames = {
+        "", "Accept", "Accept-Encoding", "Accept-Language", "Accept-Ranges", "Age", "Authorization",
+        "Cache-Control", "Connection", "Content-Encoding", "Content-Length", "Content-Range", "Content-Type",
+        "Cookie", "Date", "ETag", "Expires", "Host", "HTTP2-Settings", "If-Match", "If-Modified-Since",
+        "If-None-Match", "If-Range", "If-Unmodified-Since", "Keep-Alive", "Last-Modified", "Location",
+        "Pragma", "Proxy-Connection", "Range", "Referer", "Server", "Set-Cookie", "TE", "Trailer",
+        "Transfer-Encoding", "Upgrade", "User-Agent", "Vary", "Via"};
+
+    namespace header_hash
+    {
+        constexpr size_t kSlots = 128;
+
+        // Case-folds letters; digits and '-' are unchanged by the OR
+        constexpr size_t fold(char c) { return static_cast<unsigned char>(c) | 0x20; }
+
+        // Length, first, middle and last byte: collision-free over kHeaderNames (checked below)
+        constexpr size_t slot(std::string_view name)
+        {
+            return (name.size() + fold(name.front()) + 17 * fold(name.back()) + 4 * fold(name[name.size() / 2])) % kSlots;
+        }
+
+        constexpr std::array<HeaderId, kSlots> make_table()
+        {
+            std::array<HeaderId, kSlots> table{};
+            for (size_t id = 1; id < kHeaderNames.size(); ++id)
+                table[slot(kHeaderNames[id])] = static_cast<HeaderId>(id);
+            return table;
+        }
+        inline constexpr std::array<HeaderId, kSlots> kTable = make_table();
+
+        constexpr bool is_perfect()
+        {
+            for (size_t id = 1; id < kHeaderNames.size(); ++id)
+                if (kTable[slot(kHeaderNames[id])] != static_cast<HeaderId>(id))
+                    return false;
+            return true;
+        }
+        static_assert(is_perfect(), "two well-known header names hash to one slot: change slot()");
+
+        constexpr bool iequals(std::string_view a, std::string_view b)
+        {
+            if (a.size() != b.size())
+                return false;
+            for (size_t i = 0; i < a.size(); ++i)
+            {
+                char x = a[i], y = b[i];
+                if (x >= 'A' && x <= 'Z')
+                    x = static_cast<char>(x - 'A' + 'a');
+                if (y >= 'A' && y <= 'Z')
+                    y = static_cast<char>(y - 'A' + 'a');
+                if (x != y)
+                    return false;
+            }
+            return true;
+        }
+    }
+
+    /** @brief The HeaderId of `name` (ASCII case-insensitive), Other if it is not well known. */
+    constexpr HeaderId header_id(std::string_view name)
+    {
+        if (name.empty())
+            return HeaderId::Other;
+        HeaderId id = header_hash::kTable[header_hash::slot(name)];
+        return header_hash::iequals(kHeaderNames[static_cast<size_t>(id)], name) ? id : HeaderId::Other;
+    }
+
+    /**
+     * @brief Ordered HTTP header fields in one flat block.
+     *
+     * Field records sit in a small inline array (spilling to the heap only past
+     * kInlineFields), and every value and unknown name is stored once in a single arena
+     * string, so a typical request or cached response costs one or two allocations instead
+     * of two per header. Well-known names are not stored at all: the record keeps their
+     * HeaderId and they print in canonical spelling. All lookups are ASCII case-insensitive;
+     * the first occurrence of each well-known name is indexed, so get(HeaderId) is O(1).
+     *
+     * Views returned by get() and iteration stay valid until the container is modified.
+     */
+    class HttpHeaders
+    {
+    public:
+        struct Field
+        {
+            HeaderId id;
+            std::string_view name;
+            std::string_view value;
+        };
+
+        static constexpr size_t kInlineFields = 12;
+
+        size_t size() const { return count_; }
+        bool empty() const { return count_ == 0; }
+        Field operator[](size_t i) const { return field(record(i)); }
+
+        /** Value of the first field named `name`; empty if absent (see contains()). */
+        std::string_view get(HeaderId id) const;
+        std::string_view get(std::string_view name) const;
+        bool contains(HeaderId id) const { return index_[static_cast<size_t>(id)] != 0; }
+        bool contains(std::string_view name) const;
+
+        /** Append a field (repeated names are kept, in order). */
+        void add(std::string_view name, std::string_view value);
+        /** Replace every field named `name` with one field holding `value`. */
+        void set(std::string_view name, std::string_view value);
+        /** Drop every field named `name`. Returns how many were removed. */
+        size_t remove(std::string_view name);
+        void clear();
+
+        class const_iterator
+        {
+        public:
+            const_iterator(const HttpHeaders *headers, size_t i) : headers_(headers), i_(i) {}
+            Field operator*() const { return (*headers_)[i_]; }
+            const_iterator &operator++()
+            {
+                ++i_;
+                return *this;
+            }
+            bool operator!=(const const_iterator &other) const { return i_ != other.i_; }
+
+        private:
+            const HttpHeaders *headers_;
+            size_t i_;
+        };
+        const_iterator begin() const { return {this, 0}; }
+        const_iterator end() const { return {this, count_}; }
+
+    private:
+        struct Record
+        {
+            HeaderId id;
+            uint16_t name_length; // unknown names only (known ones use kHeaderNames)
+            uint32_t name_offset;
+            uint32_t value_offset;
+            uint32_t value_length;
+        };
+
+        const Record &record(size_t i) const { return i < kInlineFields ? inline_[i] : spill_[i - kInlineFields]; }
+        Record &record(size_t i) { return i < kInlineFields ? inline_[i] : spill_[i - kInlineFields]; }
+        Field field(const Record &r) const;
+        bool matches(const Record &r, HeaderId id, std::string_view name) const;
+        void push(const Record &r);
+        void rebuild_index();
+
+        std::string arena_; // unknown names and all values, back to back
+        std::array<Record, kInlineFields> inline_;
+        std::vector<Record> spill_;
+        uint32_t count_ = 0;
+        // 1 + position of the first field per HeaderId (0: absent); unused for Other
+        std::array<uint16_t, static_cast<size_t>(HeaderId::kCount)> index_{};
+    };
+
+} // namespace proxy
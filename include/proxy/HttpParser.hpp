@@ -1,6 +1,10 @@
 #pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
-#include <map>
+#include <string_view>
+#include "HttpHeaders.hpp"
 
 namespace proxy
 {
@@ -11,13 +15,113 @@ namespace proxy
         std::string host;
         std::string path;
         std::string http_version;
-        std::map<std::string, std::string> headers;
+        HttpHeaders headers;
         unsigned short port = 80;
     };
+
+    /** @brief Limits a request head must stay within; breaking one fails the parse. */
+    struct RequestLimits
+    {
+        size_t max_head_bytes = 16 * 1024;  // request line + headers + blank line
+        size_t max_request_line = 8 * 1024; // "METHOD target HTTP/x.y"
+        size_t max_headers = 100;           // at most RequestHeadParser::kMaxHeaders
+    };
+
+    /**
+     * @brief Incremental, allocation-free parser for one HTTP/1.x request head.
+     *
+     * feed() is given the receive buffer each time more bytes arrive (always starting at the
+     * head, possibly reallocated in between) and resumes at the line it stopped in, so no
+     * byte is scanned twice. Results are string_views into the buffer of the last feed(),
+     * kept as offsets, and stay valid until that buffer changes. Line ends, control bytes and
+     * colons are found 16/32 bytes at a time with SSE2/AVX2 where available.
+     *
+     * The grammar is strict (RFC 9112): single spaces in the request line, an "HTTP/d.d"
+     * version, token header names directly followed by ':', no obsolete line folding and no
+     * control bytes other than HTAB; a bare LF is accepted as a line end.
+     */
+    class RequestHeadParser
+    {
+    public:
+        static constexpr size_t kMaxHeaders = 100;
+
+        enum class Status
+        {
+            Incomplete, // need more bytes
+            Complete,   // head_size() bytes form the head
+            Error       // see error(); the connection should be answered and closed
+        };
+
+        enum class Error
+        {
+            None,
+            HeadTooLarge,       // 431
+            TooManyHeaders,     // 431
+            RequestLineTooLong, // 414
+            BadRequestLine,     // 400
+            BadHeader           // 400
+        };
+
+        struct Header
+        {
+            std::string_view name; // as sent (case preserved)
+            std::string_view value; // surrounding whitespace trimmed
+        };
+
+        explicit RequestHeadParser(RequestLimits limits = {});
+
+        /** @brief Continue parsing; `buffer` must start with the bytes passed last time. */
+        Status feed(std::string_view buffer);
+        // Start over for the next request (the caller drops head_size() bytes first)
+        void reset();
+
+        Status status() const { return status_; }
+        Error error() const { return error_; }
+        // Length of the head including the blank line (valid once Complete)
+        size_t head_size() const { return pos_; }
+
+        std::string_view method() const { return view(method_); }
+        std::string_view target() const { return view(target_); }
+        std::string_view version() const { return view(version_); }
+        size_t header_count() const { return header_count_; }
+        Header header(size_t i) const { return {view(headers_[i].name), view(headers_[i].value)}; }
+        // Value of the first header named `name` (ASCII case-insensitive), empty if absent
+        std::string_view find(std::string_view name) const;
+
+    private:
+        struct Span
+        {
+            uint32_t offset = 0;
+            uint32_t length = 0;
+        };
+        struct Field
+        {
+            Span name, value;
+        };
+
+        std::string_view view(Span s) const { return std::string_view(base_ + s.offset, s.length); }
+        Status fail(Error e);
+        bool parse_request_line(size_t begin, size_t end);
+        bool parse_header_line(size_t begin, size_t end);
+
+        RequestLimits limits_;
+        const char *base_ = nullptr; // buffer of the last feed()
+        size_t pos_ = 0;             // start of the first line not parsed yet
+        size_t scan_ = 0;            // bytes of that line already searched for its end
+        bool in_headers_ = false;    // request line done
+        Status status_ = Status::Incomplete;
+        Error error_ = Error::None;
+        Span method_, target_, version_;
+        std::array<Field, kMaxHeaders> headers_;
+        size_t header_count_ = 0;
+    };
+
     class HttpParser
     {
     public:
         static HttpRequest parse(const std::string &raw_request);
+        // Build the request from a head the parser completed
+        static HttpRequest parse(const RequestHeadParser &head);
         static std::string serialize(const HttpRequest &request);
     };
-}
\ No newline at end of file
+}
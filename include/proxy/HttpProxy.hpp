@@ -1,15 +1,31 @@
 #ifndef HTTP_PROXY_HPP
 #define HTTP_PROXY_HPP
 
-#include "LruCache.hpp"
+#include "ShardedLruCache.hpp"
 #include "ThreadPool.hpp"
 #include "DashEngine.hpp"
+#include "HttpHeaders.hpp"
+#include "HttpParser.hpp"
+#include "HttpResponseParser.hpp"
+#include "UpstreamPool.hpp"
+#include "InflightFetches.hpp"
+#include "ResponseSink.hpp"
+#include "CachedResponse.hpp"
+#include "DiskCache.hpp"
+#include "CacheSnapshot.hpp"
 #include <string>
-#include <map>    // to store the HTTP headers of the cached response.
+#include <string_view>
 #include <chrono> // For handling time-related information, like when a response was received or when it expires.
 #include <vector> // To store the response body, which can be binary data.
 #include <deque>
 #include <mutex>
+#include <memory>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <set>
+#include <utility>
 
 namespace proxy
 {
@@ -24,7 +40,59 @@ namespace proxy
     class HttpProxy
     {
     public:
-        explicit HttpProxy(unsigned short port, size_t cache_max_size_mb, size_t thread_cnt = 5);
+        /**
+         * @param cache_max_size_mb Response cache budget: body and header bytes of all cached
+         *        responses (0 uses kDefaultCacheBytes).
+         * @param cache_max_object_fraction Responses larger than this fraction of the budget are
+         *        relayed but not cached, so one large object cannot flush the cache. In (0, 1].
+         * @param cache_policy W-TinyLFU by default, so crawlers and one-off seeks through the
+         *        catalogue do not push hot segments and manifests out; Lru admits everything,
+         *        and Clock or S3Fifo let hits on one shard proceed in parallel.
+         */
+        explicit HttpProxy(unsigned short port, size_t cache_max_size_mb, size_t thread_cnt = 5,
+                           double cache_max_object_fraction = kDefaultMaxObjectFraction,
+                           Cache::EvictionPolicy cache_policy = Cache::EvictionPolicy::WTinyLfu);
+
+        static constexpr size_t kDefaultCacheBytes = 64 * 1024 * 1024;
+        static constexpr double kDefaultMaxObjectFraction = 0.125;
+
+        /**
+         * @brief Add a disk tier under the memory cache (call before run*()).
+         *
+         * Every response that is cached is also appended to a DiskCache in `dir`, including
+         * ones too large for the memory budget (up to one disk segment). Memory misses are
+         * then looked up on disk and, if fresh, sent straight from the file with sendfile
+         * (`X-Cache: HIT-DISK`). The disk tier is shared by all workers.
+         * @throw std::invalid_argument / std::runtime_error as DiskCache's constructor.
+         */
+        void enable_disk_cache(const std::string &dir, size_t max_bytes);
+
+        /**
+         * @brief Warm restarts: load the snapshot in `dir` if there is one, and checkpoint into it
+         *        every `interval` (0: only when save_snapshot() is called). Call before run*().
+         *
+         * The response cache snapshot is memory-mapped and entries are taken from it on their
+         * first miss, checksum-verified, so hits are served as soon as the proxy listens. The
+         * resolver's positive entries are restored with their remaining TTL.
+         */
+        void enable_snapshots(const std::string &dir, std::chrono::seconds interval);
+
+        /**
+         * @brief Serving past expiry (call before run*()).
+         *
+         * A stale entry within its stale-while-revalidate window is served at once
+         * (`X-Cache: STALE`) and revalidated in the background; one within stale-if-error is
+         * served (`X-Cache: STALE-IF-ERROR`) when its revalidation cannot reach the origin or
+         * gets a 5xx. The origin's Cache-Control windows take precedence over the policy's.
+         * Fresh entries near expiry are refreshed early in the background (XFetch), so a hot
+         * key is normally replaced before any client sees it expire.
+         */
+        void set_stale_policy(const StalePolicy &policy);
+
+        /** @brief Checkpoint the response cache(s) and the resolver cache now (e.g. at shutdown). */
+        void save_snapshot();
+
+        ~HttpProxy();
 
         /**
          * @brief Start listening for client connections and handle them.
@@ -32,53 +100,251 @@ namespace proxy
         void run();
 
         /**
-         * @brief Handle a single client connection (blocking).
+         * @brief Start the non-blocking front end instead of run() (epoll, Linux only).
+         *
+         * One thread multiplexes every client and origin socket through a per-connection
+         * state machine (read headers -> resolve -> connect -> relay -> done). The thread
+         * pool is only used for blocking DNS lookups and MPD parsing.
+         */
+        void run_event_loop();
+
+        /**
+         * @brief Shared-nothing mode: one event loop per core (epoll, Linux only).
+         *
+         * Every worker thread owns an SO_REUSEPORT listener (the kernel spreads new
+         * connections across them), a reactor, a cache shard, an upstream connection pool
+         * and a helper thread for DNS lookups, so the request path takes no lock shared
+         * with other workers. Only the DASH bandwidth/representation state is global.
+         * A response cached by one worker is not visible to the others.
+         *
+         * @param workers Number of workers; 0 means one per online CPU.
+         * @param pin_cpus Pin worker i to CPU i (modulo the CPU count).
+         */
+        void run_workers(size_t workers, bool pin_cpus);
+
+        /**
+         * @brief Handle a client connection (blocking) until it closes.
+         *
+         * Requests are served in order on the same connection (keep-alive, pipelining)
+         * until the client asks to close, stays idle for kClientIdleTimeout, or reaches
+         * kMaxRequestsPerConnection. A connection that starts with the HTTP/2 preface, or
+         * whose first request asks for "Upgrade: h2c", is served as HTTP/2 instead.
          *
          * @param client_fd File descriptor of the accepted client socket.
          */
         void handle_client(int client_fd);
 
+        /**
+         * @brief Why the proxy closed a client connection on its own (a limit or deadline hit).
+         */
+        enum class CloseReason
+        {
+            HeaderTimeout,  // request head not complete within kHeaderReadTimeout
+            IdleTimeout,    // no new request within kClientIdleTimeout
+            WriteTimeout,   // client took no bytes for kWriteStallTimeout
+            HeaderTooLarge, // request head (or its request line, or header count) over kRequestLimits
+            BadRequest,     // malformed request head
+            kCount
+        };
+
+        /**
+         * @brief Number of client connections closed for `reason` since startup (all workers).
+         */
+        uint64_t closed_by(CloseReason reason) const;
+
+        using CacheStats = Cache::ShardedLruCache<std::string, CachedResponsePtr>::Stats;
+
+        /** @brief Hits, misses, admission rejects and byte hit ratio of the shared response cache
+         *         (run() and run_event_loop(); run_workers() gives each worker its own). */
+        CacheStats cache_stats() const;
+
         // Disable copying/moving
         HttpProxy(const HttpProxy &) = delete;
         HttpProxy &operator=(const HttpProxy &) = delete;
 
     private:
-        /**
-         * @brief Represents a cached HTTP response.
-         * This will be the 'Value' in our LruCache.
-         */
-        struct ResponseCacheEntry
+        using ResponseCacheEntry = CachedResponse;
+        using ResponseCache = Cache::ShardedLruCache<std::string, CachedResponsePtr>;
+
+        // Serve one request. Returns true if the response left the connection usable for the next one.
+        bool handle_request(ResponseSink &client, HttpRequest &req, bool keep_alive);
+
+        // Client connection reuse: idle time allowed between requests, and a cap on requests
+        // per connection so long-lived clients still get rebalanced across workers.
+        static constexpr std::chrono::seconds kClientIdleTimeout{15};
+        static constexpr size_t kMaxRequestsPerConnection = 100;
+
+        // Slow-client limits. A request head must arrive in full within kHeaderReadTimeout of its
+        // first byte and fit in kMaxRequestHeadBytes; a client that accepts no response bytes for
+        // kWriteStallTimeout is dropped. Response data is never buffered beyond the relay window:
+        // the origin is simply not read while the client is behind.
+        static constexpr std::chrono::seconds kHeaderReadTimeout{10};
+        static constexpr std::chrono::seconds kWriteStallTimeout{30};
+        static constexpr size_t kMaxRequestHeadBytes = 16 * 1024;
+        static constexpr RequestLimits kRequestLimits{kMaxRequestHeadBytes, 8 * 1024, 100};
+        // Sent (best effort) before dropping a client that broke a request-head limit
+        static constexpr std::string_view kRequestTimeoutResponse =
+            "HTTP/1.1 408 Request Timeout\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        static constexpr std::string_view kHeaderTooLargeResponse =
+            "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        static constexpr std::string_view kUriTooLongResponse =
+            "HTTP/1.1 414 URI Too Long\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        static constexpr std::string_view kBadRequestResponse =
+            "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        // The response and close reason for a request head the parser rejected
+        static std::string_view rejected_head_response(RequestHeadParser::Error error, CloseReason &reason);
+
+        // Collapsed forwarding: how long a request waits for another request's origin fetch of
+        // the same cache key before it gives up and fetches on its own
+        static constexpr std::chrono::seconds kCollapsedWaitTimeout{5};
+
+        // Bump the counter for `reason` and log it
+        void count_close(CloseReason reason);
+
+        // True if the client allows another request on this connection after the response
+        // (HTTP/1.1 without "Connection: close", or HTTP/1.0 with "Connection: keep-alive")
+        // and the request has no body, which the proxy does not forward.
+        static bool client_wants_keep_alive(const HttpRequest &req);
+        // Replace the origin's hop-by-hop connection headers in a response head with our own
+        // "Connection: keep-alive" / "Connection: close" for the client connection.
+        static std::string client_response_head(const std::string &origin_head, bool keep_alive);
+
+        // Cleartext HTTP/2 on this connection: every stream goes through handle_request().
+        // `upgraded` is the HTTP/1.1 request that asked for "Upgrade: h2c" (answered as stream 1).
+        void serve_http2(int client_fd, std::string received, const HttpRequest *upgraded, const std::string &upgrade_settings);
+        // True (with its HTTP2-Settings value) if the request asks to switch to h2c; requests
+        // with a body are served as HTTP/1.1 (RFC 7540 3.2)
+        static bool wants_h2c_upgrade(const HttpRequest &req, std::string &settings);
+
+        // CONNECT: open a TCP tunnel to req.host:req.port and relay bytes both ways (splice on Linux).
+        // `early_data` is what the client sent after the CONNECT head.
+        void handle_connect(int client_fd, const HttpRequest &req, const std::string &early_data);
+        static constexpr std::chrono::seconds kTunnelIdleTimeout{300};
+        // Upper bound for establishing an origin connection, across all of a host's addresses
+        static constexpr std::chrono::seconds kConnectTimeout{5};
+
+        // Streaming relay limits: memory per connection stays bounded by the relay buffer
+        // plus (for cacheable responses) the cache fill, which is abandoned past its cap.
+        static constexpr size_t kRelayBufferSize = 16 * 1024;
+        static constexpr size_t kMaxCacheFillBytes = 16 * 1024 * 1024;
+
+        struct RelayResult
+        {
+            size_t bytes = 0;          // body bytes forwarded to the client
+            bool fill_complete = true; // the fill buffer (if any) holds the whole body
+            bool reusable = false;     // response fully framed and origin allows keep-alive
+        };
+
+        // Rewrite a client request for the origin: HTTP/1.1 origin-form, hop-by-hop headers
+        // stripped, "Connection: keep-alive" so the upstream connection can be pooled
+        static std::string build_origin_request(const HttpRequest &req);
+        // Send a request upstream (pooled connection if possible) and read the response head.
+        // A stale pooled connection is retried once on a fresh one.
+        UpstreamPool::Lease exchange_with_origin(const HttpRequest &req, const std::string &request_bytes,
+                                                 HttpResponseParser &parser, std::string &body_prefix);
+        // Stream an origin response to the client and put it in `cache` if the body fit in the fill
+        // budget and its status is cacheable_status(). `fetch_started` is when the request went to the origin (the
+        // entry's fetch_time); `filled`, if given, receives the cached entry.
+        RelayResult relay_and_cache(ResponseCache &cache, UpstreamPool::Lease &origin, ResponseSink &client,
+                                    HttpResponseParser &parser, const std::string &body_prefix, const std::string &cache_key,
+                                    bool keep_alive, std::chrono::steady_clock::time_point fetch_started,
+                                    CachedResponsePtr *filled = nullptr);
+        // Read up to the end of the origin's response head; body bytes read past it land in body_prefix
+        static void read_response_head(int origin_fd, HttpResponseParser &parser, std::string &body_prefix);
+        // Forward body bytes to the client as they arrive, until the parser reports the end of
+        // the message, copying them into `fill` when given (dropped if it exceeds the cap).
+        static RelayResult relay_body(int origin_fd, ResponseSink &client, HttpResponseParser &parser,
+                                      const std::string &body_prefix, std::vector<char> *fill,
+                                      size_t fill_limit = kMaxCacheFillBytes);
+
+        // Turn a parsed origin response head into a cache entry (status line, headers, expiry; empty body)
+        static ResponseCacheEntry parse_response_head(const HttpResponseParser &origin);
+        // What an entry costs against the cache budget: key, body and header bytes
+        static size_t cache_entry_weight(const std::string &key, const CachedResponsePtr &entry);
+        // Largest body worth buffering for `cache` (or the disk tier): fills past it could never be stored
+        size_t cache_fill_limit(const ResponseCache &cache) const;
+        // A fresh or stale entry from `cache` (or, at first, the warm-restart snapshot, moved into
+        // `cache`), else a fresh one from the disk tier (or nullptr)
+        CachedResponsePtr cache_lookup(ResponseCache &cache, std::string_view key);
+        // A 206 or a 304 describes part of the object, or the client's copy of it: never the object
+        static bool cacheable_status(int status) { return status != 206 && status != 304; }
+        // A 304 confirmed a stale entry: a copy of it (sharing head block and body) with its freshness
+        // lifetime restarted, taking a new max-age from the 304 if it carries one
+        static CachedResponsePtr refresh_cache_entry(const ResponseCacheEntry &stale, const HttpResponseParser &not_modified);
+        // cache_freshness() under the proxy's StalePolicy, with this thread's random draw
+        Freshness freshness(const ResponseCacheEntry &entry) const;
+        // Revalidate `stale` (the entry for `key` in `cache`, requested by `req`) on the
+        // revalidation pool; a no-op while the same key of the same cache is already being refreshed
+        void revalidate_in_background(ResponseCache &cache, const std::string &key, const HttpRequest &req,
+                                      CachedResponsePtr stale);
+        // The blocking conditional fetch behind revalidate_in_background(). A 304 restarts the
+        // entry's lifetime, a new 2xx-4xx response replaces it, and a 5xx leaves it as it is.
+        void revalidate(ResponseCache &cache, const std::string &key, HttpRequest req, const ResponseCacheEntry &stale);
+        // Block until no revalidation queued or running on the pool still refers to `cache`
+        // (a worker's, before it goes away)
+        void wait_for_revalidations(const ResponseCache &cache);
+
+        enum class RequestKind
         {
-            std::string status_line;                           // e.g., "HTTP/1.1 200 OK"
-            std::map<std::string, std::string> headers;        // e.g., "Content-Type: text/html"
-            std::vector<char> body;                            // store the actual HTTP body
-            std::chrono::steady_clock::time_point received_at; // the exact time when the proxy received this response from the origin server
-            std::chrono::seconds max_age;                      // calculate from Cache-Control: max-age
-            std::chrono::steady_clock::time_point expires_at;  // This would be received_at + max_age or parsed from an Expires header.
-            std::string etag;                                  // for cache validation
-            std::string last_modified;
-
-            // default constructor
-            ResponseCacheEntry() : max_age(0) {}
-            // A helper method you'd implement in the .cpp. It would check if std::chrono::steady_clock::now() is past the expires_at time
-            bool is_stale() const
-            {
-                return std::chrono::steady_clock::now() > expires_at;
-            }
+            Manifest, // *.mpd
+            Segment,  // *.m4s / *.ts / *.mp4
+            Other
+        };
+        static RequestKind classify_request(const std::string &path);
+
+        // Rewrite a segment request to the representation chosen by the DASH engine.
+        // Returns false (request untouched) when no MPD has been seen yet.
+        bool rewrite_segment_request(HttpRequest &req) const;
+        // Push a segment download measurement into the sliding window; returns the window mean (kbps)
+        double record_bandwidth_sample(size_t bytes, double elapsed_sec);
+        // Parse an MPD document and swap it in as the current DASH engine (errors are logged)
+        void update_dash_engine(const std::string &mpd_xml);
+        std::shared_ptr<const DashEngine> current_dash_engine() const;
+
+        class Reactor; // event-loop front end, see ProxyReactor.cpp
+
+        // Per-request state a reactor works with. run_event_loop() points it at the proxy's own
+        // members; run_workers() gives each worker a private set.
+        struct WorkerShard
+        {
+            ResponseCache &cache;
+            UpstreamPool &upstream_pool;
+            InflightFetches &inflight; // collapsed forwarding for `cache`
+            ThreadPool &helpers;       // blocking DNS lookups and MPD parsing
         };
-        // Helper function that parses the raw HTTP response and stores it in the cache as a CachedHttpResponse
-        void process_and_cache_response(const std::string &resp_raw, const std::string &cache_key, int client_fd);
 
-        // Helper function that serializes a CachedHttpResponse back into raw format and sends it to the client
-        // std::vector<char> serialize_cached_response(const CachedHttpResponse& cached_response);
-        void send_cached_response(int client_fd, const ResponseCacheEntry &cached);
         unsigned short port_;
         std::deque<double> recent_bandwidths_;   // bandwidth_kbps
         const size_t max_bandwidth_samples_ = 5; // sliding window
         std::mutex bandwidth_mutex_;
-        std::unique_ptr<proxy::DashEngine> dash_engine_;
-        Cache::LruCache<std::string, ResponseCacheEntry> response_cache_;
+        mutable std::mutex dash_mutex_; // guards dash_engine_ (swapped from pool threads)
+        std::shared_ptr<const proxy::DashEngine> dash_engine_;
+        ResponseCache response_cache_; // shared by every pool thread
+        std::unique_ptr<DiskCache> disk_cache_; // optional second tier, shared by everyone
+
+        // Warm restarts (enable_snapshots): the snapshot loaded at startup, drained by misses,
+        // and the periodic checkpoint thread. run_workers() registers its caches so they are saved too.
+        std::string snapshot_dir_;
+        std::unique_ptr<CacheSnapshot> warm_snapshot_;
+        std::thread snapshot_thread_;
+        std::mutex snapshot_mutex_; // one checkpoint at a time; guards snapshot_stop_
+        std::condition_variable snapshot_cv_;
+        bool snapshot_stop_ = false;
+        std::mutex worker_caches_mutex_;
+        std::vector<ResponseCache *> worker_caches_;
+        UpstreamPool upstream_pool_; // idle keep-alive connections to origins
+        InflightFetches inflight_fetches_; // origin fetches in flight, by cache key
+        std::array<std::atomic<uint64_t>, static_cast<size_t>(CloseReason::kCount)> close_counts_{};
         ThreadPool thread_pool_;
+
+        // Background revalidation (stale-while-revalidate and early refresh) has its own threads:
+        // run() keeps a pool thread per client connection, so tasks there could wait for minutes.
+        static constexpr size_t kRevalidationThreads = 2;
+        StalePolicy stale_policy_;
+        std::mutex revalidations_mutex_;
+        std::set<std::pair<const ResponseCache *, std::string>> revalidations_; // keys being refreshed
+        std::condition_variable revalidations_cv_; // signalled as each revalidation finishes
+        ThreadPool revalidation_pool_; // last: joined before the members its tasks use are destroyed
     };
 
 } // namespace proxy
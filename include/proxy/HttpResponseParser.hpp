@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace proxy
+{
+    /**
+     * @brief Incremental HTTP/1.x response framing.
+     *
+     * Bytes are fed as they arrive from the origin: first through parse_head() until
+     * head_complete(), then through parse_body() until complete(). The parser works out
+     * where the message ends (Content-Length, chunked transfer coding, or connection
+     * close), which is what allows an upstream connection to be reused afterwards.
+     * Body bytes are not copied or decoded; callers forward exactly what was consumed.
+     * A caller that needs the payload itself (without chunk framing) can ask parse_body()
+     * to collect it, or use feed() and get it as events.
+     *
+     * Interim 1xx responses (100 Continue, 103 Early Hints) are consumed and dropped: head()
+     * is always the final response's. Header fields and chunked trailers are indexed once
+     * and can be looked up without re-parsing.
+     */
+    class HttpResponseParser
+    {
+    public:
+        static constexpr size_t kMaxHeadBytes = 64 * 1024;
+
+        /** @brief Receives a response as feed() parses it. */
+        class Listener
+        {
+        public:
+            virtual ~Listener() = default;
+            // The final head is complete (header fields available)
+            virtual void on_head(const HttpResponseParser &) {}
+            // Payload bytes, chunk framing removed; may be called many times
+            virtual void on_body(std::string_view) {}
+            // The message ended (trailers available)
+            virtual void on_complete(const HttpResponseParser &) {}
+        };
+
+        struct Header
+        {
+            std::string_view name;
+            std::string_view value; // surrounding whitespace trimmed
+        };
+
+        /**
+         * @param head_request true if the request was HEAD (the response never has a body).
+         */
+        explicit HttpResponseParser(bool head_request = false);
+
+        /**
+         * @brief Consume response-head bytes (status line + headers + blank line).
+         * @return How many bytes of `data` belong to the head; the rest is body.
+         * @throw std::runtime_error if the head is malformed or larger than kMaxHeadBytes.
+         */
+        size_t parse_head(const char *data, size_t len);
+
+        /**
+         * @brief Consume body bytes.
+         * @param payload If given, the message payload in these bytes (chunk data only) is appended to it.
+         * @return How many bytes of `data` belong to this message. Anything beyond that
+         *         is not part of the response (and makes the connection unusable).
+         * @throw std::runtime_error on malformed chunked framing.
+         */
+        size_t parse_body(const char *data, size_t len, std::string *payload = nullptr);
+
+        /**
+         * @brief Head and body in one call, reported to `listener` as they are recognised.
+         * @return How many bytes of `data` belong to this message (see parse_body()).
+         */
+        size_t feed(const char *data, size_t len, Listener &listener);
+
+        /**
+         * @brief The origin closed the connection. Completes a close-delimited body.
+         * @param listener Told about the completion, if given.
+         * @throw std::runtime_error if the message was cut short.
+         */
+        void on_eof(Listener *listener = nullptr);
+
+        bool head_complete() const { return head_complete_; }
+        bool complete() const { return complete_; }
+
+        /** Raw head bytes, including the terminating blank line. */
+        const std::string &head() const { return head_; }
+        int status_code() const { return status_code_; }
+        bool chunked() const { return body_mode_ == BodyMode::Chunked; }
+        bool close_delimited() const { return body_mode_ == BodyMode::UntilClose; }
+        std::optional<size_t> content_length() const { return content_length_; }
+        // Interim 1xx responses skipped before the final head
+        size_t interim_responses() const { return interim_responses_; }
+
+        // Header fields of the final head, in order (valid once head_complete())
+        size_t header_count() const { return headers_.size(); }
+        Header header(size_t i) const { return field(head_, headers_[i]); }
+        // Value of the first field named `name` (ASCII case-insensitive), empty if absent
+        std::string_view find(std::string_view name) const;
+
+        // Trailer fields of a chunked body (valid once complete())
+        size_t trailer_count() const { return trailers_.size(); }
+        Header trailer(size_t i) const { return field(trailer_block_, trailers_[i]); }
+
+        /** True if the origin allows another request on this connection after this response. */
+        bool keep_alive() const { return keep_alive_ && body_mode_ != BodyMode::UntilClose; }
+
+    private:
+        enum class BodyMode
+        {
+            None,
+            Length,
+            Chunked,
+            UntilClose
+        };
+        enum class ChunkState
+        {
+            Size,        // hex digits of the chunk size
+            Extension,   // ";name=value" after the size, ignored
+            SizeLF,      // '\n' ending the size line
+            Data,        // chunk payload
+            DataCR,      // '\r' after the payload
+            DataLF,      // '\n' after the payload
+            TrailerStart, // start of a trailer line (or the final blank line)
+            TrailerLine, // inside a trailer field
+            TrailerEndLF // '\n' of the final blank line
+        };
+
+        // Offsets into head_ or trailer_block_, so copies of the parser stay valid
+        struct FieldSpan
+        {
+            uint32_t name_offset, name_length, value_offset, value_length;
+        };
+        static Header field(const std::string &block, const FieldSpan &span);
+        static void index_fields(const std::string &block, size_t pos, std::vector<FieldSpan> &out);
+
+        void on_head_complete();
+        void finish_size_line();
+        void finish_trailers();
+        size_t consume_body(const char *data, size_t len, std::string *payload, Listener *listener);
+
+        bool head_request_;
+        std::string head_;
+        std::vector<FieldSpan> headers_;
+        size_t interim_responses_ = 0;
+        bool head_complete_ = false;
+        bool complete_ = false;
+
+        int status_code_ = 0;
+        bool keep_alive_ = false;
+        BodyMode body_mode_ = BodyMode::UntilClose;
+        std::optional<size_t> content_length_;
+        size_t remaining_ = 0; // Length: bytes left in the body; Chunked: bytes left in the chunk
+
+        ChunkState chunk_state_ = ChunkState::Size;
+        size_t chunk_size_ = 0;
+        size_t chunk_digits_ = 0;
+        std::string trailer_block_; // raw trailer lines, CRLF-terminated
+        std::vector<FieldSpan> trailers_;
+    };
+}
@@ -0,0 +1,70 @@
+#ifndef INFLIGHT_FETCHES_HPP
+#define INFLIGHT_FETCHES_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace proxy
+{
+    /**
+     * @brief Collapsed forwarding: at most one origin fetch in flight per cache key.
+     *
+     * The first request that misses (or finds a stale entry) becomes the leader and
+     * fetches from the origin; requests for the same key arriving meanwhile register a
+     * waiter instead of sending their own request. When the leader finishes (whether or
+     * not it managed to cache the response) every waiter is notified once and looks the
+     * key up again: a hit is served from the cache, anything else falls back to a
+     * fetch of its own. Waiters bound their wait themselves, so a slow leader costs them
+     * at most that long.
+     *
+     * Thread-safety: all public methods are guarded by an internal mutex. Waiters run on
+     * the thread calling finish(), outside the lock.
+     */
+    class InflightFetches
+    {
+    public:
+        using Waiter = std::function<void()>;
+
+        enum class Join
+        {
+            Leader,   // caller must fetch, then call finish(key)
+            Finished, // the leader finished within the wait: look the key up again
+            TimedOut  // the leader is still busy: fetch without waiting any longer
+        };
+
+        /**
+         * @brief Lead a fetch for `key`, or queue `waiter` behind the one in flight.
+         * @return true if the caller is the leader (and `waiter` was dropped).
+         */
+        bool join(const std::string &key, Waiter waiter);
+
+        /**
+         * @brief Blocking variant of join(): waits up to `timeout` for the leader.
+         */
+        Join join_and_wait(const std::string &key, std::chrono::milliseconds timeout);
+
+        /**
+         * @brief The leader's fetch for `key` is over: wake its waiters and forget the key.
+         */
+        void finish(const std::string &key);
+
+        // Keys with a fetch in flight
+        size_t size() const;
+        // Requests that waited on another request's fetch instead of going to the origin
+        uint64_t collapsed() const { return collapsed_.load(std::memory_order_relaxed); }
+
+    private:
+        mutable std::mutex mutex_;
+        std::unordered_map<std::string, std::vector<Waiter>> inflight_;
+        std::atomic<uint64_t> collapsed_{0};
+    };
+
+} // namespace proxy
+
+#endif // INFLIGHT_FETCHES_HPP
@@ -5,29 +5,48 @@
 #include <unordered_map> // For std::unordered_map (for O(1) average time lookups)
 #include <optional>      // For std::optional (to return values from 'get' gracefully) C++17
 #include <cstddef>       // For size_t
-#include <stdexcept>
+#include <utility>       // For std::pair
+#include <vector>        // For std::vector (entries())
+#include <string>        // For KeyView
+#include <string_view>
+#include <type_traits>
+#include "WeightBudget.hpp"
 
 namespace Cache
 {
+    /**
+     * @brief What lookups take for a Key: std::string_view for std::string keys (so a caller
+     *        can look up a key it has not built as a std::string), the Key itself otherwise.
+     *        std::hash gives a string and its view the same hash.
+     */
+    template <typename Key>
+    using KeyView = std::conditional_t<std::is_same_v<Key, std::string>, std::string_view, Key>;
+
     template <typename Key, typename Value>
-    class LruCache
+    class LruCache : public WeightBudget<Key, Value>
     {
     public:
+        using Weigher = typename WeightBudget<Key, Value>::Weigher;
+
         /**
          * @brief Constructs an LRU cache with a given capacity.
-         * @param capacity The maximum number of items the cache can hold. Must be greater than 0.
-         * @throw std::invalid_argument if capacity is 0 (optional error handling).
+         * @param capacity The maximum total weight of the items (the number of items without a weigher). Must be greater than 0.
+         * @param weigher Weight of an entry, taken once when it is put.
+         * @param max_entry_fraction Entries heavier than this fraction of the capacity are never stored. In (0, 1].
+         * @throw std::invalid_argument if capacity is 0 or max_entry_fraction is out of range.
          */
-        explicit LruCache(size_t capacity);
+        explicit LruCache(size_t capacity, Weigher weigher = nullptr, double max_entry_fraction = 1.0);
 
         /**
          * @brief Inserts or updates a key-value pair in the cache.
          * If the key already exists, its value is updated, and it's marked as recently used.
-         * If the key doesn't exist and the cache is full, the least recently used item is evicted.
+         * Least recently used items are evicted until the total weight fits the capacity again.
+         * An entry over max_entry_weight() is rejected, and an older value under its key dropped.
          * @param key The key of the item.
          * @param value The value of the item.
+         * @return False if the entry was rejected for its weight.
          */
-        void put(const Key &key, const Value &value);
+        bool put(const Key &key, const Value &value);
 
         /**
          * @brief Retrieves the value associated with a key.
@@ -52,10 +71,14 @@ namespace Cache
         size_t size() const;
 
         /**
-         * @brief Returns the maximum capacity of the cache.
-         * @return The capacity of the cache.
+         * @brief Total weight of the cached items.
+         */
+        size_t weight() const;
+
+        /**
+         * @brief Copies of all items, most recently used first (does not update usage).
          */
-        size_t capacity() const;
+        std::vector<std::pair<Key, Value>> entries() const;
 
         /**
          * @brief Removes all items from the cache.
@@ -67,9 +90,10 @@ namespace Cache
         {
             Key key;
             Value value;
+            size_t weight;
         };
 
-        size_t capacity_;
+        size_t weight_ = 0;
         std::list<CacheItem> usage_list_;
         std::unordered_map<Key, typename std::list<CacheItem>::iterator> cache_map_;
     };
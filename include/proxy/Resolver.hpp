@@ -1,23 +1,31 @@
 #ifndef RESOLVER_HPP
 #define RESOLVER_HPP
 
+#include "SocketUtils.hpp"
 #include <string>
 #include <chrono>
 #include <unordered_map>
 #include <mutex>
+#include <vector>
 
 namespace proxy
 {
 
     /**
-     * @brief Simple synchronous DNS resolver (IPv4 only).
+     * @brief Simple synchronous DNS resolver (IPv4 and IPv6) with address health memory.
      *
      * Basic usage:
      * ```
      * std::string ip = proxy::Resolver::instance().resolve("example.com", 80);
      * // ip == "93.184.216.34"
+     * std::vector<std::string> ips = proxy::Resolver::instance().resolve_all("example.com", 80);
+     * // e.g. {"2606:2800:21f:cb07:6820:80da:af6b:8b2c", "93.184.216.34"}: race them with net::connect_race
      * ```
      *
+     * Connect results reported through record() are remembered per address: an address
+     * that keeps failing is moved to the back of resolve_all() for an exponentially growing
+     * penalty period, and healthy addresses are ordered by their smoothed connect time.
+     *
      * Why a singleton?
      *  - A single shared cache for positive / negative results
      *  - Easy to make thread-safe and to clean up centrally
@@ -44,6 +52,44 @@ namespace proxy
                             int port,
                             std::chrono::seconds timeout = std::chrono::seconds{5});
 
+        /**
+         * Resolve a hostname to all of its addresses, in the order they should be tried:
+         * address families interleaved (RFC 8305), then penalized addresses last and
+         * healthy ones by smoothed connect time.
+         *
+         * @throws std::runtime_error if the lookup fails or times out
+         */
+        std::vector<std::string> resolve_all(const std::string &hostname,
+                                             int port,
+                                             std::chrono::seconds timeout = std::chrono::seconds{5});
+
+        /**
+         * Feed connect results back into the address health memory
+         * (net::ConnectRace does not report attempts abandoned because another address won).
+         */
+        void record(const std::vector<net::ConnectOutcome> &outcomes);
+
+        /** Reorder addresses by their health (penalized last, then by smoothed connect time). */
+        std::vector<std::string> order_by_health(std::vector<std::string> ips);
+
+        /**
+         * Save the unexpired positive cache entries to `path` (written aside, then renamed over
+         * it), so a restarted proxy does not have to look every origin up again.
+         *
+         * @return entries written
+         * @throws std::runtime_error if the file cannot be written
+         */
+        size_t save_snapshot(const std::string &path);
+
+        /**
+         * Load entries saved by save_snapshot() that have not expired since, keeping their
+         * remaining TTL. Names already cached are left alone. A missing or unreadable file
+         * loads nothing.
+         *
+         * @return entries loaded
+         */
+        size_t load_snapshot(const std::string &path);
+
         /* non-copyable, non-movable */
         Resolver(const Resolver &) = delete;
         Resolver &operator=(const Resolver &) = delete;
@@ -54,15 +100,27 @@ namespace proxy
         /* ---------- simple in-memory cache ---------- */
         struct CacheEntry
         {
-            std::string ip;
+            std::vector<std::string> ips; // empty: negative entry
             std::chrono::steady_clock::time_point expires_at;
         };
 
         std::unordered_map<std::string, CacheEntry> cache_;
         std::mutex cache_mutex_;
 
-        /* Low-level helper that actually calls getaddrinfo() */
-        static std::string query_dns(const std::string &hostname, int port);
+        /* ---------- address health memory ---------- */
+        struct AddressHealth
+        {
+            std::chrono::milliseconds srtt{0}; // smoothed connect time, valid once measured
+            bool measured = false;
+            unsigned failures = 0; // consecutive
+            std::chrono::steady_clock::time_point penalized_until;
+        };
+
+        std::unordered_map<std::string, AddressHealth> health_;
+        std::mutex health_mutex_;
+
+        /* Low-level helper that actually calls getaddrinfo(); families interleaved */
+        static std::vector<std::string> query_dns(const std::string &hostname, int port);
     };
 
 } // namespace proxy
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+#include <unistd.h>
+#include "SocketUtils.hpp"
+
+namespace proxy
+{
+    /**
+     * @brief Where the response to one request goes, written as HTTP/1.1 message bytes.
+     *
+     * The blocking request path produces HTTP/1.1 responses. On an HTTP/1.1 client
+     * connection they go to the socket unchanged (SocketSink); an HTTP/2 stream re-frames
+     * them as HEADERS and DATA frames (see Http2Session).
+     */
+    class ResponseSink
+    {
+    public:
+        virtual ~ResponseSink() = default;
+
+        virtual void write(std::string_view data) = 0;
+        // Several buffers in order (e.g. a cached head block, per-hit headers and body)
+        virtual void write(const std::string_view *parts, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+                write(parts[i]);
+        }
+        // `length` bytes of a file from `offset` (a disk-tier body). Read through a buffer here;
+        // sinks writing to a socket send it without copying it through user space.
+        virtual void write_file(int file_fd, uint64_t offset, size_t length)
+        {
+            std::vector<char> buf(std::min<size_t>(length, 64 * 1024));
+            while (length > 0)
+            {
+                ssize_t n = ::pread(file_fd, buf.data(), std::min(length, buf.size()), static_cast<off_t>(offset));
+                if (n <= 0)
+                    throw std::runtime_error("read of cached file body failed");
+                write(std::string_view(buf.data(), static_cast<size_t>(n)));
+                offset += n;
+                length -= n;
+            }
+        }
+    };
+
+    /** @brief An HTTP/1.x client connection: bytes go straight to the socket. */
+    class SocketSink : public ResponseSink
+    {
+    public:
+        explicit SocketSink(int fd) : fd_(fd) {}
+
+        void write(std::string_view data) override { net::write_all(fd_, data); }
+        void write(const std::string_view *parts, size_t count) override { net::write_all(fd_, parts, count); }
+        void write_file(int file_fd, uint64_t offset, size_t length) override { net::send_file_all(fd_, file_fd, offset, length); }
+
+        int fd() const { return fd_; }
+
+    private:
+        int fd_;
+    };
+
+} // namespace proxy
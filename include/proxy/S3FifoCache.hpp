@@ -0,0 +1,108 @@
+#ifndef S3_FIFO_CACHE_HPP
+#define S3_FIFO_CACHE_HPP
+
+#include "LruCache.hpp"
+#include "SlotIndex.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace Cache
+{
+    /**
+     * @brief An S3-FIFO cache: LruCache's interface with three FIFO queues and no work on a hit.
+     *
+     * New entries enter a small FIFO (10% of the capacity). When one reaches its tail, it moves
+     * to the main FIFO if it was hit while in the small queue, and is otherwise evicted with
+     * only its hash remembered in a ghost FIFO (as many hashes as the cache holds entries). A
+     * key put again while its hash is in the ghost goes straight to the main FIFO. At the main
+     * FIFO's tail, an entry with a non-zero frequency is reinserted at the head with its
+     * frequency decremented; otherwise it is evicted. Most one-hit wonders thus leave through
+     * the small queue without disturbing the main one.
+     *
+     * A hit only bumps the entry's 2-bit atomic frequency (saturating at 3), so get() calls may
+     * run concurrently with each other (but not with put() or clear()); ShardedLruCache serves
+     * them under a shared lock. Concurrent hits may lose an increment, which costs nothing
+     * but a little precision.
+     */
+    template <typename Key, typename Value>
+    class S3FifoCache : public WeightBudget<Key, Value>
+    {
+    public:
+        using Weigher = typename WeightBudget<Key, Value>::Weigher;
+
+        /** @brief get() and contains() may run concurrently with each other. */
+        static constexpr bool kConcurrentGet = true;
+
+        /** @brief Same parameters, and exceptions, as LruCache. */
+        explicit S3FifoCache(size_t capacity, Weigher weigher = nullptr, double max_entry_fraction = 1.0);
+
+        /** @brief See LruCache::put; evicts from the small or main FIFO until the new entry fits. */
+        bool put(const Key &key, const Value &value);
+
+        /**
+         * @brief Looks up a key and bumps its frequency.
+         * @param weight If not null and the key is found, receives the entry's weight.
+         */
+        std::optional<Value> get(KeyView<Key> key, size_t *weight = nullptr);
+
+        bool contains(KeyView<Key> key) const;
+        size_t size() const;
+        size_t weight() const;
+
+        /** @brief Copies of all items, main FIFO then small FIFO, newest first (does not touch frequencies). */
+        std::vector<std::pair<Key, Value>> entries() const;
+
+        void clear();
+
+    private:
+        static constexpr uint32_t kNone = SlotIndex::kNone;
+        static constexpr uint8_t kMaxFrequency = 3;
+
+        enum class Queue : uint8_t
+        {
+            Free,
+            Small,
+            Main
+        };
+
+        struct Slot
+        {
+            Key key{};
+            Value value{};
+            size_t weight = 0;
+            uint32_t prev = kNone;
+            uint32_t next = kNone; // the free list when unused
+            Queue queue = Queue::Free;
+            std::atomic<uint8_t> frequency{0};
+        };
+
+        uint32_t find(KeyView<Key> key, uint32_t hash) const;
+        void evict(uint32_t keep);
+        // Move the small FIFO's tail to the main FIFO, or evict it into the ghost
+        void evict_small();
+        // Reinsert or evict the main FIFO's tail
+        void evict_main();
+        void erase(uint32_t slot);
+        void remember(uint32_t hash);
+
+        size_t small_capacity_;
+        size_t small_weight_ = 0, main_weight_ = 0;
+
+        // A deque, for the reason ClockCache gives
+        std::deque<Slot> slots_;
+        SlotIndex index_;
+        uint32_t free_ = kNone;
+        SlotList small_, main_; // heads: newest
+        std::deque<uint32_t> ghost_;
+        std::unordered_set<uint32_t> ghost_hashes_;
+    };
+
+} // namespace Cache
+
+#endif
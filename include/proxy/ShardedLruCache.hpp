@@ -0,0 +1,165 @@
+#ifndef SHARDED_LRU_CACHE_HPP
+#define SHARDED_LRU_CACHE_HPP
+
+#include "LruCache.hpp"
+#include "ClockCache.hpp"
+#include "FlatLruCache.hpp"
+#include "S3FifoCache.hpp"
+#include "SlruCache.hpp"
+#include "TinyLfuCache.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace Cache
+{
+    /** @brief How each shard picks what to keep. */
+    enum class EvictionPolicy
+    {
+        Lru,      // FlatLruCache: admit everything, evict the least recently used
+        WTinyLfu, // TinyLfuCache: admit from a small window only what is more popular than the victim
+        Clock,    // ClockCache: second chance by reference bit; hits run under a shared lock
+        S3Fifo,   // S3FifoCache: small, main and ghost FIFOs; hits run under a shared lock
+        Slru      // SlruCache: probation and protected LRU segments
+    };
+
+    /** @brief Parses "lru", "tinylfu", "clock", "s3fifo" or "slru". */
+    std::optional<EvictionPolicy> parse_eviction_policy(std::string_view name);
+
+    /**
+     * @brief A thread-safe LRU cache made of independently locked FlatLruCache shards.
+     *
+     * A key always maps to the same shard (by hash), and each shard has its own lock, so
+     * threads working on different keys rarely wait for each other. Recency is tracked per
+     * shard: the entry evicted is the least recently used one of the shard being filled,
+     * which approximates global LRU closely once every shard holds many entries. The
+     * EvictionPolicy picks the shard type instead (TinyLfuCache, ClockCache, S3FifoCache or
+     * SlruCache), each shard with its own policy state. With Clock and S3Fifo a hit writes
+     * only an atomic in the entry, so get() takes the shard lock shared and readers of a hot
+     * shard do not wait for each other; puts, and hits under the other policies, take it
+     * exclusively. Lookups take a KeyView (std::string_view for string keys), so callers need
+     * not build a Key.
+     */
+    template <typename Key, typename Value>
+    class ShardedLruCache
+    {
+    public:
+        /** @brief Aggregate counters over all shards since construction (or clear()). */
+        struct Stats
+        {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t inserts = 0;   // puts of a key not present
+            uint64_t updates = 0;   // puts of a key already present
+            uint64_t evictions = 0; // entries dropped to make room
+            uint64_t rejected = 0;  // puts over max_entry_weight()
+            uint64_t admission_rejects = 0; // W-TinyLFU: window candidates not admitted
+            uint64_t hit_weight = 0;  // weight served by hits
+            uint64_t fill_weight = 0; // weight of every put, i.e. what misses had to fetch
+
+            double hit_ratio() const
+            {
+                return hits + misses ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+            }
+
+            /** @brief Share of the weight (bytes, for the response cache) served from the cache. */
+            double byte_hit_ratio() const
+            {
+                return hit_weight + fill_weight
+                           ? static_cast<double>(hit_weight) / static_cast<double>(hit_weight + fill_weight)
+                           : 0.0;
+            }
+        };
+
+        using Weigher = typename LruCache<Key, Value>::Weigher;
+
+        /**
+         * @brief Constructs a cache holding at most `capacity` in total (items, or the weigher's unit).
+         * @param capacity Split as evenly as possible across the shards. Must be greater than 0.
+         * @param shards Number of shards, rounded down to a power of two; 0 picks one from the CPU
+         *        count. Never more than `capacity`, so every shard holds at least one item, and with
+         *        a weigher never more than 1 / max_entry_fraction, so every shard can hold the
+         *        heaviest entry allowed.
+         * @param weigher See LruCache::Weigher.
+         * @param max_entry_fraction Entries heavier than this fraction of `capacity` are rejected.
+         * @param policy Which cache each shard is (see EvictionPolicy).
+         * @throw std::invalid_argument if capacity is 0 or max_entry_fraction is not in (0, 1].
+         */
+        explicit ShardedLruCache(size_t capacity, size_t shards = 0, Weigher weigher = nullptr,
+                                 double max_entry_fraction = 1.0, EvictionPolicy policy = EvictionPolicy::Lru);
+
+        /** @brief Inserts or updates a key (see LruCache::put). Locks one shard. */
+        bool put(const Key &key, const Value &value);
+
+        /** @brief Looks up a key and records the hit for the policy. Locks one shard (shared for Clock and S3Fifo). */
+        std::optional<Value> get(KeyView<Key> key);
+
+        /** @brief Checks for a key without updating its usage. Locks one shard, shared. */
+        bool contains(KeyView<Key> key) const;
+
+        /** @brief Items currently cached (a snapshot: shards are locked one at a time). */
+        size_t size() const;
+
+        /** @brief Maximum total weight over all shards (items without a weigher). */
+        size_t capacity() const;
+
+        size_t shard_count() const;
+
+        EvictionPolicy policy() const;
+
+        /** @brief Total weight cached now, and the most it has been since construction. */
+        size_t weight() const;
+        size_t peak_weight() const;
+
+        /** @brief The heaviest entry put() accepts. */
+        size_t max_entry_weight() const;
+
+        Stats stats() const;
+
+        /** @brief Copies of all items, shard by shard (each locked in turn), hottest first within a shard. */
+        std::vector<std::pair<Key, Value>> entries() const;
+
+        /** @brief Removes all items and resets the statistics. */
+        void clear();
+
+    private:
+        // One cache line apart so neighbouring shards' locks do not share a line
+        struct alignas(64) Shard
+        {
+            using Variant = std::variant<FlatLruCache<Key, Value>, TinyLfuCache<Key, Value>, ClockCache<Key, Value>,
+                                         S3FifoCache<Key, Value>, SlruCache<Key, Value>>;
+
+            Shard(size_t capacity, const Weigher &weigher, double max_entry_fraction, EvictionPolicy policy);
+            static Variant make_cache(size_t capacity, const Weigher &weigher, double max_entry_fraction,
+                                      EvictionPolicy policy);
+
+            mutable std::shared_mutex mutex;
+            Variant cache;
+            Stats stats; // hits, misses and hit_weight are kept below instead
+            // Bumped by get(), which may hold the lock only shared
+            std::atomic<uint64_t> hits{0}, misses{0}, hit_weight{0};
+        };
+
+        Shard &shard_for(KeyView<Key> key) const;
+
+        size_t capacity_;
+        EvictionPolicy policy_;
+        Weigher weigher_;
+        unsigned shard_bits_ = 0;
+        std::vector<std::unique_ptr<Shard>> shards_;
+        // Sum of the shard weights, kept as each put changes one, so the peak is a true global peak
+        std::atomic<size_t> weight_{0};
+        std::atomic<size_t> peak_weight_{0};
+    };
+
+} // namespace Cache
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef SLOT_INDEX_HPP
+#define SLOT_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Cache
+{
+    /**
+     * @brief The hash index of the slot-array caches: 32-bit hash to 32-bit slot index.
+     *
+     * An open-addressing table (linear probing, at most 3/4 full, backward-shift deletion so
+     * there are no tombstones) of 8-byte buckets. It never sees the keys: find() hands each
+     * slot stored under a matching hash to the caller's predicate, which compares the key in
+     * the caller's slot array. find() only reads, so any number of threads may call it while
+     * no thread inserts or erases.
+     */
+    class SlotIndex
+    {
+    public:
+        static constexpr uint32_t kNone = UINT32_MAX;
+
+        SlotIndex();
+
+        /** @brief 32-bit hash for a key; Fibonacci-mixed, since std::hash of an integer is the integer. */
+        template <typename Key>
+        static uint32_t hash_of(const Key &key)
+        {
+            uint64_t h = static_cast<uint64_t>(std::hash<Key>{}(key)) * 0x9E3779B97F4A7C15ull;
+            return static_cast<uint32_t>(h >> 32);
+        }
+
+        /** @brief The bucket under `hash` whose slot satisfies `matches(slot)`, or kNone. */
+        template <typename Matches>
+        uint32_t find(uint32_t hash, Matches &&matches) const
+        {
+            const uint32_t mask = static_cast<uint32_t>(buckets_.size() - 1);
+            for (uint32_t i = hash & mask;; i = (i + 1) & mask)
+            {
+                const Bucket &bucket = buckets_[i];
+                if (bucket.slot == kNone)
+                    return kNone;
+                if (bucket.hash == hash && matches(bucket.slot))
+                    return i;
+            }
+        }
+
+        /** @brief The bucket holding `slot` under `hash` (which must be there). */
+        uint32_t find_slot(uint32_t hash, uint32_t slot) const
+        {
+            return find(hash, [slot](uint32_t s) { return s == slot; });
+        }
+
+        uint32_t slot(uint32_t bucket) const { return buckets_[bucket].slot; }
+
+        /** @brief Adds `slot` under `hash`, growing the table first if it would pass 3/4 full. */
+        void insert(uint32_t hash, uint32_t slot);
+
+        void erase(uint32_t bucket);
+
+        size_t size() const { return size_; }
+
+        void clear();
+
+    private:
+        struct Bucket
+        {
+            uint32_t hash = 0;
+            uint32_t slot = kNone; // kNone: empty
+        };
+
+        void place(uint32_t hash, uint32_t slot);
+        void grow();
+
+        std::vector<Bucket> buckets_; // power-of-two size
+        size_t size_ = 0;
+    };
+
+    /**
+     * @brief Head and tail of an intrusive doubly linked list threaded through a slot array.
+     *
+     * Slots carry `prev` (towards the head) and `next` (towards the tail) indices; kNone ends
+     * the list. The slot array is passed in, so one array can hold several lists.
+     */
+    struct SlotList
+    {
+        uint32_t head = SlotIndex::kNone;
+        uint32_t tail = SlotIndex::kNone;
+
+        bool empty() const { return head == SlotIndex::kNone; }
+
+        template <typename Slots>
+        void push_front(Slots &slots, uint32_t slot)
+        {
+            slots[slot].prev = SlotIndex::kNone;
+            slots[slot].next = head;
+            if (head != SlotIndex::kNone)
+                slots[head].prev = slot;
+            head = slot;
+            if (tail == SlotIndex::kNone)
+                tail = slot;
+        }
+
+        template <typename Slots>
+        void remove(Slots &slots, uint32_t slot)
+        {
+            auto &s = slots[slot];
+            (s.prev != SlotIndex::kNone ? slots[s.prev].next : head) = s.next;
+            (s.next != SlotIndex::kNone ? slots[s.next].prev : tail) = s.prev;
+        }
+    };
+
+} // namespace Cache
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef SLRU_CACHE_HPP
+#define SLRU_CACHE_HPP
+
+#include "LruCache.hpp"
+#include "SlotIndex.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace Cache
+{
+    /**
+     * @brief A segmented LRU cache: LruCache's interface, with scan resistance and no sketch.
+     *
+     * New entries go to the head of a probation segment; eviction takes the probation tail.
+     * An entry hit while on probation is promoted to the protected segment (80% of the
+     * capacity), whose least recently used entries are demoted back to the probation head
+     * when it overflows. Entries seen only once therefore never push out ones seen twice.
+     * Storage is FlatLruCache's: a slot array with intrusive lists and a SlotIndex. A hit
+     * moves the entry, so get() needs exclusive access.
+     */
+    template <typename Key, typename Value>
+    class SlruCache : public WeightBudget<Key, Value>
+    {
+    public:
+        using Weigher = typename WeightBudget<Key, Value>::Weigher;
+
+        /** @brief get() moves entries between the segments, so it needs exclusive access. */
+        static constexpr bool kConcurrentGet = false;
+
+        /** @brief Same parameters, and exceptions, as LruCache. */
+        explicit SlruCache(size_t capacity, Weigher weigher = nullptr, double max_entry_fraction = 1.0);
+
+        /** @brief See LruCache::put; a new key starts on probation, an updated one keeps its segment. */
+        bool put(const Key &key, const Value &value);
+
+        /**
+         * @brief Looks up a key, promoting it to (or refreshing it in) the protected segment.
+         * @param weight If not null and the key is found, receives the entry's weight.
+         */
+        std::optional<Value> get(KeyView<Key> key, size_t *weight = nullptr);
+
+        bool contains(KeyView<Key> key) const;
+        size_t size() const;
+        size_t weight() const;
+
+        /** @brief Copies of all items, protected then probation, each most recently used first. */
+        std::vector<std::pair<Key, Value>> entries() const;
+
+        void clear();
+
+    private:
+        static constexpr uint32_t kNone = SlotIndex::kNone;
+
+        struct Slot
+        {
+            Key key{};
+            Value value{};
+            size_t weight = 0;
+            uint32_t prev = kNone;
+            uint32_t next = kNone; // the free list when unused
+            bool is_protected = false;
+        };
+
+        uint32_t find(KeyView<Key> key, uint32_t hash) const;
+        void erase(uint32_t slot);
+        // Demote protected entries other than `keep` until the segment fits again
+        void demote_overflow(uint32_t keep);
+        // The next entry to evict that is not `keep`
+        uint32_t victim(uint32_t keep) const;
+
+        size_t protected_capacity_;
+        size_t probation_weight_ = 0, protected_weight_ = 0;
+
+        std::vector<Slot> slots_;
+        SlotIndex index_;
+        uint32_t free_ = kNone;
+        SlotList probation_, protected_; // heads: most recently used
+    };
+
+} // namespace Cache
+
+#endif
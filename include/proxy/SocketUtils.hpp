@@ -1,14 +1,176 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <vector>
+#include <sys/types.h> // ssize_t
 
 namespace net
 {
-    int create_listen_socket(uint16_t port);
+    // reuse_port: set SO_REUSEPORT so several sockets (one per worker) can listen on the same port
+    int create_listen_socket(uint16_t port, bool reuse_port = false);
     int accept_client(int listen_fd);
     std::string read_all(int client_fd);
     void write_all(int client_fd, std::string_view data);
+    // Thrown by write_all when the peer accepted nothing for the socket's send timeout
+    struct SendTimeout : std::runtime_error
+    {
+        SendTimeout() : std::runtime_error("send timed out: peer is not reading") {}
+    };
+    // Bound how long a blocking send may wait for the peer to make room (SO_SNDTIMEO).
+    void set_send_timeout(int fd, std::chrono::seconds timeout);
+    // Gather-write several buffers (writev semantics, no SIGPIPE) until all are sent. Blocking.
+    void write_all(int client_fd, const std::string_view *parts, size_t count);
+    // Send `length` bytes of a file from `offset` with sendfile (no copy through user space). Blocking.
+    void send_file_all(int client_fd, int file_fd, uint64_t offset, size_t length);
+    // Blocking connect to an IPv4 or IPv6 address that gives up after `timeout`.
     int connect_to_host(const std::string &ip, int port, std::chrono::seconds timeout);
 
+    // ---- non-blocking helpers (used by the event-loop front end) ----
+
+    // Toggle O_NONBLOCK on an fd.
+    void set_nonblocking(int fd, bool enabled = true);
+    // Accept one pending client as a non-blocking fd; returns -1 when the backlog is empty.
+    int accept_nonblocking(int listen_fd);
+    // Start a non-blocking connect (IPv4 or IPv6); the returned fd becomes writable once the handshake finishes.
+    int connect_nonblocking(const std::string &ip, int port);
+    // Pending SO_ERROR of a socket (0 when the connect succeeded).
+    int socket_error(int fd);
+    // One gather-write of `parts`, skipping the first `offset` bytes overall. Returns the bytes
+    // written, or -1 with errno set (EAGAIN on a full non-blocking socket).
+    ssize_t write_parts(int fd, const std::string_view *parts, size_t count, size_t offset);
+    // One sendfile of up to `length` bytes of a file from `offset`. Returns the bytes sent, or -1
+    // with errno set (EAGAIN on a full non-blocking socket).
+    ssize_t send_file(int fd, int file_fd, uint64_t offset, size_t length);
+
+    // ---- multi-address connects (Happy Eyeballs, RFC 8305) ----
+
+    // Result of one connection attempt, for address health tracking.
+    struct ConnectOutcome
+    {
+        std::string ip;
+        int error = 0;                     // 0: connected; ETIMEDOUT: no answer in time; else the errno
+        std::chrono::milliseconds elapsed{0};
+    };
+
+    /**
+     * @brief Races non-blocking connects to several addresses of one host.
+     *
+     * The caller drives it: launch_next() starts the next address (in the order given,
+     * normally interleaved IPv6/IPv4 by the Resolver), complete() is called when an
+     * attempt's fd reports writable, and a new attempt is launched every kAttemptDelay
+     * or as soon as one fails. The first attempt to connect wins; the others are closed.
+     * The blocking connect_race() and the event-loop front end share this logic.
+     */
+    class ConnectRace
+    {
+    public:
+        // RFC 8305 "Connection Attempt Delay": head start of each attempt before the next one
+        static constexpr std::chrono::milliseconds kAttemptDelay{250};
+
+        ConnectRace(std::vector<std::string> ips, int port);
+        ~ConnectRace(); // closes attempts still in flight (never the winner)
+
+        /**
+         * @brief Start connecting to the next untried address. Addresses that fail right away
+         * (e.g. no IPv6 route) are recorded and skipped.
+         * @return The new attempt's fd, or -1 if no address is left.
+         */
+        int launch_next();
+
+        /**
+         * @brief An attempt's fd became writable (or reported an error).
+         * @return true if it connected: the caller owns the fd (see winner_ip()). On failure
+         *         the fd is closed.
+         */
+        bool complete(int fd);
+
+        /**
+         * @brief Close every attempt still in flight; `timed_out` records them as ETIMEDOUT.
+         */
+        void cancel_pending(bool timed_out);
+
+        const std::vector<int> &pending() const { return pending_fds_; }
+        bool exhausted() const { return next_ >= ips_.size(); }
+        bool failed() const { return winner_ip_.empty() && pending_fds_.empty() && exhausted(); }
+        const std::string &winner_ip() const { return winner_ip_; }
+        const std::vector<ConnectOutcome> &outcomes() const { return outcomes_; }
+        // Human-readable reason for a failed race
+        std::string failure_message() const;
+
+        ConnectRace(const ConnectRace &) = delete;
+        ConnectRace &operator=(const ConnectRace &) = delete;
+
+    private:
+        struct Attempt
+        {
+            std::string ip;
+            std::chrono::steady_clock::time_point started;
+        };
+        void finish(int fd, int error);
+
+        std::vector<std::string> ips_;
+        int port_;
+        size_t next_ = 0;
+        std::vector<int> pending_fds_;          // in-flight fds, parallel to pending_
+        std::vector<Attempt> pending_;
+        std::vector<ConnectOutcome> outcomes_;
+        std::string winner_ip_;
+    };
+
+    /**
+     * @brief Blocking Happy Eyeballs connect: race the addresses and return the first
+     * connection established (blocking mode), within `timeout` overall.
+     * @param outcomes If given, receives every attempt's result.
+     * @param connected_ip If given, receives the address that won.
+     * @throw std::runtime_error if every address failed or the timeout expired.
+     */
+    int connect_race(const std::vector<std::string> &ips, int port, std::chrono::milliseconds timeout,
+                     std::vector<ConnectOutcome> *outcomes = nullptr, std::string *connected_ip = nullptr);
+
+    // ---- tunneling (CONNECT) ----
+
+    /**
+     * @brief One direction of a byte relay, src -> dst.
+     *
+     * On Linux bytes move through a kernel pipe with splice(), so tunneled data never
+     * enters user space; elsewhere a small user-space buffer is used. Both sockets
+     * must be non-blocking.
+     */
+    class SpliceRelay
+    {
+    public:
+        static constexpr size_t kCapacity = 64 * 1024;
+
+        SpliceRelay();
+        ~SpliceRelay();
+
+        /**
+         * @brief Move data src -> dst until neither side makes progress.
+         * @return true once src reached EOF and every byte was delivered to dst.
+         * @throw std::runtime_error on socket errors (reset, broken pipe, ...).
+         */
+        bool pump(int src, int dst);
+
+        bool wants_read() const { return !src_eof_ && pending_ < kCapacity; }
+        bool wants_write() const { return pending_ > 0; }
+
+        SpliceRelay(const SpliceRelay &) = delete;
+        SpliceRelay &operator=(const SpliceRelay &) = delete;
+
+    private:
+        int pipe_r_ = -1;
+        int pipe_w_ = -1;
+        size_t pending_ = 0; // bytes held between src and dst
+        bool src_eof_ = false;
+        std::string buffer_; // non-Linux fallback
+    };
+
+    // Relay both directions between two connected sockets until both sides are done
+    // (or nothing moves for idle_timeout). Blocking; the sockets are switched to O_NONBLOCK.
+    void splice_tunnel(int client_fd, int origin_fd, std::chrono::seconds idle_timeout);
 }
@@ -59,9 +59,7 @@ public:
             if (stop_)
                 throw std::runtime_error("enqueue on stopped ThreadPool");
             tasks_.emplace([task]
-                           { 
-               std::cout << "[Thread " << std::this_thread::get_id() << "] Executing task" << std::endl << std::flush;
-    (*task)(); });
+                           { (*task)(); });
         }
         condition_.notify_one();
         return res;
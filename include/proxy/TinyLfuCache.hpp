@@ -0,0 +1,106 @@
+#ifndef TINY_LFU_CACHE_HPP
+#define TINY_LFU_CACHE_HPP
+
+#include "FrequencySketch.hpp"
+#include "LruCache.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Cache
+{
+    /**
+     * @brief A W-TinyLFU cache: LruCache's interface with frequency-based admission.
+     *
+     * New entries land in a small LRU window (1% of the capacity). Entries pushed out of the
+     * window are candidates for the main region, a segmented LRU (a probation segment, and a
+     * protected segment of 80% of the main region for entries hit again while on probation).
+     * When the main region is full, a candidate only gets in if the FrequencySketch has seen
+     * it more often than the probation entry it would replace; otherwise the candidate is the
+     * one dropped. A burst of one-off keys (a crawler, a seek through a catalogue) therefore
+     * cycles through the window without flushing the popular entries.
+     *
+     * Lookups, hits and misses alike, feed the sketch; put() does not, since the proxy puts
+     * after a missed get().
+     */
+    template <typename Key, typename Value>
+    class TinyLfuCache : public WeightBudget<Key, Value>
+    {
+    public:
+        using Weigher = typename WeightBudget<Key, Value>::Weigher;
+
+        /** @brief get() feeds the sketch and reorders the segments, so it needs exclusive access. */
+        static constexpr bool kConcurrentGet = false;
+
+        /** @brief Same parameters, and exceptions, as LruCache. */
+        explicit TinyLfuCache(size_t capacity, Weigher weigher = nullptr, double max_entry_fraction = 1.0);
+
+        /**
+         * @brief Inserts a new entry into the window, or updates one in place.
+         * @return False if the entry is over max_entry_weight(). An entry accepted here may still
+         *         be dropped right away by admission when it leaves the window.
+         */
+        bool put(const Key &key, const Value &value);
+
+        /**
+         * @brief Records the access, and on a hit refreshes (or promotes) the entry.
+         * @param weight If not null and the key is found, receives the entry's weight.
+         */
+        std::optional<Value> get(KeyView<Key> key, size_t *weight = nullptr);
+
+        bool contains(KeyView<Key> key) const;
+        size_t size() const;
+        size_t weight() const;
+        void clear();
+
+        /** @brief Copies of all items, protected, then probation, then window (each MRU first). */
+        std::vector<std::pair<Key, Value>> entries() const;
+
+        /** @brief Window candidates turned away because a main-region entry was more popular (since clear()). */
+        uint64_t admission_rejects() const;
+
+    private:
+        enum class Region : uint8_t
+        {
+            Window,
+            Probation,
+            Protected
+        };
+
+        struct CacheItem
+        {
+            Key key;
+            Value value;
+            size_t weight;
+            Region region;
+        };
+        using ItemList = std::list<CacheItem>;
+        using ItemIterator = typename ItemList::iterator;
+
+        ItemList &list_for(Region region);
+        size_t &weight_for(Region region);
+        void move_to(ItemIterator it, Region region);
+        void erase(ItemIterator it);
+        void evict();
+        void demote_protected();
+
+        size_t window_capacity_;
+        size_t protected_capacity_;
+        size_t main_capacity_;
+
+        ItemList window_, probation_, protected_;
+        size_t window_weight_ = 0, probation_weight_ = 0, protected_weight_ = 0;
+        uint64_t admission_rejects_ = 0;
+        // Keyed by views of the keys in the list nodes, which never move: each key is stored
+        // once, and lookups need no Key
+        std::unordered_map<KeyView<Key>, ItemIterator> cache_map_;
+        FrequencySketch sketch_;
+    };
+
+} // namespace Cache
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef UPSTREAM_POOL_HPP
+#define UPSTREAM_POOL_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <atomic>
+#include "SocketUtils.hpp"
+
+namespace proxy
+{
+    /**
+     * @brief Pool of idle keep-alive connections to origin servers, keyed by (ip, port).
+     *
+     * A connection goes back into the pool only after its response was fully framed
+     * (see HttpResponseParser) and the origin allowed keep-alive. Idle connections are
+     * dropped after idle_timeout, and checked with a non-blocking peek before reuse so
+     * a connection the origin already closed is never handed out.
+     *
+     * Thread-safety: all public methods are guarded by an internal mutex.
+     */
+    class UpstreamPool
+    {
+    public:
+        struct Options
+        {
+            size_t max_idle_per_host = 8;
+            size_t max_idle_total = 256;
+            std::chrono::seconds idle_timeout{30};
+        };
+
+        /**
+         * @brief RAII handle for one origin connection.
+         *
+         * The destructor closes the socket unless keep_alive() was called, in which
+         * case it is returned to the pool.
+         */
+        class Lease
+        {
+        public:
+            Lease() = default;
+            Lease(UpstreamPool *pool, std::string ip, int port, int fd, bool reused);
+            Lease(Lease &&other) noexcept;
+            Lease &operator=(Lease &&other) noexcept;
+            ~Lease();
+
+            int fd() const { return fd_; }
+            const std::string &ip() const { return ip_; }
+            // True if the connection came from the pool (and so may turn out to be stale)
+            bool reused() const { return reused_; }
+            // The response was fully read and the origin allows reuse: pool it on release
+            void keep_alive() { keep_alive_ = true; }
+
+            Lease(const Lease &) = delete;
+            Lease &operator=(const Lease &) = delete;
+
+        private:
+            void reset();
+
+            UpstreamPool *pool_ = nullptr;
+            std::string ip_;
+            int port_ = 0;
+            int fd_ = -1;
+            bool reused_ = false;
+            bool keep_alive_ = false;
+        };
+
+        UpstreamPool();
+        explicit UpstreamPool(Options options);
+        ~UpstreamPool();
+
+        /**
+         * @brief Get a blocking connection to one of `ips` (in preference order) on `port`:
+         * a pooled one if available, else a new Happy Eyeballs connect (net::connect_race).
+         * @param outcomes If given, receives the connect attempts' results (empty on reuse).
+         * @throw std::runtime_error if no connection can be established within connect_timeout.
+         */
+        Lease acquire(const std::vector<std::string> &ips, int port, std::chrono::milliseconds connect_timeout,
+                      std::vector<net::ConnectOutcome> *outcomes = nullptr);
+
+        /**
+         * @brief Take a healthy idle connection to ip:port, or -1 if there is none.
+         * The caller owns the fd and should hand it back with put_idle() or close it.
+         */
+        int take_idle(const std::string &ip, int port);
+
+        /**
+         * @brief Park a connection whose last response was fully read. Closes it if the pool is full.
+         */
+        void put_idle(const std::string &ip, int port, int fd);
+
+        size_t idle_count() const;
+        size_t reused_count() const { return reused_; }
+        size_t connect_count() const { return connected_; }
+
+        UpstreamPool(const UpstreamPool &) = delete;
+        UpstreamPool &operator=(const UpstreamPool &) = delete;
+
+    private:
+        struct IdleConnection
+        {
+            int fd;
+            std::chrono::steady_clock::time_point idle_since;
+        };
+
+        static std::string key_of(const std::string &ip, int port) { return ip + ":" + std::to_string(port); }
+        // No pending data and no EOF: the origin has not closed its end
+        static bool is_healthy(int fd);
+        void prune_expired(std::deque<IdleConnection> &idle, std::chrono::steady_clock::time_point now);
+
+        Options options_;
+        std::unordered_map<std::string, std::deque<IdleConnection>> idle_; // most recently used at the back
+        size_t idle_total_ = 0;
+        mutable std::mutex mutex_;
+        std::atomic<size_t> reused_{0};
+        std::atomic<size_t> connected_{0};
+    };
+
+} // namespace proxy
+
+#endif // UPSTREAM_POOL_HPP
@@ -0,0 +1,86 @@
+#ifndef WEIGHT_BUDGET_HPP
+#define WEIGHT_BUDGET_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace Cache
+{
+    /**
+     * @brief Checks the capacity and max_entry_fraction a cache is constructed with.
+     * @param cache The class name, for the message.
+     * @throw std::invalid_argument if capacity is 0 or max_entry_fraction is not in (0, 1].
+     */
+    inline void check_cache_arguments(const char *cache, size_t capacity, double max_entry_fraction)
+    {
+        if (capacity == 0)
+        {
+            throw std::invalid_argument(std::string(cache) + " capacity must be greater than 0.");
+        }
+        if (!(max_entry_fraction > 0.0 && max_entry_fraction <= 1.0))
+        {
+            throw std::invalid_argument(std::string(cache) + " max entry fraction must be in (0, 1].");
+        }
+    }
+
+    /**
+     * @brief The weight accounting every eviction policy shares: the capacity, the weigher
+     *        entries are measured with, the heaviest entry put() accepts and the peak total weight.
+     *        The total itself stays with each policy, which may split it across its queues.
+     */
+    template <typename Key, typename Value>
+    class WeightBudget
+    {
+    public:
+        /**
+         * @brief Measures an entry in the units of the capacity (e.g. bytes).
+         * Without one, every entry weighs 1 and the capacity is an item count.
+         */
+        using Weigher = std::function<size_t(const Key &, const Value &)>;
+
+        /** @brief The maximum total weight of the items. */
+        size_t capacity() const { return capacity_; }
+
+        /** @brief The most the total weight has been since construction. */
+        size_t peak_weight() const { return peak_weight_; }
+
+        /** @brief The heaviest entry put() accepts; never more than capacity(). */
+        size_t max_entry_weight() const { return max_entry_weight_; }
+
+    protected:
+        /** @throw std::invalid_argument naming `cache`, see check_cache_arguments. */
+        WeightBudget(const char *cache, size_t capacity, Weigher weigher, double max_entry_fraction)
+            : capacity_(capacity), weigher_(std::move(weigher))
+        {
+            check_cache_arguments(cache, capacity, max_entry_fraction);
+            max_entry_weight_ = std::max<size_t>(1, static_cast<size_t>(static_cast<double>(capacity) * max_entry_fraction));
+        }
+
+        size_t weigh(const Key &key, const Value &value) const { return weigher_ ? weigher_(key, value) : 1; }
+
+        bool weighted() const { return static_cast<bool>(weigher_); }
+
+        /**
+         * @brief Whether put() must reject an entry of this weight. It then also drops an older
+         *        value under the key, which must not keep being served in the new one's place.
+         *        An accepted entry always fits once every other entry is evicted.
+         */
+        bool too_heavy(size_t entry_weight) const { return entry_weight > max_entry_weight_; }
+
+        /** @brief Records the total weight a put() left. */
+        void note_weight(size_t weight) { peak_weight_ = std::max(peak_weight_, weight); }
+
+    private:
+        size_t capacity_;
+        Weigher weigher_;
+        size_t max_entry_weight_;
+        size_t peak_weight_ = 0;
+    };
+
+} // namespace Cache
+
+#endif
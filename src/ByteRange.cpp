@@ -0,0 +1,300 @@
+#include "../include/proxy/ByteRange.hpp"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <ctime>
+#include <random>
+#include <string>
+
+namespace proxy
+{
+    namespace
+    {
+        std::string_view trim(std::string_view s)
+        {
+            while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+                s.remove_prefix(1);
+            while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+                s.remove_suffix(1);
+            return s;
+        }
+
+        // Digits only; a value too large for 64 bits saturates (it is past any body anyway)
+        bool parse_position(std::string_view text, uint64_t &value)
+        {
+            if (text.empty() || !std::all_of(text.begin(), text.end(), [](unsigned char c) { return std::isdigit(c); }))
+                return false;
+            if (std::from_chars(text.data(), text.data() + text.size(), value).ec == std::errc::result_out_of_range)
+                value = UINT64_MAX;
+            return true;
+        }
+
+        // W/"x" and "x" compare equal under the weak comparison of If-None-Match
+        std::string_view weak_tag(std::string_view tag)
+        {
+            return tag.substr(0, 2) == "W/" ? tag.substr(2) : tag;
+        }
+
+        // An IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT"), the form origins send
+        std::optional<time_t> parse_http_date(const std::string &date)
+        {
+            std::tm tm{};
+            const char *end = ::strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+            if (!end || *end != '\0')
+                return std::nullopt;
+            return ::timegm(&tm);
+        }
+
+        std::string content_range(const ByteRange &range, uint64_t length)
+        {
+            return "bytes " + std::to_string(range.first) + "-" + std::to_string(range.last) + "/" + std::to_string(length);
+        }
+
+        // A multipart boundary that will not turn up inside the body by chance
+        std::string make_boundary()
+        {
+            thread_local std::mt19937_64 rng{std::random_device{}()};
+            static const char digits[] = "0123456789abcdef";
+            std::string boundary = "mini_cdn_";
+            for (uint64_t bits = rng(), i = 0; i < 16; ++i, bits >>= 4)
+                boundary += digits[bits & 15];
+            return boundary;
+        }
+    }
+
+    std::optional<std::vector<ByteRange>> parse_byte_ranges(std::string_view header, uint64_t length)
+    {
+        header = trim(header);
+        constexpr std::string_view unit = "bytes=";
+        if (header.size() < unit.size() ||
+            !std::equal(unit.begin(), unit.end(), header.begin(),
+                        [](char a, char b) { return a == std::tolower(static_cast<unsigned char>(b)); }))
+            return std::nullopt;
+        header.remove_prefix(unit.size());
+
+        std::vector<ByteRange> ranges;
+        size_t specs = 0;
+        while (true)
+        {
+            const size_t comma = header.find(',');
+            std::string_view spec = trim(header.substr(0, comma));
+            if (!spec.empty()) // empty list elements are allowed
+            {
+                if (++specs > 4 * kMaxByteRanges)
+                    return std::nullopt;
+                const size_t dash = spec.find('-');
+                if (dash == std::string_view::npos)
+                    return std::nullopt;
+                std::string_view first_text = trim(spec.substr(0, dash));
+                std::string_view last_text = trim(spec.substr(dash + 1));
+                uint64_t first = 0, last = UINT64_MAX;
+                if (first_text.empty())
+                {
+                    // bytes=-N: the last N bytes
+                    uint64_t suffix = 0;
+                    if (!parse_position(last_text, suffix))
+                        return std::nullopt;
+                    if (suffix > 0 && length > 0)
+                        ranges.push_back({length - std::min(suffix, length), length - 1});
+                }
+                else
+                {
+                    if (!parse_position(first_text, first) || (!last_text.empty() && !parse_position(last_text, last)) ||
+                        last < first)
+                        return std::nullopt;
+                    if (first < length)
+                        ranges.push_back({first, std::min(last, length - 1)});
+                }
+            }
+            if (comma == std::string_view::npos)
+                break;
+            header.remove_prefix(comma + 1);
+        }
+        if (specs == 0)
+            return std::nullopt;
+
+        std::sort(ranges.begin(), ranges.end(), [](const ByteRange &a, const ByteRange &b) { return a.first < b.first; });
+        std::vector<ByteRange> merged;
+        for (const ByteRange &range : ranges)
+        {
+            if (!merged.empty() && range.first <= merged.back().last + 1)
+                merged.back().last = std::max(merged.back().last, range.last);
+            else
+                merged.push_back(range);
+        }
+        if (merged.size() > kMaxByteRanges)
+            return std::nullopt;
+        return merged;
+    }
+
+    bool if_range_matches(std::string_view if_range, const CachedResponse &entry)
+    {
+        if_range = trim(if_range);
+        if (!if_range.empty() && if_range.front() == '"')
+            return if_range == entry.etag; // a weak entry tag (W/"...") never compares equal
+        if (if_range.substr(0, 2) == "W/")
+            return false;
+        return !entry.last_modified.empty() && if_range == entry.last_modified;
+    }
+
+    std::optional<CachedReply> range_response(const CachedResponsePtr &full, std::string_view range, std::string_view if_range)
+    {
+        if (range.empty() || !full->wire_head)
+            return std::nullopt;
+        // A chunked body is cached with its framing, so its offsets are not the representation's
+        if (full->status_line.size() < 12 || full->status_line.compare(9, 3, "200") != 0 ||
+            full->headers.contains(HeaderId::TransferEncoding))
+            return std::nullopt;
+        if (!if_range.empty() && !if_range_matches(if_range, *full))
+            return std::nullopt;
+        const uint64_t length = full->body_size();
+        std::optional<std::vector<ByteRange>> ranges = parse_byte_ranges(range, length);
+        if (!ranges)
+            return std::nullopt;
+
+        CachedReply reply;
+        reply.source = full;
+        const std::string version = full->status_line.substr(0, full->status_line.find(' '));
+        if (ranges->empty())
+        {
+            reply.head = std::make_shared<const std::string>(version + " 416 Range Not Satisfiable\r\nContent-Range: bytes */" +
+                                                             std::to_string(length) + "\r\nContent-Length: 0\r\n");
+            return reply;
+        }
+
+        const bool multipart = ranges->size() > 1;
+        std::string head = version + " 206 Partial Content\r\n";
+        for (const HttpHeaders::Field field : full->headers)
+        {
+            if (field.id == HeaderId::Connection || field.id == HeaderId::KeepAlive || field.id == HeaderId::ProxyConnection ||
+                field.id == HeaderId::Age || field.id == HeaderId::ContentLength || field.id == HeaderId::ContentRange ||
+                (multipart && field.id == HeaderId::ContentType))
+                continue; // per-hit, replaced below, or (multipart) moved into each part
+            head.append(field.name).append(": ").append(field.value).append("\r\n");
+        }
+
+        // The slices are pieces of the shared body or file: nothing is copied or read here
+        const CachedReply::From from = full->body ? CachedReply::From::Body : CachedReply::From::File;
+        const uint64_t base = full->body ? 0 : full->file_body.offset;
+        const auto add_text = [&reply](const std::string &text)
+        {
+            reply.body.push_back({CachedReply::From::Text, reply.text.size(), text.size()});
+            reply.text += text;
+        };
+        if (!multipart)
+        {
+            const ByteRange &only = ranges->front();
+            head += "Content-Range: " + content_range(only, length) + "\r\nContent-Length: " + std::to_string(only.length()) + "\r\n";
+            reply.body.push_back({from, base + only.first, static_cast<size_t>(only.length())});
+        }
+        else
+        {
+            const std::string boundary = make_boundary();
+            std::string part_type;
+            if (full->headers.contains(HeaderId::ContentType))
+                part_type = "Content-Type: " + std::string(full->headers.get(HeaderId::ContentType)) + "\r\n";
+            for (size_t i = 0; i < ranges->size(); ++i)
+            {
+                const ByteRange &part = (*ranges)[i];
+                add_text((i ? "\r\n--" : "--") + boundary + "\r\n" + part_type + "Content-Range: " + content_range(part, length) + "\r\n\r\n");
+                reply.body.push_back({from, base + part.first, static_cast<size_t>(part.length())});
+            }
+            add_text("\r\n--" + boundary + "--\r\n");
+            head += "Content-Type: multipart/byteranges; boundary=" + boundary + "\r\nContent-Length: " +
+                    std::to_string(reply.body_size()) + "\r\n";
+        }
+        reply.head = std::make_shared<const std::string>(std::move(head));
+        return reply;
+    }
+
+    ClientConditions take_client_conditions(HttpHeaders &headers)
+    {
+        ClientConditions conditions;
+        const std::pair<const char *, std::string *> fields[] = {{"If-None-Match", &conditions.if_none_match},
+                                                                 {"If-Modified-Since", &conditions.if_modified_since},
+                                                                 {"Range", &conditions.range},
+                                                                 {"If-Range", &conditions.if_range}};
+        for (const auto &[name, value] : fields)
+        {
+            if (headers.contains(name))
+            {
+                *value = headers.get(name);
+                headers.remove(name);
+            }
+        }
+        return conditions;
+    }
+
+    void restore_client_conditions(HttpHeaders &headers, const ClientConditions &conditions)
+    {
+        const std::pair<const char *, const std::string *> fields[] = {{"If-None-Match", &conditions.if_none_match},
+                                                                       {"If-Modified-Since", &conditions.if_modified_since},
+                                                                       {"Range", &conditions.range},
+                                                                       {"If-Range", &conditions.if_range}};
+        for (const auto &[name, value] : fields)
+        {
+            if (!value->empty())
+                headers.set(name, *value);
+        }
+    }
+
+    bool not_modified(const ClientConditions &conditions, const CachedResponse &entry)
+    {
+        if (!conditions.if_none_match.empty())
+        {
+            if (trim(conditions.if_none_match) == "*")
+                return true;
+            const std::string_view etag = weak_tag(entry.etag);
+            std::string_view list = conditions.if_none_match;
+            while (!etag.empty())
+            {
+                const size_t comma = list.find(',');
+                if (weak_tag(trim(list.substr(0, comma))) == etag)
+                    return true;
+                if (comma == std::string_view::npos)
+                    break;
+                list.remove_prefix(comma + 1);
+            }
+            return false;
+        }
+        if (conditions.if_modified_since.empty() || entry.last_modified.empty())
+            return false;
+        const std::optional<time_t> since = parse_http_date(conditions.if_modified_since);
+        const std::optional<time_t> modified = parse_http_date(entry.last_modified);
+        return since && modified && *modified <= *since;
+    }
+
+    std::optional<CachedReply> cached_reply(const CachedResponsePtr &full, const ClientConditions &conditions)
+    {
+        if (!full->wire_head || full->status_line.size() < 12 || full->status_line.compare(9, 3, "200") != 0)
+            return std::nullopt;
+        if (!not_modified(conditions, *full))
+            return range_response(full, conditions.range, conditions.if_range);
+
+        CachedReply reply;
+        reply.source = full;
+        std::string head = full->status_line.substr(0, full->status_line.find(' ')) + " 304 Not Modified\r\n";
+        for (const HttpHeaders::Field field : full->headers)
+        {
+            // The headers a 200 would have carried that describe the representation's metadata
+            if (field.id == HeaderId::ETag || field.id == HeaderId::LastModified || field.id == HeaderId::CacheControl ||
+                field.id == HeaderId::Expires || field.id == HeaderId::Date || field.id == HeaderId::Vary)
+                head.append(field.name).append(": ").append(field.value).append("\r\n");
+        }
+        reply.head = std::make_shared<const std::string>(std::move(head));
+        return reply;
+    }
+
+    void send_cached_reply(ResponseSink &client, const CachedResponsePtr &cached, const ClientConditions &conditions,
+                           const char *x_cache, bool keep_alive)
+    {
+        std::optional<CachedReply> reply;
+        if (!conditions.empty())
+            reply = cached_reply(cached, conditions);
+        if (reply)
+            send_reply(client, *reply, x_cache, keep_alive);
+        else
+            send_cached_response(client, *cached, x_cache, keep_alive);
+    }
+
+} // namespace proxy
@@ -0,0 +1,233 @@
+#include "../include/proxy/CacheSnapshot.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace proxy
+{
+    namespace
+    {
+        constexpr char kSnapshotMagic[8] = {'C', 'D', 'N', 'S', 'N', 'A', 'P', '1'};
+
+        struct SnapshotHeader
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t reserved;
+            uint64_t entries;
+            int64_t written_at_ms; // wall clock
+        };
+
+        // Key, head block, ETag, Last-Modified and body follow, unaligned
+        struct SnapshotRecord
+        {
+            uint32_t key_bytes;
+            uint32_t head_bytes;
+            uint32_t etag_bytes;
+            uint32_t last_modified_bytes;
+            uint64_t body_bytes;
+            int64_t received_at_ms; // wall clock
+            int64_t expires_at_ms;  // wall clock
+            uint64_t checksum;      // FNV-1a over everything after this header
+        };
+
+        uint64_t fnv1a(const char *data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                hash ^= static_cast<unsigned char>(data[i]);
+                hash *= 0x100000001b3ull;
+            }
+            return hash;
+        }
+
+        int64_t now_ms(std::chrono::system_clock::time_point t)
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+        }
+        int64_t now_ms(std::chrono::steady_clock::time_point t)
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+        }
+
+    }
+
+    size_t write_cache_snapshot(const std::string &path,
+                                const std::vector<std::pair<std::string, CachedResponsePtr>> &entries,
+                                const CacheSnapshot *carry_over)
+    {
+        const std::string tmp = path + ".tmp";
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("Cannot write cache snapshot " + tmp);
+
+        // Steady-clock times only mean something in this process: carry them over as wall time
+        const int64_t steady_to_wall_ms = now_ms(std::chrono::system_clock::now()) - now_ms(std::chrono::steady_clock::now());
+        SnapshotHeader header{};
+        std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+        header.version = 1;
+        header.written_at_ms = now_ms(std::chrono::system_clock::now());
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        size_t written = 0;
+        for (const auto &[key, entry] : entries)
+        {
+            if (!entry || !entry->body || !entry->wire_head)
+                continue;
+            const std::string &head = *entry->wire_head;
+            const std::vector<char> &body = *entry->body;
+            SnapshotRecord record{};
+            record.key_bytes = static_cast<uint32_t>(key.size());
+            record.head_bytes = static_cast<uint32_t>(head.size());
+            record.etag_bytes = static_cast<uint32_t>(entry->etag.size());
+            record.last_modified_bytes = static_cast<uint32_t>(entry->last_modified.size());
+            record.body_bytes = body.size();
+            record.received_at_ms = now_ms(entry->received_at) + steady_to_wall_ms;
+            record.expires_at_ms = now_ms(entry->expires_at) + steady_to_wall_ms;
+            uint64_t hash = fnv1a(key.data(), key.size());
+            hash = fnv1a(head.data(), head.size(), hash);
+            hash = fnv1a(entry->etag.data(), entry->etag.size(), hash);
+            hash = fnv1a(entry->last_modified.data(), entry->last_modified.size(), hash);
+            record.checksum = fnv1a(body.data(), body.size(), hash);
+
+            out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+            out.write(key.data(), key.size());
+            out.write(head.data(), head.size());
+            out.write(entry->etag.data(), entry->etag.size());
+            out.write(entry->last_modified.data(), entry->last_modified.size());
+            out.write(body.data(), body.size());
+            ++written;
+        }
+        if (carry_over)
+        {
+            std::unordered_set<std::string_view> fresh;
+            for (const auto &entry : entries)
+                fresh.insert(entry.first);
+            std::lock_guard<std::mutex> lock(carry_over->mutex_);
+            for (const auto &[key, pos] : carry_over->index_)
+            {
+                if (fresh.count(key))
+                    continue;
+                SnapshotRecord record;
+                std::memcpy(&record, carry_over->data_ + pos, sizeof(record));
+                out.write(carry_over->data_ + pos, sizeof(record) + record.key_bytes + record.head_bytes +
+                                                       record.etag_bytes + record.last_modified_bytes + record.body_bytes);
+                ++written;
+            }
+        }
+        header.entries = written;
+        out.seekp(0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.close();
+        if (!out || std::rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Cannot write cache snapshot " + path);
+        }
+        return written;
+    }
+
+    CacheSnapshot::CacheSnapshot(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open cache snapshot " + path);
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader))
+        {
+            ::close(fd);
+            throw std::runtime_error("Not a cache snapshot: " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void *mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps the file
+        if (mapped == MAP_FAILED)
+            throw std::runtime_error("Cannot map cache snapshot " + path);
+        data_ = static_cast<const char *>(mapped);
+
+        SnapshotHeader header;
+        std::memcpy(&header, data_, sizeof(header));
+        if (std::memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 || header.version != 1)
+        {
+            ::munmap(const_cast<char *>(data_), size_);
+            throw std::runtime_error("Not a cache snapshot: " + path);
+        }
+        wall_to_steady_ms_ = now_ms(std::chrono::steady_clock::now()) - now_ms(std::chrono::system_clock::now());
+
+        // Index only: touches the record headers and keys, not the bodies
+        size_t pos = sizeof(header);
+        index_.reserve(header.entries);
+        for (uint64_t i = 0; i < header.entries && pos + sizeof(SnapshotRecord) <= size_; ++i)
+        {
+            SnapshotRecord record;
+            std::memcpy(&record, data_ + pos, sizeof(record));
+            uint64_t total = sizeof(record) + uint64_t{record.key_bytes} + record.head_bytes + record.etag_bytes +
+                             record.last_modified_bytes + record.body_bytes;
+            if (record.body_bytes > size_ || total > size_ - pos)
+                break; // truncated
+            index_.emplace(std::string_view(data_ + pos + sizeof(record), record.key_bytes), pos);
+            pos += total;
+        }
+    }
+
+    CacheSnapshot::~CacheSnapshot()
+    {
+        if (data_)
+            ::munmap(const_cast<char *>(data_), size_);
+    }
+
+    CachedResponsePtr CacheSnapshot::take(std::string_view key)
+    {
+        size_t pos;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(key);
+            if (it == index_.end())
+                return nullptr;
+            pos = it->second;
+            index_.erase(it);
+        }
+
+        SnapshotRecord record;
+        std::memcpy(&record, data_ + pos, sizeof(record));
+        const char *p = data_ + pos + sizeof(record);
+        const size_t payload = record.key_bytes + record.head_bytes + record.etag_bytes + record.last_modified_bytes +
+                               record.body_bytes;
+        if (fnv1a(p, payload) != record.checksum)
+            return nullptr;
+
+        auto entry = std::make_shared<CachedResponse>();
+        p += record.key_bytes;
+        std::string head(p, record.head_bytes);
+        p += record.head_bytes;
+        entry->status_line = head.substr(0, head.find("\r\n"));
+        parse_head_block(head, entry->headers);
+        read_stale_directives(*entry);
+        entry->wire_head = std::make_shared<const std::string>(std::move(head));
+        entry->etag.assign(p, record.etag_bytes);
+        p += record.etag_bytes;
+        entry->last_modified.assign(p, record.last_modified_bytes);
+        p += record.last_modified_bytes;
+        entry->body = std::make_shared<const std::vector<char>>(p, p + record.body_bytes);
+
+        using std::chrono::milliseconds;
+        entry->received_at = std::chrono::steady_clock::time_point(milliseconds(record.received_at_ms + wall_to_steady_ms_));
+        entry->expires_at = std::chrono::steady_clock::time_point(milliseconds(record.expires_at_ms + wall_to_steady_ms_));
+        entry->max_age = std::chrono::duration_cast<std::chrono::seconds>(entry->expires_at - entry->received_at);
+        return entry;
+    }
+
+    size_t CacheSnapshot::size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return index_.size();
+    }
+
+} // namespace proxy
@@ -0,0 +1,173 @@
+#include "../include/proxy/CachedResponse.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace proxy
+{
+    FileHandle::~FileHandle()
+    {
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+
+    void seal_cache_entry(CachedResponse &entry, std::vector<char> body)
+    {
+        std::string head = entry.status_line + "\r\n";
+        bool framed = false; // Content-Length or Transfer-Encoding present
+        for (const HttpHeaders::Field field : entry.headers)
+        {
+            if (field.id == HeaderId::Connection || field.id == HeaderId::KeepAlive ||
+                field.id == HeaderId::ProxyConnection || field.id == HeaderId::Age)
+                continue; // connection headers describe the origin connection; Age is computed per hit
+            framed = framed || field.id == HeaderId::ContentLength || field.id == HeaderId::TransferEncoding;
+            head.append(field.name).append(": ").append(field.value).append("\r\n");
+        }
+        if (!framed)
+            head += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        entry.wire_head = std::make_shared<const std::string>(std::move(head));
+        entry.body = std::make_shared<const std::vector<char>>(std::move(body));
+    }
+
+    void parse_head_block(std::string_view head, HttpHeaders &headers)
+    {
+        size_t pos = head.find("\r\n");
+        while (pos != std::string_view::npos && pos + 2 < head.size())
+        {
+            pos += 2;
+            size_t end = head.find("\r\n", pos);
+            std::string_view line = head.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+            size_t colon = line.find(':');
+            if (colon != std::string_view::npos)
+            {
+                std::string_view value = line.substr(colon + 1);
+                while (!value.empty() && value.front() == ' ')
+                    value.remove_prefix(1);
+                headers.add(line.substr(0, colon), value);
+            }
+            pos = end;
+        }
+    }
+
+    void read_stale_directives(CachedResponse &entry)
+    {
+        std::string cc(entry.headers.get(HeaderId::CacheControl));
+        std::transform(cc.begin(), cc.end(), cc.begin(), [](unsigned char ch)
+                       { return static_cast<char>(std::tolower(ch)); });
+        if (cc.find("must-revalidate") != std::string::npos || cc.find("proxy-revalidate") != std::string::npos ||
+            cc.find("no-cache") != std::string::npos)
+        {
+            entry.stale_while_revalidate = entry.stale_if_error = std::chrono::seconds(0);
+            return;
+        }
+        auto window = [&cc](const char *directive) -> std::optional<std::chrono::seconds>
+        {
+            size_t pos = cc.find(directive);
+            if (pos == std::string::npos)
+                return std::nullopt;
+            return std::chrono::seconds(std::max(std::atoi(cc.c_str() + pos + std::char_traits<char>::length(directive)), 0));
+        };
+        entry.stale_while_revalidate = window("stale-while-revalidate=");
+        entry.stale_if_error = window("stale-if-error=");
+    }
+
+    Freshness cache_freshness(const CachedResponse &entry, const StalePolicy &policy,
+                              std::chrono::steady_clock::time_point now, double random)
+    {
+        if (now <= entry.expires_at)
+        {
+            if (policy.early_refresh_beta <= 0 || entry.fetch_time.count() <= 0)
+                return Freshness::Fresh;
+            std::chrono::duration<double> gap = entry.fetch_time * (-policy.early_refresh_beta * std::log(random));
+            return now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(gap) >= entry.expires_at
+                       ? Freshness::RefreshEarly
+                       : Freshness::Fresh;
+        }
+        if (now <= entry.expires_at + entry.stale_while_revalidate.value_or(policy.while_revalidate))
+            return Freshness::StaleWhileRevalidate;
+        return Freshness::Expired;
+    }
+
+    bool usable_if_error(const CachedResponse &entry, const StalePolicy &policy, std::chrono::steady_clock::time_point now)
+    {
+        return now <= entry.expires_at + entry.stale_if_error.value_or(policy.if_error);
+    }
+
+    size_t cached_response_bytes(const CachedResponse &entry)
+    {
+        size_t head = entry.wire_head ? entry.wire_head->size() : entry.status_line.size();
+        size_t body = entry.body ? entry.body->size() : 0;
+        return sizeof(CachedResponse) + 2 * head + body + entry.etag.size() + entry.last_modified.size();
+    }
+
+    std::string cache_hit_headers(const CachedResponse &cached, const char *x_cache, bool keep_alive)
+    {
+        auto age = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - cached.received_at);
+        std::string out = "Age: " + std::to_string(age.count()) + "\r\nX-Cache: " + x_cache + "\r\n";
+        out += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+        return out;
+    }
+
+    void send_cached_response(ResponseSink &client, const CachedResponse &cached, const char *x_cache, bool keep_alive)
+    {
+        // Only the per-hit headers are built here; head block and body are shared with the cache
+        std::string per_hit = cache_hit_headers(cached, x_cache, keep_alive);
+        if (!cached.body)
+        {
+            std::string_view head[] = {*cached.wire_head, per_hit};
+            client.write(head, 2);
+            client.write_file(cached.file_body.file->fd(), cached.file_body.offset, cached.file_body.length);
+            return;
+        }
+        std::string_view parts[] = {*cached.wire_head, per_hit, std::string_view(cached.body->data(), cached.body->size())};
+        client.write(parts, 3);
+    }
+
+    size_t CachedReply::body_size() const
+    {
+        size_t size = 0;
+        for (const Piece &piece : body)
+            size += piece.length;
+        return size;
+    }
+
+    std::string_view CachedReply::bytes(const Piece &piece) const
+    {
+        const char *base = piece.from == From::Text ? text.data() : source->body->data();
+        return std::string_view(base + piece.offset, piece.length);
+    }
+
+    CachedReply whole_reply(CachedResponsePtr entry)
+    {
+        CachedReply reply;
+        reply.head = entry->wire_head;
+        if (entry->body)
+            reply.body.push_back({CachedReply::From::Body, 0, entry->body->size()});
+        else
+            reply.body.push_back({CachedReply::From::File, entry->file_body.offset, entry->file_body.length});
+        reply.source = std::move(entry);
+        return reply;
+    }
+
+    void send_reply(ResponseSink &client, const CachedReply &reply, const char *x_cache, bool keep_alive)
+    {
+        std::string per_hit = cache_hit_headers(*reply.source, x_cache, keep_alive);
+        std::vector<std::string_view> parts = {*reply.head, per_hit};
+        for (const CachedReply::Piece &piece : reply.body)
+        {
+            if (piece.from != CachedReply::From::File)
+            {
+                parts.push_back(reply.bytes(piece));
+                continue;
+            }
+            client.write(parts.data(), parts.size());
+            parts.clear();
+            client.write_file(reply.source->file_body.file->fd(), piece.offset, piece.length);
+        }
+        if (!parts.empty())
+            client.write(parts.data(), parts.size());
+    }
+
+} // namespace proxy
@@ -0,0 +1,169 @@
+#include "../include/proxy/ClockCache.hpp"
+#include "../include/proxy/CachedResponse.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace Cache
+{
+    template <typename Key, typename Value>
+    ClockCache<Key, Value>::ClockCache(size_t capacity, Weigher weigher, double max_entry_fraction)
+        : WeightBudget<Key, Value>("ClockCache", capacity, std::move(weigher), max_entry_fraction)
+    {
+    }
+
+    template <typename Key, typename Value>
+    uint32_t ClockCache<Key, Value>::find(KeyView<Key> key, uint32_t hash) const
+    {
+        return index_.find(hash, [&](uint32_t slot) { return slots_[slot].key == key; });
+    }
+
+    template <typename Key, typename Value>
+    void ClockCache<Key, Value>::erase(uint32_t slot)
+    {
+        Slot &s = slots_[slot];
+        index_.erase(index_.find_slot(SlotIndex::hash_of<KeyView<Key>>(s.key), slot));
+        weight_ -= s.weight;
+        s.key = Key{};
+        s.value = Value{}; // release what the value holds now, not when the slot is reused
+        s.used = false;
+        s.next_free = free_;
+        free_ = slot;
+    }
+
+    template <typename Key, typename Value>
+    void ClockCache<Key, Value>::evict(uint32_t keep)
+    {
+        // Some entry other than `keep` is unreferenced by the end of the second lap at the latest
+        const uint32_t count = static_cast<uint32_t>(slots_.size());
+        while (true)
+        {
+            if (hand_ >= count)
+                hand_ = 0;
+            Slot &s = slots_[hand_];
+            const uint32_t slot = hand_++;
+            if (!s.used || slot == keep)
+                continue;
+            if (s.referenced.load(std::memory_order_relaxed))
+            {
+                s.referenced.store(0, std::memory_order_relaxed);
+                continue;
+            }
+            erase(slot);
+            return;
+        }
+    }
+
+    template <typename Key, typename Value>
+    bool ClockCache<Key, Value>::put(const Key &key, const Value &value)
+    {
+        const size_t entry_weight = this->weigh(key, value);
+        const uint32_t hash = SlotIndex::hash_of<KeyView<Key>>(key);
+        const uint32_t bucket = find(key, hash);
+        if (this->too_heavy(entry_weight))
+        {
+            if (bucket != kNone)
+                erase(index_.slot(bucket));
+            return false;
+        }
+
+        uint32_t slot;
+        if (bucket != kNone)
+        {
+            slot = index_.slot(bucket);
+            weight_ = weight_ - slots_[slot].weight + entry_weight;
+            slots_[slot].value = value;
+            slots_[slot].weight = entry_weight;
+            slots_[slot].referenced.store(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            if (free_ != kNone)
+            {
+                slot = free_;
+                free_ = slots_[slot].next_free;
+            }
+            else
+            {
+                if (slots_.size() == kNone)
+                    throw std::length_error("ClockCache is full");
+                slot = static_cast<uint32_t>(slots_.size());
+                slots_.emplace_back();
+            }
+            Slot &s = slots_[slot];
+            s.key = key;
+            s.value = value;
+            s.weight = entry_weight;
+            s.used = true;
+            s.referenced.store(0, std::memory_order_relaxed);
+            index_.insert(hash, slot);
+            weight_ += entry_weight;
+        }
+
+        while (weight_ > this->capacity())
+            evict(slot);
+        this->note_weight(weight_);
+        return true;
+    }
+
+    template <typename Key, typename Value>
+    std::optional<Value> ClockCache<Key, Value>::get(KeyView<Key> key, size_t *weight)
+    {
+        const uint32_t bucket = find(key, SlotIndex::hash_of(key));
+        if (bucket == kNone)
+            return std::nullopt;
+        Slot &s = slots_[index_.slot(bucket)];
+        // Only store when the bit is clear, so hits on a hot entry leave its cache line shared
+        if (!s.referenced.load(std::memory_order_relaxed))
+            s.referenced.store(1, std::memory_order_relaxed);
+        if (weight)
+            *weight = s.weight;
+        return s.value;
+    }
+
+    template <typename Key, typename Value>
+    bool ClockCache<Key, Value>::contains(KeyView<Key> key) const
+    {
+        return find(key, SlotIndex::hash_of(key)) != kNone;
+    }
+
+    template <typename Key, typename Value>
+    size_t ClockCache<Key, Value>::size() const
+    {
+        return index_.size();
+    }
+
+    template <typename Key, typename Value>
+    size_t ClockCache<Key, Value>::weight() const
+    {
+        return weight_;
+    }
+
+    template <typename Key, typename Value>
+    std::vector<std::pair<Key, Value>> ClockCache<Key, Value>::entries() const
+    {
+        std::vector<std::pair<Key, Value>> out;
+        out.reserve(index_.size());
+        const size_t count = slots_.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Slot &s = slots_[(hand_ + i) % count];
+            if (s.used)
+                out.emplace_back(s.key, s.value);
+        }
+        return out;
+    }
+
+    template <typename Key, typename Value>
+    void ClockCache<Key, Value>::clear()
+    {
+        slots_.clear();
+        index_.clear();
+        free_ = kNone;
+        hand_ = 0;
+        weight_ = 0;
+    }
+}
+
+template class Cache::ClockCache<std::string, std::string>;
+template class Cache::ClockCache<int, int>;
+template class Cache::ClockCache<std::string, proxy::CachedResponsePtr>;
@@ -0,0 +1,227 @@
+#include "../include/proxy/DiskCache.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace proxy
+{
+    namespace
+    {
+        constexpr uint32_t kRecordMagic = 0x43444e31; // "CDN1"
+
+        // Fixed-size start of every record; key, head block, ETag, Last-Modified and body follow.
+        // Hits use the index's copy of the metadata; the record keeps one so a segment file
+        // describes itself.
+        struct RecordHeader
+        {
+            uint32_t magic;
+            uint32_t key_bytes;
+            uint32_t head_bytes;
+            uint32_t etag_bytes;
+            uint32_t last_modified_bytes;
+            uint32_t reserved;
+            uint64_t body_bytes;
+        };
+
+        bool pwrite_all(int fd, const char *data, size_t size, uint64_t offset)
+        {
+            while (size > 0)
+            {
+                ssize_t n = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                data += n;
+                size -= n;
+                offset += n;
+            }
+            return true;
+        }
+    }
+
+    DiskCache::DiskCache(std::string dir, size_t max_bytes, size_t segment_bytes)
+        : dir_(std::move(dir)), max_bytes_(max_bytes), segment_bytes_(segment_bytes)
+    {
+        if (segment_bytes_ == 0)
+            segment_bytes_ = std::clamp<size_t>(max_bytes / 8, 1 << 20, 256 << 20);
+        if (segment_bytes_ <= sizeof(RecordHeader) || max_bytes_ < 2 * segment_bytes_)
+            throw std::invalid_argument("Disk cache budget must hold at least two segments.");
+
+        std::error_code ec;
+        std::filesystem::create_directories(dir_, ec);
+        if (ec)
+            throw std::runtime_error("Cannot create disk cache directory " + dir_ + ": " + ec.message());
+        // The index is not persisted: records from an earlier run cannot be found again
+        for (const auto &file : std::filesystem::directory_iterator(dir_, ec))
+        {
+            const std::string name = file.path().filename().string();
+            if (name.rfind("segment-", 0) == 0 && file.path().extension() == ".log")
+                std::filesystem::remove(file.path(), ec);
+        }
+        open_segment();
+    }
+
+    uint64_t DiskCache::hash_key(std::string_view key)
+    {
+        return static_cast<uint64_t>(std::hash<std::string_view>{}(key));
+    }
+
+    void DiskCache::open_segment()
+    {
+        Segment segment;
+        segment.id = next_segment_id_;
+        segment.path = dir_ + "/segment-" + std::to_string(segment.id) + ".log";
+        int fd = ::open(segment.path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            throw std::runtime_error("Cannot create disk cache segment " + segment.path + ": " + strerror(errno));
+        segment.file = std::make_shared<const FileHandle>(fd);
+        ++next_segment_id_;
+        segments_.push_back(std::move(segment));
+    }
+
+    void DiskCache::drop_oldest()
+    {
+        Segment &oldest = segments_.front();
+        for (uint64_t key : oldest.keys)
+        {
+            auto it = index_.find(key);
+            if (it != index_.end() && it->second.segment == oldest.id)
+                index_.erase(it);
+        }
+        // Hits still sending from it keep the file open; the space comes back when they finish
+        ::unlink(oldest.path.c_str());
+        total_bytes_ -= oldest.bytes;
+        segments_.pop_front();
+        ++stats_.dropped_segments;
+    }
+
+    bool DiskCache::store(const std::string &key, const CachedResponse &entry)
+    {
+        if (!entry.body || !entry.wire_head)
+            return false;
+
+        RecordHeader header{};
+        header.magic = kRecordMagic;
+        header.key_bytes = static_cast<uint32_t>(key.size());
+        header.head_bytes = static_cast<uint32_t>(entry.wire_head->size());
+        header.etag_bytes = static_cast<uint32_t>(entry.etag.size());
+        header.last_modified_bytes = static_cast<uint32_t>(entry.last_modified.size());
+        header.body_bytes = entry.body->size();
+
+        std::string meta(reinterpret_cast<const char *>(&header), sizeof(header));
+        meta.append(key).append(*entry.wire_head).append(entry.etag).append(entry.last_modified);
+        const size_t record_bytes = meta.size() + entry.body->size();
+
+        // Reserve the record's place under the lock, write it without, publish it under the lock
+        Location location;
+        uint64_t offset = 0;
+        std::shared_ptr<const FileHandle> file;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (record_bytes > segment_bytes_)
+            {
+                ++stats_.rejected;
+                return false;
+            }
+            try
+            {
+                if (segments_.back().bytes + record_bytes > segment_bytes_)
+                    open_segment();
+            }
+            catch (const std::exception &)
+            {
+                ++stats_.rejected;
+                return false;
+            }
+            Segment &current = segments_.back();
+            location.segment = current.id;
+            location.sequence = next_sequence_++;
+            offset = current.bytes;
+            file = current.file;
+            current.bytes += record_bytes;
+            total_bytes_ += record_bytes;
+            while (total_bytes_ > max_bytes_ && segments_.size() > 1)
+                drop_oldest();
+        }
+
+        bool written = pwrite_all(file->fd(), meta.data(), meta.size(), offset) &&
+                       pwrite_all(file->fd(), entry.body->data(), entry.body->size(), offset + meta.size());
+        if (written)
+        {
+            // Shares the head block; the headers and validators are copied once, here
+            auto cached = std::make_shared<CachedResponse>(entry);
+            cached->body.reset();
+            cached->fetch_time = {}; // not refreshed early: a refresh belongs to the memory tier
+            cached->file_body = FileBody{std::move(file), offset + meta.size(), entry.body->size()};
+            location.key = key;
+            location.entry = std::move(cached);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!written || location.segment < segments_.front().id)
+        {
+            ++stats_.rejected; // write failed, or the segment was dropped while we wrote
+            return false;
+        }
+        const uint64_t hash = hash_key(key);
+        auto [it, added] = index_.try_emplace(hash);
+        if (!added && it->second.sequence > location.sequence)
+        {
+            ++stats_.rejected; // a store that reserved after us published first: it is newer
+            return false;
+        }
+        segments_[location.segment - segments_.front().id].keys.push_back(hash);
+        it->second = std::move(location);
+        ++stats_.stores;
+        return true;
+    }
+
+    CachedResponsePtr DiskCache::lookup(std::string_view key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(hash_key(key));
+        if (it == index_.end() || it->second.key != key)
+        {
+            ++stats_.misses;
+            return nullptr;
+        }
+        if (it->second.entry->is_stale())
+        {
+            index_.erase(it); // revalidation goes through the memory tier
+            ++stats_.misses;
+            return nullptr;
+        }
+        ++stats_.hits;
+        return it->second.entry;
+    }
+
+    size_t DiskCache::max_object_bytes() const
+    {
+        return segment_bytes_ - sizeof(RecordHeader);
+    }
+
+    size_t DiskCache::bytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return total_bytes_;
+    }
+
+    size_t DiskCache::size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return index_.size();
+    }
+
+    DiskCache::Stats DiskCache::stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+} // namespace proxy
@@ -0,0 +1,215 @@
+#include "../include/proxy/EventLoop.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <string>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace net
+{
+#ifdef __linux__
+    namespace
+    {
+        uint32_t to_epoll(uint32_t events)
+        {
+            uint32_t out = 0;
+            if (events & EventLoop::kReadable)
+                out |= EPOLLIN | EPOLLRDHUP;
+            if (events & EventLoop::kWritable)
+                out |= EPOLLOUT;
+            return out;
+        }
+
+        uint32_t from_epoll(uint32_t events)
+        {
+            uint32_t out = 0;
+            if (events & (EPOLLIN | EPOLLRDHUP))
+                out |= EventLoop::kReadable;
+            if (events & EPOLLOUT)
+                out |= EventLoop::kWritable;
+            if (events & (EPOLLERR | EPOLLHUP))
+                out |= EventLoop::kError;
+            return out;
+        }
+    }
+
+    EventLoop::EventLoop()
+    {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0)
+            throw std::runtime_error("epoll_create1 failed: " + std::string(strerror(errno)));
+
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd_ < 0)
+        {
+            ::close(epoll_fd_);
+            throw std::runtime_error("eventfd failed: " + std::string(strerror(errno)));
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = wake_fd_;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+    }
+
+    EventLoop::~EventLoop()
+    {
+        ::close(wake_fd_);
+        ::close(epoll_fd_);
+    }
+
+    void EventLoop::add(int fd, uint32_t events, Handler handler)
+    {
+        epoll_event ev{};
+        ev.events = to_epoll(events);
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+            throw std::runtime_error("epoll_ctl(ADD) failed: " + std::string(strerror(errno)));
+        handlers_[fd] = std::make_shared<Handler>(std::move(handler));
+    }
+
+    void EventLoop::modify(int fd, uint32_t events)
+    {
+        epoll_event ev{};
+        ev.events = to_epoll(events);
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) < 0)
+            throw std::runtime_error("epoll_ctl(MOD) failed: " + std::string(strerror(errno)));
+    }
+
+    void EventLoop::remove(int fd)
+    {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        handlers_.erase(fd);
+    }
+
+    void EventLoop::post(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(posted_mutex_);
+            posted_.push_back(std::move(task));
+        }
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    void EventLoop::stop()
+    {
+        running_ = false;
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    void EventLoop::drain_posted()
+    {
+        uint64_t count;
+        while (::read(wake_fd_, &count, sizeof(count)) > 0)
+        {
+        }
+        std::vector<std::function<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> lock(posted_mutex_);
+            tasks.swap(posted_);
+        }
+        for (auto &task : tasks)
+            task();
+    }
+
+    EventLoop::TimerId EventLoop::run_after(std::chrono::milliseconds delay, std::function<void()> task)
+    {
+        TimerId id = next_timer_id_++;
+        auto deadline = std::chrono::steady_clock::now() + delay;
+        timers_.emplace(TimerKey{deadline, id}, std::move(task));
+        timer_deadlines_[id] = deadline;
+        return id;
+    }
+
+    void EventLoop::cancel_timer(TimerId id)
+    {
+        auto it = timer_deadlines_.find(id);
+        if (it == timer_deadlines_.end())
+            return;
+        timers_.erase(TimerKey{it->second, id});
+        timer_deadlines_.erase(it);
+    }
+
+    int EventLoop::next_timeout_ms() const
+    {
+        if (timers_.empty())
+            return -1;
+        auto wait = timers_.begin()->first.first - std::chrono::steady_clock::now();
+        if (wait <= std::chrono::steady_clock::duration::zero())
+            return 0;
+        // Round up so we never wake just before the deadline and spin
+        return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(wait).count());
+    }
+
+    void EventLoop::run_due_timers()
+    {
+        auto now = std::chrono::steady_clock::now();
+        while (!timers_.empty() && timers_.begin()->first.first <= now)
+        {
+            auto it = timers_.begin();
+            std::function<void()> task = std::move(it->second);
+            timer_deadlines_.erase(it->first.second);
+            timers_.erase(it);
+            task(); // may add or cancel other timers
+        }
+    }
+
+    void EventLoop::run()
+    {
+        running_ = true;
+        epoll_event events[256];
+        while (running_)
+        {
+            int n = epoll_wait(epoll_fd_, events, 256, next_timeout_ms());
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("epoll_wait failed: " + std::string(strerror(errno)));
+            }
+            for (int i = 0; i < n; ++i)
+            {
+                int fd = events[i].data.fd;
+                if (fd == wake_fd_)
+                {
+                    drain_posted();
+                    continue;
+                }
+                auto it = handlers_.find(fd);
+                if (it == handlers_.end())
+                    continue; // removed by an earlier handler in this batch
+                // Hold a reference: the handler may remove (and destroy) itself.
+                std::shared_ptr<Handler> handler = it->second;
+                (*handler)(from_epoll(events[i].events));
+            }
+            run_due_timers();
+        }
+    }
+#else
+    EventLoop::EventLoop()
+    {
+        throw std::runtime_error("EventLoop requires epoll (Linux only)");
+    }
+    EventLoop::~EventLoop() {}
+    void EventLoop::add(int, uint32_t, Handler) {}
+    void EventLoop::modify(int, uint32_t) {}
+    void EventLoop::remove(int) {}
+    void EventLoop::post(std::function<void()>) {}
+    EventLoop::TimerId EventLoop::run_after(std::chrono::milliseconds, std::function<void()>) { return 0; }
+    void EventLoop::cancel_timer(TimerId) {}
+    void EventLoop::run() {}
+    void EventLoop::stop() {}
+    void EventLoop::drain_posted() {}
+    void EventLoop::run_due_timers() {}
+    int EventLoop::next_timeout_ms() const { return -1; }
+#endif
+}
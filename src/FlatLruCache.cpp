@@ -0,0 +1,143 @@
+#include "../include/proxy/FlatLruCache.hpp"
+#include "../include/proxy/CachedResponse.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace Cache
+{
+    template <typename Key, typename Value>
+    FlatLruCache<Key, Value>::FlatLruCache(size_t capacity, Weigher weigher, double max_entry_fraction)
+        : WeightBudget<Key, Value>("FlatLruCache", capacity, std::move(weigher), max_entry_fraction)
+    {
+    }
+
+    template <typename Key, typename Value>
+    uint32_t FlatLruCache<Key, Value>::find(KeyView<Key> key, uint32_t hash) const
+    {
+        return index_.find(hash, [&](uint32_t slot) { return slots_[slot].key == key; });
+    }
+
+    template <typename Key, typename Value>
+    void FlatLruCache<Key, Value>::erase(uint32_t bucket)
+    {
+        const uint32_t slot = index_.slot(bucket);
+        index_.erase(bucket);
+        recency_.remove(slots_, slot);
+        Slot &s = slots_[slot];
+        weight_ -= s.weight;
+        s.key = Key{};
+        s.value = Value{}; // release what the value holds now, not when the slot is reused
+        s.next = free_;
+        free_ = slot;
+    }
+
+    template <typename Key, typename Value>
+    bool FlatLruCache<Key, Value>::put(const Key &key, const Value &value)
+    {
+        const size_t entry_weight = this->weigh(key, value);
+        const uint32_t hash = SlotIndex::hash_of<KeyView<Key>>(key);
+        uint32_t bucket = find(key, hash);
+        if (this->too_heavy(entry_weight))
+        {
+            if (bucket != kNone)
+                erase(bucket);
+            return false;
+        }
+
+        uint32_t slot;
+        if (bucket != kNone)
+        {
+            slot = index_.slot(bucket);
+            weight_ = weight_ - slots_[slot].weight + entry_weight;
+            slots_[slot].value = value;
+            slots_[slot].weight = entry_weight;
+            recency_.remove(slots_, slot);
+        }
+        else
+        {
+            if (free_ != kNone)
+            {
+                slot = free_;
+                free_ = slots_[slot].next;
+            }
+            else
+            {
+                if (slots_.size() == kNone)
+                    throw std::length_error("FlatLruCache is full");
+                slot = static_cast<uint32_t>(slots_.size());
+                slots_.emplace_back();
+            }
+            slots_[slot].key = key;
+            slots_[slot].value = value;
+            slots_[slot].weight = entry_weight;
+            index_.insert(hash, slot);
+            weight_ += entry_weight;
+        }
+        recency_.push_front(slots_, slot);
+
+        // Evict from the LRU end until everything fits
+        while (weight_ > this->capacity())
+            erase(index_.find_slot(SlotIndex::hash_of<KeyView<Key>>(slots_[recency_.tail].key), recency_.tail));
+        this->note_weight(weight_);
+        return true;
+    }
+
+    template <typename Key, typename Value>
+    std::optional<Value> FlatLruCache<Key, Value>::get(KeyView<Key> key, size_t *weight)
+    {
+        const uint32_t bucket = find(key, SlotIndex::hash_of(key));
+        if (bucket == kNone)
+            return std::nullopt;
+        const uint32_t slot = index_.slot(bucket);
+        if (slot != recency_.head)
+        {
+            recency_.remove(slots_, slot);
+            recency_.push_front(slots_, slot);
+        }
+        if (weight)
+            *weight = slots_[slot].weight;
+        return slots_[slot].value;
+    }
+
+    template <typename Key, typename Value>
+    bool FlatLruCache<Key, Value>::contains(KeyView<Key> key) const
+    {
+        return find(key, SlotIndex::hash_of(key)) != kNone;
+    }
+
+    template <typename Key, typename Value>
+    size_t FlatLruCache<Key, Value>::size() const
+    {
+        return index_.size();
+    }
+
+    template <typename Key, typename Value>
+    size_t FlatLruCache<Key, Value>::weight() const
+    {
+        return weight_;
+    }
+
+    template <typename Key, typename Value>
+    std::vector<std::pair<Key, Value>> FlatLruCache<Key, Value>::entries() const
+    {
+        std::vector<std::pair<Key, Value>> out;
+        out.reserve(index_.size());
+        for (uint32_t slot = recency_.head; slot != kNone; slot = slots_[slot].next)
+            out.emplace_back(slots_[slot].key, slots_[slot].value);
+        return out;
+    }
+
+    template <typename Key, typename Value>
+    void FlatLruCache<Key, Value>::clear()
+    {
+        slots_.clear();
+        index_.clear();
+        free_ = kNone;
+        recency_ = SlotList{};
+        weight_ = 0;
+    }
+}
+
+template class Cache::FlatLruCache<std::string, std::string>;
+template class Cache::FlatLruCache<int, int>;
+template class Cache::FlatLruCache<std::string, proxy::CachedResponsePtr>;
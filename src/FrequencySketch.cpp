@@ -0,0 +1,111 @@
+#include "../include/proxy/FrequencySketch.hpp"
+#include <algorithm>
+
+namespace Cache
+{
+    namespace
+    {
+        constexpr uint64_t kRowSeeds[] = {0xc3a5c85c97cb3127ull, 0xb492b66fbe98f273ull, 0x9ae16a3b2f90404full,
+                                          0xcbf29ce484222325ull};
+
+        // Hashes like std::hash<int> are the identity: spread every bit before slicing (fmix64)
+        uint64_t spread(uint64_t h)
+        {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return h;
+        }
+    }
+
+    FrequencySketch::FrequencySketch(size_t expected_entries)
+    {
+        ensure_capacity(expected_entries);
+    }
+
+    void FrequencySketch::ensure_capacity(size_t expected_entries)
+    {
+        size_t width = 64;
+        while (width < expected_entries)
+            width <<= 1;
+        if (width <= width_)
+            return;
+        width_ = width;
+        table_.assign(kRows * width_ / 16, 0);
+        doorkeeper_.assign(width_ * 8 / 64, 0);
+        sample_size_ = 10 * width_;
+        additions_ = 0;
+    }
+
+    size_t FrequencySketch::counter_index(uint64_t hash, unsigned row) const
+    {
+        uint64_t h = (hash ^ kRowSeeds[row]) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+        return row * width_ + static_cast<size_t>(h & (width_ - 1));
+    }
+
+    unsigned FrequencySketch::counter(size_t index) const
+    {
+        return static_cast<unsigned>((table_[index >> 4] >> ((index & 15) << 2)) & 0xF);
+    }
+
+    bool FrequencySketch::doorkeeper_contains(uint64_t hash) const
+    {
+        const size_t bits = doorkeeper_.size() * 64;
+        size_t a = static_cast<size_t>(hash & (bits - 1));
+        size_t b = static_cast<size_t>((hash >> 32) & (bits - 1));
+        return (doorkeeper_[a >> 6] >> (a & 63) & 1) && (doorkeeper_[b >> 6] >> (b & 63) & 1);
+    }
+
+    void FrequencySketch::record(uint64_t hash)
+    {
+        hash = spread(hash);
+        if (!doorkeeper_contains(hash))
+        {
+            const size_t bits = doorkeeper_.size() * 64;
+            size_t a = static_cast<size_t>(hash & (bits - 1));
+            size_t b = static_cast<size_t>((hash >> 32) & (bits - 1));
+            doorkeeper_[a >> 6] |= uint64_t{1} << (a & 63);
+            doorkeeper_[b >> 6] |= uint64_t{1} << (b & 63);
+        }
+        else
+        {
+            for (unsigned row = 0; row < kRows; ++row)
+            {
+                size_t i = counter_index(hash, row);
+                if (counter(i) < kMaxCount)
+                    table_[i >> 4] += uint64_t{1} << ((i & 15) << 2);
+            }
+        }
+        if (++additions_ >= sample_size_)
+            age();
+    }
+
+    unsigned FrequencySketch::frequency(uint64_t hash) const
+    {
+        hash = spread(hash);
+        unsigned count = kMaxCount;
+        for (unsigned row = 0; row < kRows; ++row)
+            count = std::min(count, counter(counter_index(hash, row)));
+        return count + (doorkeeper_contains(hash) ? 1 : 0);
+    }
+
+    void FrequencySketch::age()
+    {
+        // Halve every counter at once: shift the word, then drop the bit each nibble got from its neighbour
+        for (uint64_t &word : table_)
+            word = (word >> 1) & 0x7777777777777777ull;
+        std::fill(doorkeeper_.begin(), doorkeeper_.end(), 0);
+        additions_ /= 2;
+    }
+
+    void FrequencySketch::clear()
+    {
+        std::fill(table_.begin(), table_.end(), 0);
+        std::fill(doorkeeper_.begin(), doorkeeper_.end(), 0);
+        additions_ = 0;
+    }
+
+} // namespace Cache
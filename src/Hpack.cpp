@@ -0,0 +1,402 @@
+#include "../include/proxy/Hpack.hpp"
+#include <array>
+
+namespace
+{
+    using proxy::HeaderField;
+    using proxy::HpackError;
+
+    // RFC 7541 Appendix A
+    const HeaderField kStaticTable[] = {
+        {":authority", ""},
+        {":method", "GET"},
+        {":method", "POST"},
+        {":path", "/"},
+        {":path", "/index.html"},
+        {":scheme", "http"},
+        {":scheme", "https"},
+        {":status", "200"},
+        {":status", "204"},
+        {":status", "206"},
+        {":status", "304"},
+        {":status", "400"},
+        {":status", "404"},
+        {":status", "500"},
+        {"accept-charset", ""},
+        {"accept-encoding", "gzip, deflate"},
+        {"accept-language", ""},
+        {"accept-ranges", ""},
+        {"accept", ""},
+        {"access-control-allow-origin", ""},
+        {"age", ""},
+        {"allow", ""},
+        {"authorization", ""},
+        {"cache-control", ""},
+        {"content-disposition", ""},
+        {"content-encoding", ""},
+        {"content-language", ""},
+        {"content-length", ""},
+        {"content-location", ""},
+        {"content-range", ""},
+        {"content-type", ""},
+        {"cookie", ""},
+        {"date", ""},
+        {"etag", ""},
+        {"expect", ""},
+        {"expires", ""},
+        {"from", ""},
+        {"host", ""},
+        {"if-match", ""},
+        {"if-modified-since", ""},
+        {"if-none-match", ""},
+        {"if-range", ""},
+        {"if-unmodified-since", ""},
+        {"last-modified", ""},
+        {"link", ""},
+        {"location", ""},
+        {"max-forwards", ""},
+        {"proxy-authenticate", ""},
+        {"proxy-authorization", ""},
+        {"range", ""},
+        {"referer", ""},
+        {"refresh", ""},
+        {"retry-after", ""},
+        {"server", ""},
+        {"set-cookie", ""},
+        {"strict-transport-security", ""},
+        {"transfer-encoding", ""},
+        {"user-agent", ""},
+        {"vary", ""},
+        {"via", ""},
+        {"www-authenticate", ""},
+    };
+    constexpr size_t kStaticTableSize = sizeof(kStaticTable) / sizeof(kStaticTable[0]);
+    constexpr size_t kEntryOverhead = 32; // RFC 7541 4.1
+
+    // RFC 7541 Appendix B: code (right-aligned) and bit length of symbols 0..255.
+    // EOS (256) is 30 one bits and must never appear in a decoded string.
+    struct HuffmanCode
+    {
+        uint32_t code;
+        uint8_t bits;
+    };
+    const HuffmanCode kHuffmanCodes[256] = {
+        {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+        {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+        {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+        {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+        {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+        {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+        {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+        {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+        {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+        {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11},
+        {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+        {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+        {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6},
+        {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6},
+        {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+        {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+        {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7},
+        {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+        {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7},
+        {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7},
+        {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+        {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7},
+        {0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13},
+        {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+        {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5},
+        {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6},
+        {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+        {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5},
+        {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5},
+        {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+        {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15},
+        {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+        {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+        {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23},
+        {0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23},
+        {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+        {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23},
+        {0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23},
+        {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+        {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24},
+        {0x3fffda, 22}, {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22},
+        {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+        {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24},
+        {0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23},
+        {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+        {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23},
+        {0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22},
+        {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+        {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19},
+        {0x3fffe7, 22}, {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25},
+        {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+        {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25},
+        {0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27},
+        {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+        {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26},
+        {0xffffffd, 28}, {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27},
+        {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+        {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23},
+        {0x3fffea, 22}, {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25},
+        {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+        {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26},
+        {0x7ffffe7, 27}, {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27},
+        {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+        {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26},
+    };
+    constexpr uint32_t kHuffmanEos = 0x3fffffff;
+    constexpr uint8_t kHuffmanEosBits = 30;
+
+    // Binary decoding tree, built once: children[node][bit], leaves hold symbol + 1.
+    struct HuffmanTree
+    {
+        std::vector<std::array<int32_t, 2>> children;
+        std::vector<int32_t> symbol; // -1 for inner nodes, 256 for EOS
+
+        HuffmanTree() : children(1, {0, 0}), symbol(1, -1)
+        {
+            for (int s = 0; s < 256; ++s)
+                add(kHuffmanCodes[s].code, kHuffmanCodes[s].bits, s);
+            add(kHuffmanEos, kHuffmanEosBits, 256);
+        }
+
+        void add(uint32_t code, uint8_t bits, int32_t sym)
+        {
+            int32_t node = 0;
+            for (int i = bits - 1; i >= 0; --i)
+            {
+                int bit = (code >> i) & 1;
+                if (children[node][bit] == 0)
+                {
+                    children[node][bit] = static_cast<int32_t>(children.size());
+                    children.push_back({0, 0});
+                    symbol.push_back(-1);
+                }
+                node = children[node][bit];
+            }
+            symbol[node] = sym;
+        }
+    };
+
+    const HuffmanTree &huffman_tree()
+    {
+        static const HuffmanTree tree;
+        return tree;
+    }
+
+    // RFC 7541 5.1: integer with an N-bit prefix
+    uint64_t decode_integer(const uint8_t *&p, const uint8_t *end, int prefix_bits)
+    {
+        if (p == end)
+            throw HpackError("HPACK: truncated integer");
+        uint64_t max_prefix = (1u << prefix_bits) - 1;
+        uint64_t value = *p++ & max_prefix;
+        if (value < max_prefix)
+            return value;
+        for (int shift = 0;; shift += 7)
+        {
+            if (p == end)
+                throw HpackError("HPACK: truncated integer");
+            if (shift > 28)
+                throw HpackError("HPACK: integer too large");
+            uint8_t b = *p++;
+            value += static_cast<uint64_t>(b & 0x7f) << shift;
+            if ((b & 0x80) == 0)
+                return value;
+        }
+    }
+
+    void encode_integer(std::string &out, uint8_t first_byte_flags, int prefix_bits, uint64_t value)
+    {
+        uint64_t max_prefix = (1u << prefix_bits) - 1;
+        if (value < max_prefix)
+        {
+            out.push_back(static_cast<char>(first_byte_flags | value));
+            return;
+        }
+        out.push_back(static_cast<char>(first_byte_flags | max_prefix));
+        value -= max_prefix;
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    std::string decode_string(const uint8_t *&p, const uint8_t *end)
+    {
+        if (p == end)
+            throw HpackError("HPACK: truncated string");
+        bool huffman = (*p & 0x80) != 0;
+        uint64_t len = decode_integer(p, end, 7);
+        if (len > static_cast<uint64_t>(end - p))
+            throw HpackError("HPACK: string runs past the header block");
+        std::string value = huffman ? proxy::HpackDecoder::huffman_decode(p, len)
+                                    : std::string(reinterpret_cast<const char *>(p), len);
+        p += len;
+        return value;
+    }
+
+    void encode_string(std::string &out, const std::string &s)
+    {
+        encode_integer(out, 0x00, 7, s.size()); // raw literal, no Huffman
+        out += s;
+    }
+}
+
+namespace proxy
+{
+    HpackDecoder::HpackDecoder(size_t max_table_size, size_t max_header_list_size)
+        : table_limit_(max_table_size), max_table_size_(max_table_size), max_header_list_size_(max_header_list_size) {}
+
+    std::string HpackDecoder::huffman_decode(const uint8_t *data, size_t len)
+    {
+        const HuffmanTree &tree = huffman_tree();
+        std::string out;
+        out.reserve(len * 8 / 5);
+        int32_t node = 0;
+        int depth = 0;      // bits consumed since the last symbol
+        bool all_ones = true; // ... and whether they were all 1 (valid padding)
+        for (size_t i = 0; i < len; ++i)
+        {
+            for (int b = 7; b >= 0; --b)
+            {
+                int bit = (data[i] >> b) & 1;
+                node = tree.children[node][bit];
+                ++depth;
+                all_ones = all_ones && bit == 1;
+                if (node == 0)
+                    throw HpackError("HPACK: invalid Huffman code");
+                int32_t sym = tree.symbol[node];
+                if (sym < 0)
+                    continue;
+                if (sym == 256)
+                    throw HpackError("HPACK: EOS in Huffman string");
+                out.push_back(static_cast<char>(sym));
+                node = 0;
+                depth = 0;
+                all_ones = true;
+            }
+        }
+        // Padding: a strict prefix of EOS, shorter than a byte
+        if (depth > 7 || !all_ones)
+            throw HpackError("HPACK: invalid Huffman padding");
+        return out;
+    }
+
+    const HeaderField &HpackDecoder::lookup(uint64_t index) const
+    {
+        if (index == 0)
+            throw HpackError("HPACK: index 0");
+        if (index <= kStaticTableSize)
+            return kStaticTable[index - 1];
+        index -= kStaticTableSize + 1;
+        if (index >= dynamic_.size())
+            throw HpackError("HPACK: index out of range");
+        return dynamic_[index];
+    }
+
+    void HpackDecoder::evict_to(size_t limit)
+    {
+        while (table_bytes_ > limit && !dynamic_.empty())
+        {
+            table_bytes_ -= dynamic_.back().name.size() + dynamic_.back().value.size() + kEntryOverhead;
+            dynamic_.pop_back();
+        }
+    }
+
+    void HpackDecoder::insert(HeaderField field)
+    {
+        size_t entry_size = field.name.size() + field.value.size() + kEntryOverhead;
+        if (entry_size > table_limit_)
+        {
+            // Not an error: the table just ends up empty (RFC 7541 4.4)
+            evict_to(0);
+            return;
+        }
+        evict_to(table_limit_ - entry_size);
+        table_bytes_ += entry_size;
+        dynamic_.push_front(std::move(field));
+    }
+
+    HeaderList HpackDecoder::decode(const uint8_t *data, size_t len)
+    {
+        HeaderList headers;
+        size_t list_size = 0;
+        bool fields_seen = false;
+        const uint8_t *p = data;
+        const uint8_t *end = data + len;
+        while (p < end)
+        {
+            uint8_t b = *p;
+            HeaderField field;
+            if (b & 0x80)
+            {
+                // Indexed header field
+                field = lookup(decode_integer(p, end, 7));
+            }
+            else if ((b & 0xe0) == 0x20)
+            {
+                // Dynamic table size update: only at the start of a block
+                if (fields_seen)
+                    throw HpackError("HPACK: table size update after a header field");
+                uint64_t size = decode_integer(p, end, 5);
+                if (size > max_table_size_)
+                    throw HpackError("HPACK: table size update above the advertised limit");
+                table_limit_ = static_cast<size_t>(size);
+                evict_to(table_limit_);
+                continue;
+            }
+            else
+            {
+                // Literal: with incremental indexing (01), without indexing (0000) or never indexed (0001)
+                bool indexing = (b & 0xc0) == 0x40;
+                uint64_t name_index = decode_integer(p, end, indexing ? 6 : 4);
+                field.name = name_index ? lookup(name_index).name : decode_string(p, end);
+                field.value = decode_string(p, end);
+                if (indexing)
+                    insert(field);
+            }
+            fields_seen = true;
+            list_size += field.name.size() + field.value.size() + kEntryOverhead;
+            if (list_size > max_header_list_size_)
+                throw HpackError("HPACK: header list too large");
+            headers.push_back(std::move(field));
+        }
+        return headers;
+    }
+
+    std::string HpackEncoder::encode(const HeaderList &headers)
+    {
+        std::string out;
+        for (const auto &field : headers)
+        {
+            size_t name_index = 0;
+            size_t exact_index = 0;
+            for (size_t i = 0; i < kStaticTableSize && !exact_index; ++i)
+            {
+                if (kStaticTable[i].name != field.name)
+                    continue;
+                if (!name_index)
+                    name_index = i + 1;
+                if (kStaticTable[i].value == field.value)
+                    exact_index = i + 1;
+            }
+            if (exact_index)
+            {
+                encode_integer(out, 0x80, 7, exact_index);
+                continue;
+            }
+            // Literal header field without indexing
+            encode_integer(out, 0x00, 4, name_index);
+            if (!name_index)
+                encode_string(out, field.name);
+            encode_string(out, field.value);
+        }
+        return out;
+    }
+
+} // namespace proxy
@@ -0,0 +1,810 @@
+#include "../include/proxy/Http2Session.hpp"
+#include "../include/proxy/HttpResponseParser.hpp"
+#include "../include/proxy/SocketUtils.hpp"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // RFC 7540 6 / 7 / 6.5.2
+    enum FrameType : uint8_t
+    {
+        kData = 0x0,
+        kHeaders = 0x1,
+        kPriority = 0x2,
+        kRstStream = 0x3,
+        kSettings = 0x4,
+        kPushPromise = 0x5,
+        kPing = 0x6,
+        kGoAway = 0x7,
+        kWindowUpdate = 0x8,
+        kContinuation = 0x9
+    };
+    constexpr uint8_t kFlagEndStream = 0x1;
+    constexpr uint8_t kFlagAck = 0x1;
+    constexpr uint8_t kFlagEndHeaders = 0x4;
+    constexpr uint8_t kFlagPadded = 0x8;
+    constexpr uint8_t kFlagPriority = 0x20;
+
+    enum ErrorCode : uint32_t
+    {
+        kNoError = 0x0,
+        kProtocolError = 0x1,
+        kInternalError = 0x2,
+        kFlowControlError = 0x3,
+        kFrameSizeError = 0x6,
+        kRefusedStream = 0x7,
+        kCompressionError = 0x9
+    };
+
+    enum SettingId : uint16_t
+    {
+        kSettingHeaderTableSize = 0x1,
+        kSettingEnablePush = 0x2,
+        kSettingMaxConcurrentStreams = 0x3,
+        kSettingInitialWindowSize = 0x4,
+        kSettingMaxFrameSize = 0x5
+    };
+
+    constexpr size_t kFrameHeaderSize = 9;
+    constexpr size_t kMaxFrameSize = 16384;       // what we accept: the protocol default
+    constexpr size_t kMaxHeaderBlock = 256 * 1024; // HEADERS + CONTINUATION, before decoding
+    constexpr int64_t kMaxWindow = 0x7fffffff;
+
+    uint32_t read_u32(const uint8_t *p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    void put_u32(std::string &out, uint32_t v)
+    {
+        out.push_back(static_cast<char>(v >> 24));
+        out.push_back(static_cast<char>(v >> 16));
+        out.push_back(static_cast<char>(v >> 8));
+        out.push_back(static_cast<char>(v));
+    }
+
+    std::string frame_header(size_t length, uint8_t type, uint8_t flags, uint32_t stream_id)
+    {
+        std::string h;
+        h.push_back(static_cast<char>(length >> 16));
+        h.push_back(static_cast<char>(length >> 8));
+        h.push_back(static_cast<char>(length));
+        h.push_back(static_cast<char>(type));
+        h.push_back(static_cast<char>(flags));
+        put_u32(h, stream_id & 0x7fffffff);
+        return h;
+    }
+
+    std::string setting(uint16_t id, uint32_t value)
+    {
+        std::string s;
+        s.push_back(static_cast<char>(id >> 8));
+        s.push_back(static_cast<char>(id));
+        put_u32(s, value);
+        return s;
+    }
+
+    std::string goaway(uint32_t last_stream_id, uint32_t code)
+    {
+        std::string p;
+        put_u32(p, last_stream_id);
+        put_u32(p, code);
+        return p;
+    }
+
+    // HTTP2-Settings is base64url without padding (RFC 7540 3.2.1)
+    std::string base64url_decode(const std::string &in)
+    {
+        std::string out;
+        uint32_t acc = 0;
+        int bits = 0;
+        for (char c : in)
+        {
+            int v;
+            if (c >= 'A' && c <= 'Z')
+                v = c - 'A';
+            else if (c >= 'a' && c <= 'z')
+                v = c - 'a' + 26;
+            else if (c >= '0' && c <= '9')
+                v = c - '0' + 52;
+            else if (c == '-' || c == '+')
+                v = 62;
+            else if (c == '_' || c == '/')
+                v = 63;
+            else
+                continue; // padding / whitespace
+            acc = (acc << 6) | static_cast<uint32_t>(v);
+            bits += 6;
+            if (bits >= 8)
+            {
+                bits -= 8;
+                out.push_back(static_cast<char>((acc >> bits) & 0xff));
+            }
+        }
+        return out;
+    }
+
+    // "if-none-match" -> "If-None-Match": requests reach the HTTP/1.1 code path looking like
+    // they came from an HTTP/1.1 client
+    std::string title_case(const std::string &name)
+    {
+        std::string out = name;
+        bool upper = true;
+        for (char &c : out)
+        {
+            if (upper)
+                c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+            upper = c == '-';
+        }
+        return out;
+    }
+
+    std::string to_lower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return s;
+    }
+
+    // Connection-specific headers have no meaning in HTTP/2 (RFC 7540 8.1.2.2)
+    bool is_connection_header(const std::string &lower_name)
+    {
+        return lower_name == "connection" || lower_name == "keep-alive" || lower_name == "proxy-connection" ||
+               lower_name == "transfer-encoding" || lower_name == "upgrade" || lower_name == "te" ||
+               lower_name == "http2-settings";
+    }
+
+    // HTTP/1.1 header fields as HTTP/2 fields: lower-case names, connection headers dropped
+    void append_fields(proxy::HeaderList &out, size_t count, const std::function<proxy::HttpResponseParser::Header(size_t)> &field)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            proxy::HttpResponseParser::Header h = field(i);
+            std::string name = to_lower(std::string(h.name));
+            if (!is_connection_header(name))
+                out.push_back({std::move(name), std::string(h.value)});
+        }
+    }
+
+    // An HTTP/1.1 response head as HTTP/2 response headers
+    proxy::HeaderList response_headers(const proxy::HttpResponseParser &parser)
+    {
+        proxy::HeaderList headers{{":status", std::to_string(parser.status_code())}};
+        append_fields(headers, parser.header_count(), [&](size_t i)
+                      { return parser.header(i); });
+        return headers;
+    }
+
+    // Trailers of a chunked HTTP/1.1 body, sent as a final HEADERS frame
+    proxy::HeaderList response_trailers(const proxy::HttpResponseParser &parser)
+    {
+        proxy::HeaderList trailers;
+        append_fields(trailers, parser.trailer_count(), [&](size_t i)
+                      { return parser.trailer(i); });
+        return trailers;
+    }
+}
+
+namespace proxy
+{
+    struct Http2Session::Stream
+    {
+        uint32_t id = 0;
+        int64_t send_window = 0; // peer's flow-control credit for this stream
+        bool reset = false;      // RST_STREAM received, or the connection is gone
+        bool done = false;       // handler finished: the thread can be joined
+        std::thread worker;
+    };
+
+    /**
+     * Receives the handler's HTTP/1.1 response bytes for one stream and re-frames them as
+     * the parser reports them: head -> HEADERS, payload -> DATA, trailers -> a last HEADERS.
+     * END_STREAM goes on the last frame. Payload from one write() is sent as one DATA run.
+     */
+    class Http2Session::StreamSink : public ResponseSink, private HttpResponseParser::Listener
+    {
+    public:
+        StreamSink(Http2Session &session, Stream &stream, bool head_request)
+            : session_(session), stream_(stream), parser_(head_request) {}
+
+        void write(std::string_view data) override
+        {
+            if (end_sent_)
+                return; // nothing after the end of the response goes out
+            parser_.feed(data.data(), data.size(), *this);
+            flush();
+        }
+
+        // The handler returned: end a body that was delimited by "connection close"
+        void finish()
+        {
+            if (end_sent_)
+                return;
+            if (!parser_.head_complete())
+                throw std::runtime_error("no response produced");
+            parser_.on_eof(this);
+            flush();
+        }
+
+        bool headers_sent() const { return headers_sent_; }
+
+    private:
+        void on_head(const HttpResponseParser &parser) override
+        {
+            headers_sent_ = true;
+            end_sent_ = parser.complete(); // bodiless: END_STREAM goes with the headers
+            session_.send_headers(stream_, response_headers(parser), end_sent_);
+        }
+
+        void on_body(std::string_view payload) override { batch_.append(payload); }
+
+        void on_complete(const HttpResponseParser &parser) override
+        {
+            ended_ = true;
+            trailers_ = response_trailers(parser);
+        }
+
+        void flush()
+        {
+            if (!end_sent_)
+            {
+                if (ended_ && trailers_.empty())
+                {
+                    session_.send_data(stream_, batch_, true);
+                    end_sent_ = true;
+                }
+                else if (!batch_.empty())
+                {
+                    session_.send_data(stream_, batch_, false);
+                }
+                if (ended_ && !end_sent_)
+                {
+                    session_.send_headers(stream_, trailers_, true);
+                    end_sent_ = true;
+                }
+            }
+            batch_.clear();
+        }
+
+        Http2Session &session_;
+        Stream &stream_;
+        HttpResponseParser parser_;
+        std::string batch_; // payload of the current write()
+        HeaderList trailers_;
+        bool headers_sent_ = false;
+        bool ended_ = false;    // the parser saw the end of the response
+        bool end_sent_ = false; // END_STREAM went out
+    };
+
+    Http2Session::Http2Session(int fd, Handler handler, Options options)
+        : fd_(fd), handler_(std::move(handler)), options_(options) {}
+
+    Http2Session::~Http2Session()
+    {
+        shut_down();
+    }
+
+    void Http2Session::run(std::string received, const HttpRequest *upgraded, const std::string &upgrade_settings)
+    {
+        in_ = std::move(received);
+        try
+        {
+            write_frame(kSettings, 0, 0, setting(kSettingMaxConcurrentStreams, options_.max_concurrent_streams) + setting(kSettingEnablePush, 0));
+            if (upgraded)
+            {
+                // The upgrade request's settings count as the client's first SETTINGS (no ACK is sent)
+                std::string settings = base64url_decode(upgrade_settings);
+                apply_settings(reinterpret_cast<const uint8_t *>(settings.data()), settings.size());
+                last_stream_id_ = 1;
+                open_stream(1, *upgraded);
+            }
+
+            bool preface_seen = false;
+            char buf[16 * 1024];
+            while (true)
+            {
+                if (!preface_seen)
+                    preface_seen = consume_preface();
+                if (preface_seen)
+                {
+                    size_t pos = 0;
+                    while (in_.size() - pos >= kFrameHeaderSize)
+                    {
+                        const uint8_t *h = reinterpret_cast<const uint8_t *>(in_.data() + pos);
+                        size_t len = (size_t(h[0]) << 16) | (size_t(h[1]) << 8) | size_t(h[2]);
+                        if (len > kMaxFrameSize)
+                            throw ConnectionError(kFrameSizeError, "frame larger than SETTINGS_MAX_FRAME_SIZE");
+                        if (in_.size() - pos < kFrameHeaderSize + len)
+                            break;
+                        handle_frame(h[3], h[4], read_u32(h + 5) & 0x7fffffff, h + kFrameHeaderSize, len);
+                        pos += kFrameHeaderSize + len;
+                    }
+                    in_.erase(0, pos);
+                }
+                reap_finished_streams();
+
+                pollfd pfd{fd_, POLLIN, 0};
+                int ready = poll(&pfd, 1, static_cast<int>(std::chrono::milliseconds(options_.idle_timeout).count()));
+                if (ready < 0 && errno == EINTR)
+                    continue;
+                if (ready == 0)
+                {
+                    if (open_streams() > 0)
+                        continue; // responses still being produced
+                    write_frame(kGoAway, 0, 0, goaway(last_stream_id_, kNoError));
+                    break;
+                }
+                if (ready < 0)
+                    break;
+                ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    break; // client closed (or reset) the connection
+                in_.append(buf, static_cast<size_t>(n));
+            }
+        }
+        catch (const ConnectionError &ex)
+        {
+            std::cerr << "[Http2] Connection error: " << ex.what() << std::endl;
+            try
+            {
+                write_frame(kGoAway, 0, 0, goaway(last_stream_id_, ex.code));
+            }
+            catch (const std::exception &)
+            {
+            }
+        }
+        catch (const std::exception &ex)
+        {
+            std::cerr << "[Http2] " << ex.what() << std::endl;
+        }
+        shut_down();
+    }
+
+    bool Http2Session::consume_preface()
+    {
+        size_t n = std::min(in_.size(), kPreface.size());
+        if (in_.compare(0, n, kPreface.substr(0, n)) != 0)
+            throw ConnectionError(kProtocolError, "invalid connection preface");
+        if (n < kPreface.size())
+            return false;
+        in_.erase(0, kPreface.size());
+        return true;
+    }
+
+    void Http2Session::handle_frame(uint8_t type, uint8_t flags, uint32_t stream_id, const uint8_t *payload, size_t len)
+    {
+        if (continuation_stream_ && (type != kContinuation || stream_id != continuation_stream_))
+            throw ConnectionError(kProtocolError, "header block interrupted");
+
+        switch (type)
+        {
+        case kData:
+        {
+            if (stream_id == 0)
+                throw ConnectionError(kProtocolError, "DATA on stream 0");
+            // Request bodies are dropped; hand the credit straight back
+            if (len > 0)
+            {
+                std::string inc;
+                put_u32(inc, static_cast<uint32_t>(len));
+                write_frame(kWindowUpdate, 0, 0, inc);
+                if (!(flags & kFlagEndStream))
+                    write_frame(kWindowUpdate, 0, stream_id, inc);
+            }
+            break;
+        }
+        case kHeaders:
+            on_headers(flags, stream_id, payload, len);
+            break;
+        case kContinuation:
+            if (!continuation_stream_)
+                throw ConnectionError(kProtocolError, "unexpected CONTINUATION");
+            header_block_.append(reinterpret_cast<const char *>(payload), len);
+            if (header_block_.size() > kMaxHeaderBlock)
+                throw ConnectionError(kProtocolError, "header block too large");
+            if (flags & kFlagEndHeaders)
+            {
+                continuation_stream_ = 0;
+                on_header_block(stream_id, header_block_end_stream_);
+            }
+            break;
+        case kPriority:
+            break; // responses are sent as they are produced
+        case kRstStream:
+        {
+            if (stream_id == 0 || len != 4)
+                throw ConnectionError(kProtocolError, "malformed RST_STREAM");
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = streams_.find(stream_id);
+            if (it != streams_.end())
+                it->second->reset = true;
+            window_cv_.notify_all();
+            break;
+        }
+        case kSettings:
+            if (stream_id != 0)
+                throw ConnectionError(kProtocolError, "SETTINGS on a stream");
+            if (flags & kFlagAck)
+            {
+                if (len != 0)
+                    throw ConnectionError(kFrameSizeError, "SETTINGS ACK with payload");
+                break;
+            }
+            apply_settings(payload, len);
+            write_frame(kSettings, kFlagAck, 0, "");
+            break;
+        case kPushPromise:
+            throw ConnectionError(kProtocolError, "PUSH_PROMISE from a client");
+        case kPing:
+            if (stream_id != 0 || len != 8)
+                throw ConnectionError(len != 8 ? kFrameSizeError : kProtocolError, "malformed PING");
+            if (!(flags & kFlagAck))
+                write_frame(kPing, kFlagAck, 0, std::string_view(reinterpret_cast<const char *>(payload), len));
+            break;
+        case kGoAway:
+            peer_going_away_ = true; // finish what is open, accept nothing new
+            break;
+        case kWindowUpdate:
+            on_window_update(stream_id, payload, len);
+            break;
+        default:
+            break; // unknown frame types are ignored (RFC 7540 4.1)
+        }
+    }
+
+    void Http2Session::on_headers(uint8_t flags, uint32_t stream_id, const uint8_t *payload, size_t len)
+    {
+        if (stream_id == 0 || stream_id % 2 == 0)
+            throw ConnectionError(kProtocolError, "HEADERS on an invalid stream id");
+        size_t pad = 0;
+        if (flags & kFlagPadded)
+        {
+            if (len < 1)
+                throw ConnectionError(kProtocolError, "malformed padding");
+            pad = payload[0];
+            ++payload;
+            --len;
+        }
+        if (flags & kFlagPriority)
+        {
+            if (len < 5)
+                throw ConnectionError(kProtocolError, "malformed priority");
+            payload += 5;
+            len -= 5;
+        }
+        if (pad > len)
+            throw ConnectionError(kProtocolError, "padding longer than the frame");
+        len -= pad;
+
+        header_block_.assign(reinterpret_cast<const char *>(payload), len);
+        header_block_end_stream_ = (flags & kFlagEndStream) != 0;
+        if (flags & kFlagEndHeaders)
+            on_header_block(stream_id, header_block_end_stream_);
+        else
+            continuation_stream_ = stream_id;
+    }
+
+    void Http2Session::on_header_block(uint32_t stream_id, bool end_stream)
+    {
+        HeaderList headers;
+        try
+        {
+            // Always decoded, even for refused streams: the HPACK table must stay in sync
+            headers = decoder_.decode(reinterpret_cast<const uint8_t *>(header_block_.data()), header_block_.size());
+        }
+        catch (const HpackError &ex)
+        {
+            throw ConnectionError(kCompressionError, ex.what());
+        }
+        header_block_.clear();
+
+        if (stream_id <= last_stream_id_)
+            return; // trailers of a request whose body we ignore anyway
+        last_stream_id_ = stream_id;
+        if (peer_going_away_ || open_streams() >= options_.max_concurrent_streams)
+        {
+            reset_stream(stream_id, kRefusedStream);
+            return;
+        }
+
+        // Rebuild an HTTP/1.1 request head so the request takes exactly the HTTP/1.1 path
+        std::string method, path, authority, fields;
+        for (const auto &field : headers)
+        {
+            if (field.name == ":method")
+                method = field.value;
+            else if (field.name == ":path")
+                path = field.value;
+            else if (field.name == ":authority")
+                authority = field.value;
+            else if (field.name.empty() || field.name[0] == ':')
+                continue; // :scheme, and unknown pseudo-headers
+            else if (field.name == "host")
+                authority = authority.empty() ? field.value : authority;
+            else if (!is_connection_header(field.name))
+                fields += title_case(field.name) + ": " + field.value + "\r\n";
+        }
+        if (method == "CONNECT" && path.empty())
+            path = authority;
+        if (method.empty() || path.empty() || authority.empty())
+        {
+            reset_stream(stream_id, kProtocolError);
+            return;
+        }
+        (void)end_stream; // with or without a body, the request is served now
+        HttpRequest req = HttpParser::parse(method + " " + path + " HTTP/1.1\r\nHost: " + authority + "\r\n" + fields + "\r\n");
+        open_stream(stream_id, std::move(req));
+    }
+
+    void Http2Session::on_window_update(uint32_t stream_id, const uint8_t *payload, size_t len)
+    {
+        if (len != 4)
+            throw ConnectionError(kFrameSizeError, "malformed WINDOW_UPDATE");
+        int64_t increment = read_u32(payload) & 0x7fffffff;
+        if (increment == 0)
+        {
+            if (stream_id == 0)
+                throw ConnectionError(kProtocolError, "zero WINDOW_UPDATE");
+            reset_stream(stream_id, kProtocolError);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stream_id == 0)
+        {
+            connection_window_ += increment;
+            if (connection_window_ > kMaxWindow)
+                throw ConnectionError(kFlowControlError, "connection window overflow");
+        }
+        else
+        {
+            auto it = streams_.find(stream_id);
+            if (it == streams_.end())
+                return; // closed stream
+            it->second->send_window += increment;
+            if (it->second->send_window > kMaxWindow)
+            {
+                it->second->reset = true;
+                window_cv_.notify_all();
+                throw ConnectionError(kFlowControlError, "stream window overflow");
+            }
+        }
+        window_cv_.notify_all();
+    }
+
+    void Http2Session::apply_settings(const uint8_t *payload, size_t len)
+    {
+        if (len % 6 != 0)
+            throw ConnectionError(kFrameSizeError, "malformed SETTINGS");
+        for (size_t i = 0; i < len; i += 6)
+        {
+            uint16_t id = static_cast<uint16_t>((payload[i] << 8) | payload[i + 1]);
+            uint32_t value = read_u32(payload + i + 2);
+            switch (id)
+            {
+            case kSettingEnablePush:
+                if (value > 1)
+                    throw ConnectionError(kProtocolError, "invalid SETTINGS_ENABLE_PUSH");
+                break;
+            case kSettingInitialWindowSize:
+            {
+                if (value > kMaxWindow)
+                    throw ConnectionError(kFlowControlError, "invalid SETTINGS_INITIAL_WINDOW_SIZE");
+                // Applies retroactively to every open stream (RFC 7540 6.9.2)
+                std::lock_guard<std::mutex> lock(mutex_);
+                int64_t delta = static_cast<int64_t>(value) - peer_initial_window_;
+                peer_initial_window_ = value;
+                for (auto &kv : streams_)
+                    kv.second->send_window += delta;
+                window_cv_.notify_all();
+                break;
+            }
+            case kSettingMaxFrameSize:
+            {
+                if (value < 16384 || value > 16777215)
+                    throw ConnectionError(kProtocolError, "invalid SETTINGS_MAX_FRAME_SIZE");
+                std::lock_guard<std::mutex> lock(mutex_);
+                peer_max_frame_size_ = value;
+                break;
+            }
+            case kSettingHeaderTableSize: // our encoder never uses the dynamic table
+            case kSettingMaxConcurrentStreams: // we never push
+            default:
+                break;
+            }
+        }
+    }
+
+    void Http2Session::open_stream(uint32_t stream_id, HttpRequest req)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto stream = std::make_unique<Stream>();
+        stream->id = stream_id;
+        stream->send_window = peer_initial_window_;
+        Stream &s = *stream;
+        streams_.emplace(stream_id, std::move(stream));
+        s.worker = std::thread([this, &s, req = std::move(req)]() mutable
+                               { serve_stream(s, std::move(req)); });
+    }
+
+    void Http2Session::serve_stream(Stream &stream, HttpRequest req)
+    {
+        StreamSink sink(*this, stream, req.method == "HEAD");
+        try
+        {
+            handler_(req, sink);
+            sink.finish();
+        }
+        catch (const std::exception &ex)
+        {
+            std::cerr << "[Http2] Stream " << stream.id << ": " << ex.what() << std::endl;
+            try
+            {
+                if (!sink.headers_sent())
+                    send_headers(stream, {{":status", "502"}, {"content-length", "0"}}, true);
+                else
+                    reset_stream(stream.id, kInternalError);
+            }
+            catch (const std::exception &)
+            {
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        stream.done = true;
+    }
+
+    void Http2Session::send_headers(Stream &stream, const HeaderList &headers, bool end_stream)
+    {
+        std::string block = HpackEncoder::encode(headers);
+        size_t max_frame;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stream.reset || closed_)
+                throw std::runtime_error("stream reset by the client");
+            max_frame = peer_max_frame_size_;
+        }
+        // HEADERS then CONTINUATIONs, back to back: nothing may come in between
+        std::string frames;
+        size_t pos = 0;
+        do
+        {
+            size_t n = std::min(block.size() - pos, max_frame);
+            bool last = pos + n == block.size();
+            uint8_t flags = (last ? kFlagEndHeaders : 0) | (pos == 0 && end_stream ? kFlagEndStream : 0);
+            frames += frame_header(n, pos == 0 ? kHeaders : kContinuation, flags, stream.id);
+            frames.append(block, pos, n);
+            pos += n;
+        } while (pos < block.size());
+        write_raw(frames);
+    }
+
+    void Http2Session::send_data(Stream &stream, std::string_view data, bool end_stream)
+    {
+        do
+        {
+            size_t n;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                bool ready = window_cv_.wait_for(lock, options_.write_stall_timeout, [&]
+                                                 { return stream.reset || closed_ || data.empty() ||
+                                                          (connection_window_ > 0 && stream.send_window > 0); });
+                if (stream.reset || closed_)
+                    throw std::runtime_error("stream reset by the client");
+                if (!ready)
+                    throw net::SendTimeout();
+                n = std::min<size_t>({data.size(), peer_max_frame_size_,
+                                      static_cast<size_t>(std::max<int64_t>(0, std::min(connection_window_, stream.send_window)))});
+                connection_window_ -= static_cast<int64_t>(n);
+                stream.send_window -= static_cast<int64_t>(n);
+            }
+            bool last = n == data.size();
+            write_frame(kData, last && end_stream ? kFlagEndStream : 0, stream.id, data.substr(0, n));
+            data.remove_prefix(n);
+        } while (!data.empty());
+    }
+
+    void Http2Session::reset_stream(uint32_t stream_id, uint32_t code)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = streams_.find(stream_id);
+            if (it != streams_.end())
+                it->second->reset = true;
+            window_cv_.notify_all();
+        }
+        std::string p;
+        put_u32(p, code);
+        write_frame(kRstStream, 0, stream_id, p);
+    }
+
+    void Http2Session::write_frame(uint8_t type, uint8_t flags, uint32_t stream_id, std::string_view payload)
+    {
+        std::string header = frame_header(payload.size(), type, flags, stream_id);
+        std::string_view parts[] = {header, payload};
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        try
+        {
+            net::write_all(fd_, parts, 2);
+        }
+        catch (const std::exception &)
+        {
+            // The connection is unusable: unblock the reader and every stream
+            shutdown(fd_, SHUT_RDWR);
+            throw;
+        }
+    }
+
+    void Http2Session::write_raw(std::string_view bytes)
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        try
+        {
+            net::write_all(fd_, bytes);
+        }
+        catch (const std::exception &)
+        {
+            shutdown(fd_, SHUT_RDWR);
+            throw;
+        }
+    }
+
+    size_t Http2Session::open_streams()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return static_cast<size_t>(std::count_if(streams_.begin(), streams_.end(), [](const auto &kv)
+                                                 { return !kv.second->done; }));
+    }
+
+    void Http2Session::reap_finished_streams()
+    {
+        std::vector<std::thread> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = streams_.begin(); it != streams_.end();)
+            {
+                if (it->second->done)
+                {
+                    finished.push_back(std::move(it->second->worker));
+                    it = streams_.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+        for (auto &t : finished)
+            t.join();
+    }
+
+    void Http2Session::shut_down()
+    {
+        std::vector<std::thread> workers;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            for (auto &kv : streams_)
+            {
+                kv.second->reset = true;
+                if (kv.second->worker.joinable())
+                    workers.push_back(std::move(kv.second->worker));
+            }
+            window_cv_.notify_all();
+        }
+        // Streams still waiting on an origin finish on their own; their writes then fail fast
+        for (auto &t : workers)
+            t.join();
+        std::lock_guard<std::mutex> lock(mutex_);
+        streams_.clear();
+    }
+
+} // namespace proxy
@@ -0,0 +1,129 @@
+#include "../include/proxy/HttpHeaders.hpp"
+#include <stdexcept>
+
+namespace proxy
+{
+    HttpHeaders::Field HttpHeaders::field(const Record &r) const
+    {
+        std::string_view name = r.id == HeaderId::Other ? std::string_view(arena_.data() + r.name_offset, r.name_length)
+                                                        : kHeaderNames[static_cast<size_t>(r.id)];
+        return {r.id, name, std::string_view(arena_.data() + r.value_offset, r.value_length)};
+    }
+
+    bool HttpHeaders::matches(const Record &r, HeaderId id, std::string_view name) const
+    {
+        if (r.id != id)
+            return false;
+        return id != HeaderId::Other ||
+               header_hash::iequals(std::string_view(arena_.data() + r.name_offset, r.name_length), name);
+    }
+
+    std::string_view HttpHeaders::get(HeaderId id) const
+    {
+        uint16_t at = index_[static_cast<size_t>(id)];
+        return id == HeaderId::Other || at == 0 ? std::string_view() : field(record(at - 1u)).value;
+    }
+
+    std::string_view HttpHeaders::get(std::string_view name) const
+    {
+        HeaderId id = header_id(name);
+        if (id != HeaderId::Other)
+            return get(id);
+        for (size_t i = 0; i < count_; ++i)
+            if (matches(record(i), id, name))
+                return field(record(i)).value;
+        return {};
+    }
+
+    bool HttpHeaders::contains(std::string_view name) const
+    {
+        HeaderId id = header_id(name);
+        if (id != HeaderId::Other)
+            return contains(id);
+        for (size_t i = 0; i < count_; ++i)
+            if (matches(record(i), id, name))
+                return true;
+        return false;
+    }
+
+    void HttpHeaders::push(const Record &r)
+    {
+        if (count_ == UINT16_MAX)
+            throw std::length_error("too many header fields");
+        if (count_ < kInlineFields)
+            inline_[count_] = r;
+        else
+            spill_.push_back(r);
+        ++count_;
+        if (r.id != HeaderId::Other && index_[static_cast<size_t>(r.id)] == 0)
+            index_[static_cast<size_t>(r.id)] = static_cast<uint16_t>(count_);
+    }
+
+    void HttpHeaders::add(std::string_view name, std::string_view value)
+    {
+        Record r{};
+        r.id = header_id(name);
+        if (r.id == HeaderId::Other)
+        {
+            r.name_offset = static_cast<uint32_t>(arena_.size());
+            r.name_length = static_cast<uint16_t>(name.size());
+            arena_.append(name);
+        }
+        r.value_offset = static_cast<uint32_t>(arena_.size());
+        r.value_length = static_cast<uint32_t>(value.size());
+        arena_.append(value);
+        push(r);
+    }
+
+    void HttpHeaders::set(std::string_view name, std::string_view value)
+    {
+        remove(name);
+        add(name, value);
+    }
+
+    size_t HttpHeaders::remove(std::string_view name)
+    {
+        HeaderId id = header_id(name);
+        if (id != HeaderId::Other && !contains(id))
+            return 0;
+        // Compact the records in place; arena bytes of removed fields are simply left behind
+        size_t kept = 0;
+        for (size_t i = 0; i < count_; ++i)
+        {
+            if (matches(record(i), id, name))
+                continue;
+            if (kept != i)
+                record(kept) = record(i);
+            ++kept;
+        }
+        size_t removed = count_ - kept;
+        count_ = static_cast<uint32_t>(kept);
+        if (count_ <= kInlineFields)
+            spill_.clear();
+        else
+            spill_.resize(count_ - kInlineFields);
+        if (removed != 0)
+            rebuild_index();
+        return removed;
+    }
+
+    void HttpHeaders::clear()
+    {
+        arena_.clear();
+        spill_.clear();
+        count_ = 0;
+        index_.fill(0);
+    }
+
+    void HttpHeaders::rebuild_index()
+    {
+        index_.fill(0);
+        for (size_t i = count_; i-- > 0;)
+        {
+            HeaderId id = record(i).id;
+            if (id != HeaderId::Other)
+                index_[static_cast<size_t>(id)] = static_cast<uint16_t>(i + 1);
+        }
+    }
+
+} // namespace proxy
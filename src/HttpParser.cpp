@@ -1,191 +1,308 @@
 #include "../include/proxy/HttpParser.hpp"
-#include <sstream> // For std::istringstream
+#include <sstream> // For std::ostringstream
 #include <string>
-#include <vector>
 #include <algorithm>
-// Simple helper to trim leading/trailing whitespace from a string
+#include <array>
+#include <cctype>
+#include <charconv>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace
 {
-    static std::string trim_whitespace(const std::string &s)
+    // RFC 9110 tchar: the bytes allowed in methods and header names
+    constexpr std::array<bool, 256> make_token_table()
     {
-        const std::string WHITESPACE = " \t\n\r\f\v";
-        ssize_t first = s.find_first_not_of(WHITESPACE);
-        if (std::string::npos == first)
-        {
-            return s; // No non-whitespace content
-        }
-        ssize_t last = s.find_last_not_of(WHITESPACE);
-        return s.substr(first, (last - first + 1));
+        std::array<bool, 256> t{};
+        for (int c = '0'; c <= '9'; ++c)
+            t[c] = true;
+        for (int c = 'a'; c <= 'z'; ++c)
+            t[c] = t[c - 'a' + 'A'] = true;
+        for (char c : std::string_view("!#$%&'*+-.^_`|~"))
+            t[static_cast<unsigned char>(c)] = true;
+        return t;
     }
-}
-namespace proxy
-{
+    constexpr std::array<bool, 256> kTokenChar = make_token_table();
 
-    HttpRequest HttpParser::parse(const std::string &raw_request)
+    bool is_token(std::string_view s)
     {
-        HttpRequest request; // Initialize with default port 80
-        std::istringstream request_stream(raw_request);
-        std::string line;
+        bool ok = !s.empty();
+        for (char c : s)
+            ok &= kTokenChar[static_cast<unsigned char>(c)]; // no early exit: valid input is the fast path
+        return ok;
+    }
 
-        // 1. Parse Request Line: METHOD target HTTP-Version
-        if (!std::getline(request_stream, line) || line.empty())
-        {
-            // Invalid: No request line or empty request
-            return HttpRequest{}; // Return default-constructed (empty) request
-        }
+    bool is_delimiter(unsigned char c, char stop)
+    {
+        return (c < 0x20 && c != '\t') || c == 0x7f || c == static_cast<unsigned char>(stop);
+    }
 
-        if (line.back() == '\r')
-        { // Remove trailing CR if present
-            line.pop_back();
+    /* First byte in [p, end) that is a control byte other than HTAB, DEL, or `stop` ('\0'
+     * for none); end if there is none. In a request head that byte is a line end, a colon
+     * or garbage, so this is the only loop that touches every byte. */
+    const char *find_delimiter(const char *p, const char *end, char stop)
+    {
+#if defined(__AVX2__)
+        const __m256i ctl32 = _mm256_set1_epi8(0x1f), del32 = _mm256_set1_epi8(0x7f);
+        const __m256i tab32 = _mm256_set1_epi8('\t'), stop32 = _mm256_set1_epi8(stop);
+        for (; end - p >= 32; p += 32)
+        {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i hit = _mm256_cmpeq_epi8(_mm256_min_epu8(x, ctl32), x); // x <= 0x1f
+            hit = _mm256_andnot_si256(_mm256_cmpeq_epi8(x, tab32), hit);
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(x, del32));
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(x, stop32));
+            if (uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit)))
+                return p + __builtin_ctz(mask);
         }
-
-        std::istringstream request_line_stream(line);
-        std::string http_version; // We'll read it but not store it in your current HttpRequest struct
-
-        request_line_stream >> request.method;
-        request_line_stream >> request.url; // This is the request-target
-        request_line_stream >> http_version;
-
-        if (request.method.empty() || request.url.empty() || http_version.empty())
+#endif
+#if defined(__SSE2__)
+        const __m128i ctl = _mm_set1_epi8(0x1f), del = _mm_set1_epi8(0x7f);
+        const __m128i tab = _mm_set1_epi8('\t'), stop16 = _mm_set1_epi8(stop);
+        for (; end - p >= 16; p += 16)
         {
-            // Invalid request line format
-            return HttpRequest{};
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i hit = _mm_cmpeq_epi8(_mm_min_epu8(x, ctl), x);
+            hit = _mm_andnot_si128(_mm_cmpeq_epi8(x, tab), hit);
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(x, del));
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(x, stop16));
+            if (uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hit)))
+                return p + __builtin_ctz(mask);
         }
+#endif
+        for (; p < end; ++p)
+            if (is_delimiter(static_cast<unsigned char>(*p), stop))
+                return p;
+        return end;
+    }
 
-        // Default path to the request-target (URL) for now.
-        // This will be refined if the URL is absolute.
-        request.path = request.url;
-
-        // 2. Parse Headers (mainly looking for "Host")
-        std::string host_header_value;
+    bool iequals(std::string_view a, std::string_view b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); ++i)
+            if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+                return false;
+        return true;
+    }
 
-        while (std::getline(request_stream, line))
-        {
-            if (!line.empty() && line.back() == '\r')
-            { // Remove trailing CR
-                line.pop_back();
-            }
-            if (line.empty())
-            { // Blank line indicates end of headers
-                break;
-            }
+    std::string_view trim_ows(std::string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+            s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+            s.remove_suffix(1);
+        return s;
+    }
 
-            size_t colon_pos = line.find(':');
-            if (colon_pos != std::string::npos)
-            {
-                std::string header_name = line.substr(0, colon_pos);
-                std::string header_value = trim_whitespace(line.substr(colon_pos + 1));
-
-                // Case-insensitive comparison for "Host"
-                std::string temp_header_name = header_name;
-                std::transform(temp_header_name.begin(), temp_header_name.end(), temp_header_name.begin(), ::tolower);
-
-                if (temp_header_name == "host")
-                {
-                    host_header_value = header_value;
-                }
-                // Note: Your HttpRequest struct doesn't store other headers.
-                // If it did, you'd add them here.
-            }
-        }
+    // An invalid port leaves `port` at its default
+    void parse_port(std::string_view digits, unsigned short &port)
+    {
+        unsigned short parsed = 0;
+        if (std::from_chars(digits.data(), digits.data() + digits.size(), parsed).ec == std::errc())
+            port = parsed;
+    }
 
-        // 3. Determine actual host, port, and path
-        // Check if the request.url (request-target) is an absolute URL
-        bool is_absolute_url = false;
-        std::string scheme;
+    // "host[:port]" -> host, and the port if one is given
+    std::string split_host_port(std::string_view authority, unsigned short &port)
+    {
+        size_t colon = authority.find(':');
+        if (colon == std::string_view::npos)
+            return std::string(authority);
+        parse_port(authority.substr(colon + 1), port);
+        return std::string(authority.substr(0, colon));
+    }
+}
 
-        if (request.url.rfind("http://", 0) == 0)
-        {
-            is_absolute_url = true;
-            scheme = "http";
-        }
-        else if (request.url.rfind("https://", 0) == 0)
-        {
-            is_absolute_url = true;
-            scheme = "https";
-            request.port = 443; // Default port for HTTPS
-        }
+namespace proxy
+{
+    // ---------- RequestHeadParser ----------
+    RequestHeadParser::RequestHeadParser(RequestLimits limits) : limits_(limits)
+    {
+        limits_.max_headers = std::min(limits_.max_headers, kMaxHeaders);
+    }
 
-        if (is_absolute_url)
-        {
-            // Parse host, port, path from the absolute URL
-            // Example: http://example.com:8080/path/to/resource
-            size_t scheme_separator_pos = request.url.find("://");
-            std::string url_no_scheme = request.url.substr(scheme_separator_pos + 3); // "example.com:8080/path/to/resource"
+    void RequestHeadParser::reset()
+    {
+        base_ = nullptr;
+        pos_ = scan_ = 0;
+        in_headers_ = false;
+        status_ = Status::Incomplete;
+        error_ = Error::None;
+        method_ = target_ = version_ = Span{};
+        header_count_ = 0;
+    }
 
-            size_t path_start_pos = url_no_scheme.find('/');
-            std::string host_port_part;
+    RequestHeadParser::Status RequestHeadParser::fail(Error e)
+    {
+        error_ = e;
+        return status_ = Status::Error;
+    }
 
-            if (path_start_pos != std::string::npos)
-            {
-                host_port_part = url_no_scheme.substr(0, path_start_pos); // "example.com:8080"
-                request.path = url_no_scheme.substr(path_start_pos);      // "/path/to/resource"
-            }
-            else
+    RequestHeadParser::Status RequestHeadParser::feed(std::string_view buffer)
+    {
+        base_ = buffer.data();
+        if (status_ != Status::Incomplete)
+            return status_;
+        const char *data = buffer.data(), *end = data + buffer.size();
+        while (true)
+        {
+            const char *hit = find_delimiter(data + pos_ + scan_, end, '\0');
+            size_t eol = static_cast<size_t>(hit - data);
+            size_t next;
+            if (hit != end && *hit == '\n')
+                next = eol + 1;
+            else if (hit != end && *hit == '\r' && hit + 1 != end)
             {
-                // No path in URL, e.g., http://example.com
-                host_port_part = url_no_scheme;
-                request.path = "/"; // Default path
+                if (hit[1] != '\n')
+                    return fail(in_headers_ ? Error::BadHeader : Error::BadRequestLine);
+                next = eol + 2;
             }
-
-            size_t port_colon_pos_in_url = host_port_part.find(':');
-            if (port_colon_pos_in_url != std::string::npos)
+            else if (hit == end || *hit == '\r')
             {
-                request.host = host_port_part.substr(0, port_colon_pos_in_url);
-                try
-                {
-                    request.port = static_cast<unsigned short>(std::stoul(host_port_part.substr(port_colon_pos_in_url + 1)));
-                }
-                catch (const std::exception &e)
-                {
-                    // Invalid port in URL, keep default (80 for http, 443 for https)
-                }
+                // Line not finished yet: remember how far it was searched (a trailing CR is looked at again)
+                scan_ = eol - pos_;
+                if (!in_headers_ && scan_ > limits_.max_request_line)
+                    return fail(Error::RequestLineTooLong);
+                if (buffer.size() > limits_.max_head_bytes)
+                    return fail(Error::HeadTooLarge);
+                return Status::Incomplete;
             }
             else
+                return fail(in_headers_ ? Error::BadHeader : Error::BadRequestLine); // control byte inside a line
+
+            if (next > limits_.max_head_bytes)
+                return fail(Error::HeadTooLarge);
+            size_t begin = pos_;
+            pos_ = next;
+            scan_ = 0;
+            if (!in_headers_)
             {
-                request.host = host_port_part;
-                // Port not in URL, it's already defaulted (80 or 443 based on scheme)
+                if (eol == begin)
+                    continue; // empty lines before the request line are ignored (RFC 9112 2.2)
+                if (eol - begin > limits_.max_request_line)
+                    return fail(Error::RequestLineTooLong);
+                if (!parse_request_line(begin, eol))
+                    return fail(Error::BadRequestLine);
+                in_headers_ = true;
             }
-        }
-        else
-        {
-            // URL is not absolute (e.g., "/path/page.html"), so path is already set correctly.
-            // Host and port must come from the "Host" header.
-            if (!host_header_value.empty())
+            else if (eol == begin)
             {
-                size_t port_colon_pos_in_host = host_header_value.find(':');
-                if (port_colon_pos_in_host != std::string::npos)
-                {
-                    request.host = host_header_value.substr(0, port_colon_pos_in_host);
-                    try
-                    {
-                        request.port = static_cast<unsigned short>(std::stoul(host_header_value.substr(port_colon_pos_in_host + 1)));
-                    }
-                    catch (const std::exception &e)
-                    {
-                        // Invalid port in Host header, keep default (80)
-                    }
-                }
-                else
-                {
-                    request.host = host_header_value;
-                    // request.port remains its default (80)
-                }
+                return status_ = Status::Complete;
             }
             else
             {
-                // No Host header and URL is not absolute. This is an error for HTTP/1.1.
-                // For this simple parser, request.host will be empty.
-                // A more robust parser would flag this as an error.
+                if (header_count_ == limits_.max_headers)
+                    return fail(Error::TooManyHeaders);
+                if (!parse_header_line(begin, eol))
+                    return fail(Error::BadHeader);
             }
         }
+    }
+
+    bool RequestHeadParser::parse_request_line(size_t begin, size_t end)
+    {
+        std::string_view line(base_ + begin, end - begin);
+        size_t sp1 = line.find(' ');
+        if (sp1 == std::string_view::npos)
+            return false;
+        size_t sp2 = line.find(' ', sp1 + 1);
+        if (sp2 == std::string_view::npos || line.find(' ', sp2 + 1) != std::string_view::npos)
+            return false;
+        std::string_view method = line.substr(0, sp1);
+        std::string_view target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+        std::string_view version = line.substr(sp2 + 1);
+        if (!is_token(method) || target.empty() || target.find('\t') != std::string_view::npos)
+            return false;
+        if (version.size() != 8 || version.compare(0, 5, "HTTP/") != 0 || !std::isdigit(static_cast<unsigned char>(version[5])) ||
+            version[6] != '.' || !std::isdigit(static_cast<unsigned char>(version[7])))
+            return false;
+        auto offset = static_cast<uint32_t>(begin);
+        method_ = {offset, static_cast<uint32_t>(method.size())};
+        target_ = {offset + static_cast<uint32_t>(sp1 + 1), static_cast<uint32_t>(target.size())};
+        version_ = {offset + static_cast<uint32_t>(sp2 + 1), 8};
+        return true;
+    }
+
+    bool RequestHeadParser::parse_header_line(size_t begin, size_t end)
+    {
+        const char *line = base_ + begin, *line_end = base_ + end;
+        // A leading space or tab would be obsolete line folding, which must be rejected
+        const char *colon = find_delimiter(line, line_end, ':');
+        if (colon == line_end || !is_token(std::string_view(line, colon - line)))
+            return false;
+        std::string_view value = trim_ows(std::string_view(colon + 1, line_end - colon - 1));
+        Field &field = headers_[header_count_++];
+        field.name = {static_cast<uint32_t>(begin), static_cast<uint32_t>(colon - line)};
+        field.value = {static_cast<uint32_t>(value.data() - base_), static_cast<uint32_t>(value.size())};
+        return true;
+    }
+
+    std::string_view RequestHeadParser::find(std::string_view name) const
+    {
+        for (size_t i = 0; i < header_count_; ++i)
+            if (iequals(view(headers_[i].name), name))
+                return view(headers_[i].value);
+        return {};
+    }
+
+    // ---------- HttpParser ----------
+    HttpRequest HttpParser::parse(const std::string &raw_request)
+    {
+        // The text is complete in memory, so only its shape is checked, not its size
+        RequestLimits limits;
+        limits.max_head_bytes = std::max(limits.max_head_bytes, raw_request.size());
+        limits.max_request_line = limits.max_head_bytes;
+        RequestHeadParser head(limits);
+        if (head.feed(raw_request) != RequestHeadParser::Status::Complete)
+            return HttpRequest{}; // Invalid: empty request (host left empty)
+        return parse(head);
+    }
+
+    HttpRequest HttpParser::parse(const RequestHeadParser &head)
+    {
+        HttpRequest request; // Initialize with default port 80
+        request.method = head.method();
+        request.url = head.target(); // This is the request-target
+        request.http_version = head.version();
+        for (size_t i = 0; i < head.header_count(); ++i)
+        {
+            RequestHeadParser::Header h = head.header(i);
+            request.headers.add(h.name, h.value);
+        }
 
-        // Ensure path is at least "/" if it was meant to be a path from an absolute URL with no explicit path
-        if (is_absolute_url && request.path.empty())
+        std::string_view url = head.target();
+        if (request.method == "CONNECT")
         {
-            request.path = "/";
+            // CONNECT uses the authority form: "host:port" (no scheme, no path)
+            request.port = 443;
+            size_t port_colon_pos = url.rfind(':');
+            request.host = url.substr(0, port_colon_pos);
+            if (port_colon_pos != std::string_view::npos)
+                parse_port(url.substr(port_colon_pos + 1), request.port);
+            return request;
         }
 
+        // Absolute form (proxy requests): http://example.com:8080/path/to/resource
+        size_t scheme_len = url.rfind("http://", 0) == 0 ? 7 : url.rfind("https://", 0) == 0 ? 8 : 0;
+        if (scheme_len != 0)
+        {
+            if (scheme_len == 8)
+                request.port = 443; // Default port for HTTPS
+            std::string_view rest = url.substr(scheme_len);
+            size_t path_start_pos = rest.find('/');
+            request.path = path_start_pos == std::string_view::npos ? "/" : std::string(rest.substr(path_start_pos));
+            request.host = split_host_port(rest.substr(0, path_start_pos), request.port);
+            return request;
+        }
+
+        // Origin form ("/path/page.html"): host and port come from the Host header. Without
+        // one (an error for HTTP/1.1) request.host stays empty and the caller rejects it.
+        request.path = request.url;
+        request.host = split_host_port(head.find("host"), request.port);
         return request;
     }
 
@@ -193,9 +310,9 @@ namespace proxy
     {
         std::ostringstream out;
         out << req.method << " " << req.path << " " << req.http_version << "\r\n";
-        for (const auto &kv : req.headers)
+        for (const HttpHeaders::Field field : req.headers)
         {
-            out << kv.first << ": " << kv.second << "\r\n";
+            out << field.name << ": " << field.value << "\r\n";
         }
         out << "\r\n"; // End of header
         return out.str();
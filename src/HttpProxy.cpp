@@ -1,21 +1,30 @@
 #include "../include/proxy/HttpProxy.hpp"
+#include "../include/proxy/Http2Session.hpp"
 #include "../include/proxy/SocketUtils.hpp"
 #include "../include/proxy/HttpParser.hpp"
 #include "../include/proxy/Resolver.hpp"
+#include "../include/proxy/HttpResponseParser.hpp"
+#include "../include/proxy/ByteRange.hpp"
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <poll.h>
 
 #include <iostream>
-#include <sstream>
 #include <regex>
-#include <map>
 #include <fstream>
 #include <ctime>
 #include <fstream>
 #include <string>
 #include <mutex>
 #include <vector>
+#include <algorithm>
+#include <string_view>
+#include <cerrno>
 #include <unistd.h> // close()
+#include <csignal>
+#include <filesystem>
+#include <iterator>
+#include <random>
 
 using namespace proxy;
 using namespace net; // SocketUtils functions
@@ -55,6 +64,53 @@ static bool isSegmentRequest(const std::string &path)
            (path.size() > 4 && path.substr(path.size() - 4) == ".mp4");
 }
 
+// ASCII lower-case copy, for matching tokens inside header values
+static std::string lower_case(std::string_view s)
+{
+    std::string out(s);
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c)
+                   { return static_cast<char>(std::tolower(c)); });
+    return out;
+}
+
+// Closes an origin socket on every exit path, including exceptions mid-relay
+namespace
+{
+    struct FdGuard
+    {
+        int fd;
+        explicit FdGuard(int f) : fd(f) {}
+        ~FdGuard()
+        {
+            if (fd >= 0)
+                ::close(fd);
+        }
+        FdGuard(const FdGuard &) = delete;
+        FdGuard &operator=(const FdGuard &) = delete;
+    };
+
+    // Ends a collapsed-forwarding lead on every exit path, waking the requests that wait on it
+    struct FetchLead
+    {
+        proxy::InflightFetches *inflight = nullptr;
+        std::string key;
+        void release()
+        {
+            if (inflight)
+                inflight->finish(key);
+            inflight = nullptr;
+        }
+        ~FetchLead() { release(); }
+    };
+
+    // Nobody reads this response: the body only goes into the cache
+    class DiscardSink : public proxy::ResponseSink
+    {
+    public:
+        void write(std::string_view) override {}
+    };
+}
+
 const std::string ACCESS_LOG_FILE = "access.log";
 const std::string ERROR_LOG_FILE = "error.log";
 
@@ -94,16 +150,141 @@ void log_error(const std::string &msg)
     log << "[" << get_time_str() << "] " << msg << std::endl;
 }
 // ---------- ctor ----------
-HttpProxy::HttpProxy(unsigned short port, size_t cache_max_size_mb, size_t thread_cnt) : port_(port),
-                                                                                         response_cache_(cache_max_size_mb > 0 ? cache_max_size_mb * 5 : 100),
-                                                                                         thread_pool_(thread_cnt)
+HttpProxy::HttpProxy(unsigned short port, size_t cache_max_size_mb, size_t thread_cnt, double cache_max_object_fraction,
+                     Cache::EvictionPolicy cache_policy)
+    : port_(port),
+      response_cache_(cache_max_size_mb > 0 ? cache_max_size_mb * 1024 * 1024 : kDefaultCacheBytes, 0,
+                      cache_entry_weight, cache_max_object_fraction, cache_policy),
+      thread_pool_(thread_cnt),
+      revalidation_pool_(kRevalidationThreads)
 {
     if (cache_max_size_mb == 0)
     {
-        std::cout << "[HttpProxy] Warning: Cache size parameter implies very small or zero capacity. Cache might be ineffective or using default." << std::endl;
+        std::cout << "[HttpProxy] Warning: no cache size given, using the default budget of " << (kDefaultCacheBytes >> 20) << " MB." << std::endl;
     }
     // std::cout << "[HttpProxy] Initialized on port " << port_
-    //           << " with estimated cache capacity: " << (cache_max_size_mb > 0 ? cache_max_size_mb * 5 : 100) << " items." << std::endl;
+    //           << " with cache budget: " << response_cache_.capacity() << " bytes." << std::endl;
+}
+
+void HttpProxy::enable_disk_cache(const std::string &dir, size_t max_bytes)
+{
+    disk_cache_ = std::make_unique<DiskCache>(dir, max_bytes);
+    // Disk hits go out with sendfile, which cannot suppress SIGPIPE per call like send(MSG_NOSIGNAL)
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cout << "[HttpProxy] Disk cache tier: " << (max_bytes >> 20) << " MB in " << dir << std::endl;
+}
+
+void HttpProxy::set_stale_policy(const StalePolicy &policy)
+{
+    stale_policy_ = policy;
+}
+
+void HttpProxy::enable_snapshots(const std::string &dir, std::chrono::seconds interval)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    snapshot_dir_ = dir;
+    try
+    {
+        warm_snapshot_ = std::make_unique<CacheSnapshot>(dir + "/responses.snap");
+        std::cout << "[HttpProxy] Warm restart: " << warm_snapshot_->size() << " cached responses in snapshot" << std::endl;
+    }
+    catch (const std::exception &ex)
+    {
+        std::cout << "[HttpProxy] No response cache snapshot loaded: " << ex.what() << std::endl;
+    }
+    size_t names = Resolver::instance().load_snapshot(dir + "/dns.snap");
+    std::cout << "[HttpProxy] Warm restart: " << names << " resolver entries" << std::endl;
+
+    if (interval.count() > 0)
+    {
+        snapshot_thread_ = std::thread([this, interval]()
+                                       {
+            std::unique_lock<std::mutex> lock(snapshot_mutex_);
+            while (!snapshot_cv_.wait_for(lock, interval, [this]() { return snapshot_stop_; }))
+            {
+                lock.unlock();
+                save_snapshot();
+                lock.lock();
+            } });
+    }
+}
+
+void HttpProxy::save_snapshot()
+{
+    if (snapshot_dir_.empty())
+        return;
+    std::lock_guard<std::mutex> lock(snapshot_mutex_); // the timer thread and a shutdown may both checkpoint
+    try
+    {
+        auto started = std::chrono::steady_clock::now();
+        std::vector<std::pair<std::string, CachedResponsePtr>> entries = response_cache_.entries();
+        {
+            std::lock_guard<std::mutex> workers(worker_caches_mutex_);
+            for (ResponseCache *cache : worker_caches_)
+            {
+                auto more = cache->entries();
+                entries.insert(entries.end(), std::make_move_iterator(more.begin()), std::make_move_iterator(more.end()));
+            }
+        }
+        size_t responses = write_cache_snapshot(snapshot_dir_ + "/responses.snap", entries, warm_snapshot_.get());
+        size_t names = Resolver::instance().save_snapshot(snapshot_dir_ + "/dns.snap");
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+        std::cout << "[HttpProxy] Snapshot: " << responses << " responses, " << names << " resolver entries in "
+                  << elapsed.count() << " ms" << std::endl;
+    }
+    catch (const std::exception &ex)
+    {
+        log_error(std::string("[Snapshot] ") + ex.what());
+    }
+}
+
+HttpProxy::~HttpProxy()
+{
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex_);
+        snapshot_stop_ = true;
+    }
+    snapshot_cv_.notify_all();
+    if (snapshot_thread_.joinable())
+        snapshot_thread_.join();
+}
+
+// ---------- close-reason counters ----------
+static const char *close_reason_name(HttpProxy::CloseReason reason)
+{
+    switch (reason)
+    {
+    case HttpProxy::CloseReason::HeaderTimeout:
+        return "header timeout";
+    case HttpProxy::CloseReason::IdleTimeout:
+        return "idle timeout";
+    case HttpProxy::CloseReason::WriteTimeout:
+        return "write timeout";
+    case HttpProxy::CloseReason::HeaderTooLarge:
+        return "header too large";
+    case HttpProxy::CloseReason::BadRequest:
+        return "bad request";
+    default:
+        return "unknown";
+    }
+}
+
+void HttpProxy::count_close(CloseReason reason)
+{
+    uint64_t total = close_counts_[static_cast<size_t>(reason)].fetch_add(1, std::memory_order_relaxed) + 1;
+    log_access(std::string("Closed client connection: ") + close_reason_name(reason) +
+               " (" + std::to_string(total) + " so far)");
+}
+
+uint64_t HttpProxy::closed_by(CloseReason reason) const
+{
+    return close_counts_[static_cast<size_t>(reason)].load(std::memory_order_relaxed);
+}
+
+HttpProxy::CacheStats HttpProxy::cache_stats() const
+{
+    return response_cache_.stats();
 }
 
 // ---------- run(): accept-loop ----------
@@ -134,148 +315,253 @@ void HttpProxy::run()
     }
 }
 
-/* --- helper: read until end-of-header --- */
-static std::string read_request_headers(int fd)
+/* --- helper: read until end-of-header ---
+ * `pending` carries bytes already received past the previous request (pipelining) and
+ * `head` resumes parsing them; on success the next request head is the first
+ * head.head_size() bytes of `pending`. The client gets idle_timeout to start a head and
+ * header_timeout to finish it; size and syntax limits are the parser's.
+ */
+enum class HeadRead
+{
+    Ready,
+    Closed,   // client closed or errored
+    Idle,     // no byte of a new request within the idle timeout
+    TimedOut, // head started but not completed within the header timeout
+    Rejected  // the parser failed the head (head.error())
+};
+
+static HeadRead read_request_head(int fd, std::string &pending, RequestHeadParser &head, std::chrono::seconds idle_timeout,
+                                  std::chrono::seconds header_timeout)
 {
-    std::string data;
-    char buf[1024];
+    using clock = std::chrono::steady_clock;
+    char buf[4096];
+    // The header deadline runs from the first byte of the head, so a slow drip of bytes
+    // cannot keep a connection (and its thread) forever
+    clock::time_point deadline{};
     while (true)
     {
+        switch (head.feed(pending))
+        {
+        case RequestHeadParser::Status::Complete:
+            return HeadRead::Ready;
+        case RequestHeadParser::Status::Error:
+            return HeadRead::Rejected;
+        case RequestHeadParser::Status::Incomplete:
+            break;
+        }
+
+        auto wait = std::chrono::milliseconds(idle_timeout);
+        if (!pending.empty())
+        {
+            if (deadline == clock::time_point{})
+                deadline = clock::now() + header_timeout;
+            wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now());
+            if (wait.count() <= 0)
+                return HeadRead::TimedOut;
+        }
+
+        pollfd pfd{fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, static_cast<int>(wait.count()));
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready == 0)
+            return pending.empty() ? HeadRead::Idle : HeadRead::TimedOut;
+        if (ready < 0)
+            return HeadRead::Closed;
         ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
         if (n <= 0)
-            break;
-        data.append(buf, n);
-        if (data.find("\r\n\r\n") != std::string::npos)
-            break; // header end
+            return HeadRead::Closed;
+        pending.append(buf, n);
     }
-    return data;
 }
 
-// ---------- handle one request ----------
+std::string_view HttpProxy::rejected_head_response(RequestHeadParser::Error error, CloseReason &reason)
+{
+    reason = CloseReason::HeaderTooLarge;
+    switch (error)
+    {
+    case RequestHeadParser::Error::HeadTooLarge:
+    case RequestHeadParser::Error::TooManyHeaders:
+        return kHeaderTooLargeResponse;
+    case RequestHeadParser::Error::RequestLineTooLong:
+        return kUriTooLongResponse;
+    default:
+        reason = CloseReason::BadRequest;
+        return kBadRequestResponse;
+    }
+}
+
+// ---------- handle one client connection ----------
 void HttpProxy::handle_client(int client_fd)
 {
     std::cout << "[Thread " << std::this_thread::get_id()
               << "] Handling client fd = " << client_fd << std::endl;
 
-    std::string req_raw = read_request_headers(client_fd);
-    HttpRequest req = HttpParser::parse(req_raw);
-
-    if (req.host.empty())
-        throw std::runtime_error("Invalid HTTP request: missing Host");
+    // A client that stops reading makes send() fail after kWriteStallTimeout instead of
+    // parking this thread; the relay never reads further ahead of it than one buffer
+    net::set_send_timeout(client_fd, kWriteStallTimeout);
 
-    // Log the type of HTTP request
-    if (isMpdRequest(req.path))
+    SocketSink client(client_fd);
+    std::string pending; // bytes of pipelined requests received ahead of time
+    RequestHeadParser head(kRequestLimits);
+    try
     {
-        std::cout << "[HttpProxy] Received MPD request: " << req.path << std::endl;
-        // Fetch mpd content from origin as usual
-        std::string ip = Resolver::instance().resolve(req.host, req.port);
-        int origin_fd = net::connect_to_host(ip, req.port, std::chrono::seconds(5));
+        for (size_t served = 0; served < kMaxRequestsPerConnection; ++served)
+        {
+            head.reset();
+            switch (read_request_head(client_fd, pending, head, kClientIdleTimeout, kHeaderReadTimeout))
+            {
+            case HeadRead::Ready:
+                break;
+            case HeadRead::Closed:
+                return;
+            case HeadRead::Idle:
+                // Only a connection that already served a request counts as idle; a client that
+                // never sends anything is as slow as one that never finishes its head
+                count_close(served > 0 ? CloseReason::IdleTimeout : CloseReason::HeaderTimeout);
+                return;
+            case HeadRead::TimedOut:
+                count_close(CloseReason::HeaderTimeout);
+                send(client_fd, kRequestTimeoutResponse.data(), kRequestTimeoutResponse.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+                return;
+            case HeadRead::Rejected:
+            {
+                CloseReason reason;
+                std::string_view response = rejected_head_response(head.error(), reason);
+                count_close(reason);
+                send(client_fd, response.data(), response.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+                return;
+            }
+            }
 
-        std::string real_req_raw = HttpParser::serialize(req);
-        net::write_all(origin_fd, real_req_raw);
-        std::string mpd_xml = net::read_all(origin_fd);
-        ::close(origin_fd);
+            if (served == 0 && head.method() == "PRI" && head.target() == "*" && head.version() == "HTTP/2.0")
+            {
+                // HTTP/2 with prior knowledge: the preface's first line looks like a request head
+                serve_http2(client_fd, std::move(pending), nullptr, "");
+                return;
+            }
 
-        // Send mpd XML back to client (keep old proxy behavior)
-        net::write_all(client_fd, mpd_xml);
+            HttpRequest req = HttpParser::parse(head);
+            pending.erase(0, head.head_size());
+            if (req.host.empty())
+                throw std::runtime_error("Invalid HTTP request: missing Host");
 
-        // Try to parse and cache DASH information for future segment selection
-        try
-        {
-            dash_engine_ = std::make_unique<proxy::DashEngine>(mpd_xml);
-            std::cout << "[HttpProxy] MPD parsed, available representations: "
-                      << dash_engine_->getRepresentations().size() << std::endl;
-            for (const auto &rep : dash_engine_->getRepresentations())
+            std::string h2_settings;
+            if (served == 0 && wants_h2c_upgrade(req, h2_settings))
+            {
+                client.write("HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+                serve_http2(client_fd, pending, &req, h2_settings);
+                return;
+            }
+
+            if (req.method == "CONNECT")
             {
-                std::cout << "   - id: " << rep.id
-                          << ", bw: " << rep.bandwidth
-                          << ", res: " << rep.width << "x" << rep.height << std::endl;
+                // The tunnel takes over the connection, including anything sent after the head
+                handle_connect(client_fd, req, pending);
+                return;
             }
+
+            bool keep_alive = client_wants_keep_alive(req) && served + 1 < kMaxRequestsPerConnection;
+            if (!handle_request(client, req, keep_alive))
+                return;
         }
-        catch (const std::exception &ex)
+    }
+    catch (const net::SendTimeout &)
+    {
+        count_close(CloseReason::WriteTimeout);
+    }
+}
+
+// ---------- HTTP/2 (h2c) ----------
+void HttpProxy::serve_http2(int client_fd, std::string received, const HttpRequest *upgraded, const std::string &upgrade_settings)
+{
+    std::cout << "[HttpProxy] HTTP/2 connection on fd = " << client_fd << std::endl;
+    Http2Session::Options options;
+    options.idle_timeout = kClientIdleTimeout;
+    options.write_stall_timeout = kWriteStallTimeout;
+    Http2Session session(client_fd, [this](HttpRequest &req, ResponseSink &stream)
+                         {
+        if (req.method == "CONNECT")
         {
-            std::cerr << "[HttpProxy] Failed to parse MPD: " << ex.what() << std::endl;
-            // dash_engine_.reset();
+            stream.write("HTTP/1.1 405 Method Not Allowed\r\nContent-Length: 0\r\n\r\n");
+            return;
         }
-        return;
+        handle_request(stream, req, false); }, options);
+    session.run(std::move(received), upgraded, upgrade_settings);
+}
+
+bool HttpProxy::wants_h2c_upgrade(const HttpRequest &req, std::string &settings)
+{
+    std::string upgrade = lower_case(req.headers.get(HeaderId::Upgrade));
+    std::string_view content_length = req.headers.get(HeaderId::ContentLength);
+    if (upgrade.find("h2c") == std::string::npos || !req.headers.contains(HeaderId::Http2Settings) ||
+        req.method == "CONNECT" || (!content_length.empty() && content_length != "0") ||
+        req.headers.contains(HeaderId::TransferEncoding))
+        return false;
+    settings = req.headers.get(HeaderId::Http2Settings);
+    return true;
+}
+
+// ---------- handle one request ----------
+bool HttpProxy::handle_request(ResponseSink &client, HttpRequest &req, bool keep_alive)
+{
+
+    // Log the type of HTTP request
+    if (isMpdRequest(req.path))
+    {
+        std::cout << "[HttpProxy] Received MPD request: " << req.path << std::endl;
+        // Fetch mpd content from origin as usual
+        HttpResponseParser parser(req.method == "HEAD");
+        std::string body_prefix;
+        UpstreamPool::Lease origin = exchange_with_origin(req, build_origin_request(req), parser, body_prefix);
+        keep_alive = keep_alive && !parser.close_delimited();
+
+        // Relay the manifest to the client while keeping a copy for the DASH engine
+        client.write(client_response_head(parser.head(), keep_alive));
+        std::vector<char> mpd_xml;
+        RelayResult relayed = relay_body(origin.fd(), client, parser, body_prefix, &mpd_xml);
+        if (relayed.reusable)
+            origin.keep_alive();
+        if (relayed.fill_complete)
+        {
+            // Try to parse and cache DASH information for future segment selection
+            update_dash_engine(std::string(mpd_xml.begin(), mpd_xml.end()));
+        }
+        return keep_alive;
     }
     else if (isSegmentRequest(req.path))
     {
         std::cout << "[HttpProxy] Received segment request: " << req.path << std::endl;
 
-        //  Estimate bandwidth (fixed for now)
-        int bandwidth_kbps = 2000; // default fallback
-
-        // Use DashEngine to select best Representation
-        if (!dash_engine_)
+        // Build new HTTP request for the origin server
+        HttpRequest rep_req = req; // copy base request
+        if (!rewrite_segment_request(rep_req))
         {
             std::cerr << "[HttpProxy] Warning: No DASH info cached for segment request, forwarding as normal." << std::endl;
             // fallback: forward as normal
         }
         else
         {
-            // Choose best Representation for bandwidth
-            Representation rep = dash_engine_->selectRepresentation(bandwidth_kbps);
-
-            // Extract segment number from the request
-            int segment_number = extractSegmentNumber(req.path);
-
-            // Build real URL to the best rep's segment
-            std::string seg_url = buildSegmentUrl(rep, segment_number);
-            std::cout << "[HttpProxy] Redirect segment to: " << seg_url << std::endl;
-
-            // Build new HTTP request for the origin server
-            HttpRequest rep_req = req;    // copy base request
-            rep_req.path = "/" + seg_url; // or + base path based on the structure of mpd
-
-            std::string rep_req_raw = HttpParser::serialize(rep_req);
-
             // Forward to origin and return response
-            std::string ip = Resolver::instance().resolve(req.host, req.port);
-            int origin_fd = net::connect_to_host(ip, req.port, std::chrono::seconds(5));
             // start timer
             auto start = std::chrono::steady_clock::now();
 
-            net::write_all(origin_fd, rep_req_raw);
-            std::string resp_raw = net::read_all(origin_fd);
+            HttpResponseParser parser(req.method == "HEAD");
+            std::string body_prefix;
+            UpstreamPool::Lease origin = exchange_with_origin(rep_req, build_origin_request(rep_req), parser, body_prefix);
+            keep_alive = keep_alive && !parser.close_delimited();
+            client.write(client_response_head(parser.head(), keep_alive));
+            RelayResult relayed = relay_body(origin.fd(), client, parser, body_prefix, nullptr);
+            if (relayed.reusable)
+                origin.keep_alive();
 
             auto end = std::chrono::steady_clock::now();
-            ::close(origin_fd);
             // timer end
 
-            // count downloading byrate
-            size_t segment_bytes = resp_raw.size();
-            double elapsed_sec = std::chrono::duration<double>(end - start).count();
-            double measured_bandwidth_kbps = 0.0;
-            if (elapsed_sec > 0.0)
-                measured_bandwidth_kbps = (segment_bytes * 8.0) / (elapsed_sec * 1000.0); // kbps
-            // save to sliding window
-            {
-                std::lock_guard<std::mutex> lock(bandwidth_mutex_);
-                recent_bandwidths_.push_back(measured_bandwidth_kbps);
-                if (recent_bandwidths_.size() > max_bandwidth_samples_)
-                    recent_bandwidths_.pop_front();
-            }
-            // get the mean of sliding window
-            {
-                std::lock_guard<std::mutex> lock(bandwidth_mutex_);
-                double sum = 0.0;
-                for (auto b : recent_bandwidths_)
-                    sum += b;
-                if (!recent_bandwidths_.empty())
-                    bandwidth_kbps = sum / recent_bandwidths_.size();
-            }
-            std::cout << "[HttpProxy] [ABR] Measured segment: " << segment_bytes
-                      << " bytes in " << elapsed_sec << " sec, bandwidth: "
-                      << measured_bandwidth_kbps << " kbps, avg: "
-                      << bandwidth_kbps << " kbps\n";
-
-            // net::write_all(origin_fd, rep_req_raw);
-            // std::string resp_raw = net::read_all(origin_fd);
-            //::close(origin_fd);
-
-            net::write_all(client_fd, resp_raw);
-            return;
+            record_bandwidth_sample(parser.head().size() + relayed.bytes, std::chrono::duration<double>(end - start).count());
+            return keep_alive;
         }
     }
     else
@@ -283,65 +569,161 @@ void HttpProxy::handle_client(int client_fd)
         std::cout << "[HttpProxy] Received normal request: " << req.path << std::endl;
     }
 
-    std::string cache_key = req.host + req.path;
+    if (req.method != "GET")
+    {
+        // Only full GET responses are cached: a HEAD response would poison the entry with an empty body
+        HttpResponseParser parser(req.method == "HEAD");
+        std::string body_prefix;
+        UpstreamPool::Lease origin = exchange_with_origin(req, build_origin_request(req), parser, body_prefix);
+        keep_alive = keep_alive && !parser.close_delimited();
+        client.write(client_response_head(parser.head(), keep_alive));
+        if (relay_body(origin.fd(), client, parser, body_prefix, nullptr).reusable)
+            origin.keep_alive();
+        return keep_alive;
+    }
+
+    // Conditional and Range requests are answered from the full object, which is what gets fetched
+    // and cached; the origin only sees the client's conditions when the object is too large to cache
+    const ClientConditions conditions = take_client_conditions(req.headers);
 
-    // check cache before network
-    auto cached = response_cache_.get(cache_key);
-    if (cached.has_value())
+    // check cache before network. The key is built in a per-thread buffer: a hit allocates nothing
+    thread_local std::string lookup_key;
+    lookup_key.assign(req.host).append(req.path);
+    CachedResponsePtr cached = cache_lookup(response_cache_, lookup_key);
+    Freshness freshness = cached ? this->freshness(*cached) : Freshness::Expired;
+    if (freshness != Freshness::Expired)
     {
-        if (!cached->is_stale())
+        // Fresh, or stale within stale-while-revalidate: answer now, refresh off the request path
+        if (freshness != Freshness::Fresh)
+            revalidate_in_background(response_cache_, lookup_key, req, cached);
+        const bool stale = freshness == Freshness::StaleWhileRevalidate;
+        std::cout << "[HttpProxy] Cache " << (stale ? "STALE" : "HIT") << ": " << lookup_key << std::endl;
+        send_cached_reply(client, cached, conditions, stale ? "STALE" : cached->body ? "HIT" : "HIT-DISK", keep_alive);
+        return keep_alive;
+    }
+    const std::string cache_key = lookup_key;
+
+    // Miss or stale: only one request per key goes to the origin, the others wait for its result
+    FetchLead lead;
+    switch (inflight_fetches_.join_and_wait(cache_key, kCollapsedWaitTimeout))
+    {
+    case InflightFetches::Join::Leader:
+        lead.inflight = &inflight_fetches_;
+        lead.key = cache_key;
+        break;
+    case InflightFetches::Join::Finished:
+        cached = cache_lookup(response_cache_, cache_key);
+        if (cached && !cached->is_stale())
         {
-            std::cout << "[HttpProxy] Cache HIT: " << cache_key << std::endl;
-            send_cached_response(client_fd, *cached);
-            return;
+            std::cout << "[HttpProxy] Cache HIT (collapsed): " << cache_key << std::endl;
+            send_cached_reply(client, cached, conditions, "COLLAPSED", keep_alive);
+            return keep_alive;
         }
+        break; // the response was not cacheable: fetch it ourselves
+    case InflightFetches::Join::TimedOut:
+        std::cout << "[HttpProxy] Collapsed fetch still running, going to origin: " << cache_key << std::endl;
+        break;
+    }
+
+    HttpResponseParser parser(false);
+    std::string body_prefix;
+    auto fetch_started = std::chrono::steady_clock::now();
+    UpstreamPool::Lease origin;
+    if (cached)
+    {
         // cache expire, validating it with the origin
         std::cout << "[HttpProxy] Cache EXPIRED: validating with conditional request: " << cache_key << std::endl;
         //  Attach ETag validator header if it exists
         if (!cached->etag.empty())
         {
-            req.headers["If-None-Match"] = cached->etag;
+            req.headers.set("If-None-Match", cached->etag);
         }
         // Attach Last-Modified validator header if it exists
         if (!cached->last_modified.empty())
         {
-            req.headers["If-Modified-Since"] = cached->last_modified;
+            req.headers.set("If-Modified-Since", cached->last_modified);
         } // conditional GET" request
         // Serialize the updated HTTP request (with conditional headers)
         // turn the req into HTTP which can be sent
-        std::string conditional_req = HttpParser::serialize(req);
-        // Connect to the origin server,
-        // send the conditional GET request, and read the response.
-        std::string ip = Resolver::instance().resolve(req.host, req.port);
-        int origin_fd = net::connect_to_host(ip, req.port, std::chrono::seconds(5));
-        net::write_all(origin_fd, conditional_req);
-        std::string resp_raw = net::read_all(origin_fd);
-        ::close(origin_fd);
-
-        if (resp_raw.find("304 Not Modified") != std::string::npos)
+        std::string conditional_req = build_origin_request(req);
+        // send the conditional GET request, and read the response head.
+        bool origin_failed = false;
+        try
         {
-            std::cout << "[HttpProxy] Server returned 304: reusing cached response.\n";
-            send_cached_response(client_fd, *cached);
-            return;
+            origin = exchange_with_origin(req, conditional_req, parser, body_prefix);
+        }
+        catch (const std::exception &ex)
+        {
+            if (!usable_if_error(*cached, stale_policy_, std::chrono::steady_clock::now()))
+                throw;
+            log_error("[HttpProxy] Revalidation of " + cache_key + " failed: " + ex.what());
+            origin_failed = true;
         }
 
-        process_and_cache_response(resp_raw, cache_key, client_fd);
-        return;
-    }
-    std::cout << "[HttpProxy] Cache MISS: " << cache_key << std::endl;
-
-    std::string ip = Resolver::instance().resolve(req.host, req.port);
-    int origin_fd = net::connect_to_host(ip, req.port, std::chrono::seconds(5));
+        if (origin_failed || (parser.status_code() >= 500 && usable_if_error(*cached, stale_policy_, std::chrono::steady_clock::now())))
+        {
+            // stale-if-error: a 5xx body still in flight is dropped with the origin connection
+            std::cout << "[HttpProxy] Origin failed, serving stale: " << cache_key << std::endl;
+            lead.release();
+            send_cached_reply(client, cached, conditions, "STALE-IF-ERROR", keep_alive);
+            return keep_alive;
+        }
 
-    std::cout << "[HttpProxy] " << req.method << ' ' << req.host << req.path
-              << "  -->  " << ip << ':' << req.port << '\n';
+        if (parser.status_code() == 304)
+        {
+            std::cout << "[HttpProxy] Server returned 304: reusing cached response.\n";
+            if (parser.keep_alive())
+                origin.keep_alive();
+            CachedResponsePtr refreshed = refresh_cache_entry(*cached, parser);
+            response_cache_.put(cache_key, refreshed);
+            lead.release();
+            send_cached_reply(client, refreshed, conditions, "REVALIDATED", keep_alive);
+            return keep_alive;
+        }
+    }
+    else
+    {
+        std::cout << "[HttpProxy] Cache MISS: " << cache_key << std::endl;
+        origin = exchange_with_origin(req, build_origin_request(req), parser, body_prefix);
+    }
+    const bool fits = parser.content_length().value_or(0) <= cache_fill_limit(response_cache_);
+    if (!fits)
+        lead.release(); // will not be cached: let the waiters fetch it themselves right away
 
-    net::write_all(origin_fd, req_raw);
-    std::string resp_raw = net::read_all(origin_fd);
-    ::close(origin_fd);
+    if (!conditions.empty() && parser.status_code() == 200 && parser.content_length())
+    {
+        if (!fits)
+        {
+            // Too large to cache whole: abandon it and let the origin answer the conditions; its
+            // 206 or 304 is relayed, never cached
+            origin = UpstreamPool::Lease();
+            req.headers.remove("If-None-Match"); // a stale entry's; the client's go back on below
+            req.headers.remove("If-Modified-Since");
+            restore_client_conditions(req.headers, conditions);
+            HttpResponseParser partial(false);
+            std::string partial_prefix;
+            UpstreamPool::Lease partial_origin = exchange_with_origin(req, build_origin_request(req), partial, partial_prefix);
+            keep_alive = keep_alive && !partial.close_delimited();
+            client.write(client_response_head(partial.head(), keep_alive));
+            if (relay_body(partial_origin.fd(), client, partial, partial_prefix, nullptr).reusable)
+                partial_origin.keep_alive();
+            return keep_alive;
+        }
+        // Fetch the whole object into the cache, then answer the client from it
+        DiscardSink discard;
+        CachedResponsePtr full;
+        relay_and_cache(response_cache_, origin, discard, parser, body_prefix, cache_key, false, fetch_started, &full);
+        lead.release();
+        if (!full)
+            throw std::runtime_error("cache fill of " + cache_key + " did not complete");
+        std::cout << "[HttpProxy] Cache MISS, answering the client's conditions from the fetched object: " << cache_key << std::endl;
+        send_cached_reply(client, full, conditions, "MISS", keep_alive);
+        return keep_alive;
+    }
 
-    // cache and send to client
-    process_and_cache_response(resp_raw, cache_key, client_fd);
+    // stream to client and fill the cache entry on the way
+    relay_and_cache(response_cache_, origin, client, parser, body_prefix, cache_key, keep_alive, fetch_started);
+    return keep_alive && !parser.close_delimited();
 }
 
 /** ------------------
@@ -349,84 +731,450 @@ void HttpProxy::handle_client(int client_fd)
  * ------------------
  */
 
-void HttpProxy::send_cached_response(int client_fd, const ResponseCacheEntry &cached)
+void HttpProxy::handle_connect(int client_fd, const HttpRequest &req, const std::string &early_data)
 {
-    std::string full_response = cached.status_line + "\r\n";
-    for (const auto &kv : cached.headers)
+    std::cout << "[HttpProxy] CONNECT tunnel to " << req.host << ':' << req.port << std::endl;
+
+    int origin_fd;
+    try
+    {
+        std::vector<std::string> ips = Resolver::instance().resolve_all(req.host, req.port);
+        std::vector<net::ConnectOutcome> outcomes;
+        try
+        {
+            origin_fd = net::connect_race(ips, req.port, kConnectTimeout, &outcomes);
+        }
+        catch (const std::exception &)
+        {
+            Resolver::instance().record(outcomes);
+            throw;
+        }
+        Resolver::instance().record(outcomes);
+    }
+    catch (const std::exception &)
     {
-        full_response += kv.first + ": " + kv.second + "\r\n";
+        net::write_all(client_fd, "HTTP/1.1 502 Bad Gateway\r\nContent-Length: 0\r\n\r\n");
+        throw;
     }
-    full_response += "\r\n";
-    full_response.append(cached.body.begin(), cached.body.end());
+    FdGuard origin(origin_fd);
 
-    net::write_all(client_fd, full_response);
+    net::write_all(client_fd, "HTTP/1.1 200 Connection Established\r\n\r\n");
+    // Bytes the client sent right after the CONNECT head (e.g. an eager TLS ClientHello)
+    if (!early_data.empty())
+        net::write_all(origin.fd, early_data);
+
+    net::splice_tunnel(client_fd, origin.fd, kTunnelIdleTimeout);
 }
 
-void HttpProxy::process_and_cache_response(const std::string &resp_raw, const std::string &cache_key, int client_fd)
+HttpProxy::RelayResult HttpProxy::relay_and_cache(ResponseCache &cache, UpstreamPool::Lease &origin, ResponseSink &client,
+                                                  HttpResponseParser &parser, const std::string &body_prefix,
+                                                  const std::string &cache_key, bool keep_alive,
+                                                  std::chrono::steady_clock::time_point fetch_started, CachedResponsePtr *filled)
 {
-    auto header_end_pos = resp_raw.find("\r\n\r\n");
-    if (header_end_pos == std::string::npos)
+    ResponseCacheEntry entry = parse_response_head(parser);
+    client.write(client_response_head(parser.head(), keep_alive && !parser.close_delimited()));
+    std::vector<char> body;
+    RelayResult relayed = relay_body(origin.fd(), client, parser, body_prefix, &body, cache_fill_limit(cache));
+    if (relayed.reusable)
+        origin.keep_alive();
+    // The entry only goes into the cache if the whole body fit in the fill budget
+    if (relayed.fill_complete && cacheable_status(parser.status_code()))
     {
-        throw std::runtime_error("Invalid HTTP response (no header-body split)");
+        entry.fetch_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - fetch_started);
+        seal_cache_entry(entry, std::move(body));
+        auto sealed = std::make_shared<const ResponseCacheEntry>(std::move(entry));
+        cache.put(cache_key, sealed);
+        if (disk_cache_)
+            disk_cache_->store(cache_key, *sealed);
+        if (filled)
+            *filled = std::move(sealed);
     }
+    return relayed;
+}
 
-    std::string status_line, header_block;
-    std::vector<char> body;
-    std::map<std::string, std::string> header_map;
+bool HttpProxy::client_wants_keep_alive(const HttpRequest &req)
+{
+    std::string_view content_length = req.headers.get(HeaderId::ContentLength);
+    if ((!content_length.empty() && content_length != "0") || req.headers.contains(HeaderId::TransferEncoding))
+        return false; // request bodies are not forwarded, so the stream cannot be resynced
+    std::string connection = lower_case(req.headers.contains(HeaderId::Connection) ? req.headers.get(HeaderId::Connection)
+                                                                                  : req.headers.get(HeaderId::ProxyConnection));
+    if (req.http_version == "HTTP/1.0")
+        return connection.find("keep-alive") != std::string::npos;
+    return connection.find("close") == std::string::npos;
+}
 
-    status_line = resp_raw.substr(0, resp_raw.find("\r\n"));
+std::string HttpProxy::client_response_head(const std::string &origin_head, bool keep_alive)
+{
+    std::string out;
+    out.reserve(origin_head.size() + 32);
+    size_t pos = 0;
+    while (pos < origin_head.size())
+    {
+        size_t next = origin_head.find("\r\n", pos);
+        if (next == std::string::npos || next == pos)
+            break; // blank line: end of the head
+        std::string_view line(origin_head.data() + pos, next - pos);
+        pos = next + 2;
 
-    // Corrected header_block extraction
-    header_block = resp_raw.substr(resp_raw.find("\r\n") + 2, header_end_pos - (resp_raw.find("\r\n") + 2));
+        // Skip the origin's hop-by-hop connection headers (not on the status line)
+        size_t colon = line.find(':');
+        if (!out.empty() && colon != std::string_view::npos)
+        {
+            std::string name(line.substr(0, colon));
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            if (name == "connection" || name == "keep-alive" || name == "proxy-connection")
+                continue;
+        }
+        out.append(line.data(), line.size());
+        out += "\r\n";
+    }
+    out += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    return out;
+}
+
+std::string HttpProxy::build_origin_request(const HttpRequest &req)
+{
+    HttpRequest out = req;
+    out.http_version = "HTTP/1.1";
+    // Hop-by-hop headers describe the client connection, not ours to the origin
+    for (HeaderId id : {HeaderId::Connection, HeaderId::ProxyConnection, HeaderId::KeepAlive, HeaderId::TE,
+                        HeaderId::Trailer, HeaderId::Upgrade, HeaderId::Http2Settings})
+        out.headers.remove(kHeaderNames[static_cast<size_t>(id)]);
+    out.headers.set("Host", req.port == 80 ? req.host : req.host + ":" + std::to_string(req.port));
+    out.headers.set("Connection", "keep-alive");
+    return HttpParser::serialize(out);
+}
 
-    std::istringstream stream(header_block);
-    std::string line;
-    while (std::getline(stream, line))
+UpstreamPool::Lease HttpProxy::exchange_with_origin(const HttpRequest &req, const std::string &request_bytes,
+                                                    HttpResponseParser &parser, std::string &body_prefix)
+{
+    std::vector<std::string> ips = Resolver::instance().resolve_all(req.host, req.port);
+    for (int attempt = 0;; ++attempt)
     {
-        auto colon_pos = line.find(":");
-        if (colon_pos != std::string::npos)
+        std::vector<net::ConnectOutcome> outcomes;
+        UpstreamPool::Lease origin;
+        try
+        {
+            origin = upstream_pool_.acquire(ips, req.port, kConnectTimeout, &outcomes);
+        }
+        catch (const std::exception &)
         {
-            std::string key = line.substr(0, colon_pos);
-            std::string value = line.substr(colon_pos + 1);
-            while (!value.empty() && (value[0] == ' ' || value[0] == '\t'))
-                value.erase(0, 1);
-            header_map[key] = value;
+            Resolver::instance().record(outcomes);
+            throw;
+        }
+        Resolver::instance().record(outcomes);
+        std::cout << "[HttpProxy] " << req.method << ' ' << req.host << req.path
+                  << "  -->  " << origin.ip() << ':' << req.port << (origin.reused() ? " (reused)" : "") << '\n';
+        try
+        {
+            net::write_all(origin.fd(), request_bytes);
+            read_response_head(origin.fd(), parser, body_prefix);
+            return origin;
+        }
+        catch (const std::exception &)
+        {
+            // A pooled connection may have been closed by the origin just before we used it;
+            // retry once on a fresh connection if not a single response byte arrived.
+            if (!origin.reused() || attempt > 0 || !parser.head().empty())
+                throw;
+            parser = HttpResponseParser(req.method == "HEAD");
         }
     }
+}
 
-    // Extract the body
-    body.assign(resp_raw.begin() + header_end_pos + 4, resp_raw.end());
+void HttpProxy::read_response_head(int origin_fd, HttpResponseParser &parser, std::string &body_prefix)
+{
+    char buf[4096];
+    while (!parser.head_complete())
+    {
+        ssize_t n = recv(origin_fd, buf, sizeof(buf), 0);
+        if (n < 0)
+            throw std::runtime_error("recv failed while reading response head");
+        if (n == 0)
+        {
+            parser.on_eof(); // throws: no complete head
+            break;
+        }
+        size_t used = parser.parse_head(buf, static_cast<size_t>(n));
+        body_prefix.assign(buf + used, static_cast<size_t>(n) - used);
+    }
+}
+
+HttpProxy::RelayResult HttpProxy::relay_body(int origin_fd, ResponseSink &client, HttpResponseParser &parser,
+                                             const std::string &body_prefix, std::vector<char> *fill, size_t fill_limit)
+{
+    RelayResult result;
+    bool in_sync = true; // no bytes beyond the end of the message
+    auto forward = [&](const char *data, size_t len)
+    {
+        size_t used = parser.parse_body(data, len);
+        in_sync = in_sync && used == len;
+        if (used == 0)
+            return;
+        client.write(std::string_view(data, used));
+        result.bytes += used;
+        if (fill && result.fill_complete)
+        {
+            if (fill->size() + used > fill_limit)
+            {
+                // Too big to cache: keep relaying, but release the partial copy now
+                result.fill_complete = false;
+                std::vector<char>().swap(*fill);
+            }
+            else
+            {
+                fill->insert(fill->end(), data, data + used);
+            }
+        }
+    };
+
+    if (!body_prefix.empty())
+        forward(body_prefix.data(), body_prefix.size());
+
+    char buf[kRelayBufferSize];
+    while (!parser.complete())
+    {
+        ssize_t n = recv(origin_fd, buf, sizeof(buf), 0);
+        if (n < 0)
+            throw std::runtime_error("recv failed while relaying response body");
+        if (n == 0)
+        {
+            parser.on_eof(); // fine for close-delimited bodies, throws on truncation
+            break;
+        }
+        forward(buf, static_cast<size_t>(n));
+    }
+
+    result.reusable = in_sync && parser.keep_alive();
+    return result;
+}
+
+HttpProxy::ResponseCacheEntry HttpProxy::parse_response_head(const HttpResponseParser &origin)
+{
+    const std::string &head = origin.head();
+    std::string status_line = head.substr(0, head.find("\r\n"));
+    HttpHeaders headers;
+    for (size_t i = 0; i < origin.header_count(); ++i)
+    {
+        HttpResponseParser::Header h = origin.header(i);
+        headers.add(h.name, h.value);
+    }
 
     // Compute expiration metadata
     std::chrono::steady_clock::time_point expires_at;
     std::chrono::seconds max_age{0};
     auto now = std::chrono::steady_clock::now();
 
-    if (header_map.count("Cache-Control") && header_map["Cache-Control"].find("max-age=") != std::string::npos)
+    std::string cc = lower_case(headers.get(HeaderId::CacheControl));
+    size_t pos = cc.find("max-age=");
+    if (pos != std::string::npos)
     {
-        std::string cc = header_map["Cache-Control"];
-        size_t pos = cc.find("max-age=");
-        if (pos != std::string::npos)
-        {
-            int age = std::stoi(cc.substr(pos + 8));
-            max_age = std::chrono::seconds(age);
-        }
+        int age = std::atoi(cc.c_str() + pos + 8);
+        max_age = std::chrono::seconds(std::max(age, 0));
     }
     expires_at = now + max_age;
 
-    // Build and insert the cache entry
+    // Build the cache entry (the body is filled in by the caller)
     ResponseCacheEntry entry;
     entry.status_line = status_line;
-    entry.headers = header_map;
-    entry.body = body;
+    entry.etag = headers.get(HeaderId::ETag);
+    entry.last_modified = headers.get(HeaderId::LastModified);
+    entry.headers = std::move(headers);
     entry.received_at = now;
     entry.max_age = max_age;
     entry.expires_at = expires_at;
-    if (header_map.count("ETag"))
-        entry.etag = header_map["ETag"];
-    if (header_map.count("Last-Modified"))
-        entry.last_modified = header_map["Last-Modified"];
+    read_stale_directives(entry);
+    return entry;
+}
+
+size_t HttpProxy::cache_entry_weight(const std::string &key, const CachedResponsePtr &entry)
+{
+    return key.size() + cached_response_bytes(*entry);
+}
+
+size_t HttpProxy::cache_fill_limit(const ResponseCache &cache) const
+{
+    size_t limit = cache.max_entry_weight();
+    if (disk_cache_)
+        limit = std::max(limit, disk_cache_->max_object_bytes());
+    return std::min(kMaxCacheFillBytes, limit);
+}
+
+CachedResponsePtr HttpProxy::cache_lookup(ResponseCache &cache, std::string_view key)
+{
+    CachedResponsePtr cached = cache.get(key).value_or(nullptr);
+    if (!cached && warm_snapshot_ && (cached = warm_snapshot_->take(key)))
+        cache.put(std::string(key), cached);
+    if (!cached && disk_cache_)
+        cached = disk_cache_->lookup(key);
+    return cached;
+}
+
+CachedResponsePtr HttpProxy::refresh_cache_entry(const ResponseCacheEntry &stale, const HttpResponseParser &not_modified)
+{
+    // Cached entries are shared and immutable: copy the small parts, keep the body
+    auto entry = std::make_shared<ResponseCacheEntry>(stale);
+    ResponseCacheEntry update = parse_response_head(not_modified);
+    if (update.headers.contains(HeaderId::CacheControl))
+        entry->max_age = update.max_age;
+    entry->received_at = update.received_at;
+    entry->expires_at = entry->received_at + entry->max_age;
+    return entry;
+}
+
+Freshness HttpProxy::freshness(const ResponseCacheEntry &entry) const
+{
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+    double random = 1.0 - std::uniform_real_distribution<double>(0.0, 1.0)(rng); // (0, 1]
+    return cache_freshness(entry, stale_policy_, std::chrono::steady_clock::now(), random);
+}
+
+void HttpProxy::revalidate_in_background(ResponseCache &cache, const std::string &key, const HttpRequest &req,
+                                         CachedResponsePtr stale)
+{
+    {
+        std::lock_guard<std::mutex> lock(revalidations_mutex_);
+        if (!revalidations_.emplace(&cache, key).second)
+            return;
+    }
+    revalidation_pool_.enqueue([this, &cache, key, req, stale]()
+                               {
+        try {
+            revalidate(cache, key, req, *stale);
+        } catch (const std::exception &ex) {
+            log_error("[HttpProxy] Background revalidation of " + key + " failed: " + ex.what());
+        }
+        std::lock_guard<std::mutex> lock(revalidations_mutex_);
+        revalidations_.erase({&cache, key});
+        revalidations_cv_.notify_all(); });
+}
+
+void HttpProxy::wait_for_revalidations(const ResponseCache &cache)
+{
+    std::unique_lock<std::mutex> lock(revalidations_mutex_);
+    revalidations_cv_.wait(lock, [this, &cache]()
+                           {
+        auto it = revalidations_.lower_bound({&cache, std::string()});
+        return it == revalidations_.end() || it->first != &cache; });
+}
 
-    response_cache_.put(cache_key, entry);
-    send_cached_response(client_fd, entry);
+void HttpProxy::revalidate(ResponseCache &cache, const std::string &key, HttpRequest req, const ResponseCacheEntry &stale)
+{
+    // Only our own validators: a 304 for the client's copy would say nothing about the entry
+    req.headers.remove("If-None-Match");
+    req.headers.remove("If-Modified-Since");
+    if (!stale.etag.empty())
+        req.headers.set("If-None-Match", stale.etag);
+    if (!stale.last_modified.empty())
+        req.headers.set("If-Modified-Since", stale.last_modified);
+    HttpResponseParser parser(false);
+    std::string body_prefix;
+    auto fetch_started = std::chrono::steady_clock::now();
+    UpstreamPool::Lease origin = exchange_with_origin(req, build_origin_request(req), parser, body_prefix);
+    if (parser.status_code() == 304)
+    {
+        if (parser.keep_alive())
+            origin.keep_alive();
+        cache.put(key, refresh_cache_entry(stale, parser));
+        std::cout << "[HttpProxy] Revalidated in background: " << key << std::endl;
+        return;
+    }
+    if (parser.status_code() >= 500)
+        throw std::runtime_error("origin answered " + std::to_string(parser.status_code()));
+    DiscardSink discard;
+    relay_and_cache(cache, origin, discard, parser, body_prefix, key, false, fetch_started);
+    std::cout << "[HttpProxy] Refreshed in background: " << key << std::endl;
+}
+
+HttpProxy::RequestKind HttpProxy::classify_request(const std::string &path)
+{
+    if (isMpdRequest(path))
+        return RequestKind::Manifest;
+    if (isSegmentRequest(path))
+        return RequestKind::Segment;
+    return RequestKind::Other;
+}
+
+/** ------------------
+ * DASH helpers (shared by the blocking and event-loop front ends)
+ * ------------------
+ */
+
+std::shared_ptr<const DashEngine> HttpProxy::current_dash_engine() const
+{
+    std::lock_guard<std::mutex> lock(dash_mutex_);
+    return dash_engine_;
+}
+
+void HttpProxy::update_dash_engine(const std::string &mpd_xml)
+{
+    try
+    {
+        auto engine = std::make_shared<const proxy::DashEngine>(mpd_xml);
+        std::cout << "[HttpProxy] MPD parsed, available representations: "
+                  << engine->getRepresentations().size() << std::endl;
+        for (const auto &rep : engine->getRepresentations())
+        {
+            std::cout << "   - id: " << rep.id
+                      << ", bw: " << rep.bandwidth
+                      << ", res: " << rep.width << "x" << rep.height << std::endl;
+        }
+        std::lock_guard<std::mutex> lock(dash_mutex_);
+        dash_engine_ = std::move(engine);
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << "[HttpProxy] Failed to parse MPD: " << ex.what() << std::endl;
+    }
+}
+
+bool HttpProxy::rewrite_segment_request(HttpRequest &req) const
+{
+    auto engine = current_dash_engine();
+    if (!engine)
+        return false;
+
+    //  Estimate bandwidth (fixed for now)
+    int bandwidth_kbps = 2000; // default fallback
+
+    // Choose best Representation for bandwidth
+    Representation rep = engine->selectRepresentation(bandwidth_kbps);
+
+    // Extract segment number from the request
+    int segment_number = extractSegmentNumber(req.path);
+
+    // Build real URL to the best rep's segment
+    std::string seg_url = buildSegmentUrl(rep, segment_number);
+    std::cout << "[HttpProxy] Redirect segment to: " << seg_url << std::endl;
+
+    req.path = "/" + seg_url; // or + base path based on the structure of mpd
+    return true;
+}
+
+double HttpProxy::record_bandwidth_sample(size_t segment_bytes, double elapsed_sec)
+{
+    // count downloading byrate
+    double measured_bandwidth_kbps = 0.0;
+    if (elapsed_sec > 0.0)
+        measured_bandwidth_kbps = (segment_bytes * 8.0) / (elapsed_sec * 1000.0); // kbps
+
+    double avg_kbps = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(bandwidth_mutex_);
+        // save to sliding window
+        recent_bandwidths_.push_back(measured_bandwidth_kbps);
+        if (recent_bandwidths_.size() > max_bandwidth_samples_)
+            recent_bandwidths_.pop_front();
+        // get the mean of sliding window
+        double sum = 0.0;
+        for (auto b : recent_bandwidths_)
+            sum += b;
+        avg_kbps = sum / recent_bandwidths_.size();
+    }
+    std::cout << "[HttpProxy] [ABR] Measured segment: " << segment_bytes
+              << " bytes in " << elapsed_sec << " sec, bandwidth: "
+              << measured_bandwidth_kbps << " kbps, avg: "
+              << avg_kbps << " kbps\n";
+    return avg_kbps;
 }
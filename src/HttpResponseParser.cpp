@@ -0,0 +1,396 @@
+#include "../include/proxy/HttpResponseParser.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+    bool iequals(std::string_view a, std::string_view b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); ++i)
+            if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+                return false;
+        return true;
+    }
+
+    // Case-insensitive substring test for comma-separated header values ("chunked", "close")
+    bool icontains(std::string_view haystack, std::string_view needle)
+    {
+        for (size_t i = 0; i + needle.size() <= haystack.size(); ++i)
+            if (iequals(haystack.substr(i, needle.size()), needle))
+                return true;
+        return false;
+    }
+
+    std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+            s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r'))
+            s.remove_suffix(1);
+        return s;
+    }
+
+    // "1234", or a list of identical values ("1234, 1234", RFC 9110 8.6)
+    size_t parse_content_length(std::string_view value)
+    {
+        std::optional<size_t> length;
+        while (true)
+        {
+            size_t comma = value.find(',');
+            std::string_view item = trim(value.substr(0, comma));
+            size_t n = 0;
+            auto [end, ec] = std::from_chars(item.data(), item.data() + item.size(), n);
+            if (item.empty() || ec != std::errc() || end != item.data() + item.size() || (length && *length != n))
+                throw std::runtime_error("Invalid Content-Length: " + std::string(value));
+            length = n;
+            if (comma == std::string_view::npos)
+                return n;
+            value.remove_prefix(comma + 1);
+        }
+    }
+
+    int hex_value(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+}
+
+namespace proxy
+{
+    HttpResponseParser::HttpResponseParser(bool head_request) : head_request_(head_request) {}
+
+    size_t HttpResponseParser::parse_head(const char *data, size_t len)
+    {
+        size_t consumed = 0;
+        while (!head_complete_ && consumed < len)
+        {
+            // Only the last 3 bytes of what we already have can start the terminator
+            size_t scan_from = head_.size() >= 3 ? head_.size() - 3 : 0;
+            size_t old_size = head_.size();
+            head_.append(data + consumed, len - consumed);
+            auto header_end_pos = head_.find("\r\n\r\n", scan_from);
+            if (header_end_pos == std::string::npos)
+            {
+                if (head_.size() > kMaxHeadBytes)
+                    throw std::runtime_error("Origin response head too large");
+                return len;
+            }
+            head_.resize(header_end_pos + 4);
+            consumed += head_.size() - old_size;
+            on_head_complete();
+            if (status_code_ >= 100 && status_code_ < 200 && status_code_ != 101)
+            {
+                // Interim response: the final one follows on the same connection
+                ++interim_responses_;
+                head_.clear();
+                head_complete_ = complete_ = false;
+            }
+        }
+        return consumed;
+    }
+
+    HttpResponseParser::Header HttpResponseParser::field(const std::string &block, const FieldSpan &span)
+    {
+        return {std::string_view(block.data() + span.name_offset, span.name_length),
+                std::string_view(block.data() + span.value_offset, span.value_length)};
+    }
+
+    void HttpResponseParser::index_fields(const std::string &block, size_t pos, std::vector<FieldSpan> &out)
+    {
+        out.clear();
+        while (pos < block.size())
+        {
+            size_t next = block.find("\r\n", pos);
+            if (next == std::string::npos || next == pos)
+                break;
+            std::string_view line(block.data() + pos, next - pos);
+            pos = next + 2;
+
+            size_t colon_pos = line.find(':');
+            if (colon_pos == std::string_view::npos)
+                continue; // not a field; tolerated from origins
+            std::string_view name = trim(line.substr(0, colon_pos));
+            std::string_view value = trim(line.substr(colon_pos + 1));
+            out.push_back({static_cast<uint32_t>(name.data() - block.data()), static_cast<uint32_t>(name.size()),
+                           static_cast<uint32_t>(value.data() - block.data()), static_cast<uint32_t>(value.size())});
+        }
+    }
+
+    std::string_view HttpResponseParser::find(std::string_view name) const
+    {
+        for (const FieldSpan &span : headers_)
+        {
+            Header h = field(head_, span);
+            if (iequals(h.name, name))
+                return h.value;
+        }
+        return {};
+    }
+
+    void HttpResponseParser::on_head_complete()
+    {
+        head_complete_ = true;
+
+        // Status line: "HTTP/1.1 200 OK"
+        size_t line_end = head_.find("\r\n");
+        std::string_view status_line(head_.data(), line_end);
+        size_t sp = status_line.find(' ');
+        if (status_line.rfind("HTTP/", 0) != 0 || sp == std::string_view::npos)
+            throw std::runtime_error("Invalid HTTP response status line: " + std::string(status_line));
+        status_code_ = std::atoi(head_.c_str() + sp + 1);
+        bool http11 = status_line.compare(0, sp, "HTTP/1.0") != 0;
+
+        index_fields(head_, line_end + 2, headers_);
+        bool is_chunked = false;
+        bool conn_close = false, conn_keep_alive = false;
+        content_length_.reset();
+        for (const FieldSpan &span : headers_)
+        {
+            Header h = field(head_, span);
+            if (iequals(h.name, "content-length"))
+            {
+                size_t length = parse_content_length(h.value);
+                if (content_length_ && *content_length_ != length)
+                    throw std::runtime_error("Conflicting Content-Length headers");
+                content_length_ = length;
+            }
+            else if (iequals(h.name, "transfer-encoding"))
+            {
+                is_chunked = icontains(h.value, "chunked");
+            }
+            else if (iequals(h.name, "connection"))
+            {
+                conn_close = conn_close || icontains(h.value, "close");
+                conn_keep_alive = conn_keep_alive || icontains(h.value, "keep-alive");
+            }
+        }
+        keep_alive_ = http11 ? !conn_close : conn_keep_alive;
+
+        bool no_body = head_request_ || (status_code_ >= 100 && status_code_ < 200) ||
+                       status_code_ == 204 || status_code_ == 304;
+        if (no_body)
+            body_mode_ = BodyMode::None;
+        else if (is_chunked) // Transfer-Encoding wins over Content-Length
+            body_mode_ = BodyMode::Chunked;
+        else if (content_length_)
+            body_mode_ = BodyMode::Length;
+        else
+            body_mode_ = BodyMode::UntilClose;
+
+        remaining_ = body_mode_ == BodyMode::Length ? *content_length_ : 0;
+        complete_ = body_mode_ == BodyMode::None || (body_mode_ == BodyMode::Length && remaining_ == 0);
+    }
+
+    void HttpResponseParser::finish_size_line()
+    {
+        if (chunk_digits_ == 0)
+            throw std::runtime_error("Invalid chunk size line");
+        if (chunk_size_ == 0)
+        {
+            chunk_state_ = ChunkState::TrailerStart; // last-chunk: trailers follow
+        }
+        else
+        {
+            remaining_ = chunk_size_;
+            chunk_state_ = ChunkState::Data;
+        }
+    }
+
+    void HttpResponseParser::finish_trailers()
+    {
+        index_fields(trailer_block_, 0, trailers_);
+        complete_ = true;
+    }
+
+    size_t HttpResponseParser::parse_body(const char *data, size_t len, std::string *payload)
+    {
+        return consume_body(data, len, payload, nullptr);
+    }
+
+    size_t HttpResponseParser::feed(const char *data, size_t len, Listener &listener)
+    {
+        if (complete_)
+            return 0;
+        size_t used = 0;
+        if (!head_complete_)
+        {
+            used = parse_head(data, len);
+            if (!head_complete_)
+                return used;
+            listener.on_head(*this);
+        }
+        used += consume_body(data + used, len - used, nullptr, &listener);
+        if (complete_)
+            listener.on_complete(*this);
+        return used;
+    }
+
+    size_t HttpResponseParser::consume_body(const char *data, size_t len, std::string *payload, Listener *listener)
+    {
+        if (complete_ || !head_complete_)
+            return 0;
+
+        auto emit = [&](const char *p, size_t n)
+        {
+            if (n == 0)
+                return;
+            if (payload)
+                payload->append(p, n);
+            if (listener)
+                listener->on_body(std::string_view(p, n));
+        };
+
+        switch (body_mode_)
+        {
+        case BodyMode::None:
+            return 0;
+        case BodyMode::UntilClose:
+            emit(data, len);
+            return len;
+        case BodyMode::Length:
+        {
+            size_t take = std::min(len, remaining_);
+            emit(data, take);
+            remaining_ -= take;
+            complete_ = remaining_ == 0;
+            return take;
+        }
+        case BodyMode::Chunked:
+            break;
+        }
+
+        size_t i = 0;
+        while (i < len && !complete_)
+        {
+            char c = data[i];
+            switch (chunk_state_)
+            {
+            case ChunkState::Size:
+            {
+                int v = hex_value(c);
+                if (v >= 0)
+                {
+                    if (++chunk_digits_ > 15)
+                        throw std::runtime_error("Chunk size too large");
+                    chunk_size_ = chunk_size_ * 16 + static_cast<size_t>(v);
+                }
+                else if (c == ';' || c == ' ' || c == '\t')
+                    chunk_state_ = ChunkState::Extension;
+                else if (c == '\r')
+                    chunk_state_ = ChunkState::SizeLF;
+                else if (c == '\n')
+                    finish_size_line();
+                else
+                    throw std::runtime_error("Invalid character in chunk size");
+                ++i;
+                break;
+            }
+            case ChunkState::Extension:
+                if (c == '\r')
+                    chunk_state_ = ChunkState::SizeLF;
+                else if (c == '\n')
+                    finish_size_line();
+                ++i;
+                break;
+            case ChunkState::SizeLF:
+                if (c != '\n')
+                    throw std::runtime_error("Invalid chunk size line ending");
+                finish_size_line();
+                ++i;
+                break;
+            case ChunkState::Data:
+            {
+                size_t take = std::min(len - i, remaining_);
+                emit(data + i, take);
+                remaining_ -= take;
+                i += take;
+                if (remaining_ == 0)
+                    chunk_state_ = ChunkState::DataCR;
+                break;
+            }
+            case ChunkState::DataCR:
+                if (c == '\r')
+                {
+                    chunk_state_ = ChunkState::DataLF;
+                }
+                else if (c == '\n')
+                {
+                    chunk_state_ = ChunkState::Size;
+                    chunk_size_ = chunk_digits_ = 0;
+                }
+                else
+                {
+                    throw std::runtime_error("Missing CRLF after chunk data");
+                }
+                ++i;
+                break;
+            case ChunkState::DataLF:
+                if (c != '\n')
+                    throw std::runtime_error("Missing CRLF after chunk data");
+                chunk_state_ = ChunkState::Size;
+                chunk_size_ = chunk_digits_ = 0;
+                ++i;
+                break;
+            case ChunkState::TrailerStart:
+                if (c == '\r')
+                    chunk_state_ = ChunkState::TrailerEndLF;
+                else if (c == '\n')
+                    finish_trailers();
+                else
+                {
+                    trailer_block_.push_back(c);
+                    chunk_state_ = ChunkState::TrailerLine;
+                }
+                ++i;
+                break;
+            case ChunkState::TrailerLine:
+                if (c == '\n')
+                {
+                    // Stored CRLF-terminated whatever the origin used
+                    if (trailer_block_.back() != '\r')
+                        trailer_block_.push_back('\r');
+                    chunk_state_ = ChunkState::TrailerStart;
+                }
+                trailer_block_.push_back(c);
+                if (trailer_block_.size() > kMaxHeadBytes)
+                    throw std::runtime_error("Chunked trailers too large");
+                ++i;
+                break;
+            case ChunkState::TrailerEndLF:
+                if (c != '\n')
+                    throw std::runtime_error("Invalid end of chunked body");
+                finish_trailers();
+                ++i;
+                break;
+            }
+        }
+        return i;
+    }
+
+    void HttpResponseParser::on_eof(Listener *listener)
+    {
+        if (complete_)
+            return;
+        if (head_complete_ && body_mode_ == BodyMode::UntilClose)
+        {
+            complete_ = true;
+            if (listener)
+                listener->on_complete(*this);
+            return;
+        }
+        throw std::runtime_error(head_complete_ ? "Origin closed the connection mid-body"
+                                                : "Invalid HTTP response (no header-body split)");
+    }
+}
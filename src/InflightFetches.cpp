@@ -0,0 +1,67 @@
+#include "../include/proxy/InflightFetches.hpp"
+#include <condition_variable>
+#include <memory>
+
+namespace proxy
+{
+    bool InflightFetches::join(const std::string &key, Waiter waiter)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = inflight_.find(key);
+        if (it == inflight_.end())
+        {
+            inflight_.emplace(key, std::vector<Waiter>());
+            return true;
+        }
+        it->second.push_back(std::move(waiter));
+        collapsed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    InflightFetches::Join InflightFetches::join_and_wait(const std::string &key, std::chrono::milliseconds timeout)
+    {
+        // Shared with the waiter, which may run after this call gave up waiting
+        struct Signal
+        {
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool done = false;
+        };
+        auto signal = std::make_shared<Signal>();
+        bool leader = join(key, [signal]()
+                           {
+            std::lock_guard<std::mutex> lock(signal->mutex);
+            signal->done = true;
+            signal->cv.notify_all(); });
+        if (leader)
+            return Join::Leader;
+
+        std::unique_lock<std::mutex> lock(signal->mutex);
+        return signal->cv.wait_for(lock, timeout, [&]
+                                   { return signal->done; })
+                   ? Join::Finished
+                   : Join::TimedOut;
+    }
+
+    void InflightFetches::finish(const std::string &key)
+    {
+        std::vector<Waiter> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = inflight_.find(key);
+            if (it == inflight_.end())
+                return;
+            waiters = std::move(it->second);
+            inflight_.erase(it);
+        }
+        for (auto &waiter : waiters)
+            waiter();
+    }
+
+    size_t InflightFetches::size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return inflight_.size();
+    }
+
+} // namespace proxy
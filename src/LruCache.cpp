@@ -1,67 +1,70 @@
 #include "../include/proxy/LruCache.hpp"
-#include "../include/proxy/HttpProxy.hpp"
+#include "../include/proxy/CachedResponse.hpp"
+#include <utility>
 
 namespace Cache
 {
     template <typename Key, typename Value>
-    LruCache<Key, Value>::LruCache(size_t capacity) : capacity_(capacity)
+    LruCache<Key, Value>::LruCache(size_t capacity, Weigher weigher, double max_entry_fraction)
+        : WeightBudget<Key, Value>("LruCache", capacity, std::move(weigher), max_entry_fraction)
     {
-        if (capacity == 0)
-        {
-            throw std::invalid_argument("LRU Cache Capacity must be greater than 0.");
-        }
     }
 
     template <typename Key, typename Value>
-    void LruCache<Key, Value>::put(const Key &key, const Value &value)
+    bool LruCache<Key, Value>::put(const Key &key, const Value &value)
     {
-        if (capacity_ == 0)
+        size_t weight = this->weigh(key, value);
+        auto it = cache_map_.find(key);
+        if (this->too_heavy(weight))
         {
-            return;
+            if (it != cache_map_.end())
+            {
+                weight_ -= it->second->weight;
+                usage_list_.erase(it->second);
+                cache_map_.erase(it);
+            }
+            return false;
         }
 
-        auto it = cache_map_.find(key);
         // Key already exists in cache: Cache hit
         if (it != cache_map_.end())
         {
+            weight_ = weight_ - it->second->weight + weight;
             it->second->value = value;
+            it->second->weight = weight;
             usage_list_.splice(usage_list_.begin(), usage_list_, it->second);
         }
         else
         {
-            if (usage_list_.size() >= capacity_)
-            {
-                if (!usage_list_.empty())
-                {
-                    const CacheItem &lru_item = usage_list_.back();
-                    cache_map_.erase(lru_item.key);
-                    usage_list_.pop_back(); // Remove from list
-                }
-            }
             // Add the new item to the front of the usage_list_ (MRU)
-            usage_list_.emplace_front(CacheItem{key, value}); // Construct CacheItem in place
+            usage_list_.emplace_front(CacheItem{key, value, weight}); // Construct CacheItem in place
 
             // Add the new key and an iterator to its position in usage_list_ to the cache_map_
             cache_map_[key] = usage_list_.begin();
+            weight_ += weight;
+        }
+
+        // Evict from the LRU end until everything fits
+        while (weight_ > this->capacity())
+        {
+            const CacheItem &lru_item = usage_list_.back();
+            weight_ -= lru_item.weight;
+            cache_map_.erase(lru_item.key);
+            usage_list_.pop_back(); // Remove from list
         }
+        this->note_weight(weight_);
+        return true;
     }
 
     template <typename Key, typename Value>
     bool LruCache<Key, Value>::contains(const Key &key) const
     {
-        // if (capacity_ == 0) {
-        //     return false;
-        // }
         return cache_map_.count(key) > 0;
     }
 
     template <typename Key, typename Value>
     std::optional<Value> LruCache<Key, Value>::get(const Key &key)
     {
-        if (capacity_ == 0)
-        {
-            return std::nullopt;
-        }
         auto map_iterator = cache_map_.find(key);
         if (map_iterator == cache_map_.end())
         {
@@ -76,11 +79,21 @@ namespace Cache
     {
         return usage_list_.size();
     }
+
     template <typename Key, typename Value>
-    size_t LruCache<Key, Value>::capacity() const
+    size_t LruCache<Key, Value>::weight() const
     {
+        return weight_;
+    }
 
-        return capacity_;
+    template <typename Key, typename Value>
+    std::vector<std::pair<Key, Value>> LruCache<Key, Value>::entries() const
+    {
+        std::vector<std::pair<Key, Value>> out;
+        out.reserve(usage_list_.size());
+        for (const CacheItem &item : usage_list_)
+            out.emplace_back(item.key, item.value);
+        return out;
     }
 
     template <typename Key, typename Value>
@@ -88,9 +101,10 @@ namespace Cache
     {
         usage_list_.clear();
         cache_map_.clear();
+        weight_ = 0;
     }
 }
 
 template class Cache::LruCache<std::string, std::string>;
 template class Cache::LruCache<int, int>;
-template class Cache::LruCache<std::string, proxy::HttpProxy::ResponseCacheEntry>;
\ No newline at end of file
+template class Cache::LruCache<std::string, proxy::CachedResponsePtr>;
\ No newline at end of file
@@ -0,0 +1,1258 @@
+#include "../include/proxy/HttpProxy.hpp"
+#include "../include/proxy/EventLoop.hpp"
+#include "../include/proxy/SocketUtils.hpp"
+#include "../include/proxy/HttpParser.hpp"
+#include "../include/proxy/Resolver.hpp"
+#include "../include/proxy/HttpResponseParser.hpp"
+#include "../include/proxy/ByteRange.hpp"
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <unistd.h> // close()
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace proxy;
+
+void log_error(const std::string &msg); // HttpProxy.cpp
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/**
+ * @brief Event-loop front end: one thread, many connections.
+ *
+ * Each client connection walks through
+ *   ReadHeaders -> Resolving -> Connecting -> Relaying
+ * (cache hits jump straight from ReadHeaders to Writing; a miss for a key another
+ * connection is already fetching waits in Collapsed, then is served from the cache or
+ * fetches on its own). Once a response is fully
+ * sent on a keep-alive connection it goes back to ReadHeaders for the next request;
+ * pipelined requests already buffered are served in order, one at a time. While relaying, origin
+ * bytes are forwarded as they arrive through a bounded output buffer; the origin
+ * is paused whenever a slow client falls kMaxPendingOutput bytes behind, and the client is
+ * dropped if it accepts nothing for kWriteStallTimeout. All socket I/O is
+ * non-blocking; getaddrinfo() and MPD parsing run on the proxy's thread pool and
+ * report back through EventLoop::post(). Handlers capture the connection id, not
+ * a pointer, so late completions for an already closed connection are dropped.
+ */
+class HttpProxy::Reactor
+{
+public:
+    Reactor(HttpProxy &proxy, WorkerShard shard, net::EventLoop &loop, int listen_fd)
+        : proxy_(proxy), shard_(shard), loop_(loop), listen_fd_(listen_fd)
+    {
+        loop_.add(listen_fd_, net::EventLoop::kReadable, [this](uint32_t)
+                  { on_accept(); });
+    }
+
+    ~Reactor()
+    {
+        while (!connections_.empty())
+            close_connection(connections_.begin()->first);
+        loop_.remove(listen_fd_);
+    }
+
+private:
+    enum class State
+    {
+        ReadHeaders, // collecting the request head from the client
+        Collapsed,   // waiting for another connection's origin fetch of the same cache key
+        Resolving,   // DNS lookup running on the thread pool
+        Connecting,  // non-blocking connects to the origin's addresses racing (Happy Eyeballs)
+        Relaying,    // sending the request, then streaming the origin response to the client
+        Writing,     // flushing a locally built response (cache hit, 304 reuse)
+        Tunneling    // CONNECT: splicing bytes both ways between client and origin
+    };
+
+    struct Connection
+    {
+        uint64_t id = 0;
+        int client_fd = -1;
+        int origin_fd = -1;
+        State state = State::ReadHeaders;
+        RequestKind kind = RequestKind::Other;
+
+        std::string in_buf; // raw request bytes from the client not yet handled
+        RequestHeadParser head{kRequestLimits}; // resumes on in_buf as bytes arrive
+        size_t served = 0;  // requests completed on this connection
+        bool keep_alive = false; // keep the connection open after the current response
+        net::EventLoop::TimerId idle_timer = 0;   // armed while waiting for the next request
+        net::EventLoop::TimerId header_timer = 0; // kHeaderReadTimeout from the first byte of a head
+        net::EventLoop::TimerId write_timer = 0;  // armed while the client is not taking bytes
+        HttpRequest req;
+        std::string cache_key;
+        CachedResponsePtr stale; // set while revalidating an expired entry
+        ClientConditions conditions; // validators and Range: answered from the full object (see begin_reply)
+        bool reply_fill = false;     // fetching the full object to answer `conditions` from; nothing relayed
+        bool inflight_leader = false;                // others wait on this fetch (shard_.inflight)
+        net::EventLoop::TimerId collapse_timer = 0;  // kCollapsedWaitTimeout while Collapsed
+
+        std::string origin_request; // bytes to send upstream
+        size_t origin_written = 0;
+        std::vector<std::string> origin_ips; // resolved addresses, in preference order
+        std::unique_ptr<net::ConnectRace> race; // while Connecting
+        net::EventLoop::TimerId attempt_timer = 0; // next address joins the race
+        net::EventLoop::TimerId connect_timer = 0; // kConnectTimeout for the whole race
+        std::string origin_ip; // address actually connected to
+        bool origin_reused = false; // connection came from the upstream pool
+        bool origin_retried = false;
+        HttpResponseParser parser;  // frames the origin response
+        bool origin_in_sync = true; // no bytes past the end of the response
+        std::optional<ResponseCacheEntry> fill_entry; // cacheable response being relayed (head only)
+        std::optional<std::vector<char>> fill;        // body copy kept while relaying (cache fill / manifest)
+        size_t relayed_bytes = 0;
+        bool origin_eof = false;
+        bool origin_paused = false; // backpressure: client has kMaxPendingOutput unsent bytes
+        std::chrono::steady_clock::time_point fetch_started;
+
+        std::string out_buf; // bytes to send to the client
+        size_t out_written = 0;
+
+        // Cached response being sent: its head block and body pieces (held even if the cache evicts
+        // the entry meanwhile, never copied), with the per-hit headers in between
+        std::optional<CachedReply> reply;
+        std::string reply_extra;
+        size_t reply_sent = 0;
+        uint32_t client_events = net::EventLoop::kReadable;
+
+        bool tunnel = false; // CONNECT request
+        std::unique_ptr<net::SpliceRelay> upstream;   // client -> origin
+        std::unique_ptr<net::SpliceRelay> downstream; // origin -> client
+        bool upstream_done = false;
+        bool downstream_done = false;
+    };
+
+    // Stop reading the origin while this many bytes wait for a slow client
+    static constexpr size_t kMaxPendingOutput = 4 * kRelayBufferSize;
+
+    static size_t pending_output(const Connection &c) { return c.out_buf.size() - c.out_written; }
+
+    void set_client_events(Connection &c, uint32_t events)
+    {
+        if (c.client_events != events)
+        {
+            loop_.modify(c.client_fd, events);
+            c.client_events = events;
+        }
+    }
+
+    Connection *find(uint64_t id)
+    {
+        auto it = connections_.find(id);
+        return it == connections_.end() ? nullptr : it->second.get();
+    }
+
+    void on_accept()
+    {
+        while (true)
+        {
+            int client_fd;
+            try
+            {
+                client_fd = net::accept_nonblocking(listen_fd_);
+            }
+            catch (const std::exception &ex)
+            {
+                std::cerr << "[Reactor] " << ex.what() << std::endl;
+                return;
+            }
+            if (client_fd < 0)
+                return; // backlog drained
+
+            auto conn = std::make_unique<Connection>();
+            conn->id = next_id_++;
+            conn->client_fd = client_fd;
+            uint64_t id = conn->id;
+            Connection &c = *conn;
+            connections_.emplace(id, std::move(conn));
+            loop_.add(client_fd, net::EventLoop::kReadable, [this, id](uint32_t events)
+                      { on_client_event(id, events); });
+            arm_idle_timer(c);
+        }
+    }
+
+    // Close connections that sit between requests for longer than kClientIdleTimeout
+    void arm_idle_timer(Connection &c)
+    {
+        uint64_t id = c.id;
+        c.idle_timer = loop_.run_after(kClientIdleTimeout, [this, id]()
+                                       {
+            Connection *c = find(id);
+            if (!c)
+                return;
+            c->idle_timer = 0;
+            if (c->state != State::ReadHeaders)
+                return;
+            // A connection that never sent a request is a slow client, not an idle one
+            proxy_.count_close(c->served > 0 ? CloseReason::IdleTimeout : CloseReason::HeaderTimeout);
+            close_connection(id); });
+    }
+
+    // Once a head has started it must be complete within kHeaderReadTimeout (slowloris)
+    void arm_header_timer(Connection &c)
+    {
+        uint64_t id = c.id;
+        c.header_timer = loop_.run_after(kHeaderReadTimeout, [this, id]()
+                                         {
+            Connection *c = find(id);
+            if (!c)
+                return;
+            c->header_timer = 0;
+            if (c->state == State::ReadHeaders)
+                reject_request(*c, kRequestTimeoutResponse, CloseReason::HeaderTimeout); });
+    }
+
+    // Drop a client that stopped reading: no byte accepted for kWriteStallTimeout
+    void arm_write_timer(Connection &c)
+    {
+        uint64_t id = c.id;
+        c.write_timer = loop_.run_after(kWriteStallTimeout, [this, id]()
+                                        {
+            Connection *c = find(id);
+            if (!c)
+                return;
+            c->write_timer = 0;
+            proxy_.count_close(CloseReason::WriteTimeout);
+            close_connection(id); });
+    }
+
+    // The client is blocked on a full socket: (re)start the stall clock if bytes went out since
+    void client_write_blocked(Connection &c, bool progressed)
+    {
+        if (progressed)
+            cancel_timer(c.write_timer);
+        if (c.write_timer == 0)
+            arm_write_timer(c);
+        set_client_events(c, net::EventLoop::kWritable);
+    }
+
+    // Answer a request-head limit violation (best effort, the client may not be reading) and close
+    void reject_request(Connection &c, std::string_view response, CloseReason reason)
+    {
+        proxy_.count_close(reason);
+        send(c.client_fd, response.data(), response.size(), MSG_NOSIGNAL);
+        close_connection(c.id);
+    }
+
+    // Start on the next request if a complete head is buffered. Returns false if `c` may be gone.
+    bool try_next_request(Connection &c)
+    {
+        switch (c.head.feed(c.in_buf))
+        {
+        case RequestHeadParser::Status::Error:
+        {
+            CloseReason reason;
+            std::string_view response = rejected_head_response(c.head.error(), reason);
+            reject_request(c, response, reason);
+            return false;
+        }
+        case RequestHeadParser::Status::Incomplete:
+            if (!c.in_buf.empty() && c.header_timer == 0)
+            {
+                // A head has started: the idle clock gives way to the (shorter) header deadline
+                cancel_timer(c.idle_timer);
+                arm_header_timer(c);
+            }
+            return true;
+        case RequestHeadParser::Status::Complete:
+            break;
+        }
+        cancel_timer(c.idle_timer);
+        cancel_timer(c.header_timer);
+        set_client_events(c, 0); // nothing more to read for this request
+        c.req = HttpParser::parse(c.head);
+        c.in_buf.erase(0, c.head.head_size());
+        on_request(c);
+        return false;
+    }
+
+    // The response went out in full on a keep-alive connection: reset for the next request.
+    void finish_request(Connection &c)
+    {
+        Connection next;
+        next.id = c.id;
+        next.client_fd = c.client_fd;
+        next.in_buf = std::move(c.in_buf);
+        next.served = c.served + 1;
+        next.client_events = c.client_events;
+        next.cache_key = std::move(c.cache_key); // keeps its buffer: the next key is built in place
+        next.cache_key.clear();
+        c = std::move(next);
+
+        arm_idle_timer(c);
+        if (try_next_request(c)) // pipelined request already here?
+            set_client_events(c, net::EventLoop::kReadable);
+    }
+
+    void on_client_event(uint64_t id, uint32_t events)
+    {
+        Connection *c = find(id);
+        if (!c)
+            return;
+
+        if (c->state == State::ReadHeaders && (events & net::EventLoop::kReadable))
+        {
+            char buf[4096];
+            // Read no further than one maximal head; the rest stays in the kernel until this
+            // request is done (or the head turns out to be too large)
+            while (c->in_buf.size() <= kMaxRequestHeadBytes)
+            {
+                ssize_t n = recv(c->client_fd, buf, sizeof(buf), 0);
+                if (n > 0)
+                {
+                    c->in_buf.append(buf, n);
+                    continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    break;
+                if (n < 0 && errno == EINTR)
+                    continue;
+                close_connection(id); // peer closed or hard error before a full request
+                return;
+            }
+            try_next_request(*c);
+            return;
+        }
+        if (c->state == State::Tunneling)
+        {
+            pump_tunnel(*c);
+            return;
+        }
+        if ((c->state == State::Writing || c->state == State::Relaying) && (events & net::EventLoop::kWritable))
+        {
+            flush_client(*c);
+            return;
+        }
+        if (events & net::EventLoop::kError)
+            close_connection(id); // client went away mid-request
+    }
+
+    void on_request(Connection &c)
+    {
+        if (c.req.host.empty())
+        {
+            log_error("Invalid HTTP request: missing Host");
+            close_connection(c.id);
+            return;
+        }
+
+        c.keep_alive = client_wants_keep_alive(c.req) && c.served + 1 < kMaxRequestsPerConnection;
+        c.kind = classify_request(c.req.path);
+        if (c.req.method == "CONNECT")
+        {
+            std::cout << "[Reactor] CONNECT tunnel to " << c.req.host << ':' << c.req.port << std::endl;
+            c.tunnel = true;
+        }
+        else if (c.kind == RequestKind::Manifest)
+        {
+            std::cout << "[Reactor] Received MPD request: " << c.req.path << std::endl;
+            c.origin_request = build_origin_request(c.req);
+        }
+        else if (c.kind == RequestKind::Segment)
+        {
+            HttpRequest rep_req = c.req;
+            if (proxy_.rewrite_segment_request(rep_req))
+                c.origin_request = build_origin_request(rep_req);
+            else
+                c.kind = RequestKind::Other; // no MPD seen yet: forward as normal
+        }
+
+        if (c.kind == RequestKind::Other && !c.tunnel && c.req.method != "GET")
+        {
+            c.origin_request = build_origin_request(c.req); // not cacheable: plain relay
+        }
+        else if (c.kind == RequestKind::Other && !c.tunnel)
+        {
+            // The full object is what gets fetched and cached; conditions are answered from it
+            c.conditions = take_client_conditions(c.req.headers);
+            c.cache_key.assign(c.req.host).append(c.req.path);
+            if (serve_from_cache(c, true))
+                return;
+        }
+        start_fetch(c);
+    }
+
+    // Answer a cacheable GET from the cache, or park it behind an in-flight fetch of the same key
+    // (collapsed forwarding). Returns false if `c` must go to the origin itself; origin_request
+    // is then set up (conditional if a stale entry can be revalidated).
+    bool serve_from_cache(Connection &c, bool may_collapse)
+    {
+        CachedResponsePtr cached = proxy_.cache_lookup(shard_.cache, c.cache_key);
+        Freshness freshness = cached ? proxy_.freshness(*cached) : Freshness::Expired;
+        if (freshness != Freshness::Expired)
+        {
+            // Fresh, or stale within stale-while-revalidate: the refresh runs on the revalidation pool
+            if (freshness != Freshness::Fresh)
+                proxy_.revalidate_in_background(shard_.cache, c.cache_key, c.req, cached);
+            const bool stale = freshness == Freshness::StaleWhileRevalidate;
+            std::cout << "[Reactor] Cache " << (stale ? "STALE" : "HIT") << ": " << c.cache_key << std::endl;
+            const char *x_cache = stale ? "STALE" : cached->body ? "HIT" : "HIT-DISK";
+            begin_reply(c, std::move(cached), x_cache);
+            return true;
+        }
+        if (may_collapse)
+        {
+            uint64_t id = c.id;
+            size_t served = c.served; // tells a late wake-up from one for the current request
+            bool leader = shard_.inflight.join(c.cache_key, [this, id, served]()
+                                               { loop_.post([this, id, served]()
+                                                            { on_collapsed_wakeup(id, served, true); }); });
+            if (!leader)
+            {
+                std::cout << "[Reactor] Waiting for in-flight fetch: " << c.cache_key << std::endl;
+                c.state = State::Collapsed;
+                c.collapse_timer = loop_.run_after(kCollapsedWaitTimeout, [this, id, served]()
+                                                   { on_collapsed_wakeup(id, served, false); });
+                return true;
+            }
+            c.inflight_leader = true;
+        }
+        if (cached)
+        {
+            std::cout << "[Reactor] Cache EXPIRED: validating with conditional request: " << c.cache_key << std::endl;
+            if (!cached->etag.empty())
+                c.req.headers.set("If-None-Match", cached->etag);
+            if (!cached->last_modified.empty())
+                c.req.headers.set("If-Modified-Since", cached->last_modified);
+            c.origin_request = build_origin_request(c.req);
+            c.stale = std::move(cached);
+        }
+        else
+        {
+            std::cout << "[Reactor] Cache MISS: " << c.cache_key << std::endl;
+            c.origin_request = build_origin_request(c.req);
+        }
+        return false;
+    }
+
+    // The fetch `c` waited on is over (leader_done) or took longer than kCollapsedWaitTimeout
+    void on_collapsed_wakeup(uint64_t id, size_t served, bool leader_done)
+    {
+        Connection *c = find(id);
+        if (!c || c->state != State::Collapsed || c->served != served)
+            return;
+        if (leader_done)
+        {
+            cancel_timer(c->collapse_timer);
+            CachedResponsePtr cached = proxy_.cache_lookup(shard_.cache, c->cache_key);
+            if (cached && !cached->is_stale())
+            {
+                std::cout << "[Reactor] Cache HIT (collapsed): " << c->cache_key << std::endl;
+                begin_reply(*c, std::move(cached), "COLLAPSED");
+                return;
+            }
+        }
+        else
+        {
+            c->collapse_timer = 0;
+            std::cout << "[Reactor] Collapsed fetch still running, going to origin: " << c->cache_key << std::endl;
+        }
+        // Not cacheable, or too slow: fetch without joining again
+        if (!serve_from_cache(*c, false))
+            start_fetch(*c);
+    }
+
+    // The waiters on this connection's fetch may look at the cache now
+    void release_inflight(Connection &c)
+    {
+        if (!c.inflight_leader)
+            return;
+        c.inflight_leader = false;
+        shard_.inflight.finish(c.cache_key);
+    }
+
+    // stale-if-error: revalidating c.stale failed before any of the origin's response went to the
+    // client. Serves the stale entry if it is still within its window; false if it is not.
+    bool serve_stale_on_error(Connection &c)
+    {
+        if (!c.stale || c.relayed_bytes > 0 || !usable_if_error(*c.stale, proxy_.stale_policy_, std::chrono::steady_clock::now()))
+            return false;
+        std::cout << "[Reactor] Origin failed, serving stale: " << c.cache_key << std::endl;
+        c.origin_in_sync = false;
+        release_origin(c);
+        release_inflight(c);
+        CachedResponsePtr stale = std::move(c.stale);
+        begin_reply(c, std::move(stale), "STALE-IF-ERROR");
+        return true;
+    }
+
+    void start_fetch(Connection &c)
+    {
+        c.parser = HttpResponseParser(c.req.method == "HEAD");
+
+        // getaddrinfo() blocks, so it runs on the pool and reports back to the loop.
+        c.state = State::Resolving;
+        uint64_t id = c.id;
+        std::string host = c.req.host;
+        unsigned short port = c.req.port;
+        shard_.helpers.enqueue([this, id, host, port]()
+                                    {
+            std::vector<std::string> ips;
+            std::string error;
+            try {
+                ips = Resolver::instance().resolve_all(host, port);
+            } catch (const std::exception &ex) {
+                error = ex.what();
+            }
+            loop_.post([this, id, ips, error]() { on_resolved(id, ips, error); }); });
+    }
+
+    void on_resolved(uint64_t id, const std::vector<std::string> &ips, const std::string &error)
+    {
+        Connection *c = find(id);
+        if (!c)
+            return;
+        if (!error.empty())
+        {
+            log_error("[Reactor] " + error);
+            if (!serve_stale_on_error(*c))
+                close_connection(id);
+            return;
+        }
+        c->origin_ips = ips;
+
+        // Plain requests may reuse an idle keep-alive connection; tunnels always get their own.
+        int pooled = -1;
+        for (size_t i = 0; !c->tunnel && pooled < 0 && i < ips.size(); ++i)
+        {
+            pooled = shard_.upstream_pool.take_idle(ips[i], c->req.port);
+            c->origin_ip = ips[i];
+        }
+        if (pooled >= 0)
+        {
+            net::set_nonblocking(pooled);
+            c->origin_reused = true;
+            on_origin_connected(*c, pooled);
+        }
+        else
+        {
+            start_connect(*c);
+        }
+    }
+
+    // Race the resolved addresses; the first to connect becomes the origin connection.
+    void start_connect(Connection &c)
+    {
+        c.race = std::make_unique<net::ConnectRace>(c.origin_ips, c.req.port);
+        c.state = State::Connecting;
+        uint64_t id = c.id;
+        c.connect_timer = loop_.run_after(kConnectTimeout, [this, id]()
+                                          {
+            Connection *c = find(id);
+            if (!c)
+                return;
+            c->connect_timer = 0;
+            if (c->race)
+                connect_failed(*c, true); });
+        launch_attempt(c);
+    }
+
+    void launch_attempt(Connection &c)
+    {
+        cancel_timer(c.attempt_timer);
+        uint64_t id = c.id;
+        int fd = c.race->launch_next();
+        if (fd >= 0)
+            loop_.add(fd, net::EventLoop::kWritable, [this, id, fd](uint32_t)
+                      { on_attempt_event(id, fd); });
+        if (c.race->failed())
+        {
+            connect_failed(c, false);
+            return;
+        }
+        if (!c.race->exhausted())
+            c.attempt_timer = loop_.run_after(net::ConnectRace::kAttemptDelay, [this, id]()
+                                              {
+                Connection *c = find(id);
+                if (!c)
+                    return;
+                c->attempt_timer = 0;
+                if (c->race)
+                    launch_attempt(*c); });
+    }
+
+    void on_attempt_event(uint64_t id, int fd)
+    {
+        Connection *c = find(id);
+        if (!c || !c->race)
+            return;
+        loop_.remove(fd);
+        if (!c->race->complete(fd))
+        {
+            // This address failed: the next one goes now instead of after the delay
+            if (c->race->failed())
+                connect_failed(*c, false);
+            else if (!c->race->exhausted())
+                launch_attempt(*c);
+            return;
+        }
+        c->origin_ip = c->race->winner_ip();
+        end_race(*c, false);
+        on_origin_connected(*c, fd);
+    }
+
+    // Close the attempts still racing and feed the results to the address health memory
+    void end_race(Connection &c, bool timed_out)
+    {
+        for (int fd : c.race->pending())
+            loop_.remove(fd);
+        c.race->cancel_pending(timed_out);
+        Resolver::instance().record(c.race->outcomes());
+        c.race.reset();
+        cancel_timer(c.attempt_timer);
+        cancel_timer(c.connect_timer);
+    }
+
+    void connect_failed(Connection &c, bool timed_out)
+    {
+        for (int fd : c.race->pending())
+            loop_.remove(fd);
+        c.race->cancel_pending(timed_out); // so the message lists the attempts that timed out
+        std::string reason = c.race->failure_message();
+        end_race(c, timed_out);
+        log_error("[Reactor] " + std::string(timed_out ? "connect timed out for " : "connect failed for ") +
+                  c.req.host + ": " + reason);
+        if (!serve_stale_on_error(c))
+            close_connection(c.id);
+    }
+
+    void on_origin_connected(Connection &c, int fd)
+    {
+        uint64_t id = c.id;
+        c.origin_fd = fd;
+        std::cout << "[Reactor] " << c.req.method << ' ' << c.req.host << c.req.path
+                  << "  -->  " << c.origin_ip << ':' << c.req.port << (c.origin_reused ? " (reused)" : "") << '\n';
+        loop_.add(c.origin_fd, c.tunnel ? 0 : net::EventLoop::kWritable, [this, id](uint32_t events)
+                  { on_origin_event(id, events); });
+        if (c.tunnel)
+        {
+            start_tunnel(c);
+            return;
+        }
+        c.state = State::Relaying;
+        c.fetch_started = std::chrono::steady_clock::now();
+    }
+
+    void cancel_timer(net::EventLoop::TimerId &timer)
+    {
+        if (timer != 0)
+        {
+            loop_.cancel_timer(timer);
+            timer = 0;
+        }
+    }
+
+    // A pooled connection may have been closed by the origin just before we used it.
+    // If nothing of the response arrived yet, start over once on a fresh connection.
+    bool retry_on_fresh_connection(Connection &c)
+    {
+        if (!c.origin_reused || c.origin_retried || !c.parser.head().empty())
+            return false;
+        loop_.remove(c.origin_fd);
+        ::close(c.origin_fd);
+        c.origin_fd = -1;
+        c.origin_reused = false;
+        c.origin_retried = true;
+        c.origin_written = 0;
+        c.parser = HttpResponseParser(c.req.method == "HEAD");
+        start_connect(c);
+        return true;
+    }
+
+    // Give the origin connection back to the pool if the exchange left it reusable, else close it.
+    void release_origin(Connection &c)
+    {
+        if (c.origin_fd < 0)
+            return;
+        loop_.remove(c.origin_fd);
+        if (c.parser.complete() && c.parser.keep_alive() && c.origin_in_sync)
+            shard_.upstream_pool.put_idle(c.origin_ip, c.req.port, c.origin_fd);
+        else
+            ::close(c.origin_fd);
+        c.origin_fd = -1;
+    }
+
+    void on_origin_event(uint64_t id, uint32_t events)
+    {
+        Connection *c = find(id);
+        if (!c)
+            return;
+
+        if (c->state == State::Tunneling)
+        {
+            pump_tunnel(*c);
+            return;
+        }
+        if (c->state != State::Relaying)
+            return;
+
+        if (c->origin_written < c->origin_request.size())
+        {
+            while (c->origin_written < c->origin_request.size())
+            {
+                ssize_t n = send(c->origin_fd, c->origin_request.data() + c->origin_written,
+                                 c->origin_request.size() - c->origin_written, MSG_NOSIGNAL);
+                if (n > 0)
+                {
+                    c->origin_written += n;
+                    continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    return; // wait for the next writable event
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (!retry_on_fresh_connection(*c) && !serve_stale_on_error(*c))
+                    close_connection(id);
+                return;
+            }
+            loop_.modify(c->origin_fd, net::EventLoop::kReadable);
+            return;
+        }
+
+        if (events & (net::EventLoop::kReadable | net::EventLoop::kError))
+        {
+            char buf[kRelayBufferSize];
+            while (pending_output(*c) < kMaxPendingOutput)
+            {
+                ssize_t n = recv(c->origin_fd, buf, sizeof(buf), 0);
+                if (n > 0)
+                {
+                    if (!on_origin_data(*c, buf, static_cast<size_t>(n)))
+                        return; // connection was closed or switched to a cached reply
+                    continue;
+                }
+                if (n == 0)
+                {
+                    if (retry_on_fresh_connection(*c))
+                        return;
+                    try
+                    {
+                        c->parser.on_eof(); // completes close-delimited bodies
+                    }
+                    catch (const std::exception &ex)
+                    {
+                        log_error(std::string("[Reactor] ") + ex.what() + ": " + c->req.host);
+                        if (!serve_stale_on_error(*c))
+                            close_connection(id);
+                        return;
+                    }
+                    on_origin_complete(*c);
+                    return;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                if (errno == EINTR)
+                    continue;
+                if (!retry_on_fresh_connection(*c) && !serve_stale_on_error(*c))
+                    close_connection(id);
+                return;
+            }
+            if (pending_output(*c) >= kMaxPendingOutput)
+            {
+                // Backpressure: park the origin until the client drains its buffer.
+                loop_.modify(c->origin_fd, 0);
+                c->origin_paused = true;
+            }
+            flush_client(*c);
+        }
+    }
+
+    // Handle bytes from the origin. Returns false if the caller must stop touching `c`.
+    bool on_origin_data(Connection &c, const char *data, size_t len)
+    {
+        try
+        {
+            if (!c.parser.head_complete())
+            {
+                size_t used = c.parser.parse_head(data, len);
+                if (!c.parser.head_complete())
+                    return true;
+                data += used;
+                len -= used;
+
+                if (c.stale && c.parser.status_code() == 304)
+                {
+                    std::cout << "[Reactor] Server returned 304: reusing cached response.\n";
+                    c.origin_in_sync = len == 0;
+                    release_origin(c);
+                    CachedResponsePtr refreshed = refresh_cache_entry(*c.stale, c.parser);
+                    shard_.cache.put(c.cache_key, refreshed);
+                    release_inflight(c);
+                    begin_reply(c, std::move(refreshed), "REVALIDATED");
+                    return false;
+                }
+                if (c.parser.status_code() >= 500 && serve_stale_on_error(c))
+                    return false;
+                if (c.kind == RequestKind::Other && c.req.method == "GET")
+                {
+                    const bool fits = c.parser.content_length().value_or(0) <= proxy_.cache_fill_limit(shard_.cache);
+                    if (!c.conditions.empty() && c.parser.status_code() == 200 && c.parser.content_length())
+                    {
+                        if (!fits)
+                        {
+                            refetch_with_conditions(c);
+                            return false;
+                        }
+                        c.reply_fill = true;
+                    }
+                    if (HttpProxy::cacheable_status(c.parser.status_code()))
+                    {
+                        c.fill_entry = parse_response_head(c.parser);
+                        c.fill.emplace();
+                    }
+                    if (!fits)
+                        release_inflight(c); // will not be cached: no point in making others wait
+                }
+                else if (c.kind == RequestKind::Manifest)
+                {
+                    c.fill.emplace(); // only the body is needed, for the DASH engine
+                }
+                if (!c.reply_fill)
+                {
+                    c.keep_alive = c.keep_alive && !c.parser.close_delimited();
+                    c.out_buf += client_response_head(c.parser.head(), c.keep_alive);
+                    c.relayed_bytes += c.parser.head().size();
+                }
+            }
+
+            size_t used = c.parser.parse_body(data, len);
+            c.origin_in_sync = c.origin_in_sync && used == len;
+            if (!c.reply_fill)
+            {
+                c.out_buf.append(data, used);
+                c.relayed_bytes += used;
+            }
+            if (c.fill)
+            {
+                size_t limit = c.fill_entry ? proxy_.cache_fill_limit(shard_.cache) : kMaxCacheFillBytes;
+                if (c.fill->size() + used > limit)
+                {
+                    c.fill.reset(); // too large to cache: keep relaying, drop the copy
+                    release_inflight(c);
+                }
+                else
+                    c.fill->insert(c.fill->end(), data, data + used);
+            }
+        }
+        catch (const std::exception &ex)
+        {
+            log_error(std::string("[Reactor] ") + ex.what() + ": " + c.req.host);
+            if (!serve_stale_on_error(c))
+                close_connection(c.id);
+            return false;
+        }
+
+        if (c.parser.complete())
+        {
+            on_origin_complete(c);
+            return false;
+        }
+        return true;
+    }
+
+    void on_origin_complete(Connection &c)
+    {
+        release_origin(c);
+        c.origin_eof = true;
+        CachedResponsePtr reply_source; // the full object the client's conditions are answered from
+
+        switch (c.kind)
+        {
+        case RequestKind::Manifest:
+            if (c.fill)
+            {
+                // MPD parsing is CPU work: hand it to the pool, keep the loop responsive.
+                std::string mpd_xml(c.fill->begin(), c.fill->end());
+                shard_.helpers.enqueue([this, mpd_xml]()
+                                            { proxy_.update_dash_engine(mpd_xml); });
+            }
+            break;
+        case RequestKind::Segment:
+        {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - c.fetch_started).count();
+            proxy_.record_bandwidth_sample(c.relayed_bytes, elapsed);
+            break;
+        }
+        case RequestKind::Other:
+            if (c.fill && c.fill_entry)
+            {
+                c.fill_entry->fetch_time =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - c.fetch_started);
+                seal_cache_entry(*c.fill_entry, std::move(*c.fill));
+                auto sealed = std::make_shared<const ResponseCacheEntry>(std::move(*c.fill_entry));
+                shard_.cache.put(c.cache_key, sealed);
+                if (c.reply_fill)
+                    reply_source = sealed;
+                if (proxy_.disk_cache_)
+                {
+                    // Disk writes block: keep them off the loop
+                    DiskCache *disk = proxy_.disk_cache_.get();
+                    shard_.helpers.enqueue([disk, key = c.cache_key, sealed]()
+                                           { disk->store(key, *sealed); });
+                }
+            }
+            release_inflight(c);
+            break;
+        }
+        c.fill.reset();
+        c.fill_entry.reset();
+        if (c.reply_fill)
+        {
+            if (!reply_source)
+            {
+                close_connection(c.id); // the body outgrew its Content-Length: nothing to cut from
+                return;
+            }
+            std::cout << "[Reactor] Cache MISS, answering the client's conditions from the fetched object: " << c.cache_key << std::endl;
+            begin_reply(c, std::move(reply_source), "MISS");
+            return;
+        }
+        flush_client(c);
+    }
+
+    // A conditional or Range request for an object too large to cache: drop the full response and
+    // let the origin answer the client's conditions itself; its 206 or 304 is relayed, never cached
+    void refetch_with_conditions(Connection &c)
+    {
+        c.origin_in_sync = false;
+        release_origin(c);
+        release_inflight(c);
+        if (c.stale)
+        {
+            c.req.headers.remove("If-None-Match"); // ours; the client's go back on below
+            c.req.headers.remove("If-Modified-Since");
+            c.stale.reset();
+        }
+        restore_client_conditions(c.req.headers, c.conditions);
+        c.conditions = ClientConditions();
+        c.origin_request = build_origin_request(c.req);
+        c.origin_written = 0;
+        c.origin_reused = c.origin_retried = false;
+        c.origin_in_sync = true;
+        start_fetch(c);
+    }
+
+    void begin_reply(Connection &c, CachedResponsePtr entry, const char *x_cache)
+    {
+        c.reply.reset();
+        if (!c.conditions.empty())
+            c.reply = cached_reply(entry, c.conditions);
+        if (!c.reply)
+            c.reply = whole_reply(std::move(entry));
+        c.state = State::Writing;
+        c.reply_extra = cache_hit_headers(*c.reply->source, x_cache, c.keep_alive);
+        c.reply_sent = 0;
+        c.origin_eof = true; // nothing else will be appended
+        flush_client(c);
+    }
+
+    // Push buffered bytes to the client. Closes the connection once the response is
+    // complete and fully sent; resumes a paused origin once the buffer drains.
+    void flush_client(Connection &c)
+    {
+        bool progressed = false;
+        if (c.reply)
+        {
+            const CachedReply &reply = *c.reply;
+            const size_t head = reply.head->size() + c.reply_extra.size();
+            const size_t total = head + reply.body_size();
+            while (c.reply_sent < total)
+            {
+                // The piece reply_sent is in: a file piece goes out with sendfile, a run of head
+                // parts and memory pieces with one writev
+                size_t piece = 0, piece_start = head;
+                if (c.reply_sent >= head)
+                {
+                    while (piece_start + reply.body[piece].length <= c.reply_sent)
+                        piece_start += reply.body[piece++].length;
+                }
+                ssize_t n;
+                if (c.reply_sent >= head && reply.body[piece].from == CachedReply::From::File)
+                {
+                    const size_t skip = c.reply_sent - piece_start;
+                    n = net::send_file(c.client_fd, reply.source->file_body.file->fd(), reply.body[piece].offset + skip,
+                                       reply.body[piece].length - skip);
+                }
+                else
+                {
+                    constexpr size_t kMaxParts = 8;
+                    std::string_view parts[kMaxParts];
+                    size_t count = 0;
+                    if (c.reply_sent < head)
+                    {
+                        parts[count++] = *reply.head;
+                        parts[count++] = c.reply_extra;
+                    }
+                    for (; piece < reply.body.size() && count < kMaxParts && reply.body[piece].from != CachedReply::From::File; ++piece)
+                        parts[count++] = reply.bytes(reply.body[piece]);
+                    n = net::write_parts(c.client_fd, parts, count, c.reply_sent < head ? c.reply_sent : c.reply_sent - piece_start);
+                }
+                if (n > 0)
+                {
+                    c.reply_sent += n;
+                    progressed = true;
+                    continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                {
+                    client_write_blocked(c, progressed);
+                    return;
+                }
+                if (n < 0 && errno == EINTR)
+                    continue;
+                close_connection(c.id);
+                return;
+            }
+            c.reply.reset();
+        }
+
+        while (c.out_written < c.out_buf.size())
+        {
+            ssize_t n = send(c.client_fd, c.out_buf.data() + c.out_written,
+                             c.out_buf.size() - c.out_written, MSG_NOSIGNAL);
+            if (n > 0)
+            {
+                c.out_written += n;
+                progressed = true;
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                client_write_blocked(c, progressed); // resume on the next writable event
+                return;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            close_connection(c.id);
+            return;
+        }
+        c.out_buf.clear();
+        c.out_written = 0;
+        cancel_timer(c.write_timer);
+
+        if (c.origin_eof)
+        {
+            if (c.keep_alive)
+                finish_request(c);
+            else
+                close_connection(c.id);
+            return;
+        }
+        set_client_events(c, 0);
+        if (c.origin_paused)
+        {
+            c.origin_paused = false;
+            loop_.modify(c.origin_fd, net::EventLoop::kReadable);
+        }
+    }
+
+    void start_tunnel(Connection &c)
+    {
+        static const std::string established = "HTTP/1.1 200 Connection Established\r\n\r\n";
+        // Anything the client sent after the CONNECT head (e.g. an eager TLS ClientHello)
+        std::string early = std::move(c.in_buf);
+
+        // Both writes are tiny and go to fresh sockets, so a short write means trouble.
+        if (send(c.client_fd, established.data(), established.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(established.size()) ||
+            (!early.empty() && send(c.origin_fd, early.data(), early.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(early.size())))
+        {
+            close_connection(c.id);
+            return;
+        }
+        try
+        {
+            c.upstream = std::make_unique<net::SpliceRelay>();
+            c.downstream = std::make_unique<net::SpliceRelay>();
+        }
+        catch (const std::exception &ex)
+        {
+            log_error(std::string("[Reactor] ") + ex.what());
+            close_connection(c.id);
+            return;
+        }
+        c.in_buf.clear();
+        c.state = State::Tunneling;
+        pump_tunnel(c);
+    }
+
+    void pump_tunnel(Connection &c)
+    {
+        try
+        {
+            if (!c.upstream_done && c.upstream->pump(c.client_fd, c.origin_fd))
+            {
+                c.upstream_done = true;
+                shutdown(c.origin_fd, SHUT_WR); // propagate the half-close
+            }
+            if (!c.downstream_done && c.downstream->pump(c.origin_fd, c.client_fd))
+            {
+                c.downstream_done = true;
+                shutdown(c.client_fd, SHUT_WR);
+            }
+        }
+        catch (const std::exception &)
+        {
+            close_connection(c.id); // reset / broken pipe on either side ends the tunnel
+            return;
+        }
+        if (c.upstream_done && c.downstream_done)
+        {
+            close_connection(c.id);
+            return;
+        }
+        set_client_events(c, (c.upstream->wants_read() ? net::EventLoop::kReadable : 0) |
+                                 (c.downstream->wants_write() ? net::EventLoop::kWritable : 0));
+        loop_.modify(c.origin_fd, (c.downstream->wants_read() ? net::EventLoop::kReadable : 0) |
+                                      (c.upstream->wants_write() ? net::EventLoop::kWritable : 0));
+    }
+
+    void close_connection(uint64_t id)
+    {
+        auto it = connections_.find(id);
+        if (it == connections_.end())
+            return;
+        Connection &c = *it->second;
+        cancel_timer(c.idle_timer);
+        cancel_timer(c.header_timer);
+        cancel_timer(c.write_timer);
+        cancel_timer(c.collapse_timer);
+        release_inflight(c);
+        if (c.race)
+        {
+            for (int fd : c.race->pending())
+                loop_.remove(fd); // the race closes them
+            c.race.reset();
+        }
+        cancel_timer(c.attempt_timer);
+        cancel_timer(c.connect_timer);
+        if (c.origin_fd >= 0)
+        {
+            loop_.remove(c.origin_fd);
+            ::close(c.origin_fd);
+        }
+        loop_.remove(c.client_fd);
+        ::close(c.client_fd);
+        connections_.erase(it);
+    }
+
+    HttpProxy &proxy_;
+    WorkerShard shard_;
+    net::EventLoop &loop_;
+    int listen_fd_;
+    uint64_t next_id_ = 1;
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections_;
+};
+
+// ---------- run_event_loop(): epoll front end ----------
+void HttpProxy::run_event_loop()
+{
+    int listen_fd = net::create_listen_socket(port_);
+    net::set_nonblocking(listen_fd);
+
+    net::EventLoop loop;
+    Reactor reactor(*this, WorkerShard{response_cache_, upstream_pool_, inflight_fetches_, thread_pool_}, loop, listen_fd);
+    std::cout << "[HttpProxy] Event loop listening on 0.0.0.0:" << port_ << std::endl;
+    loop.run();
+    ::close(listen_fd);
+}
+
+// ---------- run_workers(): one reactor per core ----------
+static void pin_current_thread(size_t cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0)
+        log_error("[Worker] pthread_setaffinity_np(" + std::to_string(cpu) + ") failed: " + strerror(rc));
+#else
+    (void)cpu; // no portable affinity API: workers float
+#endif
+}
+
+void HttpProxy::run_workers(size_t workers, bool pin_cpus)
+{
+    size_t cpus = std::max<unsigned>(1, std::thread::hardware_concurrency());
+    if (workers == 0)
+        workers = cpus;
+    // Split the configured byte budget across the shards so total memory stays the same; each
+    // keeps the proxy-wide object size limit, unless that is more than its whole share
+    size_t shard_capacity = std::max<size_t>(1, response_cache_.capacity() / workers);
+    double shard_object_fraction = std::min(1.0, static_cast<double>(response_cache_.max_entry_weight()) / static_cast<double>(shard_capacity));
+
+    // Listeners are created up front so a bind error surfaces here, not in a worker thread
+    std::vector<int> listen_fds;
+    for (size_t i = 0; i < workers; ++i)
+    {
+        int fd = net::create_listen_socket(port_, true);
+        net::set_nonblocking(fd);
+        listen_fds.push_back(fd);
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < workers; ++i)
+    {
+        threads.emplace_back([this, i, cpus, pin_cpus, shard_capacity, shard_object_fraction, listen_fd = listen_fds[i]]()
+                             {
+            if (pin_cpus)
+                pin_current_thread(i % cpus);
+            try {
+                // The loop is declared first so helper tasks can still post to it while draining
+                net::EventLoop loop;
+                // Not only the loop thread's: revalidation pool threads put refreshed entries and
+                // checkpoints read it, so it is a locked ShardedLruCache. One shard, as the loop
+                // thread makes nearly every call and there is little contention to spread.
+                ResponseCache cache(shard_capacity, 1, cache_entry_weight, shard_object_fraction,
+                                    response_cache_.policy());
+                // Listed for save_snapshot() for as long as it exists, and kept until the
+                // revalidations started for it are done
+                struct Listing
+                {
+                    HttpProxy &proxy;
+                    ResponseCache &cache;
+                    Listing(HttpProxy &p, ResponseCache &c) : proxy(p), cache(c)
+                    {
+                        std::lock_guard<std::mutex> lock(proxy.worker_caches_mutex_);
+                        proxy.worker_caches_.push_back(&cache);
+                    }
+                    ~Listing()
+                    {
+                        // The revalidation pool outlives this worker; its tasks hold `cache` by
+                        // reference. The reactor is gone by now, so no new ones are queued.
+                        proxy.wait_for_revalidations(cache);
+                        std::lock_guard<std::mutex> lock(proxy.worker_caches_mutex_);
+                        auto &caches = proxy.worker_caches_;
+                        caches.erase(std::remove(caches.begin(), caches.end(), &cache), caches.end());
+                    }
+                } listing(*this, cache);
+                UpstreamPool upstream_pool;
+                InflightFetches inflight;
+                ThreadPool helpers(1);
+                Reactor reactor(*this, WorkerShard{cache, upstream_pool, inflight, helpers}, loop, listen_fd);
+                loop.run();
+            } catch (const std::exception &ex) {
+                log_error("[Worker " + std::to_string(i) + "] " + ex.what());
+                std::cerr << "[Worker " << i << "] Error: " << ex.what() << std::endl;
+            }
+            ::close(listen_fd); });
+    }
+    std::cout << "[HttpProxy] " << workers << " workers listening on 0.0.0.0:" << port_
+              << (pin_cpus ? " (pinned)" : "") << std::endl;
+    for (auto &t : threads)
+        t.join();
+}
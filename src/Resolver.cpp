@@ -4,6 +4,10 @@
 #include <iostream> // For potential debug/error messages, can be replaced by a logger
 #include <thread>   // For std::this_thread::sleep_for
 #include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 
 // POSIX/Network headers for getaddrinfo
 #include <sys/types.h>
@@ -22,7 +26,6 @@ namespace proxy
     const std::chrono::seconds DEFAULT_POSITIVE_TTL{300};      // 5 minutes
     const std::chrono::seconds DEFAULT_NEGATIVE_TTL{60};       // 1 minute (as per assignment.md)
     const int MAX_DNS_RETRIES = 3;                             // As per assignment.md
-    const std::string FAILURE_IP_MARKER = "DNS_LOOKUP_FAILED"; // Special marker for negative cache
 
     Resolver &Resolver::instance()
     {
@@ -31,14 +34,19 @@ namespace proxy
         return resolver_instance;
     }
 
-    std::string Resolver::query_dns(const std::string &hostname, int port)
+    // Address health tuning: a failing address sits out 2s, 4s, 8s, ... up to 5 minutes
+    const std::chrono::seconds HEALTH_BASE_PENALTY{2};
+    const std::chrono::seconds HEALTH_MAX_PENALTY{300};
+
+    std::vector<std::string> Resolver::query_dns(const std::string &hostname, int port)
     {
         addrinfo hints{};
         addrinfo *result_list = nullptr;
 
         std::memset(&hints, 0, sizeof(hints));
-        hints.ai_family = AF_INET;       // We are interested in IPv4 addresses only
+        hints.ai_family = AF_UNSPEC;     // IPv4 and IPv6
         hints.ai_socktype = SOCK_STREAM; // TCP
+        hints.ai_flags = AI_ADDRCONFIG;  // only families this host can actually use
 
         std::string service_port = std::to_string(port);
 
@@ -54,79 +62,99 @@ namespace proxy
             throw std::runtime_error("getaddrinfo failed for " + hostname + ": " + gai_strerror(gai_error));
         }
 
-        std::string ipv4_address_str;
-        bool found = false;
-
-        // Iterate through the linked list of results
+        // Split by family, keeping getaddrinfo's (RFC 6724) order within each
+        std::vector<std::string> v6, v4;
+        int first_family = 0;
         for (addrinfo *ptr = result_list; ptr != nullptr; ptr = ptr->ai_next)
         {
+            char ip_buffer[INET6_ADDRSTRLEN];
+            const void *src = nullptr;
             if (ptr->ai_family == AF_INET)
-            { // Ensure it's an IPv4 address
-                sockaddr_in *ipv4_sockaddr = reinterpret_cast<sockaddr_in *>(ptr->ai_addr);
-                char ip_buffer[INET_ADDRSTRLEN]; // Buffer to hold the IPv4 string
+                src = &reinterpret_cast<sockaddr_in *>(ptr->ai_addr)->sin_addr;
+            else if (ptr->ai_family == AF_INET6)
+                src = &reinterpret_cast<sockaddr_in6 *>(ptr->ai_addr)->sin6_addr;
+            if (!src || inet_ntop(ptr->ai_family, src, ip_buffer, sizeof(ip_buffer)) == nullptr)
+                continue;
 
-                // Convert the binary IP address to a human-readable string
-                if (inet_ntop(AF_INET, &(ipv4_sockaddr->sin_addr), ip_buffer, INET_ADDRSTRLEN) != nullptr)
-                {
-                    ipv4_address_str = ip_buffer;
-                    found = true;
-                    break; // Found the first IPv4 address, use it
-                }
-                else
-                {
-                    // inet_ntop failed, this is unusual
-                    // perror("inet_ntop failed"); // For debugging
-                }
-            }
+            auto &bucket = ptr->ai_family == AF_INET ? v4 : v6;
+            if (std::find(bucket.begin(), bucket.end(), ip_buffer) == bucket.end())
+                bucket.push_back(ip_buffer);
+            if (first_family == 0)
+                first_family = ptr->ai_family;
         }
 
         freeaddrinfo(result_list); // Always free the memory allocated by getaddrinfo
 
-        if (!found)
+        if (v4.empty() && v6.empty())
         {
-            throw std::runtime_error("No IPv4 address found for " + hostname);
+            throw std::runtime_error("No address found for " + hostname);
         }
 
-        return ipv4_address_str;
+        // Interleave the families, starting with the one getaddrinfo preferred (RFC 8305 section 4)
+        auto &first = first_family == AF_INET ? v4 : v6;
+        auto &second = first_family == AF_INET ? v6 : v4;
+        std::vector<std::string> ordered;
+        for (size_t i = 0; i < std::max(first.size(), second.size()); ++i)
+        {
+            if (i < first.size())
+                ordered.push_back(first[i]);
+            if (i < second.size())
+                ordered.push_back(second[i]);
+        }
+        return ordered;
     }
 
     std::string Resolver::resolve(const std::string &hostname,
                                   int port,
                                   std::chrono::seconds timeout)
+    {
+        // Single-address callers get IPv4 when there is one, as before
+        std::vector<std::string> ips = resolve_all(hostname, port, timeout);
+        for (const auto &ip : ips)
+        {
+            if (ip.find(':') == std::string::npos)
+                return ip;
+        }
+        return ips.front();
+    }
+
+    std::vector<std::string> Resolver::resolve_all(const std::string &hostname,
+                                                   int port,
+                                                   std::chrono::seconds timeout)
     {
         auto deadline = std::chrono::steady_clock::now() + timeout;
 
         // --- 1. Check cache ---
         { // Scope for lock_guard
-            std::lock_guard<std::mutex> lock(cache_mutex_);
-            auto it = cache_.find(hostname);
-            if (it != cache_.end())
+            std::vector<std::string> cached_ips;
             {
-                const CacheEntry &entry = it->second;
-                if (entry.expires_at > std::chrono::steady_clock::now())
+                std::lock_guard<std::mutex> lock(cache_mutex_);
+                auto it = cache_.find(hostname);
+                if (it != cache_.end())
                 {
-                    if (entry.ip != FAILURE_IP_MARKER)
+                    const CacheEntry &entry = it->second;
+                    if (entry.expires_at > std::chrono::steady_clock::now())
                     {
-                        // std::cout << "[Resolver] Cache hit for " << hostname << ": " << entry.ip << std::endl;
-                        return entry.ip; // Positive cache hit
+                        if (entry.ips.empty())
+                        {
+                            // std::cout << "[Resolver] Negative cache hit for " << hostname << std::endl;
+                            throw std::runtime_error("Previously failed to resolve " + hostname + " (cached negative result)");
+                        }
+                        cached_ips = entry.ips; // Positive cache hit
                     }
                     else
                     {
-                        // std::cout << "[Resolver] Negative cache hit for " << hostname << std::endl;
-                        throw std::runtime_error("Previously failed to resolve " + hostname + " (cached negative result)");
+                        // Entry expired, remove it
+                        cache_.erase(it);
                     }
                 }
-                else
-                {
-                    // Entry expired, remove it
-                    // std::cout << "[Resolver] Cache expired for " << hostname << std::endl;
-                    cache_.erase(it);
-                }
-            }
-        } // Mutex is released here
+            } // Mutex is released here
+            if (!cached_ips.empty())
+                return order_by_health(std::move(cached_ips));
+        }
 
         // --- 2. Perform DNS query with retries if not found in cache or expired ---
-        std::string resolved_ip;
+        std::vector<std::string> resolved_ips;
         std::chrono::seconds current_backoff_delay(1); // Initial back-off delay
 
         for (int attempt = 0; attempt < MAX_DNS_RETRIES; ++attempt)
@@ -140,15 +168,14 @@ namespace proxy
             // std::cout << "[Resolver] Attempt " << attempt + 1 << " to resolve " << hostname << std::endl;
             try
             {
-                resolved_ip = query_dns(hostname, port); // This can block
+                resolved_ips = query_dns(hostname, port); // This can block
 
                 // If successful, cache and return
                 { // Scope for lock_guard
                     std::lock_guard<std::mutex> lock(cache_mutex_);
-                    cache_[hostname] = {resolved_ip, std::chrono::steady_clock::now() + DEFAULT_POSITIVE_TTL};
-                    // std::cout << "[Resolver] Resolved and cached " << hostname << " -> " << resolved_ip << std::endl;
+                    cache_[hostname] = {resolved_ips, std::chrono::steady_clock::now() + DEFAULT_POSITIVE_TTL};
                 }
-                return resolved_ip;
+                return order_by_health(std::move(resolved_ips));
             }
             catch (const std::runtime_error &e)
             {
@@ -176,9 +203,134 @@ namespace proxy
         // std::cerr << "[Resolver] Storing negative cache entry for " << hostname << std::endl;
         { // Scope for lock_guard
             std::lock_guard<std::mutex> lock(cache_mutex_);
-            cache_[hostname] = {FAILURE_IP_MARKER, std::chrono::steady_clock::now() + DEFAULT_NEGATIVE_TTL};
+            cache_[hostname] = {{}, std::chrono::steady_clock::now() + DEFAULT_NEGATIVE_TTL};
         }
         throw std::runtime_error("Failed to resolve " + hostname + " after " + std::to_string(MAX_DNS_RETRIES) + " retries or timeout.");
     }
 
+    namespace
+    {
+        const char *const SNAPSHOT_MAGIC = "mini_cdn-dns 1";
+
+        int64_t wall_ms()
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        }
+    }
+
+    size_t Resolver::save_snapshot(const std::string &path)
+    {
+        // One line per name: "<hostname> <expiry, wall-clock ms> <ip> [<ip> ...]"
+        std::ostringstream lines;
+        size_t saved = 0;
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex_);
+            auto now = std::chrono::steady_clock::now();
+            int64_t now_wall = wall_ms();
+            for (const auto &[hostname, entry] : cache_)
+            {
+                if (entry.ips.empty() || entry.expires_at <= now)
+                    continue; // negative entries are short-lived: look again after a restart
+                lines << hostname << ' '
+                      << now_wall + std::chrono::duration_cast<std::chrono::milliseconds>(entry.expires_at - now).count();
+                for (const auto &ip : entry.ips)
+                    lines << ' ' << ip;
+                lines << '\n';
+                ++saved;
+            }
+        }
+
+        const std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            out << SNAPSHOT_MAGIC << '\n'
+                << lines.str();
+            if (!out)
+                throw std::runtime_error("Cannot write resolver snapshot " + tmp);
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0)
+            throw std::runtime_error("Cannot write resolver snapshot " + path);
+        return saved;
+    }
+
+    size_t Resolver::load_snapshot(const std::string &path)
+    {
+        std::ifstream in(path);
+        std::string line;
+        if (!std::getline(in, line) || line != SNAPSHOT_MAGIC)
+            return 0;
+
+        size_t loaded = 0;
+        auto now = std::chrono::steady_clock::now();
+        int64_t now_wall = wall_ms();
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        while (std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            std::string hostname;
+            int64_t expires_wall = 0;
+            CacheEntry entry;
+            if (!(fields >> hostname >> expires_wall) || expires_wall <= now_wall)
+                continue;
+            for (std::string ip; fields >> ip;)
+                entry.ips.push_back(ip);
+            if (entry.ips.empty())
+                continue;
+            entry.expires_at = now + std::chrono::milliseconds(expires_wall - now_wall);
+            if (cache_.emplace(hostname, std::move(entry)).second)
+                ++loaded;
+        }
+        return loaded;
+    }
+
+    std::vector<std::string> Resolver::order_by_health(std::vector<std::string> ips)
+    {
+        std::lock_guard<std::mutex> lock(health_mutex_);
+        auto now = std::chrono::steady_clock::now();
+        auto penalized = [&](const std::string &ip)
+        {
+            auto it = health_.find(ip);
+            return it != health_.end() && it->second.penalized_until > now;
+        };
+        // Stable: addresses without history keep the resolver's (interleaved) order
+        std::stable_sort(ips.begin(), ips.end(), [&](const std::string &a, const std::string &b)
+                         {
+            bool pa = penalized(a), pb = penalized(b);
+            if (pa != pb)
+                return pb; // healthy before penalized
+            auto ia = health_.find(a), ib = health_.find(b);
+            bool ma = ia != health_.end() && ia->second.measured;
+            bool mb = ib != health_.end() && ib->second.measured;
+            if (ma && mb)
+                return ia->second.srtt < ib->second.srtt;
+            return false; });
+        return ips;
+    }
+
+    void Resolver::record(const std::vector<net::ConnectOutcome> &outcomes)
+    {
+        std::lock_guard<std::mutex> lock(health_mutex_);
+        auto now = std::chrono::steady_clock::now();
+        for (const auto &o : outcomes)
+        {
+            AddressHealth &h = health_[o.ip];
+            if (o.error == 0)
+            {
+                // Smoothed like TCP's SRTT: 7/8 history, 1/8 new sample
+                h.srtt = h.measured ? (h.srtt * 7 + o.elapsed) / 8 : o.elapsed;
+                h.measured = true;
+                h.failures = 0;
+                h.penalized_until = {};
+            }
+            else
+            {
+                ++h.failures;
+                auto penalty = HEALTH_BASE_PENALTY * (1u << std::min(h.failures - 1, 8u));
+                h.penalized_until = now + std::min<std::chrono::seconds>(penalty, HEALTH_MAX_PENALTY);
+            }
+        }
+    }
+
 } // namespace proxy
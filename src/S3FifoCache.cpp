@@ -0,0 +1,239 @@
+#include "../include/proxy/S3FifoCache.hpp"
+#include "../include/proxy/CachedResponse.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace Cache
+{
+    template <typename Key, typename Value>
+    S3FifoCache<Key, Value>::S3FifoCache(size_t capacity, Weigher weigher, double max_entry_fraction)
+        : WeightBudget<Key, Value>("S3FifoCache", capacity, std::move(weigher), max_entry_fraction), small_capacity_(std::max<size_t>(1, capacity / 10))
+    {
+    }
+
+    template <typename Key, typename Value>
+    uint32_t S3FifoCache<Key, Value>::find(KeyView<Key> key, uint32_t hash) const
+    {
+        return index_.find(hash, [&](uint32_t slot) { return slots_[slot].key == key; });
+    }
+
+    template <typename Key, typename Value>
+    void S3FifoCache<Key, Value>::erase(uint32_t slot)
+    {
+        Slot &s = slots_[slot];
+        index_.erase(index_.find_slot(SlotIndex::hash_of<KeyView<Key>>(s.key), slot));
+        if (s.queue == Queue::Small)
+        {
+            small_.remove(slots_, slot);
+            small_weight_ -= s.weight;
+        }
+        else
+        {
+            main_.remove(slots_, slot);
+            main_weight_ -= s.weight;
+        }
+        s.key = Key{};
+        s.value = Value{}; // release what the value holds now, not when the slot is reused
+        s.queue = Queue::Free;
+        s.next = free_;
+        free_ = slot;
+    }
+
+    template <typename Key, typename Value>
+    void S3FifoCache<Key, Value>::remember(uint32_t hash)
+    {
+        if (ghost_hashes_.insert(hash).second)
+            ghost_.push_back(hash);
+        while (ghost_.size() > std::max<size_t>(1, index_.size()))
+        {
+            ghost_hashes_.erase(ghost_.front());
+            ghost_.pop_front();
+        }
+    }
+
+    template <typename Key, typename Value>
+    void S3FifoCache<Key, Value>::evict_small()
+    {
+        const uint32_t slot = small_.tail;
+        Slot &s = slots_[slot];
+        if (s.frequency.load(std::memory_order_relaxed) > 0)
+        {
+            small_.remove(slots_, slot);
+            small_weight_ -= s.weight;
+            s.frequency.store(0, std::memory_order_relaxed);
+            s.queue = Queue::Main;
+            main_.push_front(slots_, slot);
+            main_weight_ += s.weight;
+            return;
+        }
+        const uint32_t hash = SlotIndex::hash_of<KeyView<Key>>(s.key);
+        erase(slot);
+        remember(hash);
+    }
+
+    template <typename Key, typename Value>
+    void S3FifoCache<Key, Value>::evict_main()
+    {
+        const uint32_t slot = main_.tail;
+        Slot &s = slots_[slot];
+        const uint8_t frequency = s.frequency.load(std::memory_order_relaxed);
+        if (frequency > 0)
+        {
+            s.frequency.store(static_cast<uint8_t>(frequency - 1), std::memory_order_relaxed);
+            main_.remove(slots_, slot);
+            main_.push_front(slots_, slot);
+            return;
+        }
+        erase(slot);
+    }
+
+    template <typename Key, typename Value>
+    void S3FifoCache<Key, Value>::evict(uint32_t keep)
+    {
+        // One step: a promotion, a reinsertion or an eviction. `keep` is the entry being put and
+        // may sit in either queue, even alone; the weight is over the capacity, so the other
+        // queue then holds something
+        const auto holds_others = [keep](const SlotList &queue)
+        { return !queue.empty() && !(queue.head == keep && queue.tail == keep); };
+        bool small = small_weight_ > small_capacity_ || main_.empty();
+        if (!holds_others(small ? small_ : main_))
+            small = !small;
+        SlotList &queue = small ? small_ : main_;
+        if (queue.tail == keep)
+        {
+            // Step past it: the entries behind it go first
+            queue.remove(slots_, keep);
+            queue.push_front(slots_, keep);
+            return;
+        }
+        if (small)
+            evict_small();
+        else
+            evict_main();
+    }
+
+    template <typename Key, typename Value>
+    bool S3FifoCache<Key, Value>::put(const Key &key, const Value &value)
+    {
+        const size_t entry_weight = this->weigh(key, value);
+        const uint32_t hash = SlotIndex::hash_of<KeyView<Key>>(key);
+        const uint32_t bucket = find(key, hash);
+        if (this->too_heavy(entry_weight))
+        {
+            if (bucket != kNone)
+                erase(index_.slot(bucket));
+            return false;
+        }
+
+        uint32_t slot;
+        if (bucket != kNone)
+        {
+            slot = index_.slot(bucket);
+            Slot &s = slots_[slot];
+            size_t &queue_weight = s.queue == Queue::Small ? small_weight_ : main_weight_;
+            queue_weight = queue_weight - s.weight + entry_weight;
+            s.value = value;
+            s.weight = entry_weight;
+        }
+        else
+        {
+            if (free_ != kNone)
+            {
+                slot = free_;
+                free_ = slots_[slot].next;
+            }
+            else
+            {
+                if (slots_.size() == kNone)
+                    throw std::length_error("S3FifoCache is full");
+                slot = static_cast<uint32_t>(slots_.size());
+                slots_.emplace_back();
+            }
+            Slot &s = slots_[slot];
+            s.key = key;
+            s.value = value;
+            s.weight = entry_weight;
+            s.frequency.store(0, std::memory_order_relaxed);
+            // Evicted from the small FIFO recently and wanted again: it has proven itself
+            if (ghost_hashes_.count(hash))
+            {
+                s.queue = Queue::Main;
+                main_.push_front(slots_, slot);
+                main_weight_ += entry_weight;
+            }
+            else
+            {
+                s.queue = Queue::Small;
+                small_.push_front(slots_, slot);
+                small_weight_ += entry_weight;
+            }
+            index_.insert(hash, slot);
+        }
+
+        while (weight() > this->capacity())
+            evict(slot);
+        this->note_weight(weight());
+        return true;
+    }
+
+    template <typename Key, typename Value>
+    std::optional<Value> S3FifoCache<Key, Value>::get(KeyView<Key> key, size_t *weight)
+    {
+        const uint32_t bucket = find(key, SlotIndex::hash_of(key));
+        if (bucket == kNone)
+            return std::nullopt;
+        Slot &s = slots_[index_.slot(bucket)];
+        // Only store below the cap, so hits on a hot entry leave its cache line shared
+        const uint8_t frequency = s.frequency.load(std::memory_order_relaxed);
+        if (frequency < kMaxFrequency)
+            s.frequency.store(static_cast<uint8_t>(frequency + 1), std::memory_order_relaxed);
+        if (weight)
+            *weight = s.weight;
+        return s.value;
+    }
+
+    template <typename Key, typename Value>
+    bool S3FifoCache<Key, Value>::contains(KeyView<Key> key) const
+    {
+        return find(key, SlotIndex::hash_of(key)) != kNone;
+    }
+
+    template <typename Key, typename Value>
+    size_t S3FifoCache<Key, Value>::size() const
+    {
+        return index_.size();
+    }
+
+    template <typename Key, typename Value>
+    size_t S3FifoCache<Key, Value>::weight() const
+    {
+        return small_weight_ + main_weight_;
+    }
+
+    template <typename Key, typename Value>
+    std::vector<std::pair<Key, Value>> S3FifoCache<Key, Value>::entries() const
+    {
+        std::vector<std::pair<Key, Value>> out;
+        out.reserve(index_.size());
+        for (const SlotList *queue : {&main_, &small_})
+            for (uint32_t slot = queue->head; slot != kNone; slot = slots_[slot].next)
+                out.emplace_back(slots_[slot].key, slots_[slot].value);
+        return out;
+    }
+
+    template <typename Key, typename Value>
+    void S3FifoCache<Key, Value>::clear()
+    {
+        slots_.clear();
+        index_.clear();
+        free_ = kNone;
+        small_ = main_ = SlotList{};
+        small_weight_ = main_weight_ = 0;
+        ghost_.clear();
+        ghost_hashes_.clear();
+    }
+}
+
+template class Cache::S3FifoCache<std::string, std::string>;
+template class Cache::S3FifoCache<int, int>;
+template class Cache::S3FifoCache<std::string, proxy::CachedResponsePtr>;
@@ -0,0 +1,271 @@
+#include "../include/proxy/ShardedLruCache.hpp"
+#include "../include/proxy/CachedResponse.hpp"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace Cache
+{
+    std::optional<EvictionPolicy> parse_eviction_policy(std::string_view name)
+    {
+        if (name == "lru")
+            return EvictionPolicy::Lru;
+        if (name == "tinylfu")
+            return EvictionPolicy::WTinyLfu;
+        if (name == "clock")
+            return EvictionPolicy::Clock;
+        if (name == "s3fifo")
+            return EvictionPolicy::S3Fifo;
+        if (name == "slru")
+            return EvictionPolicy::Slru;
+        return std::nullopt;
+    }
+
+    template <typename Key, typename Value>
+    ShardedLruCache<Key, Value>::Shard::Shard(size_t capacity, const Weigher &weigher, double max_entry_fraction,
+                                              EvictionPolicy policy)
+        : cache(make_cache(capacity, weigher, max_entry_fraction, policy))
+    {
+    }
+
+    template <typename Key, typename Value>
+    typename ShardedLruCache<Key, Value>::Shard::Variant ShardedLruCache<Key, Value>::Shard::make_cache(
+        size_t capacity, const Weigher &weigher, double max_entry_fraction, EvictionPolicy policy)
+    {
+        switch (policy)
+        {
+        case EvictionPolicy::WTinyLfu:
+            return Variant(std::in_place_type<TinyLfuCache<Key, Value>>, capacity, weigher, max_entry_fraction);
+        case EvictionPolicy::Clock:
+            return Variant(std::in_place_type<ClockCache<Key, Value>>, capacity, weigher, max_entry_fraction);
+        case EvictionPolicy::S3Fifo:
+            return Variant(std::in_place_type<S3FifoCache<Key, Value>>, capacity, weigher, max_entry_fraction);
+        case EvictionPolicy::Slru:
+            return Variant(std::in_place_type<SlruCache<Key, Value>>, capacity, weigher, max_entry_fraction);
+        case EvictionPolicy::Lru:
+            break;
+        }
+        return Variant(std::in_place_type<FlatLruCache<Key, Value>>, capacity, weigher, max_entry_fraction);
+    }
+
+    template <typename Key, typename Value>
+    ShardedLruCache<Key, Value>::ShardedLruCache(size_t capacity, size_t shards, Weigher weigher, double max_entry_fraction,
+                                                 EvictionPolicy policy)
+        : capacity_(capacity), policy_(policy), weigher_(std::move(weigher))
+    {
+        // Before the shard count divides by the fraction
+        check_cache_arguments("ShardedLruCache", capacity, max_entry_fraction);
+        if (shards == 0)
+        {
+            // A few shards per core keeps two busy threads from landing on one lock too often
+            shards = 4 * std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        shards = std::min(shards, capacity);
+        if (weigher_)
+            shards = std::min(shards, std::max<size_t>(1, static_cast<size_t>(1.0 / max_entry_fraction)));
+        while ((size_t{1} << shard_bits_) < shards)
+            ++shard_bits_;
+        if ((size_t{1} << shard_bits_) > shards)
+            --shard_bits_;
+
+        // Each shard gets its share of the capacity and, relative to that share, the same
+        // absolute limit on entry weight as the whole cache
+        const size_t count = size_t{1} << shard_bits_;
+        const double shard_fraction = std::min(1.0, max_entry_fraction * static_cast<double>(count));
+        shards_.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+            shards_.push_back(std::make_unique<Shard>(capacity / count + (i < capacity % count ? 1 : 0), weigher_,
+                                                     shard_fraction, policy_));
+    }
+
+    template <typename Key, typename Value>
+    typename ShardedLruCache<Key, Value>::Shard &ShardedLruCache<Key, Value>::shard_for(KeyView<Key> key) const
+    {
+        if (shard_bits_ == 0)
+            return *shards_[0];
+        // Fibonacci hashing: take the top bits of the mixed hash, so the shard does not depend
+        // on the same low bits the shard's own hash table uses for its buckets
+        uint64_t h = static_cast<uint64_t>(std::hash<KeyView<Key>>{}(key)) * 0x9E3779B97F4A7C15ull;
+        return *shards_[static_cast<size_t>(h >> (64 - shard_bits_))];
+    }
+
+    template <typename Key, typename Value>
+    bool ShardedLruCache<Key, Value>::put(const Key &key, const Value &value)
+    {
+        Shard &shard = shard_for(key);
+        std::lock_guard<std::shared_mutex> lock(shard.mutex);
+        size_t delta = 0;
+        const bool stored = std::visit(
+            [&](auto &cache)
+            {
+                const bool present = cache.contains(key);
+                const size_t size_before = cache.size();
+                const size_t weight_before = cache.weight();
+                const bool ok = cache.put(key, value);
+                if (!ok)
+                {
+                    ++shard.stats.rejected;
+                }
+                else
+                {
+                    ++(present ? shard.stats.updates : shard.stats.inserts);
+                    shard.stats.evictions += size_before + (present ? 0 : 1) - cache.size();
+                }
+                // Unsigned wrap-around makes a shrinking shard subtract
+                delta = cache.weight() - weight_before;
+                return ok;
+            },
+            shard.cache);
+        shard.stats.fill_weight += weigher_ ? weigher_(key, value) : 1;
+
+        const size_t total = weight_.fetch_add(delta, std::memory_order_relaxed) + delta;
+        size_t peak = peak_weight_.load(std::memory_order_relaxed);
+        while (total > peak && !peak_weight_.compare_exchange_weak(peak, total, std::memory_order_relaxed))
+        {
+        }
+        return stored;
+    }
+
+    template <typename Key, typename Value>
+    std::optional<Value> ShardedLruCache<Key, Value>::get(KeyView<Key> key)
+    {
+        Shard &shard = shard_for(key);
+        size_t weight = 0;
+        // The variant's alternative is fixed at construction, so picking it needs no lock
+        std::optional<Value> value = std::visit(
+            [&](auto &cache)
+            {
+                if constexpr (std::decay_t<decltype(cache)>::kConcurrentGet)
+                {
+                    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                    return cache.get(key, &weight);
+                }
+                else
+                {
+                    std::lock_guard<std::shared_mutex> lock(shard.mutex);
+                    return cache.get(key, &weight);
+                }
+            },
+            shard.cache);
+        (value ? shard.hits : shard.misses).fetch_add(1, std::memory_order_relaxed);
+        if (weight)
+            shard.hit_weight.fetch_add(weight, std::memory_order_relaxed);
+        return value;
+    }
+
+    template <typename Key, typename Value>
+    bool ShardedLruCache<Key, Value>::contains(KeyView<Key> key) const
+    {
+        Shard &shard = shard_for(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return std::visit([&](const auto &cache) { return cache.contains(key); }, shard.cache);
+    }
+
+    template <typename Key, typename Value>
+    size_t ShardedLruCache<Key, Value>::size() const
+    {
+        size_t total = 0;
+        for (const auto &shard : shards_)
+        {
+            std::shared_lock<std::shared_mutex> lock(shard->mutex);
+            total += std::visit([](const auto &cache) { return cache.size(); }, shard->cache);
+        }
+        return total;
+    }
+
+    template <typename Key, typename Value>
+    size_t ShardedLruCache<Key, Value>::capacity() const
+    {
+        return capacity_;
+    }
+
+    template <typename Key, typename Value>
+    size_t ShardedLruCache<Key, Value>::shard_count() const
+    {
+        return shards_.size();
+    }
+
+    template <typename Key, typename Value>
+    EvictionPolicy ShardedLruCache<Key, Value>::policy() const
+    {
+        return policy_;
+    }
+
+    template <typename Key, typename Value>
+    size_t ShardedLruCache<Key, Value>::weight() const
+    {
+        return weight_.load(std::memory_order_relaxed);
+    }
+
+    template <typename Key, typename Value>
+    size_t ShardedLruCache<Key, Value>::peak_weight() const
+    {
+        return peak_weight_.load(std::memory_order_relaxed);
+    }
+
+    template <typename Key, typename Value>
+    size_t ShardedLruCache<Key, Value>::max_entry_weight() const
+    {
+        return std::visit([](const auto &cache) { return cache.max_entry_weight(); }, shards_.front()->cache);
+    }
+
+    template <typename Key, typename Value>
+    typename ShardedLruCache<Key, Value>::Stats ShardedLruCache<Key, Value>::stats() const
+    {
+        Stats total;
+        for (const auto &shard : shards_)
+        {
+            std::shared_lock<std::shared_mutex> lock(shard->mutex);
+            total.hits += shard->hits.load(std::memory_order_relaxed);
+            total.misses += shard->misses.load(std::memory_order_relaxed);
+            total.inserts += shard->stats.inserts;
+            total.updates += shard->stats.updates;
+            total.evictions += shard->stats.evictions;
+            total.rejected += shard->stats.rejected;
+            total.hit_weight += shard->hit_weight.load(std::memory_order_relaxed);
+            total.fill_weight += shard->stats.fill_weight;
+            if (const auto *tiny = std::get_if<TinyLfuCache<Key, Value>>(&shard->cache))
+                total.admission_rejects += tiny->admission_rejects();
+        }
+        return total;
+    }
+
+    template <typename Key, typename Value>
+    std::vector<std::pair<Key, Value>> ShardedLruCache<Key, Value>::entries() const
+    {
+        std::vector<std::pair<Key, Value>> out;
+        for (const auto &shard : shards_)
+        {
+            std::shared_lock<std::shared_mutex> lock(shard->mutex);
+            auto items = std::visit([](const auto &cache) { return cache.entries(); }, shard->cache);
+            out.insert(out.end(), std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+        }
+        return out;
+    }
+
+    template <typename Key, typename Value>
+    void ShardedLruCache<Key, Value>::clear()
+    {
+        for (const auto &shard : shards_)
+        {
+            std::lock_guard<std::shared_mutex> lock(shard->mutex);
+            std::visit(
+                [&](auto &cache)
+                {
+                    weight_.fetch_sub(cache.weight(), std::memory_order_relaxed);
+                    cache.clear();
+                },
+                shard->cache);
+            shard->stats = Stats{};
+            shard->hits = shard->misses = shard->hit_weight = 0;
+        }
+    }
+}
+
+template class Cache::ShardedLruCache<std::string, std::string>;
+template class Cache::ShardedLruCache<std::string, proxy::CachedResponsePtr>;
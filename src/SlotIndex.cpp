@@ -0,0 +1,64 @@
+#include "../include/proxy/SlotIndex.hpp"
+#include <stdexcept>
+
+namespace Cache
+{
+    SlotIndex::SlotIndex() : buckets_(16)
+    {
+    }
+
+    void SlotIndex::insert(uint32_t hash, uint32_t slot)
+    {
+        if ((size_ + 1) * 4 > buckets_.size() * 3)
+            grow();
+        place(hash, slot);
+        ++size_;
+    }
+
+    void SlotIndex::place(uint32_t hash, uint32_t slot)
+    {
+        const uint32_t mask = static_cast<uint32_t>(buckets_.size() - 1);
+        uint32_t i = hash & mask;
+        while (buckets_[i].slot != kNone)
+            i = (i + 1) & mask;
+        buckets_[i] = Bucket{hash, slot};
+    }
+
+    void SlotIndex::erase(uint32_t bucket)
+    {
+        // Backward shift (Knuth's Algorithm R): pull later buckets of the probe run into the
+        // hole unless that would put them before their home bucket
+        const uint32_t mask = static_cast<uint32_t>(buckets_.size() - 1);
+        uint32_t hole = bucket;
+        for (uint32_t i = (hole + 1) & mask; buckets_[i].slot != kNone; i = (i + 1) & mask)
+        {
+            const uint32_t home = buckets_[i].hash & mask;
+            const bool home_in_range = hole <= i ? (home > hole && home <= i) : (home > hole || home <= i);
+            if (!home_in_range)
+            {
+                buckets_[hole] = buckets_[i];
+                hole = i;
+            }
+        }
+        buckets_[hole] = Bucket{};
+        --size_;
+    }
+
+    void SlotIndex::grow()
+    {
+        if (buckets_.size() > (size_t{1} << 31))
+            throw std::length_error("SlotIndex is full");
+        // Buckets keep their hash, so rehashing never touches the keys
+        std::vector<Bucket> old(buckets_.size() * 2);
+        old.swap(buckets_);
+        for (const Bucket &bucket : old)
+            if (bucket.slot != kNone)
+                place(bucket.hash, bucket.slot);
+    }
+
+    void SlotIndex::clear()
+    {
+        buckets_.assign(16, Bucket{});
+        size_ = 0;
+    }
+}
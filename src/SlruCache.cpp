@@ -0,0 +1,192 @@
+#include "../include/proxy/SlruCache.hpp"
+#include "../include/proxy/CachedResponse.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace Cache
+{
+    template <typename Key, typename Value>
+    SlruCache<Key, Value>::SlruCache(size_t capacity, Weigher weigher, double max_entry_fraction)
+        : WeightBudget<Key, Value>("SlruCache", capacity, std::move(weigher), max_entry_fraction), protected_capacity_(capacity - capacity / 5)
+    {
+    }
+
+    template <typename Key, typename Value>
+    uint32_t SlruCache<Key, Value>::find(KeyView<Key> key, uint32_t hash) const
+    {
+        return index_.find(hash, [&](uint32_t slot) { return slots_[slot].key == key; });
+    }
+
+    template <typename Key, typename Value>
+    void SlruCache<Key, Value>::erase(uint32_t slot)
+    {
+        Slot &s = slots_[slot];
+        index_.erase(index_.find_slot(SlotIndex::hash_of<KeyView<Key>>(s.key), slot));
+        (s.is_protected ? protected_ : probation_).remove(slots_, slot);
+        (s.is_protected ? protected_weight_ : probation_weight_) -= s.weight;
+        s.key = Key{};
+        s.value = Value{}; // release what the value holds now, not when the slot is reused
+        s.is_protected = false;
+        s.next = free_;
+        free_ = slot;
+    }
+
+    template <typename Key, typename Value>
+    void SlruCache<Key, Value>::demote_overflow(uint32_t keep)
+    {
+        while (protected_weight_ > protected_capacity_ && protected_.tail != keep)
+        {
+            const uint32_t slot = protected_.tail;
+            Slot &s = slots_[slot];
+            protected_.remove(slots_, slot);
+            protected_weight_ -= s.weight;
+            s.is_protected = false;
+            probation_.push_front(slots_, slot);
+            probation_weight_ += s.weight;
+        }
+    }
+
+    template <typename Key, typename Value>
+    uint32_t SlruCache<Key, Value>::victim(uint32_t keep) const
+    {
+        // The probation tail, or the protected tail once probation holds only `keep` (which an
+        // update or a demotion may have left anywhere in either segment)
+        for (const SlotList *segment : {&probation_, &protected_})
+        {
+            const uint32_t slot = segment->tail == keep ? slots_[keep].prev : segment->tail;
+            if (slot != kNone)
+                return slot;
+        }
+        return kNone;
+    }
+
+    template <typename Key, typename Value>
+    bool SlruCache<Key, Value>::put(const Key &key, const Value &value)
+    {
+        const size_t entry_weight = this->weigh(key, value);
+        const uint32_t hash = SlotIndex::hash_of<KeyView<Key>>(key);
+        const uint32_t bucket = find(key, hash);
+        if (this->too_heavy(entry_weight))
+        {
+            if (bucket != kNone)
+                erase(index_.slot(bucket));
+            return false;
+        }
+
+        uint32_t slot;
+        if (bucket != kNone)
+        {
+            slot = index_.slot(bucket);
+            Slot &s = slots_[slot];
+            SlotList &segment = s.is_protected ? protected_ : probation_;
+            size_t &segment_weight = s.is_protected ? protected_weight_ : probation_weight_;
+            segment_weight = segment_weight - s.weight + entry_weight;
+            s.value = value;
+            s.weight = entry_weight;
+            segment.remove(slots_, slot);
+            segment.push_front(slots_, slot);
+            demote_overflow(slot);
+        }
+        else
+        {
+            if (free_ != kNone)
+            {
+                slot = free_;
+                free_ = slots_[slot].next;
+            }
+            else
+            {
+                if (slots_.size() == kNone)
+                    throw std::length_error("SlruCache is full");
+                slot = static_cast<uint32_t>(slots_.size());
+                slots_.emplace_back();
+            }
+            Slot &s = slots_[slot];
+            s.key = key;
+            s.value = value;
+            s.weight = entry_weight;
+            s.is_protected = false;
+            probation_.push_front(slots_, slot);
+            probation_weight_ += entry_weight;
+            index_.insert(hash, slot);
+        }
+
+        while (weight() > this->capacity())
+            erase(victim(slot));
+        this->note_weight(weight());
+        return true;
+    }
+
+    template <typename Key, typename Value>
+    std::optional<Value> SlruCache<Key, Value>::get(KeyView<Key> key, size_t *weight)
+    {
+        const uint32_t bucket = find(key, SlotIndex::hash_of(key));
+        if (bucket == kNone)
+            return std::nullopt;
+        const uint32_t slot = index_.slot(bucket);
+        Slot &s = slots_[slot];
+        if (s.is_protected)
+        {
+            if (slot != protected_.head)
+            {
+                protected_.remove(slots_, slot);
+                protected_.push_front(slots_, slot);
+            }
+        }
+        else
+        {
+            probation_.remove(slots_, slot);
+            probation_weight_ -= s.weight;
+            s.is_protected = true;
+            protected_.push_front(slots_, slot);
+            protected_weight_ += s.weight;
+            demote_overflow(slot);
+        }
+        if (weight)
+            *weight = s.weight;
+        return s.value;
+    }
+
+    template <typename Key, typename Value>
+    bool SlruCache<Key, Value>::contains(KeyView<Key> key) const
+    {
+        return find(key, SlotIndex::hash_of(key)) != kNone;
+    }
+
+    template <typename Key, typename Value>
+    size_t SlruCache<Key, Value>::size() const
+    {
+        return index_.size();
+    }
+
+    template <typename Key, typename Value>
+    size_t SlruCache<Key, Value>::weight() const
+    {
+        return probation_weight_ + protected_weight_;
+    }
+
+    template <typename Key, typename Value>
+    std::vector<std::pair<Key, Value>> SlruCache<Key, Value>::entries() const
+    {
+        std::vector<std::pair<Key, Value>> out;
+        out.reserve(index_.size());
+        for (const SlotList *segment : {&protected_, &probation_})
+            for (uint32_t slot = segment->head; slot != kNone; slot = slots_[slot].next)
+                out.emplace_back(slots_[slot].key, slots_[slot].value);
+        return out;
+    }
+
+    template <typename Key, typename Value>
+    void SlruCache<Key, Value>::clear()
+    {
+        slots_.clear();
+        index_.clear();
+        free_ = kNone;
+        probation_ = protected_ = SlotList{};
+        probation_weight_ = protected_weight_ = 0;
+    }
+}
+
+template class Cache::SlruCache<std::string, std::string>;
+template class Cache::SlruCache<int, int>;
+template class Cache::SlruCache<std::string, proxy::CachedResponsePtr>;
@@ -1,15 +1,26 @@
 #include "../include/proxy/SocketUtils.hpp"
 #include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <cerrno>
 #include <stdexcept>
 #include <cstring>
 #include <string>
+#include <algorithm>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
 
 namespace net
 {
-    int create_listen_socket(uint16_t port)
+    int create_listen_socket(uint16_t port, bool reuse_port)
     {
         int serverSocketFd = socket(AF_INET, SOCK_STREAM, 0);
         if (serverSocketFd < 0)
@@ -27,6 +38,21 @@ namespace net
             close(serverSocketFd);
             throw std::runtime_error(errorMsg);
         }
+        if (reuse_port)
+        {
+#ifdef SO_REUSEPORT
+            // Each listener gets its own accept queue; the kernel hashes new connections across them
+            if (setsockopt(serverSocketFd, SOL_SOCKET, SO_REUSEPORT, &optVal, sizeof(optVal)) < 0)
+            {
+                std::string errorMsg = "setsockopt(SO_REUSEPORT) failed: " + std::string(strerror(errno));
+                close(serverSocketFd);
+                throw std::runtime_error(errorMsg);
+            }
+#else
+            close(serverSocketFd);
+            throw std::runtime_error("SO_REUSEPORT is not supported on this platform");
+#endif
+        }
         sockaddr_in addr{};
         addr.sin_family = AF_INET;
         addr.sin_addr.s_addr = INADDR_ANY;
@@ -41,7 +67,7 @@ namespace net
             throw std::runtime_error("listen failed");
         return serverSocketFd;
     }
-    int net::accept_client(int listen_fd)
+    int accept_client(int listen_fd)
     {
         // Accept a client connection from the listening socket
         // Returns a new client_fd representing this client
@@ -63,7 +89,7 @@ namespace net
      * Returns the complete string that was read.
      */
 
-    std::string net::read_all(int client_fd)
+    std::string read_all(int client_fd)
     {
         char buffer[4096];
         std::string result;
@@ -88,44 +114,484 @@ namespace net
      * might not transmit everything at once).
      */
 
-    void net::write_all(int client_fd, std::string_view data)
+    void write_all(int client_fd, std::string_view data)
     {
         size_t total_sent = 0;
         while (total_sent < data.size())
         {
-            ssize_t sent = send(client_fd, data.data() + total_sent, data.size() - total_sent, 0);
+            // MSG_NOSIGNAL: a peer that went away must surface as an error, not kill the process
+            ssize_t sent = send(client_fd, data.data() + total_sent, data.size() - total_sent, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                throw SendTimeout();
+            if (sent < 0)
+                throw std::runtime_error("send failed");
+            total_sent += sent;
+        }
+    }
+
+    void write_all(int client_fd, const std::string_view *parts, size_t count)
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < count; ++i)
+            total += parts[i].size();
+        size_t total_sent = 0;
+        while (total_sent < total)
+        {
+            ssize_t sent = write_parts(client_fd, parts, count, total_sent);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                throw SendTimeout();
             if (sent < 0)
                 throw std::runtime_error("send failed");
             total_sent += sent;
         }
     }
 
+    void send_file_all(int client_fd, int file_fd, uint64_t offset, size_t length)
+    {
+        while (length > 0)
+        {
+            ssize_t sent = send_file(client_fd, file_fd, offset, length);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                throw SendTimeout();
+            if (sent < 0)
+                throw std::runtime_error("sendfile failed: " + std::string(strerror(errno)));
+            if (sent == 0)
+                throw std::runtime_error("sendfile failed: file shorter than expected");
+            offset += sent;
+            length -= sent;
+        }
+    }
+
+    void set_send_timeout(int fd, std::chrono::seconds timeout)
+    {
+        timeval tv{};
+        tv.tv_sec = static_cast<time_t>(timeout.count());
+        if (setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0)
+            throw std::runtime_error("setsockopt(SO_SNDTIMEO) failed: " + std::string(strerror(errno)));
+    }
+
+    ssize_t write_parts(int fd, const std::string_view *parts, size_t count, size_t offset)
+    {
+        constexpr size_t kMaxParts = 8; // callers send a head, a few headers and a body
+        iovec iov[kMaxParts];
+        size_t n = 0;
+        for (size_t i = 0; i < count && n < kMaxParts; ++i)
+        {
+            if (offset >= parts[i].size())
+            {
+                offset -= parts[i].size();
+                continue;
+            }
+            iov[n].iov_base = const_cast<char *>(parts[i].data() + offset);
+            iov[n].iov_len = parts[i].size() - offset;
+            offset = 0;
+            ++n;
+        }
+        if (n == 0)
+            return 0;
+        // sendmsg rather than writev for MSG_NOSIGNAL: a vanished peer must not raise SIGPIPE
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        return sendmsg(fd, &msg, MSG_NOSIGNAL);
+    }
+
+    ssize_t send_file(int fd, int file_fd, uint64_t offset, size_t length)
+    {
+        // sendfile has no MSG_NOSIGNAL: the proxy ignores SIGPIPE once a disk tier is enabled
+        off_t pos = static_cast<off_t>(offset);
+        return ::sendfile(fd, file_fd, &pos, length);
+    }
+
     int connect_to_host(const std::string &ip, int port, std::chrono::seconds timeout)
     {
-        int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-        if (sockfd < 0)
+        return connect_race({ip}, port, timeout);
+    }
+
+    void set_nonblocking(int fd, bool enabled)
+    {
+        int flags = fcntl(fd, F_GETFL, 0);
+        if (flags < 0)
+            throw std::runtime_error("fcntl(F_GETFL) failed: " + std::string(strerror(errno)));
+        flags = enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+        if (fcntl(fd, F_SETFL, flags) < 0)
+            throw std::runtime_error("fcntl(F_SETFL) failed: " + std::string(strerror(errno)));
+    }
+
+    int accept_nonblocking(int listen_fd)
+    {
+        int client_fd = accept(listen_fd, nullptr, nullptr);
+        if (client_fd < 0)
         {
-            throw std::runtime_error("Failed to create socket");
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED)
+                return -1;
+            throw std::runtime_error("accept failed: " + std::string(strerror(errno)));
         }
+        set_nonblocking(client_fd);
+        return client_fd;
+    }
 
-        // Fill sockaddr_in
-        sockaddr_in addr;
-        std::memset(&addr, 0, sizeof(addr));
-        addr.sin_family = AF_INET;
-        addr.sin_port = htons(port);
-        if (inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) <= 0)
+    namespace
+    {
+        // Parse an IPv4 or IPv6 literal into a socket address
+        socklen_t to_sockaddr(const std::string &ip, int port, sockaddr_storage &storage)
         {
-            ::close(sockfd);
+            std::memset(&storage, 0, sizeof(storage));
+            auto *v4 = reinterpret_cast<sockaddr_in *>(&storage);
+            if (inet_pton(AF_INET, ip.c_str(), &v4->sin_addr) == 1)
+            {
+                v4->sin_family = AF_INET;
+                v4->sin_port = htons(port);
+                return sizeof(sockaddr_in);
+            }
+            auto *v6 = reinterpret_cast<sockaddr_in6 *>(&storage);
+            if (inet_pton(AF_INET6, ip.c_str(), &v6->sin6_addr) == 1)
+            {
+                v6->sin6_family = AF_INET6;
+                v6->sin6_port = htons(port);
+                return sizeof(sockaddr_in6);
+            }
             throw std::runtime_error("Invalid IP address: " + ip);
         }
 
-        // Connect
-        if (connect(sockfd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+        // Non-blocking connect; returns the fd, or -1 with errno set if it failed right away
+        int start_connect(const std::string &ip, int port)
         {
-            ::close(sockfd);
-            throw std::runtime_error("Connection failed to " + ip + ":" + std::to_string(port));
+            sockaddr_storage addr;
+            socklen_t len = to_sockaddr(ip, port, addr);
+            int sockfd = socket(addr.ss_family, SOCK_STREAM, 0);
+            if (sockfd < 0)
+                return -1;
+            set_nonblocking(sockfd);
+            // EINPROGRESS is the normal outcome: completion is reported through writability.
+            if (connect(sockfd, reinterpret_cast<sockaddr *>(&addr), len) < 0 && errno != EINPROGRESS)
+            {
+                int err = errno;
+                ::close(sockfd);
+                errno = err;
+                return -1;
+            }
+            return sockfd;
         }
+    }
 
+    int connect_nonblocking(const std::string &ip, int port)
+    {
+        int sockfd = start_connect(ip, port);
+        if (sockfd < 0)
+            throw std::runtime_error("Connection failed to " + ip + ":" + std::to_string(port) + ": " + strerror(errno));
         return sockfd;
     }
-}
\ No newline at end of file
+
+    int socket_error(int fd)
+    {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+            return errno;
+        return err;
+    }
+
+    // ---------- ConnectRace ----------
+
+    ConnectRace::ConnectRace(std::vector<std::string> ips, int port) : ips_(std::move(ips)), port_(port) {}
+
+    ConnectRace::~ConnectRace()
+    {
+        for (int fd : pending_fds_)
+            ::close(fd);
+    }
+
+    int ConnectRace::launch_next()
+    {
+        while (next_ < ips_.size())
+        {
+            const std::string &ip = ips_[next_++];
+            int fd;
+            try
+            {
+                fd = start_connect(ip, port_);
+            }
+            catch (const std::exception &)
+            {
+                outcomes_.push_back({ip, EINVAL, std::chrono::milliseconds(0)});
+                continue;
+            }
+            if (fd < 0)
+            {
+                outcomes_.push_back({ip, errno, std::chrono::milliseconds(0)});
+                continue;
+            }
+            pending_fds_.push_back(fd);
+            pending_.push_back({ip, std::chrono::steady_clock::now()});
+            return fd;
+        }
+        return -1;
+    }
+
+    void ConnectRace::finish(int fd, int error)
+    {
+        for (size_t i = 0; i < pending_fds_.size(); ++i)
+        {
+            if (pending_fds_[i] != fd)
+                continue;
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - pending_[i].started);
+            outcomes_.push_back({pending_[i].ip, error, elapsed});
+            if (error == 0)
+                winner_ip_ = pending_[i].ip;
+            pending_fds_.erase(pending_fds_.begin() + i);
+            pending_.erase(pending_.begin() + i);
+            return;
+        }
+    }
+
+    bool ConnectRace::complete(int fd)
+    {
+        int err = socket_error(fd);
+        finish(fd, err);
+        if (err != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        return true;
+    }
+
+    void ConnectRace::cancel_pending(bool timed_out)
+    {
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < pending_fds_.size(); ++i)
+        {
+            if (timed_out)
+                outcomes_.push_back({pending_[i].ip, ETIMEDOUT,
+                                     std::chrono::duration_cast<std::chrono::milliseconds>(now - pending_[i].started)});
+            ::close(pending_fds_[i]);
+        }
+        pending_fds_.clear();
+        pending_.clear();
+    }
+
+    std::string ConnectRace::failure_message() const
+    {
+        std::string msg = "Connection failed to port " + std::to_string(port_) + ":";
+        if (outcomes_.empty())
+            return msg + " no address to try";
+        for (const auto &o : outcomes_)
+            msg += " " + o.ip + " (" + strerror(o.error) + ")";
+        return msg;
+    }
+
+    int connect_race(const std::vector<std::string> &ips, int port, std::chrono::milliseconds timeout,
+                     std::vector<ConnectOutcome> *outcomes, std::string *connected_ip)
+    {
+        ConnectRace race(ips, port);
+        auto report = [&]()
+        {
+            if (outcomes)
+                *outcomes = race.outcomes();
+        };
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        auto next_launch = std::chrono::steady_clock::now();
+        std::vector<pollfd> pfds;
+
+        while (true)
+        {
+            auto now = std::chrono::steady_clock::now();
+            // Launch the next address when its turn comes, or at once if nothing is in flight
+            if (!race.exhausted() && (now >= next_launch || race.pending().empty()))
+            {
+                race.launch_next();
+                next_launch = now + ConnectRace::kAttemptDelay;
+            }
+            if (race.failed())
+            {
+                report();
+                throw std::runtime_error(race.failure_message());
+            }
+            if (race.pending().empty())
+                continue; // every launched attempt failed at once; try the next address
+            if (now >= deadline)
+            {
+                race.cancel_pending(true);
+                report();
+                throw std::runtime_error(race.failure_message());
+            }
+
+            auto wake = race.exhausted() ? deadline : std::min(deadline, next_launch);
+            int wait_ms = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(wake - now).count());
+            pfds.clear();
+            for (int fd : race.pending())
+                pfds.push_back({fd, POLLOUT, 0});
+            int ready = poll(pfds.data(), pfds.size(), wait_ms);
+            if (ready < 0 && errno != EINTR)
+                throw std::runtime_error("poll failed during connect: " + std::string(strerror(errno)));
+            for (const auto &p : pfds)
+            {
+                if (p.revents == 0)
+                    continue;
+                if (race.complete(p.fd))
+                {
+                    race.cancel_pending(false); // the losers
+                    report();
+                    if (connected_ip)
+                        *connected_ip = race.winner_ip();
+                    set_nonblocking(p.fd, false);
+                    return p.fd;
+                }
+                next_launch = std::chrono::steady_clock::now(); // a failure: don't wait out the delay
+            }
+        }
+    }
+
+#ifdef __linux__
+    SpliceRelay::SpliceRelay()
+    {
+        int fds[2];
+        if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0)
+            throw std::runtime_error("pipe2 failed: " + std::string(strerror(errno)));
+        pipe_r_ = fds[0];
+        pipe_w_ = fds[1];
+    }
+
+    SpliceRelay::~SpliceRelay()
+    {
+        ::close(pipe_r_);
+        ::close(pipe_w_);
+    }
+
+    bool SpliceRelay::pump(int src, int dst)
+    {
+        while (true)
+        {
+            bool progressed = false;
+            if (wants_read())
+            {
+                ssize_t n = splice(src, nullptr, pipe_w_, nullptr, kCapacity - pending_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (n > 0)
+                {
+                    pending_ += n;
+                    progressed = true;
+                }
+                else if (n == 0)
+                {
+                    src_eof_ = true;
+                    progressed = true;
+                }
+                else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                {
+                    throw std::runtime_error("splice from socket failed: " + std::string(strerror(errno)));
+                }
+            }
+            if (pending_ > 0)
+            {
+                ssize_t n = splice(pipe_r_, nullptr, dst, nullptr, pending_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (n > 0)
+                {
+                    pending_ -= n;
+                    progressed = true;
+                }
+                else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                {
+                    throw std::runtime_error("splice to socket failed: " + std::string(strerror(errno)));
+                }
+            }
+            if (!progressed)
+                break;
+        }
+        return src_eof_ && pending_ == 0;
+    }
+#else
+    SpliceRelay::SpliceRelay() : buffer_(kCapacity, '\0') {}
+    SpliceRelay::~SpliceRelay() {}
+
+    bool SpliceRelay::pump(int src, int dst)
+    {
+        // buffer_[0, pending_) holds bytes not yet written to dst
+        while (true)
+        {
+            bool progressed = false;
+            if (wants_read())
+            {
+                ssize_t n = recv(src, &buffer_[pending_], kCapacity - pending_, 0);
+                if (n > 0)
+                {
+                    pending_ += n;
+                    progressed = true;
+                }
+                else if (n == 0)
+                {
+                    src_eof_ = true;
+                    progressed = true;
+                }
+                else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                {
+                    throw std::runtime_error("recv failed in tunnel: " + std::string(strerror(errno)));
+                }
+            }
+            if (pending_ > 0)
+            {
+                ssize_t n = send(dst, buffer_.data(), pending_, 0);
+                if (n > 0)
+                {
+                    buffer_.erase(0, n);
+                    buffer_.resize(kCapacity);
+                    pending_ -= n;
+                    progressed = true;
+                }
+                else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                {
+                    throw std::runtime_error("send failed in tunnel: " + std::string(strerror(errno)));
+                }
+            }
+            if (!progressed)
+                break;
+        }
+        return src_eof_ && pending_ == 0;
+    }
+#endif
+
+    void splice_tunnel(int client_fd, int origin_fd, std::chrono::seconds idle_timeout)
+    {
+        set_nonblocking(client_fd);
+        set_nonblocking(origin_fd);
+
+        SpliceRelay upstream;   // client -> origin
+        SpliceRelay downstream; // origin -> client
+        bool up_done = false, down_done = false;
+
+        while (!(up_done && down_done))
+        {
+            if (!up_done && upstream.pump(client_fd, origin_fd))
+            {
+                up_done = true;
+                shutdown(origin_fd, SHUT_WR); // propagate the half-close
+            }
+            if (!down_done && downstream.pump(origin_fd, client_fd))
+            {
+                down_done = true;
+                shutdown(client_fd, SHUT_WR);
+            }
+            if (up_done && down_done)
+                break;
+
+            pollfd fds[2];
+            fds[0].fd = client_fd;
+            fds[0].events = (upstream.wants_read() ? POLLIN : 0) | (downstream.wants_write() ? POLLOUT : 0);
+            fds[1].fd = origin_fd;
+            fds[1].events = (downstream.wants_read() ? POLLIN : 0) | (upstream.wants_write() ? POLLOUT : 0);
+            fds[0].revents = fds[1].revents = 0;
+
+            int ready = poll(fds, 2, static_cast<int>(idle_timeout.count() * 1000));
+            if (ready < 0 && errno != EINTR)
+                throw std::runtime_error("poll failed in tunnel: " + std::string(strerror(errno)));
+            if (ready == 0)
+                throw std::runtime_error("tunnel idle timeout");
+        }
+    }
+}
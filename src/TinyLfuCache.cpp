@@ -0,0 +1,209 @@
+#include "../include/proxy/TinyLfuCache.hpp"
+#include "../include/proxy/CachedResponse.hpp"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace Cache
+{
+    template <typename Key, typename Value>
+    TinyLfuCache<Key, Value>::TinyLfuCache(size_t capacity, Weigher weigher, double max_entry_fraction)
+        : WeightBudget<Key, Value>("TinyLfuCache", capacity, std::move(weigher), max_entry_fraction), sketch_(this->weighted() ? 1024 : capacity)
+    {
+        window_capacity_ = std::max<size_t>(1, capacity / 100);
+        main_capacity_ = capacity - window_capacity_;
+        protected_capacity_ = main_capacity_ / 10 * 8;
+    }
+
+    template <typename Key, typename Value>
+    typename TinyLfuCache<Key, Value>::ItemList &TinyLfuCache<Key, Value>::list_for(Region region)
+    {
+        return region == Region::Window ? window_ : region == Region::Probation ? probation_ : protected_;
+    }
+
+    template <typename Key, typename Value>
+    size_t &TinyLfuCache<Key, Value>::weight_for(Region region)
+    {
+        return region == Region::Window ? window_weight_ : region == Region::Probation ? probation_weight_ : protected_weight_;
+    }
+
+    // To the MRU end of `region`; iterators stay valid across the splice
+    template <typename Key, typename Value>
+    void TinyLfuCache<Key, Value>::move_to(ItemIterator it, Region region)
+    {
+        weight_for(it->region) -= it->weight;
+        weight_for(region) += it->weight;
+        list_for(region).splice(list_for(region).begin(), list_for(it->region), it);
+        it->region = region;
+    }
+
+    template <typename Key, typename Value>
+    void TinyLfuCache<Key, Value>::erase(ItemIterator it)
+    {
+        weight_for(it->region) -= it->weight;
+        cache_map_.erase(KeyView<Key>(it->key));
+        list_for(it->region).erase(it);
+    }
+
+    template <typename Key, typename Value>
+    void TinyLfuCache<Key, Value>::demote_protected()
+    {
+        while (protected_weight_ > protected_capacity_ && !protected_.empty())
+            move_to(std::prev(protected_.end()), Region::Probation);
+    }
+
+    template <typename Key, typename Value>
+    void TinyLfuCache<Key, Value>::evict()
+    {
+        std::hash<KeyView<Key>> hash;
+        while (window_weight_ > window_capacity_ && !window_.empty())
+        {
+            ItemIterator candidate = std::prev(window_.end());
+            const unsigned candidate_frequency = sketch_.frequency(hash(candidate->key));
+            bool admit = true;
+            // Make room in the main region, one probation (then protected) LRU victim at a time,
+            // as long as each victim is less popular than the candidate
+            while (probation_weight_ + protected_weight_ + candidate->weight > main_capacity_)
+            {
+                if (probation_.empty() && protected_.empty())
+                {
+                    admit = false; // heavier than the whole main region
+                    break;
+                }
+                ItemIterator victim = std::prev(probation_.empty() ? protected_.end() : probation_.end());
+                if (candidate_frequency <= sketch_.frequency(hash(victim->key)))
+                {
+                    admit = false;
+                    break;
+                }
+                erase(victim);
+            }
+            if (admit)
+            {
+                move_to(candidate, Region::Probation);
+            }
+            else
+            {
+                ++admission_rejects_;
+                erase(candidate);
+            }
+        }
+        // An entry updated in place may have grown the main region
+        while (probation_weight_ + protected_weight_ > main_capacity_)
+            erase(std::prev(probation_.empty() ? protected_.end() : probation_.end()));
+    }
+
+    template <typename Key, typename Value>
+    bool TinyLfuCache<Key, Value>::put(const Key &key, const Value &value)
+    {
+        size_t entry_weight = this->weigh(key, value);
+        auto it = cache_map_.find(key);
+        if (this->too_heavy(entry_weight))
+        {
+            if (it != cache_map_.end())
+                erase(it->second);
+            return false;
+        }
+
+        if (it != cache_map_.end())
+        {
+            ItemIterator item = it->second;
+            weight_for(item->region) = weight_for(item->region) - item->weight + entry_weight;
+            item->value = value;
+            item->weight = entry_weight;
+            list_for(item->region).splice(list_for(item->region).begin(), list_for(item->region), item);
+            demote_protected();
+        }
+        else
+        {
+            window_.emplace_front(CacheItem{key, value, entry_weight, Region::Window});
+            cache_map_.emplace(KeyView<Key>(window_.front().key), window_.begin());
+            window_weight_ += entry_weight;
+            // Weighed caches do not know their entry count up front: keep the sketch wider than it
+            if (cache_map_.size() > sketch_.width())
+                sketch_.ensure_capacity(2 * cache_map_.size());
+        }
+        evict();
+        this->note_weight(weight());
+        return true;
+    }
+
+    template <typename Key, typename Value>
+    std::optional<Value> TinyLfuCache<Key, Value>::get(KeyView<Key> key, size_t *weight)
+    {
+        sketch_.record(std::hash<KeyView<Key>>{}(key));
+        auto it = cache_map_.find(key);
+        if (it == cache_map_.end())
+        {
+            return std::nullopt;
+        }
+        ItemIterator item = it->second;
+        if (item->region == Region::Probation)
+        {
+            // Hit again after admission: protect it, making room by demoting the protected LRU
+            move_to(item, Region::Protected);
+            demote_protected();
+        }
+        else
+        {
+            list_for(item->region).splice(list_for(item->region).begin(), list_for(item->region), item);
+        }
+        if (weight)
+            *weight = item->weight;
+        return item->value;
+    }
+
+    template <typename Key, typename Value>
+    bool TinyLfuCache<Key, Value>::contains(KeyView<Key> key) const
+    {
+        return cache_map_.count(key) > 0;
+    }
+
+    template <typename Key, typename Value>
+    size_t TinyLfuCache<Key, Value>::size() const
+    {
+        return cache_map_.size();
+    }
+
+    template <typename Key, typename Value>
+    size_t TinyLfuCache<Key, Value>::weight() const
+    {
+        return window_weight_ + probation_weight_ + protected_weight_;
+    }
+
+    template <typename Key, typename Value>
+    uint64_t TinyLfuCache<Key, Value>::admission_rejects() const
+    {
+        return admission_rejects_;
+    }
+
+    template <typename Key, typename Value>
+    std::vector<std::pair<Key, Value>> TinyLfuCache<Key, Value>::entries() const
+    {
+        std::vector<std::pair<Key, Value>> out;
+        out.reserve(cache_map_.size());
+        for (const ItemList *list : {&protected_, &probation_, &window_})
+            for (const CacheItem &item : *list)
+                out.emplace_back(item.key, item.value);
+        return out;
+    }
+
+    template <typename Key, typename Value>
+    void TinyLfuCache<Key, Value>::clear()
+    {
+        window_.clear();
+        probation_.clear();
+        protected_.clear();
+        cache_map_.clear();
+        window_weight_ = probation_weight_ = protected_weight_ = 0;
+        admission_rejects_ = 0;
+        sketch_.clear();
+    }
+}
+
+template class Cache::TinyLfuCache<std::string, std::string>;
+template class Cache::TinyLfuCache<int, int>;
+template class Cache::TinyLfuCache<std::string, proxy::CachedResponsePtr>;
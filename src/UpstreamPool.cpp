@@ -0,0 +1,152 @@
+#include "../include/proxy/UpstreamPool.hpp"
+#include "../include/proxy/SocketUtils.hpp"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <unistd.h> // close()
+
+namespace proxy
+{
+    // ---------- Lease ----------
+
+    UpstreamPool::Lease::Lease(UpstreamPool *pool, std::string ip, int port, int fd, bool reused)
+        : pool_(pool), ip_(std::move(ip)), port_(port), fd_(fd), reused_(reused) {}
+
+    UpstreamPool::Lease::Lease(Lease &&other) noexcept
+        : pool_(other.pool_), ip_(std::move(other.ip_)), port_(other.port_), fd_(other.fd_),
+          reused_(other.reused_), keep_alive_(other.keep_alive_)
+    {
+        other.fd_ = -1;
+    }
+
+    UpstreamPool::Lease &UpstreamPool::Lease::operator=(Lease &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            pool_ = other.pool_;
+            ip_ = std::move(other.ip_);
+            port_ = other.port_;
+            fd_ = other.fd_;
+            reused_ = other.reused_;
+            keep_alive_ = other.keep_alive_;
+            other.fd_ = -1;
+        }
+        return *this;
+    }
+
+    UpstreamPool::Lease::~Lease()
+    {
+        reset();
+    }
+
+    void UpstreamPool::Lease::reset()
+    {
+        if (fd_ < 0)
+            return;
+        if (keep_alive_ && pool_)
+            pool_->put_idle(ip_, port_, fd_);
+        else
+            ::close(fd_);
+        fd_ = -1;
+    }
+
+    // ---------- UpstreamPool ----------
+
+    UpstreamPool::UpstreamPool() : UpstreamPool(Options{}) {}
+
+    UpstreamPool::UpstreamPool(Options options) : options_(options) {}
+
+    UpstreamPool::~UpstreamPool()
+    {
+        for (auto &kv : idle_)
+            for (auto &conn : kv.second)
+                ::close(conn.fd);
+    }
+
+    UpstreamPool::Lease UpstreamPool::acquire(const std::vector<std::string> &ips, int port, std::chrono::milliseconds connect_timeout,
+                                              std::vector<net::ConnectOutcome> *outcomes)
+    {
+        for (const auto &ip : ips)
+        {
+            int fd = take_idle(ip, port);
+            if (fd >= 0)
+            {
+                net::set_nonblocking(fd, false);
+                return Lease(this, ip, port, fd, true);
+            }
+        }
+        std::string ip;
+        int fd = net::connect_race(ips, port, connect_timeout, outcomes, &ip);
+        ++connected_;
+        return Lease(this, ip, port, fd, false);
+    }
+
+    int UpstreamPool::take_idle(const std::string &ip, int port)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = idle_.find(key_of(ip, port));
+        if (it == idle_.end())
+            return -1;
+
+        auto &idle = it->second;
+        prune_expired(idle, std::chrono::steady_clock::now());
+        while (!idle.empty())
+        {
+            // Most recently used first: it is the least likely to have been closed by the origin
+            int fd = idle.back().fd;
+            idle.pop_back();
+            --idle_total_;
+            if (is_healthy(fd))
+            {
+                ++reused_;
+                return fd;
+            }
+            ::close(fd);
+        }
+        return -1;
+    }
+
+    void UpstreamPool::put_idle(const std::string &ip, int port, int fd)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto &idle = idle_[key_of(ip, port)];
+        prune_expired(idle, std::chrono::steady_clock::now());
+        if (idle.size() >= options_.max_idle_per_host || idle_total_ >= options_.max_idle_total)
+        {
+            ::close(fd);
+            return;
+        }
+        idle.push_back({fd, std::chrono::steady_clock::now()});
+        ++idle_total_;
+    }
+
+    size_t UpstreamPool::idle_count() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return idle_total_;
+    }
+
+    void UpstreamPool::prune_expired(std::deque<IdleConnection> &idle, std::chrono::steady_clock::time_point now)
+    {
+        // Oldest at the front
+        while (!idle.empty() && now - idle.front().idle_since > options_.idle_timeout)
+        {
+            ::close(idle.front().fd);
+            idle.pop_front();
+            --idle_total_;
+        }
+    }
+
+    bool UpstreamPool::is_healthy(int fd)
+    {
+        char byte;
+        ssize_t n = recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (n == 0)
+            return false; // origin closed its end
+        if (n > 0)
+            return false; // unsolicited bytes: framing is out of sync
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+} // namespace proxy
@@ -1,10 +1,125 @@
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <csignal>
+#include <pthread.h>
 #include "../include/proxy/HttpProxy.hpp"
 #include "../include/proxy/SocketUtils.hpp"
 
-int main()
+int main(int argc, char *argv[])
 {
-    proxy::HttpProxy proxy(8080, 10, 5);
-    proxy.run(); // run() created listen_fd and pool
+    // --reactor: epoll front end instead of one pool thread per connection
+    // --workers N: N shared-nothing reactors on SO_REUSEPORT listeners (0 = one per CPU)
+    // --pin: pin each worker to its own CPU
+    // --cache-mb N: response cache budget in MB (body + header bytes)
+    // --max-object-fraction F: do not cache responses larger than F of the budget
+    // --cache-policy lru|tinylfu|clock|s3fifo|slru: eviction/admission policy of the response cache (default tinylfu)
+    // --disk-cache DIR: add a disk tier (segment files in DIR) under the memory cache
+    // --disk-cache-mb N: disk tier budget in MB (default 1024)
+    // --snapshot-dir DIR: warm restarts from DIR; checkpoint there periodically and on SIGINT/SIGTERM
+    // --snapshot-interval S: seconds between checkpoints (default 60, 0 = only at shutdown)
+    // --stale-while-revalidate S: serve expired entries for S more seconds while refreshing them (default 0)
+    // --stale-if-error S: serve expired entries for S seconds when the origin fails (default 0)
+    // --early-refresh-beta B: XFetch early refresh of hot entries (default 1, 0 = off)
+    bool use_event_loop = false;
+    bool use_workers = false;
+    bool pin_cpus = false;
+    size_t workers = 0;
+    size_t cache_mb = 10;
+    double max_object_fraction = proxy::HttpProxy::kDefaultMaxObjectFraction;
+    Cache::EvictionPolicy cache_policy = Cache::EvictionPolicy::WTinyLfu;
+    const char *disk_cache_dir = nullptr;
+    size_t disk_cache_mb = 1024;
+    const char *snapshot_dir = nullptr;
+    long snapshot_interval = 60;
+    proxy::StalePolicy stale_policy;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--reactor") == 0)
+            use_event_loop = true;
+        else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+        {
+            use_workers = true;
+            workers = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--pin") == 0)
+            pin_cpus = true;
+        else if (std::strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc)
+            cache_mb = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--max-object-fraction") == 0 && i + 1 < argc)
+            max_object_fraction = std::strtod(argv[++i], nullptr);
+        else if (std::strcmp(argv[i], "--cache-policy") == 0 && i + 1 < argc)
+        {
+            const char *policy = argv[++i];
+            if (auto parsed = Cache::parse_eviction_policy(policy))
+                cache_policy = *parsed;
+            else
+            {
+                std::cerr << "Unknown --cache-policy " << policy << " (expected lru, tinylfu, clock, s3fifo or slru)"
+                          << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--disk-cache") == 0 && i + 1 < argc)
+            disk_cache_dir = argv[++i];
+        else if (std::strcmp(argv[i], "--disk-cache-mb") == 0 && i + 1 < argc)
+            disk_cache_mb = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--snapshot-dir") == 0 && i + 1 < argc)
+            snapshot_dir = argv[++i];
+        else if (std::strcmp(argv[i], "--snapshot-interval") == 0 && i + 1 < argc)
+            snapshot_interval = std::strtol(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--stale-while-revalidate") == 0 && i + 1 < argc)
+            stale_policy.while_revalidate = std::chrono::seconds(std::max(0L, std::strtol(argv[++i], nullptr, 10)));
+        else if (std::strcmp(argv[i], "--stale-if-error") == 0 && i + 1 < argc)
+            stale_policy.if_error = std::chrono::seconds(std::max(0L, std::strtol(argv[++i], nullptr, 10)));
+        else if (std::strcmp(argv[i], "--early-refresh-beta") == 0 && i + 1 < argc)
+            stale_policy.early_refresh_beta = std::strtod(argv[++i], nullptr);
+    }
+
+    // With snapshots, SIGINT/SIGTERM are taken by one thread that checkpoints before exiting.
+    // Blocked here, before any thread starts, so every thread inherits the mask.
+    sigset_t shutdown_signals;
+    sigemptyset(&shutdown_signals);
+    sigaddset(&shutdown_signals, SIGINT);
+    sigaddset(&shutdown_signals, SIGTERM);
+    if (snapshot_dir)
+        pthread_sigmask(SIG_BLOCK, &shutdown_signals, nullptr);
+
+    proxy::HttpProxy proxy(8080, cache_mb, 5, max_object_fraction, cache_policy);
+    proxy.set_stale_policy(stale_policy);
+    if (disk_cache_dir)
+    {
+        try
+        {
+            proxy.enable_disk_cache(disk_cache_dir, disk_cache_mb * 1024 * 1024);
+        }
+        catch (const std::exception &ex)
+        {
+            std::cerr << "Cannot enable the disk cache: " << ex.what() << std::endl;
+            return 1;
+        }
+    }
+    if (snapshot_dir)
+    {
+        proxy.enable_snapshots(snapshot_dir, std::chrono::seconds(std::max(0L, snapshot_interval)));
+        std::thread([&proxy, shutdown_signals]()
+                    {
+            int signal = 0;
+            sigwait(&shutdown_signals, &signal);
+            std::cout << "[main] Signal " << signal << ": saving snapshot before exit" << std::endl;
+            proxy.save_snapshot();
+            std::cout.flush();
+            std::_Exit(0); })
+            .detach();
+    }
+    if (use_workers)
+        proxy.run_workers(workers, pin_cpus); // one listener + epoll loop + cache shard per worker
+    else if (use_event_loop)
+        proxy.run_event_loop(); // run_event_loop() created listen_fd and epoll loop
+    else
+        proxy.run(); // run() created listen_fd and pool
     return 0;
 }
@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/ByteRange.hpp"
+#include "test_entries.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+
+using proxy::ByteRange;
+using proxy::CachedReply;
+using proxy::CachedResponse;
+using proxy::CachedResponsePtr;
+using test_entries::make_entry;
+using test_entries::make_shared_entry;
+
+namespace
+{
+    std::string body_of(const CachedReply &reply)
+    {
+        std::string body;
+        for (const CachedReply::Piece &piece : reply.body)
+            body += reply.bytes(piece);
+        return body;
+    }
+
+    // Collects what a reply sends (file pieces through ResponseSink's pread fallback)
+    class StringSink : public proxy::ResponseSink
+    {
+    public:
+        void write(std::string_view data) override { out.append(data); }
+        std::string out;
+    };
+
+    bool same(const std::vector<ByteRange> &ranges, const std::vector<std::pair<uint64_t, uint64_t>> &expected)
+    {
+        if (ranges.size() != expected.size())
+            return false;
+        for (size_t i = 0; i < ranges.size(); ++i)
+            if (ranges[i].first != expected[i].first || ranges[i].last != expected[i].second)
+                return false;
+        return true;
+    }
+}
+
+TEST(ByteRangeTest, ParsesAndClipsRanges)
+{
+    EXPECT_TRUE(same(*proxy::parse_byte_ranges("bytes=0-9", 100), {{0, 9}}));
+    EXPECT_TRUE(same(*proxy::parse_byte_ranges("BYTES=90-", 100), {{90, 99}}));
+    EXPECT_TRUE(same(*proxy::parse_byte_ranges("bytes=-10", 100), {{90, 99}}));
+    EXPECT_TRUE(same(*proxy::parse_byte_ranges("bytes=-500", 100), {{0, 99}}));
+    EXPECT_TRUE(same(*proxy::parse_byte_ranges("bytes=50-1000", 100), {{50, 99}}));
+    EXPECT_TRUE(same(*proxy::parse_byte_ranges("bytes=0-0, , -1", 100), {{0, 0}, {99, 99}}));
+    EXPECT_TRUE(same(*proxy::parse_byte_ranges("bytes=99999999999999999999999-", 100), {}));
+
+    // Sorted, overlapping and adjacent ranges merged
+    EXPECT_TRUE(same(*proxy::parse_byte_ranges("bytes=50-59,0-9,5-19,20-29", 100), {{0, 29}, {50, 59}}));
+
+    // Ignored: not bytes, malformed, reversed
+    for (const char *ignored : {"items=0-9", "bytes = 0-9", "bytes=", "bytes=abc", "bytes=5", "bytes=9-5", "bytes=-", "bytes=1-2-3"})
+        EXPECT_FALSE(proxy::parse_byte_ranges(ignored, 100)) << ignored;
+
+    // Unsatisfiable: nothing overlaps the body
+    EXPECT_TRUE(proxy::parse_byte_ranges("bytes=100-200", 100)->empty());
+    EXPECT_TRUE(proxy::parse_byte_ranges("bytes=-0", 100)->empty());
+    EXPECT_TRUE(proxy::parse_byte_ranges("bytes=0-", 0)->empty());
+}
+
+TEST(ByteRangeTest, TooManyRangesAreIgnored)
+{
+    std::string many = "bytes=";
+    for (size_t i = 0; i <= proxy::kMaxByteRanges; ++i)
+        many += std::to_string(i * 10) + "-" + std::to_string(i * 10 + 1) + ",";
+    EXPECT_FALSE(proxy::parse_byte_ranges(many, 1000));
+
+    // Many specs that merge into few are fine, up to a bound on the work
+    std::string merging = "bytes=";
+    for (int i = 0; i < 40; ++i)
+        merging += "0-" + std::to_string(i) + ",";
+    EXPECT_TRUE(same(*proxy::parse_byte_ranges(merging, 1000), {{0, 39}}));
+    for (int i = 40; i < 80; ++i)
+        merging += "0-" + std::to_string(i) + ",";
+    EXPECT_FALSE(proxy::parse_byte_ranges(merging, 1000));
+}
+
+TEST(ByteRangeTest, IfRangeNeedsAStrongMatch)
+{
+    CachedResponse entry = make_entry("0123456789");
+    EXPECT_TRUE(proxy::if_range_matches("\"v1\"", entry));
+    EXPECT_FALSE(proxy::if_range_matches("\"v2\"", entry));
+    EXPECT_FALSE(proxy::if_range_matches("W/\"v1\"", entry));
+    EXPECT_TRUE(proxy::if_range_matches("Sat, 17 Oct 2026 10:00:00 GMT", entry));
+    EXPECT_FALSE(proxy::if_range_matches("Sat, 17 Oct 2026 09:00:00 GMT", entry));
+
+    CachedResponsePtr shared = make_shared_entry("0123456789");
+    EXPECT_TRUE(proxy::range_response(shared, "bytes=0-1", "\"v1\""));
+    EXPECT_FALSE(proxy::range_response(shared, "bytes=0-1", "\"v2\"")); // the whole, current object instead
+}
+
+TEST(ByteRangeTest, SingleRangeIsA206WithContentRange)
+{
+    CachedResponsePtr entry = make_shared_entry("0123456789");
+    auto partial = proxy::range_response(entry, "bytes=2-5", "");
+    ASSERT_TRUE(partial);
+    EXPECT_EQ(body_of(*partial), "2345");
+    const std::string &head = *partial->head;
+    EXPECT_EQ(head.rfind("HTTP/1.1 206 Partial Content\r\n", 0), 0u);
+    EXPECT_NE(head.find("Content-Range: bytes 2-5/10\r\n"), std::string::npos);
+    EXPECT_NE(head.find("Content-Length: 4\r\n"), std::string::npos);
+    EXPECT_NE(head.find("Content-Type: text/plain\r\n"), std::string::npos);
+    EXPECT_EQ(head.find("Content-Length: 10"), std::string::npos);
+
+    // A view of the shared body: nothing is copied
+    ASSERT_EQ(partial->body.size(), 1u);
+    EXPECT_EQ(partial->bytes(partial->body[0]).data(), entry->body->data() + 2);
+    EXPECT_EQ(partial->source, entry);
+}
+
+TEST(ByteRangeTest, SeveralRangesAreMultipart)
+{
+    CachedResponsePtr entry = make_shared_entry("0123456789");
+    auto partial = proxy::range_response(entry, "bytes=0-1,7-", "");
+    ASSERT_TRUE(partial);
+    const std::string &head = *partial->head;
+    const std::string marker = "Content-Type: multipart/byteranges; boundary=";
+    const size_t at = head.find(marker);
+    ASSERT_NE(at, std::string::npos);
+    const std::string boundary = head.substr(at + marker.size(), head.find("\r\n", at) - at - marker.size());
+    EXPECT_EQ(head.find("Content-Type: text/plain"), std::string::npos);
+
+    const std::string expected = "--" + boundary + "\r\nContent-Type: text/plain\r\nContent-Range: bytes 0-1/10\r\n\r\n01" +
+                                 "\r\n--" + boundary + "\r\nContent-Type: text/plain\r\nContent-Range: bytes 7-9/10\r\n\r\n789" +
+                                 "\r\n--" + boundary + "--\r\n";
+    EXPECT_EQ(body_of(*partial), expected);
+    EXPECT_NE(head.find("Content-Length: " + std::to_string(expected.size()) + "\r\n"), std::string::npos);
+
+    StringSink sink;
+    proxy::send_reply(sink, *partial, "HIT", true);
+    EXPECT_EQ(sink.out.rfind(head, 0), 0u);
+    EXPECT_EQ(sink.out.substr(sink.out.size() - expected.size()), expected);
+}
+
+TEST(ByteRangeTest, FileBodiesAreSlicedAsFilePieces)
+{
+    char path[] = "/tmp/byte_range_XXXXXX";
+    const int fd = ::mkstemp(path);
+    ASSERT_GE(fd, 0);
+    ::unlink(path);
+    const std::string file = "record header|0123456789|next record";
+    ASSERT_EQ(::write(fd, file.data(), file.size()), static_cast<ssize_t>(file.size()));
+
+    CachedResponse disk = make_entry("0123456789");
+    disk.body.reset();
+    disk.file_body = proxy::FileBody{std::make_shared<const proxy::FileHandle>(fd), 14, 10};
+    CachedResponsePtr entry = std::make_shared<const CachedResponse>(std::move(disk));
+
+    auto single = proxy::range_response(entry, "bytes=-3", "");
+    ASSERT_TRUE(single);
+    ASSERT_EQ(single->body.size(), 1u);
+    EXPECT_EQ(single->body[0].from, CachedReply::From::File);
+    EXPECT_EQ(single->body[0].offset, 21u);
+    EXPECT_EQ(single->body[0].length, 3u);
+
+    auto multipart = proxy::range_response(entry, "bytes=0-1,8-9", "");
+    ASSERT_TRUE(multipart);
+    StringSink sink;
+    proxy::send_reply(sink, *multipart, "HIT-DISK", false);
+    EXPECT_NE(sink.out.find("Content-Range: bytes 0-1/10\r\n\r\n01\r\n--"), std::string::npos);
+    EXPECT_NE(sink.out.find("Content-Range: bytes 8-9/10\r\n\r\n89\r\n--"), std::string::npos);
+}
+
+TEST(ByteRangeTest, UnsatisfiableIs416)
+{
+    CachedResponsePtr entry = make_shared_entry("0123456789");
+    auto refused = proxy::range_response(entry, "bytes=10-", "");
+    ASSERT_TRUE(refused);
+    EXPECT_EQ(refused->head->rfind("HTTP/1.1 416 Range Not Satisfiable\r\n", 0), 0u);
+    EXPECT_NE(refused->head->find("Content-Range: bytes */10\r\n"), std::string::npos);
+    EXPECT_TRUE(refused->body.empty());
+}
+
+TEST(ByteRangeTest, WholeResponseWhenRangeDoesNotApply)
+{
+    CachedResponsePtr entry = make_shared_entry("0123456789");
+    EXPECT_FALSE(proxy::range_response(entry, "", ""));
+    EXPECT_FALSE(proxy::range_response(entry, "bytes=oops", ""));
+
+    EXPECT_FALSE(proxy::range_response(make_shared_entry("gone", "", std::chrono::seconds(60), "HTTP/1.1 404 Not Found"), "bytes=0-1", ""));
+
+    CachedResponse chunked;
+    chunked.status_line = "HTTP/1.1 200 OK";
+    chunked.headers.add("Transfer-Encoding", "chunked");
+    const std::string framed = "4\r\nabcd\r\n0\r\n\r\n";
+    proxy::seal_cache_entry(chunked, std::vector<char>(framed.begin(), framed.end()));
+    EXPECT_FALSE(proxy::range_response(std::make_shared<const CachedResponse>(std::move(chunked)), "bytes=0-1", ""));
+}
+
+TEST(ByteRangeTest, TakesAndRestoresTheClientsConditions)
+{
+    proxy::HttpHeaders headers;
+    headers.add("Host", "example.com");
+    headers.add("If-None-Match", "\"v1\"");
+    headers.add("Range", "bytes=0-9");
+    proxy::ClientConditions conditions = proxy::take_client_conditions(headers);
+    EXPECT_EQ(conditions.if_none_match, "\"v1\"");
+    EXPECT_EQ(conditions.range, "bytes=0-9");
+    EXPECT_TRUE(conditions.if_modified_since.empty());
+    EXPECT_FALSE(headers.contains("If-None-Match"));
+    EXPECT_FALSE(headers.contains("Range"));
+    EXPECT_FALSE(conditions.empty());
+
+    proxy::restore_client_conditions(headers, conditions);
+    EXPECT_EQ(headers.get("If-None-Match"), "\"v1\"");
+    EXPECT_EQ(headers.get("Range"), "bytes=0-9");
+    EXPECT_FALSE(headers.contains("If-Modified-Since"));
+    EXPECT_TRUE(proxy::take_client_conditions(headers).if_range.empty());
+}
+
+TEST(ByteRangeTest, CurrentCopiesGetA304FromTheEntry)
+{
+    CachedResponsePtr entry = make_shared_entry("0123456789");
+    proxy::ClientConditions conditions;
+    conditions.if_none_match = "\"v0\", W/\"v1\"";
+    conditions.range = "bytes=0-1";
+    auto reply = proxy::cached_reply(entry, conditions);
+    ASSERT_TRUE(reply);
+    EXPECT_EQ(reply->head->rfind("HTTP/1.1 304 Not Modified\r\n", 0), 0u);
+    EXPECT_NE(reply->head->find("ETag: \"v1\"\r\n"), std::string::npos);
+    EXPECT_EQ(reply->head->find("Content-"), std::string::npos);
+    EXPECT_TRUE(reply->body.empty());
+
+    // If-None-Match decides when present, whatever If-Modified-Since says
+    conditions.if_none_match = "\"v0\"";
+    conditions.if_modified_since = "Sat, 17 Oct 2026 10:00:00 GMT";
+    EXPECT_EQ(proxy::cached_reply(entry, conditions)->head->rfind("HTTP/1.1 206 Partial Content\r\n", 0), 0u);
+    conditions.range.clear();
+    EXPECT_FALSE(proxy::cached_reply(entry, conditions));
+
+    conditions.if_none_match.clear();
+    EXPECT_TRUE(proxy::not_modified(conditions, *entry));
+    conditions.if_modified_since = "Sun, 18 Oct 2026 10:00:00 GMT";
+    EXPECT_TRUE(proxy::not_modified(conditions, *entry));
+    conditions.if_modified_since = "Fri, 16 Oct 2026 10:00:00 GMT";
+    EXPECT_FALSE(proxy::not_modified(conditions, *entry));
+    conditions.if_modified_since = "yesterday";
+    EXPECT_FALSE(proxy::not_modified(conditions, *entry));
+    conditions.if_none_match = "*";
+    EXPECT_TRUE(proxy::not_modified(conditions, *entry));
+
+    EXPECT_FALSE(proxy::cached_reply(make_shared_entry("gone", "", std::chrono::seconds(60), "HTTP/1.1 404 Not Found"), conditions));
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/CacheSnapshot.hpp"
+#include "../include/proxy/Resolver.hpp"
+#include "test_entries.hpp"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using proxy::CachedResponse;
+using proxy::CachedResponsePtr;
+using proxy::CacheSnapshot;
+using test_entries::make_shared_entry;
+
+namespace
+{
+    std::string temp_path(const std::string &name)
+    {
+        std::string path = testing::TempDir() + "/" + name;
+        std::remove(path.c_str());
+        return path;
+    }
+}
+
+TEST(CacheSnapshotTest, RoundTripsEntriesLazily)
+{
+    std::string path = temp_path("roundtrip.snap");
+    CachedResponsePtr a = make_shared_entry(1000, 'a');
+    CachedResponsePtr b = make_shared_entry(70000, 'b', std::chrono::seconds(-5)); // already stale
+    EXPECT_EQ(proxy::write_cache_snapshot(path, {{"host/a", a}, {"host/b", b}}), 2u);
+
+    CacheSnapshot snapshot(path);
+    EXPECT_EQ(snapshot.size(), 2u);
+    CachedResponsePtr restored = snapshot.take("host/a");
+    ASSERT_TRUE(restored);
+    EXPECT_EQ(*restored->wire_head, *a->wire_head);
+    EXPECT_EQ(*restored->body, *a->body);
+    EXPECT_EQ(restored->status_line, "HTTP/1.1 200 OK");
+    EXPECT_EQ(restored->headers.get("content-type"), "text/plain");
+    EXPECT_EQ(restored->etag, "\"v1\"");
+    EXPECT_FALSE(restored->is_stale());
+    EXPECT_NEAR(std::chrono::duration<double>(restored->expires_at - a->expires_at).count(), 0.0, 1.0);
+
+    EXPECT_EQ(snapshot.take("host/a"), nullptr); // handed out once
+    CachedResponsePtr stale = snapshot.take("host/b");
+    ASSERT_TRUE(stale);
+    EXPECT_TRUE(stale->is_stale()); // still usable for revalidation
+    EXPECT_EQ(snapshot.take("host/missing"), nullptr);
+    EXPECT_EQ(snapshot.size(), 0u);
+}
+
+TEST(CacheSnapshotTest, CorruptRecordsAreSkipped)
+{
+    std::string path = temp_path("corrupt.snap");
+    proxy::write_cache_snapshot(path, {{"k", make_shared_entry(100, 'x')}});
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(-10, std::ios::end);
+        file.put('y');
+    }
+    CacheSnapshot snapshot(path);
+    EXPECT_EQ(snapshot.size(), 1u);
+    EXPECT_EQ(snapshot.take("k"), nullptr);
+
+    std::string junk = temp_path("junk.snap");
+    std::ofstream(junk) << "not a snapshot at all, just some text";
+    EXPECT_THROW(CacheSnapshot{junk}, std::runtime_error);
+    EXPECT_THROW(CacheSnapshot{temp_path("missing.snap")}, std::runtime_error);
+}
+
+TEST(CacheSnapshotTest, CarriesOverEntriesNotTakenYet)
+{
+    std::string first = temp_path("first.snap");
+    proxy::write_cache_snapshot(first, {{"cold", make_shared_entry(10, 'c')}, {"hot", make_shared_entry(10, 'h')}});
+    CacheSnapshot loaded(first);
+    CachedResponsePtr hot = loaded.take("hot");
+    ASSERT_TRUE(hot);
+
+    std::string second = temp_path("second.snap");
+    EXPECT_EQ(proxy::write_cache_snapshot(second, {{"hot", hot}, {"new", make_shared_entry(10, 'n')}}, &loaded), 3u);
+    CacheSnapshot reloaded(second);
+    EXPECT_EQ(reloaded.size(), 3u);
+    CachedResponsePtr cold = reloaded.take("cold");
+    ASSERT_TRUE(cold);
+    EXPECT_EQ((*cold->body)[0], 'c');
+}
+
+TEST(ResolverSnapshotTest, RestoresUnexpiredNames)
+{
+    std::string path = temp_path("dns.snap");
+    const auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+    {
+        std::ofstream out(path);
+        out << "mini_cdn-dns 1\n"
+            << "warm.snapshot.test " << now_ms + 60000 << " 192.0.2.10 2001:db8::10\n"
+            << "expired.snapshot.test " << now_ms - 1000 << " 192.0.2.11\n";
+    }
+    proxy::Resolver &resolver = proxy::Resolver::instance();
+    EXPECT_EQ(resolver.load_snapshot(path), 1u);
+    std::vector<std::string> ips = resolver.resolve_all("warm.snapshot.test", 80); // no DNS query
+    ASSERT_EQ(ips.size(), 2u);
+
+    std::string saved = temp_path("dns2.snap");
+    EXPECT_GE(resolver.save_snapshot(saved), 1u);
+    std::ifstream in(saved);
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_NE(contents.find("warm.snapshot.test"), std::string::npos);
+    EXPECT_EQ(contents.find("expired.snapshot.test"), std::string::npos);
+    EXPECT_EQ(resolver.load_snapshot(temp_path("missing-dns.snap")), 0u);
+}
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/CachedResponse.hpp"
+#include "test_entries.hpp"
+#include <chrono>
+#include <string>
+
+using proxy::CachedResponse;
+using proxy::Freshness;
+using proxy::StalePolicy;
+using test_entries::make_entry;
+using namespace std::chrono_literals;
+
+TEST(CachedResponseTest, ReadsStaleDirectives)
+{
+    CachedResponse windows = make_entry("", "max-age=60, Stale-While-Revalidate=30, stale-if-error=600");
+    EXPECT_EQ(windows.stale_while_revalidate, 30s);
+    EXPECT_EQ(windows.stale_if_error, 600s);
+
+    CachedResponse unset = make_entry("", "max-age=60");
+    EXPECT_FALSE(unset.stale_while_revalidate);
+    EXPECT_FALSE(unset.stale_if_error);
+
+    for (const char *strict : {"max-age=60, must-revalidate, stale-if-error=600", "proxy-revalidate", "no-cache"})
+    {
+        CachedResponse entry = make_entry("", strict);
+        EXPECT_EQ(entry.stale_while_revalidate, 0s) << strict;
+        EXPECT_EQ(entry.stale_if_error, 0s) << strict;
+    }
+}
+
+TEST(CachedResponseTest, StaleWindowsFollowTheOriginThenThePolicy)
+{
+    StalePolicy policy;
+    policy.while_revalidate = 10s;
+    policy.if_error = 100s;
+    CachedResponse entry = make_entry("", "max-age=60");
+    const auto expiry = entry.expires_at;
+
+    EXPECT_EQ(proxy::cache_freshness(entry, policy, expiry - 1s, 0.5), Freshness::Fresh);
+    EXPECT_EQ(proxy::cache_freshness(entry, policy, expiry + 5s, 0.5), Freshness::StaleWhileRevalidate);
+    EXPECT_EQ(proxy::cache_freshness(entry, policy, expiry + 11s, 0.5), Freshness::Expired);
+    EXPECT_TRUE(proxy::usable_if_error(entry, policy, expiry + 99s));
+    EXPECT_FALSE(proxy::usable_if_error(entry, policy, expiry + 101s));
+
+    CachedResponse origin = make_entry("", "max-age=60, stale-while-revalidate=30, stale-if-error=0");
+    EXPECT_EQ(proxy::cache_freshness(origin, policy, origin.expires_at + 20s, 0.5), Freshness::StaleWhileRevalidate);
+    EXPECT_FALSE(proxy::usable_if_error(origin, policy, origin.expires_at + 1s));
+
+    CachedResponse strict = make_entry("", "max-age=60, must-revalidate");
+    EXPECT_EQ(proxy::cache_freshness(strict, policy, strict.expires_at + 1s, 0.5), Freshness::Expired);
+}
+
+TEST(CachedResponseTest, NothingIsServedStaleUnlessTheOriginOrOperatorSaysSo)
+{
+    StalePolicy policy;
+    CachedResponse entry = make_entry("", "max-age=60");
+    EXPECT_EQ(proxy::cache_freshness(entry, policy, entry.expires_at + 1s, 0.5), Freshness::Expired);
+    EXPECT_FALSE(proxy::usable_if_error(entry, policy, entry.expires_at + 1s));
+
+    CachedResponse origin = make_entry("", "max-age=60, stale-while-revalidate=30, stale-if-error=600");
+    EXPECT_EQ(proxy::cache_freshness(origin, policy, origin.expires_at + 20s, 0.5), Freshness::StaleWhileRevalidate);
+    EXPECT_TRUE(proxy::usable_if_error(origin, policy, origin.expires_at + 500s));
+}
+
+TEST(CachedResponseTest, EarlyRefreshGrowsNearExpiryAndWithFetchTime)
+{
+    StalePolicy policy;
+    CachedResponse entry = make_entry("", "max-age=60");
+    entry.fetch_time = 1000ms;
+    const auto expiry = entry.expires_at;
+
+    // -ln(random) * fetch_time: random = 0.5 reaches about 0.69 s ahead of expiry
+    EXPECT_EQ(proxy::cache_freshness(entry, policy, expiry - 600ms, 0.5), Freshness::RefreshEarly);
+    EXPECT_EQ(proxy::cache_freshness(entry, policy, expiry - 800ms, 0.5), Freshness::Fresh);
+    EXPECT_EQ(proxy::cache_freshness(entry, policy, expiry - 30s, 1e-20), Freshness::RefreshEarly); // rare long draw
+    EXPECT_EQ(proxy::cache_freshness(entry, policy, expiry - 1ms, 1.0), Freshness::Fresh);
+
+    CachedResponse slow = make_entry("", "max-age=60");
+    slow.fetch_time = 4000ms;
+    EXPECT_EQ(proxy::cache_freshness(slow, policy, expiry - 2s, 0.5), Freshness::RefreshEarly);
+
+    policy.early_refresh_beta = 0;
+    EXPECT_EQ(proxy::cache_freshness(entry, policy, expiry - 1ms, 1e-20), Freshness::Fresh);
+    policy.early_refresh_beta = 1;
+    CachedResponse unknown = make_entry("", "max-age=60"); // restored entries have no fetch time
+    EXPECT_EQ(proxy::cache_freshness(unknown, policy, expiry - 1ms, 1e-20), Freshness::Fresh);
+}
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/SocketUtils.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+
+namespace
+{
+    // Listener on 127.0.0.1 with a kernel-chosen port
+    struct LoopbackListener
+    {
+        int fd = -1;
+        int port = 0;
+
+        LoopbackListener()
+        {
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+            listen(fd, 8);
+            socklen_t len = sizeof(addr);
+            getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+            port = ntohs(addr.sin_port);
+        }
+        ~LoopbackListener() { ::close(fd); }
+    };
+}
+
+TEST(ConnectRaceTest, ConnectsToListener)
+{
+    LoopbackListener listener;
+    std::string ip;
+    int fd = net::connect_race({"127.0.0.1"}, listener.port, std::chrono::seconds(2), nullptr, &ip);
+    EXPECT_GE(fd, 0);
+    EXPECT_EQ(ip, "127.0.0.1");
+    ::close(fd);
+}
+
+TEST(ConnectRaceTest, RefusedAddressFallsThroughWithoutDelay)
+{
+    LoopbackListener listener; // bound to 127.0.0.1 only: 127.0.0.2 refuses
+    std::vector<net::ConnectOutcome> outcomes;
+    std::string ip;
+    auto start = std::chrono::steady_clock::now();
+    int fd = net::connect_race({"127.0.0.2", "127.0.0.1"}, listener.port, std::chrono::seconds(2), &outcomes, &ip);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    ::close(fd);
+
+    EXPECT_EQ(ip, "127.0.0.1");
+    EXPECT_LT(elapsed, net::ConnectRace::kAttemptDelay); // the failure launched the next address at once
+    ASSERT_EQ(outcomes.size(), 2u);
+    EXPECT_EQ(outcomes[0].ip, "127.0.0.2");
+    EXPECT_NE(outcomes[0].error, 0);
+    EXPECT_EQ(outcomes[1].error, 0);
+}
+
+TEST(ConnectRaceTest, TimeoutIsEnforced)
+{
+    // Non-routable: either fails at once (no route) or never answers; both must end quickly
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_THROW(net::connect_race({"10.255.255.1"}, 80, std::chrono::milliseconds(300)), std::runtime_error);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+}
+
+TEST(ConnectRaceTest, AllAddressesFail)
+{
+    int port;
+    {
+        LoopbackListener listener;
+        port = listener.port; // closed again: nothing listens there any more
+    }
+    std::vector<net::ConnectOutcome> outcomes;
+    EXPECT_THROW(net::connect_race({"127.0.0.1", "127.0.0.2"}, port, std::chrono::seconds(2), &outcomes), std::runtime_error);
+    EXPECT_EQ(outcomes.size(), 2u);
+}
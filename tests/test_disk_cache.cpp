@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/DiskCache.hpp"
+#include "test_entries.hpp"
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using proxy::CachedResponse;
+using proxy::DiskCache;
+using test_entries::make_entry;
+
+namespace
+{
+    std::string fresh_dir(const std::string &name)
+    {
+        std::string dir = testing::TempDir() + "/disk_cache_" + name;
+        std::filesystem::remove_all(dir);
+        return dir;
+    }
+
+    class CopySink : public proxy::ResponseSink
+    {
+    public:
+        void write(std::string_view data) override { out.append(data); }
+        std::string out;
+    };
+}
+
+TEST(DiskCacheTest, ServesStoredEntriesFromTheFile)
+{
+    DiskCache disk(fresh_dir("serve"), 8 << 20);
+    CachedResponse entry = make_entry(100000, 'x');
+    ASSERT_TRUE(disk.store("origin:80/a.m4s", entry));
+    EXPECT_EQ(disk.size(), 1u);
+
+    proxy::CachedResponsePtr hit = disk.lookup("origin:80/a.m4s");
+    ASSERT_TRUE(hit);
+    EXPECT_FALSE(hit->body);
+    EXPECT_EQ(hit->body_size(), 100000u);
+    EXPECT_EQ(*hit->wire_head, *entry.wire_head);
+    EXPECT_EQ(hit->status_line, "HTTP/1.1 200 OK");
+    EXPECT_EQ(hit->etag, entry.etag);
+    EXPECT_EQ(hit->last_modified, entry.last_modified);
+    EXPECT_FALSE(hit->is_stale());
+
+    CopySink sink;
+    proxy::send_cached_response(sink, *hit, "HIT-DISK", true);
+    std::string head = *entry.wire_head + proxy::cache_hit_headers(*hit, "HIT-DISK", true);
+    ASSERT_EQ(sink.out.size(), head.size() + 100000);
+    EXPECT_EQ(sink.out.substr(0, head.size()), head);
+    EXPECT_EQ(sink.out.substr(head.size()), std::string(100000, 'x'));
+
+    EXPECT_EQ(disk.lookup("origin:80/other.m4s"), nullptr);
+    DiskCache::Stats stats = disk.stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.stores, 1u);
+}
+
+TEST(DiskCacheTest, HitsComeFromTheIndexWithoutReadingTheRecord)
+{
+    const std::string dir = fresh_dir("index");
+    DiskCache disk(dir, 8 << 20);
+    ASSERT_TRUE(disk.store("k", make_entry(1000, 'x')));
+    {
+        // Wipe the record's metadata; only the body is ever read from the file
+        std::fstream file(dir + "/segment-0.log", std::ios::in | std::ios::out | std::ios::binary);
+        file.write(std::string(64, '\0').data(), 64);
+    }
+
+    proxy::CachedResponsePtr hit = disk.lookup("k");
+    ASSERT_TRUE(hit);
+    EXPECT_EQ(hit->headers.get("content-type"), "text/plain");
+    EXPECT_EQ(hit->etag, "\"v1\"");
+    EXPECT_EQ(disk.lookup("k"), hit); // the same shared entry, not a new one per hit
+}
+
+TEST(DiskCacheTest, StaleEntriesMissAndLeaveTheIndex)
+{
+    DiskCache disk(fresh_dir("stale"), 8 << 20);
+    ASSERT_TRUE(disk.store("k", make_entry(10, 'b', std::chrono::seconds(-1))));
+    EXPECT_EQ(disk.lookup("k"), nullptr);
+    EXPECT_EQ(disk.size(), 0u);
+}
+
+TEST(DiskCacheTest, RewrittenKeysServeTheNewestRecord)
+{
+    DiskCache disk(fresh_dir("rewrite"), 8 << 20);
+    ASSERT_TRUE(disk.store("k", make_entry(1000, 'a')));
+    ASSERT_TRUE(disk.store("k", make_entry(2000, 'b')));
+    proxy::CachedResponsePtr hit = disk.lookup("k");
+    ASSERT_TRUE(hit);
+    EXPECT_EQ(hit->body_size(), 2000u);
+    EXPECT_EQ(disk.size(), 1u);
+}
+
+TEST(DiskCacheTest, DropsTheOldestSegmentWhenFull)
+{
+    std::string dir = fresh_dir("fifo");
+    DiskCache disk(dir, 256 << 10, 64 << 10); // four 64 KB segments, two 30 KB records each
+    for (int i = 0; i < 12; ++i)
+        ASSERT_TRUE(disk.store("k" + std::to_string(i), make_entry(30 << 10)));
+
+    EXPECT_LE(disk.bytes(), size_t{256} << 10);
+    EXPECT_GT(disk.stats().dropped_segments, 0u);
+    EXPECT_EQ(disk.lookup("k0"), nullptr);
+    EXPECT_NE(disk.lookup("k11"), nullptr);
+    size_t files = 0;
+    for (const auto &file : std::filesystem::directory_iterator(dir))
+        files += file.path().extension() == ".log";
+    EXPECT_LE(files, 4u);
+}
+
+TEST(DiskCacheTest, RejectsRecordsLargerThanASegment)
+{
+    DiskCache disk(fresh_dir("reject"), 256 << 10, 64 << 10);
+    EXPECT_FALSE(disk.store("big", make_entry(64 << 10)));
+    EXPECT_EQ(disk.stats().rejected, 1u);
+    EXPECT_LT(disk.max_object_bytes(), size_t{64} << 10);
+    EXPECT_THROW(DiskCache(fresh_dir("tiny"), 100 << 10, 64 << 10), std::invalid_argument);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../include/proxy/CachedResponse.hpp"
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace test_entries
+{
+    /**
+     * @brief A cache entry as the proxy fills one from an origin response: a text/plain body
+     *        with its Content-Length, the ETag and Last-Modified validators (as headers and as
+     *        parsed fields), the stale directives of `cache_control` and a sealed head block.
+     *        Fresh for `max_age` from now.
+     */
+    inline proxy::CachedResponse make_entry(const std::string &body, const std::string &cache_control = "",
+                                            std::chrono::seconds max_age = std::chrono::seconds(60),
+                                            const std::string &status_line = "HTTP/1.1 200 OK")
+    {
+        proxy::CachedResponse entry;
+        entry.status_line = status_line;
+        entry.headers.add("Content-Type", "text/plain");
+        entry.headers.add("Content-Length", std::to_string(body.size()));
+        entry.headers.add("ETag", "\"v1\"");
+        entry.headers.add("Last-Modified", "Sat, 17 Oct 2026 10:00:00 GMT");
+        if (!cache_control.empty())
+            entry.headers.add("Cache-Control", cache_control);
+        entry.etag = "\"v1\"";
+        entry.last_modified = "Sat, 17 Oct 2026 10:00:00 GMT";
+        entry.received_at = std::chrono::steady_clock::now();
+        entry.max_age = max_age;
+        entry.expires_at = entry.received_at + max_age;
+        proxy::read_stale_directives(entry);
+        proxy::seal_cache_entry(entry, std::vector<char>(body.begin(), body.end()));
+        return entry;
+    }
+
+    /** @brief An entry whose body is `body_bytes` copies of `fill`. */
+    inline proxy::CachedResponse make_entry(size_t body_bytes, char fill = 'b',
+                                            std::chrono::seconds max_age = std::chrono::seconds(60))
+    {
+        return make_entry(std::string(body_bytes, fill), "", max_age);
+    }
+
+    /** @brief make_entry, shared the way the memory tier holds it. */
+    template <typename... Args>
+    proxy::CachedResponsePtr make_shared_entry(Args &&...args)
+    {
+        return std::make_shared<const proxy::CachedResponse>(make_entry(std::forward<Args>(args)...));
+    }
+}
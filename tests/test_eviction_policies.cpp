@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/ClockCache.hpp"
+#include "../include/proxy/FlatLruCache.hpp"
+#include "../include/proxy/S3FifoCache.hpp"
+#include "../include/proxy/ShardedLruCache.hpp"
+#include "../include/proxy/SlruCache.hpp"
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+template <typename Cache>
+class EvictionPolicyTest : public ::testing::Test
+{
+};
+
+using PolicyCaches = ::testing::Types<Cache::FlatLruCache<std::string, std::string>,
+                                      Cache::ClockCache<std::string, std::string>,
+                                      Cache::S3FifoCache<std::string, std::string>,
+                                      Cache::SlruCache<std::string, std::string>>;
+TYPED_TEST_SUITE(EvictionPolicyTest, PolicyCaches);
+
+TYPED_TEST(EvictionPolicyTest, WeightedPutGetUpdate)
+{
+    TypeParam cache(1000, [](const std::string &, const std::string &value) { return value.size(); }, 0.5);
+    EXPECT_TRUE(cache.put("a", std::string(300, 'a')));
+    EXPECT_TRUE(cache.put("b", std::string(300, 'b')));
+    size_t weight = 0;
+    EXPECT_EQ(cache.get("a", &weight), std::string(300, 'a'));
+    EXPECT_EQ(weight, 300u);
+    EXPECT_EQ(cache.get("missing"), std::nullopt);
+    EXPECT_TRUE(cache.put("a", std::string(100, 'a')));
+    EXPECT_EQ(cache.weight(), 400u);
+
+    // Too heavy: rejected, and the old value goes with it
+    EXPECT_FALSE(cache.put("b", std::string(501, 'b')));
+    EXPECT_FALSE(cache.contains("b"));
+    EXPECT_EQ(cache.weight(), 100u);
+    EXPECT_GE(cache.peak_weight(), 600u);
+
+    EXPECT_THROW(TypeParam(0), std::invalid_argument);
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_FALSE(cache.get("a"));
+}
+
+TEST(EvictionPolicyTest, ArgumentErrorsNameThePolicy)
+{
+    try
+    {
+        Cache::S3FifoCache<std::string, std::string> cache(0);
+        FAIL();
+    }
+    catch (const std::invalid_argument &e)
+    {
+        EXPECT_STREQ(e.what(), "S3FifoCache capacity must be greater than 0.");
+    }
+    try
+    {
+        Cache::ClockCache<std::string, std::string> cache(10, nullptr, 1.5);
+        FAIL();
+    }
+    catch (const std::invalid_argument &e)
+    {
+        EXPECT_STREQ(e.what(), "ClockCache max entry fraction must be in (0, 1].");
+    }
+}
+
+TYPED_TEST(EvictionPolicyTest, GrowingAnEntryInPlaceEvictsTheOthers)
+{
+    // The grown entry is the oldest, and the only one in its queue or segment once the other goes
+    TypeParam cache(100, [](const std::string &, const std::string &value) { return value.size(); });
+    EXPECT_TRUE(cache.put("a", std::string(5, 'a')));
+    EXPECT_TRUE(cache.put("b", std::string(5, 'b')));
+    EXPECT_TRUE(cache.put("a", std::string(96, 'a')));
+    EXPECT_EQ(cache.get("a"), std::string(96, 'a'));
+    EXPECT_FALSE(cache.contains("b"));
+    EXPECT_EQ(cache.weight(), 96u);
+
+    EXPECT_TRUE(cache.put("c", std::string(4, 'c')));
+    EXPECT_TRUE(cache.put("c", std::string(100, 'c')));
+    EXPECT_EQ(cache.size(), 1u);
+    EXPECT_EQ(cache.weight(), 100u);
+}
+
+TYPED_TEST(EvictionPolicyTest, ChurnStaysWithinCapacity)
+{
+    TypeParam cache(2000, [](const std::string &, const std::string &value) { return value.size(); }, 0.25);
+    std::mt19937 rng(7);
+    for (int i = 0; i < 20000; ++i)
+    {
+        const std::string key = std::to_string(rng() % 300);
+        if (rng() % 3 == 0)
+            ASSERT_TRUE(cache.put(key, std::string(1 + rng() % 500, 'v')));
+        else
+            cache.get(key);
+        ASSERT_LE(cache.weight(), 2000u);
+    }
+    size_t total = 0;
+    const auto items = cache.entries();
+    for (const auto &[key, value] : items)
+    {
+        EXPECT_TRUE(cache.contains(key));
+        total += value.size();
+    }
+    EXPECT_EQ(items.size(), cache.size());
+    EXPECT_EQ(total, cache.weight());
+}
+
+TEST(ClockCacheTest, ReferencedEntriesGetASecondChance)
+{
+    Cache::ClockCache<int, int> cache(3);
+    cache.put(1, 1);
+    cache.put(2, 2);
+    cache.put(3, 3);
+    EXPECT_EQ(cache.get(1), 1);
+    cache.put(4, 4); // the hand clears 1's bit and takes 2
+    EXPECT_TRUE(cache.contains(1));
+    EXPECT_FALSE(cache.contains(2));
+    EXPECT_TRUE(cache.contains(3));
+    EXPECT_TRUE(cache.contains(4));
+    cache.put(5, 5); // the hand moves on from where it stopped: 3 goes
+    EXPECT_FALSE(cache.contains(3));
+    EXPECT_TRUE(cache.contains(1));
+    cache.put(6, 6); // 4, then 1, whose bit is clear now
+    cache.put(7, 7);
+    EXPECT_FALSE(cache.contains(4));
+    EXPECT_FALSE(cache.contains(1));
+}
+
+TEST(S3FifoCacheTest, OneHitWondersLeaveThroughTheSmallQueue)
+{
+    Cache::S3FifoCache<int, int> cache(10);
+    for (int hot = 0; hot < 5; ++hot)
+    {
+        cache.put(hot, hot);
+        cache.get(hot);
+    }
+    for (int once = 100; once < 1000; ++once)
+        cache.put(once, once);
+    for (int hot = 0; hot < 5; ++hot)
+        EXPECT_TRUE(cache.contains(hot)) << hot;
+    EXPECT_EQ(cache.size(), 10u);
+}
+
+TEST(S3FifoCacheTest, GhostHitsGoStraightToTheMainQueue)
+{
+    Cache::S3FifoCache<int, int> cache(10);
+    for (int i = 0; i <= 10; ++i)
+        cache.put(i, i); // 0 is evicted unseen and remembered
+    EXPECT_FALSE(cache.contains(0));
+    cache.put(0, 0);
+    EXPECT_EQ(cache.entries().front().first, 0);
+    for (int once = 100; once < 200; ++once)
+        cache.put(once, once);
+    EXPECT_TRUE(cache.contains(0));
+}
+
+TEST(S3FifoCacheTest, GrowingTheMainTailWithTheSmallQueueEmpty)
+{
+    Cache::S3FifoCache<std::string, std::string> cache(100, [](const std::string &, const std::string &value) { return value.size(); });
+    for (const char *key : {"x", "y", "z", "w"})
+        cache.put(key, std::string(40, 'v')); // "x" and "y" leave through the small queue, into the ghost
+    cache.put("x", std::string(5, 'x'));      // back from the ghost: main
+    cache.put("y", std::string(5, 'y'));
+    cache.put("y", std::string(50, 'y')); // "z" goes
+    ASSERT_FALSE(cache.contains("z"));
+
+    // "w" goes next, then "x" is the main FIFO's tail with the small FIFO empty
+    EXPECT_TRUE(cache.put("x", std::string(60, 'x')));
+    EXPECT_EQ(cache.get("x"), std::string(60, 'x'));
+    EXPECT_FALSE(cache.contains("w"));
+    EXPECT_FALSE(cache.contains("y"));
+    EXPECT_EQ(cache.weight(), 60u);
+}
+
+TEST(SlruCacheTest, ProtectedEntriesSurviveScans)
+{
+    Cache::SlruCache<int, int> cache(10);
+    for (int hot = 0; hot < 5; ++hot)
+    {
+        cache.put(hot, hot);
+        cache.get(hot);
+    }
+    for (int once = 100; once < 200; ++once)
+        cache.put(once, once);
+    for (int hot = 0; hot < 5; ++hot)
+        EXPECT_TRUE(cache.contains(hot)) << hot;
+
+    // Protected holds 8: promoting more demotes the least recently used back to probation
+    for (int i = 10; i < 20; ++i)
+    {
+        cache.put(i, i);
+        cache.get(i);
+    }
+    EXPECT_EQ(cache.size(), 10u);
+    EXPECT_EQ(cache.entries().front().first, 19);
+}
+
+TEST(ShardedEvictionPolicyTest, ConcurrentHitsUnderSharedLocks)
+{
+    for (auto policy : {Cache::EvictionPolicy::Clock, Cache::EvictionPolicy::S3Fifo, Cache::EvictionPolicy::Slru})
+    {
+        Cache::ShardedLruCache<std::string, std::string> cache(200, 2, nullptr, 1.0, policy);
+        EXPECT_EQ(cache.policy(), policy);
+        for (int i = 0; i < 50; ++i)
+            cache.put("hot" + std::to_string(i), std::to_string(i));
+
+        const int threads = 8, ops = 5000;
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t)
+            workers.emplace_back(
+                [&, t]
+                {
+                    for (int i = 0; i < ops; ++i)
+                    {
+                        const int k = (i * 7 + t) % 60;
+                        if (t == 0 && i % 10 == 0)
+                            cache.put("cold" + std::to_string(i), "x");
+                        else if (auto v = cache.get("hot" + std::to_string(k)))
+                        {
+                            EXPECT_EQ(*v, std::to_string(k));
+                        }
+                    }
+                });
+        for (auto &w : workers)
+            w.join();
+
+        const auto stats = cache.stats();
+        EXPECT_EQ(stats.hits + stats.misses, static_cast<uint64_t>(threads * ops - ops / 10));
+        EXPECT_GT(stats.hits, stats.misses);
+        EXPECT_LE(cache.weight(), 200u);
+    }
+    EXPECT_EQ(Cache::parse_eviction_policy("s3fifo"), Cache::EvictionPolicy::S3Fifo);
+    EXPECT_EQ(Cache::parse_eviction_policy("lfu"), std::nullopt);
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/FlatLruCache.hpp"
+#include "../include/proxy/LruCache.hpp"
+#include <random>
+#include <string>
+#include <string_view>
+
+TEST(FlatLruCacheTest, EvictsTheLeastRecentlyUsed)
+{
+    Cache::FlatLruCache<std::string, std::string> cache(2);
+    cache.put("a", "1");
+    cache.put("b", "2");
+    cache.get("a");      // mark "a" as recently used
+    cache.put("c", "3"); // "b" should be evicted
+
+    EXPECT_TRUE(cache.contains("a"));
+    EXPECT_FALSE(cache.contains("b"));
+    EXPECT_TRUE(cache.contains("c"));
+    cache.put("a", "updated");
+    EXPECT_EQ(cache.get("a"), std::optional<std::string>{"updated"});
+    EXPECT_EQ(cache.size(), 2u);
+}
+
+TEST(FlatLruCacheTest, LooksUpStringViewsWithoutOwningTheKey)
+{
+    Cache::FlatLruCache<std::string, std::string> cache(10);
+    cache.put("example.com/video/seg-1.m4s", "1");
+    std::string request = "GET example.com/video/seg-1.m4s HTTP/1.1";
+    std::string_view key = std::string_view(request).substr(4, 27);
+    size_t weight = 0;
+    EXPECT_EQ(cache.get(key, &weight), std::optional<std::string>{"1"});
+    EXPECT_EQ(weight, 1u);
+    EXPECT_FALSE(cache.contains(std::string_view(request).substr(4, 26)));
+}
+
+TEST(FlatLruCacheTest, WeighsEntriesAndEvictsUntilTheyFit)
+{
+    Cache::FlatLruCache<std::string, std::string> cache(100, [](const std::string &, const std::string &v)
+                                                        { return v.size(); }, 0.6);
+    cache.put("a", std::string(40, 'a'));
+    cache.put("b", std::string(40, 'b'));
+    EXPECT_TRUE(cache.put("c", std::string(50, 'c')));
+    EXPECT_FALSE(cache.contains("a"));
+    EXPECT_EQ(cache.weight(), 90u);
+
+    EXPECT_FALSE(cache.put("b", std::string(70, 'B'))); // over max_entry_weight(): the old "b" goes too
+    EXPECT_FALSE(cache.contains("b"));
+    EXPECT_EQ(cache.weight(), 50u);
+    EXPECT_EQ(cache.peak_weight(), 90u);
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_EQ(cache.weight(), 0u);
+    EXPECT_THROW((Cache::FlatLruCache<int, int>(0)), std::invalid_argument);
+}
+
+TEST(FlatLruCacheTest, BehavesLikeLruCacheUnderChurn)
+{
+    // Enough keys to grow the table several times and exercise backward-shift deletion
+    Cache::FlatLruCache<int, int> flat(500);
+    Cache::LruCache<int, int> list(500);
+    std::mt19937 rng(7);
+    for (int i = 0; i < 200000; ++i)
+    {
+        int key = static_cast<int>(rng() % 2000);
+        if (rng() % 3 == 0)
+        {
+            EXPECT_EQ(flat.put(key, i), list.put(key, i));
+        }
+        else
+        {
+            ASSERT_EQ(flat.get(key), list.get(key)) << "op " << i;
+        }
+    }
+    EXPECT_EQ(flat.size(), list.size());
+    EXPECT_EQ(flat.entries(), list.entries());
+}
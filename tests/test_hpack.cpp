@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/Hpack.hpp"
+#include <string>
+#include <vector>
+
+using proxy::HeaderField;
+using proxy::HeaderList;
+using proxy::HpackDecoder;
+using proxy::HpackEncoder;
+using proxy::HpackError;
+
+namespace
+{
+    HeaderList decode(HpackDecoder &decoder, const std::vector<uint8_t> &block)
+    {
+        return decoder.decode(block.data(), block.size());
+    }
+
+    void expect_headers(const HeaderList &got, const HeaderList &want)
+    {
+        ASSERT_EQ(got.size(), want.size());
+        for (size_t i = 0; i < want.size(); ++i)
+        {
+            EXPECT_EQ(got[i].name, want[i].name) << "field " << i;
+            EXPECT_EQ(got[i].value, want[i].value) << "field " << i;
+        }
+    }
+}
+
+// RFC 7541 C.3: requests without Huffman coding, one decoder across all three
+TEST(HpackTest, DecodesRequestsWithoutHuffman)
+{
+    HpackDecoder decoder;
+    expect_headers(decode(decoder, {0x82, 0x86, 0x84, 0x41, 0x0f, 0x77, 0x77, 0x77, 0x2e, 0x65, 0x78, 0x61,
+                                    0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x63, 0x6f, 0x6d}),
+                   {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}});
+    EXPECT_EQ(decoder.table_size(), 57u);
+
+    expect_headers(decode(decoder, {0x82, 0x86, 0x84, 0xbe, 0x58, 0x08, 0x6e, 0x6f, 0x2d, 0x63, 0x61, 0x63,
+                                    0x68, 0x65}),
+                   {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"},
+                    {"cache-control", "no-cache"}});
+    EXPECT_EQ(decoder.table_size(), 110u);
+
+    expect_headers(decode(decoder, {0x82, 0x87, 0x85, 0xbf, 0x40, 0x0a, 0x63, 0x75, 0x73, 0x74, 0x6f, 0x6d,
+                                    0x2d, 0x6b, 0x65, 0x79, 0x0c, 0x63, 0x75, 0x73, 0x74, 0x6f, 0x6d, 0x2d,
+                                    0x76, 0x61, 0x6c, 0x75, 0x65}),
+                   {{":method", "GET"}, {":scheme", "https"}, {":path", "/index.html"},
+                    {":authority", "www.example.com"}, {"custom-key", "custom-value"}});
+    EXPECT_EQ(decoder.table_size(), 164u);
+}
+
+// RFC 7541 C.4: the same requests with Huffman-coded strings
+TEST(HpackTest, DecodesRequestsWithHuffman)
+{
+    HpackDecoder decoder;
+    expect_headers(decode(decoder, {0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b,
+                                    0xa0, 0xab, 0x90, 0xf4, 0xff}),
+                   {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}});
+
+    expect_headers(decode(decoder, {0x82, 0x86, 0x84, 0xbe, 0x58, 0x86, 0xa8, 0xeb, 0x10, 0x64, 0x9c, 0xbf}),
+                   {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"},
+                    {"cache-control", "no-cache"}});
+
+    expect_headers(decode(decoder, {0x82, 0x87, 0x85, 0xbf, 0x40, 0x88, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xa9,
+                                    0x7d, 0x7f, 0x89, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xb8, 0xe8, 0xb4, 0xbf}),
+                   {{":method", "GET"}, {":scheme", "https"}, {":path", "/index.html"},
+                    {":authority", "www.example.com"}, {"custom-key", "custom-value"}});
+    EXPECT_EQ(decoder.table_size(), 164u);
+}
+
+// RFC 7541 C.5: a 256-byte table forces evictions across responses
+TEST(HpackTest, EvictsWhenTableIsFull)
+{
+    HpackDecoder decoder(256);
+    // 4.1 then 4.2 after a size update down to 256: the first response fills the table exactly
+    auto first = decode(decoder, {0x48, 0x03, 0x33, 0x30, 0x32, 0x58, 0x07, 0x70, 0x72, 0x69, 0x76, 0x61, 0x74,
+                                  0x65, 0x61, 0x1d, 0x4d, 0x6f, 0x6e, 0x2c, 0x20, 0x32, 0x31, 0x20, 0x4f, 0x63,
+                                  0x74, 0x20, 0x32, 0x30, 0x31, 0x33, 0x20, 0x32, 0x30, 0x3a, 0x31, 0x33, 0x3a,
+                                  0x32, 0x31, 0x20, 0x47, 0x4d, 0x54, 0x6e, 0x17, 0x68, 0x74, 0x74, 0x70, 0x73,
+                                  0x3a, 0x2f, 0x2f, 0x77, 0x77, 0x77, 0x2e, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c,
+                                  0x65, 0x2e, 0x63, 0x6f, 0x6d});
+    ASSERT_EQ(first.size(), 4u);
+    EXPECT_EQ(first[0].name, ":status");
+    EXPECT_EQ(first[0].value, "302");
+    EXPECT_EQ(decoder.table_size(), 222u);
+
+    // ":status: 307" evicts ":status: 302"; the other three entries are reused by index
+    expect_headers(decode(decoder, {0x48, 0x03, 0x33, 0x30, 0x37, 0xc1, 0xc0, 0xbf}),
+                   {{":status", "307"}, {"cache-control", "private"}, {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+                    {"location", "https://www.example.com"}});
+    EXPECT_EQ(decoder.table_size(), 222u);
+}
+
+TEST(HpackTest, TableSizeUpdateAboveLimitIsAnError)
+{
+    HpackDecoder decoder(4096);
+    std::vector<uint8_t> ok{0x3f, 0xe1, 0x1f, 0x82}; // size update to 4096, then ":method: GET"
+    EXPECT_EQ(decode(decoder, ok).size(), 1u);
+
+    std::vector<uint8_t> too_big{0x3f, 0xe2, 0x1f}; // 4097
+    EXPECT_THROW(decode(decoder, too_big), HpackError);
+}
+
+TEST(HpackTest, RejectsMalformedBlocks)
+{
+    HpackDecoder decoder;
+    std::vector<uint8_t> bad_index{0xff, 0x00};            // index 127 with an empty table
+    std::vector<uint8_t> truncated{0x41, 0x0f, 0x77, 0x77}; // literal longer than the block
+    std::vector<uint8_t> zero_index{0x80};
+    EXPECT_THROW(decode(decoder, bad_index), HpackError);
+    EXPECT_THROW(decode(decoder, truncated), HpackError);
+    EXPECT_THROW(decode(decoder, zero_index), HpackError);
+}
+
+TEST(HpackTest, RejectsOversizedHeaderList)
+{
+    HpackDecoder decoder(4096, 100);
+    std::vector<uint8_t> block{0x00, 0x01, 'x', 0x7f, 0x00}; // literal "x", value of 127 bytes
+    block.insert(block.end(), 127, 'v');
+    EXPECT_THROW(decode(decoder, block), HpackError);
+}
+
+TEST(HpackTest, HuffmanRejectsBadPadding)
+{
+    // "www.example.com" followed by a full byte of EOS padding (more than 7 bits)
+    std::vector<uint8_t> padded{0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0, 0xab, 0x90, 0xf4, 0xff, 0xff};
+    EXPECT_THROW(HpackDecoder::huffman_decode(padded.data(), padded.size()), HpackError);
+}
+
+TEST(HpackTest, EncoderOutputRoundTrips)
+{
+    HeaderList headers{{":status", "200"},
+                       {":status", "206"},
+                       {"content-type", "video/mp4"},
+                       {"content-length", "123456"},
+                       {"x-cache", "HIT"},
+                       {"long-value", std::string(300, 'a')}};
+    std::string block = HpackEncoder::encode(headers);
+    EXPECT_EQ(static_cast<uint8_t>(block[0]), 0x88); // fully indexed ":status: 200"
+
+    HpackDecoder decoder;
+    expect_headers(decoder.decode(reinterpret_cast<const uint8_t *>(block.data()), block.size()), headers);
+    EXPECT_EQ(decoder.table_size(), 0u); // nothing indexed, so the peer's table is never touched
+}
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/HttpHeaders.hpp"
+#include <cctype>
+#include <string>
+#include <vector>
+
+using proxy::header_id;
+using proxy::HeaderId;
+using proxy::HttpHeaders;
+
+// Every well-known name maps to its own id, in any case; anything else is Other
+TEST(HttpHeadersTest, InternsWellKnownNamesCaseInsensitively)
+{
+    static_assert(header_id("Cache-Control") == HeaderId::CacheControl, "resolved at compile time");
+    for (size_t i = 1; i < proxy::kHeaderNames.size(); ++i)
+    {
+        std::string name(proxy::kHeaderNames[i]);
+        EXPECT_EQ(header_id(name), static_cast<HeaderId>(i)) << name;
+        for (char &c : name)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        EXPECT_EQ(header_id(name), static_cast<HeaderId>(i)) << name;
+    }
+    EXPECT_EQ(header_id("X-Cache"), HeaderId::Other);
+    EXPECT_EQ(header_id("Hosts"), HeaderId::Other);
+    EXPECT_EQ(header_id("Rangf"), HeaderId::Other); // differs from "Range" in the last byte only
+    EXPECT_EQ(header_id(""), HeaderId::Other);
+}
+
+TEST(HttpHeadersTest, LooksUpAnySpelling)
+{
+    HttpHeaders headers;
+    headers.add("cache-control", "max-age=60");
+    headers.add("X-Custom", "1");
+    headers.add("ETAG", "\"v1\"");
+
+    EXPECT_EQ(headers.get(HeaderId::CacheControl), "max-age=60");
+    EXPECT_EQ(headers.get("Cache-Control"), "max-age=60");
+    EXPECT_EQ(headers.get("x-custom"), "1");
+    EXPECT_TRUE(headers.contains("ETag"));
+    EXPECT_FALSE(headers.contains(HeaderId::Expires));
+    EXPECT_FALSE(headers.contains("X-Missing"));
+    EXPECT_TRUE(headers.get("X-Missing").empty());
+
+    // Well-known names come back in canonical spelling, others as given
+    std::vector<std::string> names;
+    for (HttpHeaders::Field field : headers)
+        names.emplace_back(field.name);
+    EXPECT_EQ(names, (std::vector<std::string>{"Cache-Control", "X-Custom", "ETag"}));
+}
+
+TEST(HttpHeadersTest, KeepsRepeatsInOrderAndFirstWins)
+{
+    HttpHeaders headers;
+    headers.add("Via", "1.1 a");
+    headers.add("Set-Cookie", "a=1");
+    headers.add("Via", "1.1 b");
+    EXPECT_EQ(headers.size(), 3u);
+    EXPECT_EQ(headers.get(HeaderId::Via), "1.1 a");
+
+    EXPECT_EQ(headers.remove("via"), 2u);
+    EXPECT_EQ(headers.size(), 1u);
+    EXPECT_FALSE(headers.contains(HeaderId::Via));
+    EXPECT_EQ(headers.get(HeaderId::SetCookie), "a=1"); // index follows the compaction
+
+    headers.set("Set-Cookie", "b=2");
+    EXPECT_EQ(headers.size(), 1u);
+    EXPECT_EQ(headers[0].value, "b=2");
+}
+
+TEST(HttpHeadersTest, SpillsPastInlineCapacity)
+{
+    HttpHeaders headers;
+    const size_t n = HttpHeaders::kInlineFields * 3;
+    for (size_t i = 0; i < n; ++i)
+        headers.add("X-H" + std::to_string(i), std::to_string(i));
+    headers.add("Host", "late.example");
+    ASSERT_EQ(headers.size(), n + 1);
+    EXPECT_EQ(headers.get("x-h30"), "30");
+    EXPECT_EQ(headers.get(HeaderId::Host), "late.example");
+
+    // Removing from the inline part shifts spilled records down
+    EXPECT_EQ(headers.remove("X-H0"), 1u);
+    EXPECT_EQ(headers[0].name, "X-H1");
+    EXPECT_EQ(headers[HttpHeaders::kInlineFields - 1].name, "X-H" + std::to_string(HttpHeaders::kInlineFields));
+    EXPECT_EQ(headers.get(HeaderId::Host), "late.example");
+
+    // Copies are independent
+    HttpHeaders copy = headers;
+    headers.clear();
+    EXPECT_TRUE(headers.empty());
+    EXPECT_EQ(copy.get(HeaderId::Host), "late.example");
+    EXPECT_EQ(copy.size(), n);
+}
@@ -13,3 +13,135 @@ TEST(HttpParserTest, RelativeUrlWithHostHeader)
     EXPECT_EQ(req.port, 8081);
     EXPECT_EQ(req.path, "/home");
 }
+
+TEST(HttpParserTest, ConnectAuthorityForm)
+{
+    std::string raw_request =
+        "CONNECT cdn.example.com:8443 HTTP/1.1\r\n"
+        "Host: cdn.example.com:8443\r\n\r\n";
+
+    auto req = proxy::HttpParser::parse(raw_request);
+    EXPECT_EQ(req.method, "CONNECT");
+    EXPECT_EQ(req.host, "cdn.example.com");
+    EXPECT_EQ(req.port, 8443);
+    EXPECT_TRUE(req.path.empty());
+}
+
+TEST(HttpParserTest, KeepsVersionAndHeaders)
+{
+    std::string raw_request =
+        "GET http://origin.local/seg-1.m4s HTTP/1.1\r\n"
+        "Host: origin.local\r\n"
+        "Range: bytes=0-99\r\n\r\n";
+
+    auto req = proxy::HttpParser::parse(raw_request);
+    EXPECT_EQ(req.http_version, "HTTP/1.1");
+    EXPECT_EQ(req.path, "/seg-1.m4s");
+    ASSERT_TRUE(req.headers.contains("Range"));
+    EXPECT_EQ(req.headers.get("range"), "bytes=0-99");
+}
+
+using proxy::RequestHeadParser;
+using proxy::RequestLimits;
+using Status = RequestHeadParser::Status;
+using Error = RequestHeadParser::Error;
+
+TEST(RequestHeadParserTest, ResumesAcrossPartialReadsAndReallocation)
+{
+    const std::string request =
+        "GET /video/seg-42.m4s HTTP/1.1\r\n"
+        "Host: cdn.example.com:8080\r\n"
+        "User-Agent: a-rather-long-user-agent-string-to-cross-vector-widths/1.0\r\n"
+        "Accept:*/*\r\n\r\n"
+        "GET /next HTTP/1.1\r\n"; // pipelined, not part of this head
+    const size_t head_size = request.find("GET /next");
+
+    RequestHeadParser parser;
+    std::string buffer;
+    for (size_t i = 0; i < request.size(); ++i)
+    {
+        std::string grown = buffer + request[i]; // new storage every time
+        buffer.swap(grown);
+        Status status = parser.feed(buffer);
+        if (i + 1 < head_size)
+            ASSERT_EQ(status, Status::Incomplete) << "at byte " << i;
+        else
+            ASSERT_EQ(status, Status::Complete) << "at byte " << i;
+    }
+    EXPECT_EQ(parser.head_size(), head_size);
+    EXPECT_EQ(parser.method(), "GET");
+    EXPECT_EQ(parser.target(), "/video/seg-42.m4s");
+    EXPECT_EQ(parser.version(), "HTTP/1.1");
+    ASSERT_EQ(parser.header_count(), 3u);
+    EXPECT_EQ(parser.header(0).name, "Host");
+    EXPECT_EQ(parser.header(2).value, "*/*");
+    EXPECT_EQ(parser.find("user-agent"), "a-rather-long-user-agent-string-to-cross-vector-widths/1.0");
+    EXPECT_TRUE(parser.find("cookie").empty());
+
+    // Views point into the buffer last fed, without copies
+    EXPECT_EQ(parser.method().data(), buffer.data());
+
+    auto req = proxy::HttpParser::parse(parser);
+    EXPECT_EQ(req.host, "cdn.example.com");
+    EXPECT_EQ(req.port, 8080);
+    EXPECT_EQ(req.path, "/video/seg-42.m4s");
+}
+
+TEST(RequestHeadParserTest, TrimsValuesAndAcceptsBareLf)
+{
+    RequestHeadParser parser;
+    ASSERT_EQ(parser.feed("\r\nGET / HTTP/1.0\nHost: \t a.example \t\nX-Empty:\n\n"), Status::Complete);
+    EXPECT_EQ(parser.find("HOST"), "a.example");
+    EXPECT_EQ(parser.header(1).name, "X-Empty");
+    EXPECT_TRUE(parser.header(1).value.empty());
+
+    parser.reset();
+    ASSERT_EQ(parser.feed("HEAD /x HTTP/1.1\r\n\r\n"), Status::Complete);
+    EXPECT_EQ(parser.method(), "HEAD");
+    EXPECT_EQ(parser.header_count(), 0u);
+}
+
+TEST(RequestHeadParserTest, RejectsMalformedHeads)
+{
+    auto error_of = [](const std::string &head)
+    {
+        RequestHeadParser parser;
+        EXPECT_EQ(parser.feed(head), Status::Error) << head;
+        return parser.error();
+    };
+    EXPECT_EQ(error_of("GET  / HTTP/1.1\r\n\r\n"), Error::BadRequestLine);       // double space
+    EXPECT_EQ(error_of("GET / HTTP/1.1 extra\r\n\r\n"), Error::BadRequestLine); // too many parts
+    EXPECT_EQ(error_of("GET / HTTQ/1.1\r\n\r\n"), Error::BadRequestLine);
+    EXPECT_EQ(error_of("G(T / HTTP/1.1\r\n\r\n"), Error::BadRequestLine);       // method not a token
+    EXPECT_EQ(error_of("GET / HTTP/1.1\rX\r\n\r\n"), Error::BadRequestLine);    // bare CR
+    EXPECT_EQ(error_of("GET / HTTP/1.1\r\nHost : a\r\n\r\n"), Error::BadHeader); // space before colon
+    EXPECT_EQ(error_of("GET / HTTP/1.1\r\nNoColon\r\n\r\n"), Error::BadHeader);
+    EXPECT_EQ(error_of("GET / HTTP/1.1\r\nA: b\r\n c\r\n\r\n"), Error::BadHeader); // obsolete folding
+    // A NUL deep inside a long value (found by the vector loop, not the scalar tail)
+    EXPECT_EQ(error_of("GET / HTTP/1.1\r\nX-Long: " + std::string(40, 'v') + '\0' + std::string(40, 'v') + "\r\n\r\n"),
+              Error::BadHeader);
+}
+
+TEST(RequestHeadParserTest, EnforcesLimits)
+{
+    RequestLimits limits;
+    limits.max_head_bytes = 128;
+    limits.max_request_line = 32;
+    limits.max_headers = 2;
+
+    RequestHeadParser line(limits);
+    EXPECT_EQ(line.feed("GET /" + std::string(40, 'a')), Status::Error); // before the line even ends
+    EXPECT_EQ(line.error(), Error::RequestLineTooLong);
+
+    RequestHeadParser head(limits);
+    EXPECT_EQ(head.feed("GET / HTTP/1.1\r\nX: " + std::string(200, 'a')), Status::Error);
+    EXPECT_EQ(head.error(), Error::HeadTooLarge);
+
+    RequestHeadParser count(limits);
+    EXPECT_EQ(count.feed("GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\n\r\n"), Status::Error);
+    EXPECT_EQ(count.error(), Error::TooManyHeaders);
+
+    // Bytes after a complete head do not count against it
+    RequestHeadParser fits(limits);
+    EXPECT_EQ(fits.feed("GET / HTTP/1.1\r\nA: 1\r\n\r\n" + std::string(500, 'x')), Status::Complete);
+}
@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/HttpProxy.hpp"
+#include "../include/proxy/SocketUtils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+    uint16_t local_port(int fd)
+    {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+        return ntohs(addr.sin_port);
+    }
+
+    int connect_local(uint16_t port)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    void send_all(int fd, const std::string &data)
+    {
+        for (size_t sent = 0; sent < data.size();)
+        {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                return;
+            sent += n;
+        }
+    }
+
+    // One response off `fd`: its head, then Content-Length bytes of body
+    std::string read_response(int fd)
+    {
+        std::string in;
+        char buf[65536];
+        size_t head_end;
+        while ((head_end = in.find("\r\n\r\n")) == std::string::npos)
+        {
+            ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0)
+                return in;
+            in.append(buf, n);
+        }
+        std::string lower = in.substr(0, head_end);
+        std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char ch)
+                       { return static_cast<char>(std::tolower(ch)); });
+        size_t length = 0;
+        size_t pos = lower.find("\r\ncontent-length:");
+        if (pos != std::string::npos)
+            length = std::stoul(lower.substr(pos + 17));
+        while (in.size() < head_end + 4 + length)
+        {
+            ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0)
+                break;
+            in.append(buf, n);
+        }
+        return in;
+    }
+
+    // An origin that answers each request on its own connection, by what the request carries
+    class FakeOrigin
+    {
+    public:
+        FakeOrigin() : listen_fd_(net::create_listen_socket(0)), port_(local_port(listen_fd_))
+        {
+            thread_ = std::thread([this]() { serve(); });
+        }
+
+        ~FakeOrigin()
+        {
+            stop_ = true;
+            ::shutdown(listen_fd_, SHUT_RDWR);
+            ::close(listen_fd_);
+            thread_.join();
+        }
+
+        uint16_t port() const { return port_; }
+
+        // Request heads, lower-cased, in the order they arrived
+        std::vector<std::string> requests()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return requests_;
+        }
+
+    private:
+        void serve()
+        {
+            while (!stop_)
+            {
+                int fd = ::accept(listen_fd_, nullptr, nullptr);
+                if (fd < 0)
+                    return;
+                std::string head;
+                char buf[4096];
+                while (head.find("\r\n\r\n") == std::string::npos)
+                {
+                    ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+                    if (n <= 0)
+                        break;
+                    head.append(buf, n);
+                }
+                std::transform(head.begin(), head.end(), head.begin(), [](unsigned char ch)
+                               { return static_cast<char>(std::tolower(ch)); });
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    requests_.push_back(head);
+                }
+                send_all(fd, respond(head));
+                ::close(fd);
+            }
+        }
+
+        // First fetch: a small object. Revalidation: it has grown past the cache's limit. A Range
+        // request: a 206, or a 304 if it carries a validator (the client would have no body).
+        static std::string respond(const std::string &head)
+        {
+            const bool conditional = head.find("\r\nif-none-match:") != std::string::npos;
+            const bool range = head.find("\r\nrange:") != std::string::npos;
+            if (range && conditional)
+                return "HTTP/1.1 304 Not Modified\r\nETag: \"v2\"\r\nConnection: close\r\n\r\n";
+            if (range)
+                return "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes 0-3/200000\r\n"
+                       "Content-Length: 4\r\nConnection: close\r\n\r\nxxxx";
+            if (conditional)
+                return "HTTP/1.1 200 OK\r\nETag: \"v2\"\r\nContent-Length: 200000\r\nConnection: close\r\n\r\n" +
+                       std::string(200000, 'x');
+            return "HTTP/1.1 200 OK\r\nETag: \"v1\"\r\nContent-Length: 10\r\nConnection: close\r\n\r\n0123456789";
+        }
+
+        int listen_fd_;
+        uint16_t port_;
+        std::atomic<bool> stop_{false};
+        std::mutex mutex_;
+        std::vector<std::string> requests_;
+        std::thread thread_;
+    };
+}
+
+TEST(HttpProxyTest, RangeOnAStaleEntryGrownTooLargeGoesOutWithoutTheEntrysValidators)
+{
+    std::signal(SIGPIPE, SIG_IGN); // the proxy abandons the 200000-byte body mid-send
+    FakeOrigin origin;
+    // 1 MB with an eighth per object: the grown object is not cached
+    proxy::HttpProxy proxy(0, 1, 1, 0.125);
+
+    int listen_fd = net::create_listen_socket(0);
+    int client = connect_local(local_port(listen_fd));
+    ASSERT_GE(client, 0);
+    int accepted = ::accept(listen_fd, nullptr, nullptr);
+    std::thread serving([&]() { proxy.handle_client(accepted); });
+
+    const std::string url = "http://127.0.0.1:" + std::to_string(origin.port()) + "/object";
+    const std::string host = "Host: 127.0.0.1:" + std::to_string(origin.port()) + "\r\n";
+    send_all(client, "GET " + url + " HTTP/1.1\r\n" + host + "\r\n");
+    EXPECT_EQ(read_response(client).substr(0, 15), "HTTP/1.1 200 OK");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10)); // no max-age: stale by now
+    send_all(client, "GET " + url + " HTTP/1.1\r\n" + host + "Range: bytes=0-3\r\n\r\n");
+    std::string reply = read_response(client);
+    EXPECT_EQ(reply.substr(0, 12), "HTTP/1.1 206");
+    EXPECT_EQ(reply.substr(reply.size() - 4), "xxxx");
+
+    ::shutdown(client, SHUT_RDWR);
+    serving.join();
+    ::close(client);
+    ::close(accepted);
+    ::close(listen_fd);
+
+    std::vector<std::string> requests = origin.requests();
+    ASSERT_EQ(requests.size(), 3u);
+    EXPECT_NE(requests[1].find("\r\nif-none-match: \"v1\""), std::string::npos); // the revalidation
+    EXPECT_NE(requests[2].find("\r\nrange: bytes=0-3"), std::string::npos);     // the refetch
+    EXPECT_EQ(requests[2].find("\r\nif-none-match:"), std::string::npos);
+    EXPECT_EQ(requests[2].find("\r\nif-modified-since:"), std::string::npos);
+}
@@ -0,0 +1,239 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/HttpResponseParser.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    // Feed `raw` one byte at a time; returns how many bytes belonged to the message.
+    size_t feed_bytewise(proxy::HttpResponseParser &parser, const std::string &raw)
+    {
+        size_t used = 0;
+        for (size_t i = 0; i < raw.size() && !parser.complete(); ++i)
+        {
+            if (!parser.head_complete())
+                used += parser.parse_head(raw.data() + i, 1);
+            else
+                used += parser.parse_body(raw.data() + i, 1);
+        }
+        return used;
+    }
+}
+
+TEST(HttpResponseParserTest, ContentLengthBody)
+{
+    std::string raw =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Length: 5\r\n\r\n"
+        "helloHTTP/1.1";
+
+    proxy::HttpResponseParser parser;
+    size_t head = parser.parse_head(raw.data(), raw.size());
+    ASSERT_TRUE(parser.head_complete());
+    EXPECT_EQ(parser.status_code(), 200);
+    EXPECT_EQ(parser.content_length(), 5u);
+    size_t body = parser.parse_body(raw.data() + head, raw.size() - head);
+    EXPECT_EQ(body, 5u); // the trailing bytes are not part of this response
+    EXPECT_TRUE(parser.complete());
+    EXPECT_TRUE(parser.keep_alive());
+}
+
+TEST(HttpResponseParserTest, ChunkedWithTrailers)
+{
+    std::string raw =
+        "HTTP/1.1 200 OK\r\n"
+        "Transfer-Encoding: chunked\r\n\r\n"
+        "5;ext=1\r\nhello\r\n"
+        "6\r\n world\r\n"
+        "0\r\n"
+        "X-Checksum: abc\r\n"
+        "\r\n";
+
+    proxy::HttpResponseParser parser;
+    EXPECT_EQ(feed_bytewise(parser, raw), raw.size());
+    EXPECT_TRUE(parser.chunked());
+    EXPECT_TRUE(parser.complete());
+    EXPECT_TRUE(parser.keep_alive());
+    ASSERT_EQ(parser.trailer_count(), 1u);
+    EXPECT_EQ(parser.trailer(0).name, "X-Checksum");
+    EXPECT_EQ(parser.trailer(0).value, "abc");
+}
+
+TEST(HttpResponseParserTest, ChunkedPayloadWithoutFraming)
+{
+    std::string head = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+    std::string body = "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n";
+
+    proxy::HttpResponseParser parser;
+    parser.parse_head(head.data(), head.size());
+    std::string payload;
+    for (size_t i = 0; i < body.size(); i += 4) // split across chunk boundaries
+        parser.parse_body(body.data() + i, std::min<size_t>(4, body.size() - i), &payload);
+    EXPECT_TRUE(parser.complete());
+    EXPECT_EQ(payload, "hello world");
+}
+
+TEST(HttpResponseParserTest, CloseDelimitedBody)
+{
+    std::string raw =
+        "HTTP/1.0 200 OK\r\n\r\n"
+        "some body";
+
+    proxy::HttpResponseParser parser;
+    size_t head = parser.parse_head(raw.data(), raw.size());
+    EXPECT_EQ(parser.parse_body(raw.data() + head, raw.size() - head), raw.size() - head);
+    EXPECT_FALSE(parser.complete());
+    parser.on_eof();
+    EXPECT_TRUE(parser.complete());
+    EXPECT_FALSE(parser.keep_alive());
+}
+
+TEST(HttpResponseParserTest, NotModifiedHasNoBody)
+{
+    std::string raw =
+        "HTTP/1.1 304 Not Modified\r\n"
+        "Content-Length: 100\r\n\r\n";
+
+    proxy::HttpResponseParser parser;
+    EXPECT_EQ(parser.parse_head(raw.data(), raw.size()), raw.size());
+    EXPECT_EQ(parser.status_code(), 304);
+    EXPECT_TRUE(parser.complete());
+}
+
+TEST(HttpResponseParserTest, ConnectionCloseDisablesReuse)
+{
+    std::string raw =
+        "HTTP/1.1 200 OK\r\n"
+        "Connection: close\r\n"
+        "Content-Length: 0\r\n\r\n";
+
+    proxy::HttpResponseParser parser;
+    parser.parse_head(raw.data(), raw.size());
+    EXPECT_TRUE(parser.complete());
+    EXPECT_FALSE(parser.keep_alive());
+}
+
+TEST(HttpResponseParserTest, TruncatedBodyThrows)
+{
+    std::string raw =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Length: 10\r\n\r\n"
+        "abc";
+
+    proxy::HttpResponseParser parser;
+    size_t head = parser.parse_head(raw.data(), raw.size());
+    parser.parse_body(raw.data() + head, raw.size() - head);
+    EXPECT_THROW(parser.on_eof(), std::runtime_error);
+}
+
+TEST(HttpResponseParserTest, IndexesHeaderFields)
+{
+    std::string raw =
+        "HTTP/1.1 200 OK\r\n"
+        "Cache-Control:  max-age=60 \r\n"
+        "ETag: \"v1\"\r\n"
+        "Content-Length: 0\r\n\r\n";
+
+    proxy::HttpResponseParser parser;
+    parser.parse_head(raw.data(), raw.size());
+    ASSERT_EQ(parser.header_count(), 3u);
+    EXPECT_EQ(parser.header(0).name, "Cache-Control");
+    EXPECT_EQ(parser.header(0).value, "max-age=60");
+    EXPECT_EQ(parser.find("etag"), "\"v1\"");
+    EXPECT_TRUE(parser.find("expires").empty());
+
+    // Field views are offsets into the parser's own head, so copies stay valid
+    proxy::HttpResponseParser copy = parser;
+    EXPECT_EQ(copy.find("ETag").data(), copy.head().data() + copy.head().find("\"v1\""));
+}
+
+TEST(HttpResponseParserTest, SkipsInterimResponses)
+{
+    std::string raw =
+        "HTTP/1.1 100 Continue\r\n\r\n"
+        "HTTP/1.1 103 Early Hints\r\n"
+        "Link: </style.css>; rel=preload\r\n\r\n"
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Length: 2\r\n\r\n"
+        "ok";
+
+    proxy::HttpResponseParser whole;
+    size_t head = whole.parse_head(raw.data(), raw.size());
+    EXPECT_EQ(raw.substr(head), "ok");
+    EXPECT_EQ(whole.status_code(), 200);
+    EXPECT_EQ(whole.interim_responses(), 2u);
+    EXPECT_EQ(whole.head().rfind("HTTP/1.1 200 OK", 0), 0u);
+    EXPECT_TRUE(whole.find("link").empty());
+
+    proxy::HttpResponseParser bytewise;
+    EXPECT_EQ(feed_bytewise(bytewise, raw), raw.size());
+    EXPECT_EQ(bytewise.status_code(), 200);
+    EXPECT_TRUE(bytewise.complete());
+}
+
+TEST(HttpResponseParserTest, ConflictingContentLengthThrows)
+{
+    std::string conflicting = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\nContent-Length: 6\r\n\r\n";
+    std::string junk = "HTTP/1.1 200 OK\r\nContent-Length: 5x\r\n\r\n";
+    std::string repeated = "HTTP/1.1 200 OK\r\nContent-Length: 5, 5\r\n\r\n";
+
+    proxy::HttpResponseParser a, b, c;
+    EXPECT_THROW(a.parse_head(conflicting.data(), conflicting.size()), std::runtime_error);
+    EXPECT_THROW(b.parse_head(junk.data(), junk.size()), std::runtime_error);
+    c.parse_head(repeated.data(), repeated.size());
+    EXPECT_EQ(c.content_length(), 5u);
+}
+
+namespace
+{
+    // Records the events feed() reports
+    struct Recorder : proxy::HttpResponseParser::Listener
+    {
+        std::string events;
+        std::string body;
+        void on_head(const proxy::HttpResponseParser &parser) override { events += "head(" + std::to_string(parser.status_code()) + ")"; }
+        void on_body(std::string_view payload) override
+        {
+            if (body.empty())
+                events += "body";
+            body.append(payload);
+        }
+        void on_complete(const proxy::HttpResponseParser &parser) override
+        {
+            events += "complete(" + std::to_string(parser.trailer_count()) + ")";
+        }
+    };
+}
+
+TEST(HttpResponseParserTest, FeedReportsEventsIncrementally)
+{
+    std::string raw =
+        "HTTP/1.1 200 OK\r\n"
+        "Transfer-Encoding: chunked\r\n\r\n"
+        "4\r\nwiki\r\n5\r\npedia\r\n0\r\nX-A: 1\nX-B: 2\r\n\r\n"
+        "HTTP/1.1 200 OK\r\n"; // the next response on the connection
+
+    for (size_t step : {size_t(1), size_t(7), raw.size()})
+    {
+        proxy::HttpResponseParser parser;
+        Recorder recorder;
+        size_t used = 0;
+        for (size_t pos = 0; pos < raw.size() && !parser.complete(); pos += step)
+            used += parser.feed(raw.data() + pos, std::min(step, raw.size() - pos), recorder);
+        EXPECT_EQ(used, raw.find("HTTP/1.1", 10)) << "step " << step;
+        EXPECT_EQ(recorder.events, "head(200)bodycomplete(2)") << "step " << step;
+        EXPECT_EQ(recorder.body, "wikipedia");
+        EXPECT_EQ(parser.trailer(1).name, "X-B");
+        EXPECT_EQ(parser.trailer(1).value, "2");
+    }
+
+    // A close-delimited body completes on EOF
+    std::string until_close = "HTTP/1.0 200 OK\r\n\r\nabc";
+    proxy::HttpResponseParser parser;
+    Recorder recorder;
+    parser.feed(until_close.data(), until_close.size(), recorder);
+    parser.on_eof(&recorder);
+    EXPECT_EQ(recorder.events, "head(200)bodycomplete(0)");
+    EXPECT_EQ(recorder.body, "abc");
+}
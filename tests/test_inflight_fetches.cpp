@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/InflightFetches.hpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using proxy::InflightFetches;
+
+TEST(InflightFetchesTest, FirstJoinLeadsLaterOnesWait)
+{
+    InflightFetches inflight;
+    int woken = 0;
+    EXPECT_TRUE(inflight.join("a", [&]
+                              { ++woken; }));
+    EXPECT_FALSE(inflight.join("a", [&]
+                               { ++woken; }));
+    EXPECT_FALSE(inflight.join("a", [&]
+                               { ++woken; }));
+    EXPECT_TRUE(inflight.join("b", [&]
+                              { ++woken; })); // other keys are independent
+    EXPECT_EQ(inflight.size(), 2u);
+    EXPECT_EQ(inflight.collapsed(), 2u);
+
+    inflight.finish("a");
+    EXPECT_EQ(woken, 2); // each waiter once, the leader's own callback never
+    EXPECT_EQ(inflight.size(), 1u);
+
+    // The key is free again: the next miss leads a new fetch
+    EXPECT_TRUE(inflight.join("a", [] {}));
+}
+
+TEST(InflightFetchesTest, FinishUnknownKeyIsHarmless)
+{
+    InflightFetches inflight;
+    inflight.finish("nothing");
+    EXPECT_EQ(inflight.size(), 0u);
+}
+
+TEST(InflightFetchesTest, WaiterMayJoinAgainFromItsCallback)
+{
+    InflightFetches inflight;
+    bool led_again = false;
+    ASSERT_TRUE(inflight.join("k", [] {}));
+    ASSERT_FALSE(inflight.join("k", [&]
+                               { led_again = inflight.join("k", [] {}); }));
+    inflight.finish("k");
+    EXPECT_TRUE(led_again);
+}
+
+TEST(InflightFetchesTest, BlockingWaitersWakeWhenLeaderFinishes)
+{
+    InflightFetches inflight;
+    ASSERT_EQ(inflight.join_and_wait("seg", std::chrono::seconds(1)), InflightFetches::Join::Leader);
+
+    std::atomic<int> finished{0};
+    std::vector<std::thread> followers;
+    for (int i = 0; i < 4; ++i)
+        followers.emplace_back([&]
+                               {
+            if (inflight.join_and_wait("seg", std::chrono::seconds(5)) == InflightFetches::Join::Finished)
+                ++finished; });
+    while (inflight.collapsed() < 4)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    inflight.finish("seg");
+    for (auto &t : followers)
+        t.join();
+    EXPECT_EQ(finished.load(), 4);
+}
+
+TEST(InflightFetchesTest, BlockingWaitIsBounded)
+{
+    InflightFetches inflight;
+    ASSERT_EQ(inflight.join_and_wait("slow", std::chrono::seconds(1)), InflightFetches::Join::Leader);
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(inflight.join_and_wait("slow", std::chrono::milliseconds(50)), InflightFetches::Join::TimedOut);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    inflight.finish("slow"); // the abandoned waiter still runs, harmlessly
+}
@@ -33,3 +33,46 @@ TEST(LruCacheTest, OverwriteValue)
     cache.put("a", "updated");
     EXPECT_EQ(cache.get("a"), std::optional<std::string>{"updated"});
 }
+
+TEST(LruCacheTest, WeighsEntriesAndEvictsUntilTheyFit)
+{
+    Cache::LruCache<std::string, std::string> cache(100, [](const std::string &, const std::string &v)
+                                                    { return v.size(); });
+    cache.put("a", std::string(40, 'a'));
+    cache.put("b", std::string(40, 'b'));
+    EXPECT_EQ(cache.weight(), 80u);
+
+    // 50 more bytes only fit once "a" (least recently used) is gone
+    EXPECT_TRUE(cache.put("c", std::string(50, 'c')));
+    EXPECT_FALSE(cache.contains("a"));
+    EXPECT_EQ(cache.weight(), 90u);
+
+    // Growing "c" in place pushes out "b" as well
+    cache.put("c", std::string(100, 'C'));
+    EXPECT_EQ(cache.size(), 1u);
+    EXPECT_EQ(cache.weight(), 100u);
+    EXPECT_EQ(cache.peak_weight(), 100u);
+
+    cache.clear();
+    EXPECT_EQ(cache.weight(), 0u);
+    EXPECT_EQ(cache.peak_weight(), 100u);
+}
+
+TEST(LruCacheTest, RejectsEntriesOverTheMaxFraction)
+{
+    Cache::LruCache<std::string, std::string> cache(
+        100, [](const std::string &, const std::string &v)
+        { return v.size(); },
+        0.25);
+    EXPECT_EQ(cache.max_entry_weight(), 25u);
+    EXPECT_TRUE(cache.put("small", std::string(25, 's')));
+    EXPECT_FALSE(cache.put("big", std::string(26, 'b')));
+    EXPECT_FALSE(cache.contains("big"));
+
+    // A value that outgrows the limit also drops the old one under its key
+    EXPECT_FALSE(cache.put("small", std::string(30, 's')));
+    EXPECT_FALSE(cache.contains("small"));
+    EXPECT_EQ(cache.weight(), 0u);
+
+    EXPECT_THROW((Cache::LruCache<std::string, std::string>(100, nullptr, 0.0)), std::invalid_argument);
+}
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "../include/proxy/Resolver.hpp"
+#include <cerrno>
 
 TEST(ResolverTest, BasicResolution)
 {
@@ -19,3 +20,22 @@ TEST(ResolverTest, NegativeCache)
         proxy::Resolver::instance().resolve("this-domain-should-not-exist.tld", 80, std::chrono::seconds{2}),
         std::runtime_error);
 }
+
+TEST(ResolverTest, FailingAddressesMoveToTheBack)
+{
+    auto &resolver = proxy::Resolver::instance();
+    resolver.record({{"192.0.2.1", ECONNREFUSED, std::chrono::milliseconds(1)}});
+
+    auto ordered = resolver.order_by_health({"192.0.2.1", "192.0.2.2", "192.0.2.3"});
+    EXPECT_EQ(ordered, (std::vector<std::string>{"192.0.2.2", "192.0.2.3", "192.0.2.1"}));
+}
+
+TEST(ResolverTest, FasterAddressesComeFirst)
+{
+    auto &resolver = proxy::Resolver::instance();
+    resolver.record({{"198.51.100.1", 0, std::chrono::milliseconds(80)},
+                     {"198.51.100.2", 0, std::chrono::milliseconds(5)}});
+
+    auto ordered = resolver.order_by_health({"198.51.100.1", "198.51.100.2"});
+    EXPECT_EQ(ordered, (std::vector<std::string>{"198.51.100.2", "198.51.100.1"}));
+}
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/ShardedLruCache.hpp"
+#include "../include/proxy/CachedResponse.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+using Sharded = Cache::ShardedLruCache<std::string, std::string>;
+
+TEST(ShardedLruCacheTest, PutGetAndStats)
+{
+    Sharded cache(8, 4);
+    cache.put("a", "1");
+    cache.put("b", "2");
+    cache.put("a", "updated");
+
+    EXPECT_EQ(cache.get("a"), std::optional<std::string>{"updated"});
+    EXPECT_EQ(cache.get("b"), std::optional<std::string>{"2"});
+    EXPECT_EQ(cache.get("missing"), std::nullopt);
+    EXPECT_TRUE(cache.contains("b"));
+    EXPECT_EQ(cache.size(), 2u);
+
+    Sharded::Stats stats = cache.stats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.inserts, 2u);
+    EXPECT_EQ(stats.updates, 1u);
+    EXPECT_EQ(stats.evictions, 0u);
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_EQ(cache.stats().hits, 0u);
+}
+
+TEST(ShardedLruCacheTest, SplitsCapacityAcrossShards)
+{
+    Sharded cache(10, 5); // rounded down to 4 shards holding 3, 3, 2 and 2
+    EXPECT_EQ(cache.shard_count(), 4u);
+    EXPECT_EQ(cache.capacity(), 10u);
+    for (int i = 0; i < 100; ++i)
+        cache.put("key-" + std::to_string(i), "v");
+    EXPECT_LE(cache.size(), 10u);
+    Sharded::Stats stats = cache.stats();
+    EXPECT_EQ(stats.inserts - stats.evictions, cache.size());
+
+    // Never more shards than items, so no shard has zero capacity
+    Sharded tiny(3, 16);
+    EXPECT_EQ(tiny.shard_count(), 2u);
+    EXPECT_THROW(Sharded(0), std::invalid_argument);
+}
+
+TEST(ShardedLruCacheTest, TracksWeightAcrossShards)
+{
+    auto bytes = [](const std::string &, const std::string &v)
+    { return v.size(); };
+    // A quarter of the budget per entry at most, so no more than four shards
+    Sharded cache(1000, 16, bytes, 0.25);
+    EXPECT_EQ(cache.shard_count(), 4u);
+    EXPECT_EQ(cache.max_entry_weight(), 250u);
+
+    EXPECT_FALSE(cache.put("huge", std::string(251, 'h')));
+    EXPECT_EQ(cache.stats().rejected, 1u);
+    for (int i = 0; i < 40; ++i)
+        EXPECT_TRUE(cache.put("key-" + std::to_string(i), std::string(100, 'v')));
+    EXPECT_LE(cache.weight(), 1000u);
+    EXPECT_EQ(cache.weight(), 100 * cache.size());
+    EXPECT_GE(cache.peak_weight(), cache.weight());
+
+    size_t peak = cache.peak_weight();
+    cache.clear();
+    EXPECT_EQ(cache.weight(), 0u);
+    EXPECT_EQ(cache.peak_weight(), peak);
+}
+
+TEST(ShardedLruCacheTest, ConcurrentReadersAndWriters)
+{
+    Sharded cache(100, 8);
+    const int threads = 8, ops = 5000, keys = 400;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&cache, t]()
+                             {
+            for (int i = 0; i < ops; ++i)
+            {
+                std::string key = "key-" + std::to_string((i * 31 + t * 17) % keys);
+                if (auto v = cache.get(key))
+                    EXPECT_EQ(*v, "value-" + key);
+                else
+                    cache.put(key, "value-" + key);
+            } });
+    }
+    for (auto &w : workers)
+        w.join();
+
+    Sharded::Stats stats = cache.stats();
+    EXPECT_EQ(stats.hits + stats.misses, static_cast<uint64_t>(threads * ops));
+    EXPECT_LE(cache.size(), 100u);
+    EXPECT_EQ(stats.inserts - stats.evictions, cache.size());
+}
+
+// Hits share the cached entry; one still being sent outlives its eviction
+TEST(ShardedLruCacheTest, HitsShareEntriesThatOutliveEviction)
+{
+    Cache::ShardedLruCache<std::string, proxy::CachedResponsePtr> cache(1, 1);
+    auto entry = std::make_shared<proxy::CachedResponse>();
+    entry->status_line = "HTTP/1.1 200 OK";
+    entry->body = std::make_shared<const std::vector<char>>(1 << 20, 'b');
+    cache.put("a", entry);
+    const proxy::CachedResponse *stored = entry.get();
+    entry.reset();
+
+    proxy::CachedResponsePtr first = cache.get("a").value_or(nullptr);
+    proxy::CachedResponsePtr second = cache.get("a").value_or(nullptr);
+    ASSERT_TRUE(first);
+    EXPECT_EQ(first.get(), stored);
+    EXPECT_EQ(second.get(), stored);
+    EXPECT_EQ(first.use_count(), 3); // the cache and both hits
+
+    cache.put("b", std::make_shared<proxy::CachedResponse>()); // evicts "a"
+    EXPECT_FALSE(cache.contains("a"));
+    EXPECT_EQ(first.use_count(), 2);
+    EXPECT_EQ(first->body->size(), 1u << 20);
+}
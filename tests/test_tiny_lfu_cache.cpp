@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+#include "../include/proxy/FrequencySketch.hpp"
+#include "../include/proxy/LruCache.hpp"
+#include "../include/proxy/ShardedLruCache.hpp"
+#include "../include/proxy/TinyLfuCache.hpp"
+#include <stdexcept>
+#include <string>
+
+TEST(FrequencySketchTest, DoorkeeperAbsorbsTheFirstSighting)
+{
+    Cache::FrequencySketch sketch(1024);
+    EXPECT_EQ(sketch.width(), 1024u);
+    EXPECT_EQ(sketch.frequency(42), 0u);
+    sketch.record(42);
+    EXPECT_EQ(sketch.frequency(42), 1u);
+    for (int i = 0; i < 4; ++i)
+        sketch.record(42);
+    EXPECT_EQ(sketch.frequency(42), 5u);
+    EXPECT_EQ(sketch.frequency(43), 0u);
+
+    sketch.clear();
+    EXPECT_EQ(sketch.frequency(42), 0u);
+}
+
+TEST(FrequencySketchTest, HalvesCountsEveryTenTimesWidth)
+{
+    Cache::FrequencySketch sketch(10); // rounded up to 64 counters per row, aged every 640 records
+    EXPECT_EQ(sketch.width(), 64u);
+    for (int i = 0; i < 639; ++i)
+        sketch.record(7);
+    EXPECT_EQ(sketch.frequency(7), 16u); // saturated counter + doorkeeper bit
+    sketch.record(7);
+    EXPECT_EQ(sketch.frequency(7), 7u); // halved, doorkeeper cleared
+}
+
+TEST(TinyLfuCacheTest, PutGetUpdate)
+{
+    Cache::TinyLfuCache<std::string, std::string> cache(100);
+    EXPECT_TRUE(cache.put("a", "1"));
+    EXPECT_TRUE(cache.put("b", "2"));
+    EXPECT_TRUE(cache.put("a", "updated"));
+
+    EXPECT_EQ(cache.get("a"), std::optional<std::string>{"updated"});
+    EXPECT_EQ(cache.get("b"), std::optional<std::string>{"2"});
+    EXPECT_EQ(cache.get("missing"), std::nullopt);
+    EXPECT_TRUE(cache.contains("a"));
+    EXPECT_EQ(cache.size(), 2u);
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_EQ(cache.weight(), 0u);
+}
+
+TEST(TinyLfuCacheTest, InvalidArguments)
+{
+    using Tiny = Cache::TinyLfuCache<int, int>;
+    EXPECT_THROW(Tiny(0), std::invalid_argument);
+    EXPECT_THROW(Tiny(10, nullptr, 0.0), std::invalid_argument);
+    EXPECT_THROW(Tiny(10, nullptr, 1.5), std::invalid_argument);
+}
+
+TEST(TinyLfuCacheTest, NeverHoldsMoreThanItsCapacity)
+{
+    Cache::TinyLfuCache<int, int> single(1);
+    single.put(1, 1);
+    single.put(2, 2);
+    EXPECT_EQ(single.size(), 1u);
+    EXPECT_TRUE(single.contains(2));
+
+    Cache::TinyLfuCache<int, int> cache(50);
+    for (int i = 0; i < 1000; ++i)
+    {
+        cache.get(i % 70);
+        cache.put(i % 70, i);
+        ASSERT_LE(cache.size(), 50u);
+    }
+}
+
+// A one-pass scan over twice the capacity: LRU ends up holding only scan keys, W-TinyLFU
+// keeps the working set because no scan key is more popular than the entries it would evict
+TEST(TinyLfuCacheTest, KeepsHotEntriesThroughAScan)
+{
+    Cache::TinyLfuCache<int, int> tiny(1000);
+    Cache::LruCache<int, int> lru(1000);
+    auto read_through = [&](int key)
+    {
+        if (!tiny.get(key))
+            tiny.put(key, key);
+        if (!lru.get(key))
+            lru.put(key, key);
+    };
+    for (int round = 0; round < 10; ++round)
+        for (int hot = 0; hot < 100; ++hot)
+            read_through(hot);
+    for (int scan = 1000; scan < 3000; ++scan)
+        read_through(scan);
+
+    int tiny_hot = 0, lru_hot = 0;
+    for (int hot = 0; hot < 100; ++hot)
+    {
+        tiny_hot += tiny.contains(hot);
+        lru_hot += lru.contains(hot);
+    }
+    EXPECT_EQ(tiny_hot, 100);
+    EXPECT_EQ(lru_hot, 0);
+    EXPECT_GT(tiny.admission_rejects(), 0u);
+}
+
+TEST(TinyLfuCacheTest, AdmitsANewKeyOnceItIsPopular)
+{
+    Cache::TinyLfuCache<int, int> cache(100); // window of 1
+    for (int cold = 0; cold < 100; ++cold)
+    {
+        cache.get(cold);
+        cache.put(cold, cold);
+    }
+    for (int i = 0; i < 5; ++i)
+        cache.get(500);
+    cache.put(500, 500);
+    cache.put(501, 501); // pushes 500 out of the window: it beats the coldest main entry
+    EXPECT_TRUE(cache.contains(500));
+    EXPECT_EQ(cache.size(), 100u);
+}
+
+TEST(TinyLfuCacheTest, WeighsEntriesAndRejectsOversizedOnes)
+{
+    Cache::TinyLfuCache<std::string, std::string> cache(
+        1000, [](const std::string &, const std::string &value) { return value.size(); }, 0.5);
+    EXPECT_EQ(cache.max_entry_weight(), 500u);
+    EXPECT_TRUE(cache.put("a", std::string(300, 'a')));
+    EXPECT_TRUE(cache.put("b", std::string(300, 'b')));
+    EXPECT_EQ(cache.weight(), 600u);
+
+    EXPECT_FALSE(cache.put("a", std::string(501, 'a')));
+    EXPECT_FALSE(cache.contains("a"));
+    EXPECT_EQ(cache.weight(), 300u);
+    EXPECT_GE(cache.peak_weight(), 600u);
+    for (int i = 0; i < 50; ++i)
+    {
+        cache.put(std::to_string(i), std::string(100, 'x'));
+        ASSERT_LE(cache.weight(), 1000u);
+    }
+}
+
+TEST(TinyLfuCacheTest, GrowingAnEntryInPlaceEvictsTheOthers)
+{
+    Cache::TinyLfuCache<std::string, std::string> cache(100, [](const std::string &, const std::string &value) { return value.size(); });
+    EXPECT_TRUE(cache.put("a", std::string(5, 'a')));
+    EXPECT_TRUE(cache.put("b", std::string(5, 'b')));
+    EXPECT_TRUE(cache.put("a", std::string(96, 'a')));
+    EXPECT_EQ(cache.get("a"), std::string(96, 'a'));
+    EXPECT_FALSE(cache.contains("b"));
+    EXPECT_EQ(cache.weight(), 96u);
+}
+
+TEST(TinyLfuCacheTest, ShardedCacheReportsHitRatios)
+{
+    using Sharded = Cache::ShardedLruCache<std::string, std::string>;
+    Sharded cache(
+        1000, 2, [](const std::string &, const std::string &value) { return value.size(); }, 0.5,
+        Cache::EvictionPolicy::WTinyLfu);
+    EXPECT_EQ(cache.policy(), Cache::EvictionPolicy::WTinyLfu);
+
+    EXPECT_EQ(cache.get("a"), std::nullopt);
+    cache.put("a", std::string(100, 'a'));
+    for (int i = 0; i < 3; ++i)
+        EXPECT_TRUE(cache.get("a"));
+
+    Sharded::Stats stats = cache.stats();
+    EXPECT_EQ(stats.hits, 3u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_DOUBLE_EQ(stats.hit_ratio(), 0.75);
+    EXPECT_EQ(stats.hit_weight, 300u);
+    EXPECT_EQ(stats.fill_weight, 100u);
+    EXPECT_DOUBLE_EQ(stats.byte_hit_ratio(), 0.75);
+
+    cache.clear();
+    EXPECT_EQ(cache.stats().hit_weight, 0u);
+    EXPECT_EQ(cache.weight(), 0u);
+}